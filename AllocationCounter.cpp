@@ -0,0 +1,98 @@
+#include "AllocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <malloc.h>
+#include <new>
+
+namespace jRenderer {
+
+namespace {
+
+std::atomic<uint64_t> g_allocations = 0;
+std::atomic<uint64_t> g_bytes = 0;
+
+void Count(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    g_bytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+} // namespace
+
+uint64_t AllocationCounter::GetAllocations() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+uint64_t AllocationCounter::GetBytes() {
+    return g_bytes.load(std::memory_order_relaxed);
+}
+
+} // namespace jRenderer
+
+// Every form is replaced, so no new or delete of the runtime is left to
+// pair with these on another heap.
+void *operator new(size_t size) {
+    jRenderer::Count(size);
+    if (void *p = malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size) { return operator new(size); }
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept {
+    jRenderer::Count(size);
+    return malloc(size ? size : 1);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+void operator delete(void *p, const std::nothrow_t &) noexcept { free(p); }
+void operator delete[](void *p, const std::nothrow_t &) noexcept { free(p); }
+
+void *operator new(size_t size, std::align_val_t alignment) {
+    jRenderer::Count(size);
+    if (void *p = _aligned_malloc(size ? size : 1, size_t(alignment)))
+        return p;
+    throw std::bad_alloc();
+}
+
+void *operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void *operator new(size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+    jRenderer::Count(size);
+    return _aligned_malloc(size ? size : 1, size_t(alignment));
+}
+
+void *operator new[](size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &tag) noexcept {
+    return operator new(size, alignment, tag);
+}
+
+void operator delete(void *p, std::align_val_t) noexcept { _aligned_free(p); }
+void operator delete[](void *p, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+void operator delete(void *p, size_t, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+void operator delete[](void *p, size_t, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+void operator delete(void *p, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+    _aligned_free(p);
+}
+void operator delete[](void *p, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+    _aligned_free(p);
+}
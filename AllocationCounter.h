@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+namespace jRenderer {
+
+// Counts the calls of the global operator new, of all threads, since the
+// start of the program. AllocationCounter.cpp replaces the operator, so
+// everything that allocates through new, the std containers too, is
+// counted. The difference across a frame is what it allocated.
+class AllocationCounter {
+  public:
+    static uint64_t GetAllocations();
+    static uint64_t GetBytes();
+};
+
+} // namespace jRenderer
@@ -1,11 +1,14 @@
 #include "AppBase.h"
 
 #include <algorithm>
+#include <chrono>
 #include <directxtk/SimpleMath.h>
 #include <random>
 
+#include "AllocationCounter.h"
 #include "D3D11Utils.h"
 #include "GraphicsCommon.h"
+#include "JobSystem.h"
 
 // imgui_impl_win32.cpp ǵ ޽ ó Լ   
 // Vcpkg  IMGUI   ٷ    
@@ -46,6 +49,11 @@ AppBase::~AppBase() {
     ImGui::DestroyContext();
 
     DestroyWindow(m_mainWindow);
+
+    // Its rebuilds run on the job system
+    m_hotReload.Stop();
+    JobSystem::Shutdown();
+    Graphics::ShutdownStates();
 }
 
 float AppBase::GetAspectRatio() const {
@@ -53,10 +61,25 @@ float AppBase::GetAspectRatio() const {
 }
 
 int AppBase::Run() {
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms = std::chrono::duration<float, std::milli>;
+
+    m_framePipeline.Reset(m_maxFramesInFlight);
+    auto lastPresent = Clock::now();
+    // States created from now on stall a frame
+    Graphics::stateCache.SetLoading(false);
+
+    // The first frames still grow the reused vectors, buffers and pools.
+    constexpr int ALLOCATION_CHECK_WARMUP = 60;
+    int checkedFrames = -ALLOCATION_CHECK_WARMUP;
+    int allocatingFrames = 0;
+    uint64_t lastAllocations = AllocationCounter::GetAllocations();
 
     // Main message loop
     MSG msg = {0};
     while (WM_QUIT != msg.message) {
+        // ޽ ó GUI Update()  ¸ ǵ帮Ƿ ٴ.
+        std::unique_lock<std::mutex> simLock(m_simMutex);
         if (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
             TranslateMessage(&msg);
             DispatchMessage(&msg);
@@ -76,19 +99,106 @@ int AppBase::Run() {
             ImGui::End();
             ImGui::Render();
 
-            Update(ImGui::GetIO().DeltaTime);
-
-            Render(); // <- ߿: 츮  
+            // Mode and depth only change between frames. Reloaded resources
+            // are swapped in then too, with no snapshot in flight that
+            // still indexes the old meshes.
+            const bool hasReloads = m_hotReload.HasPending();
+            if (m_updateThread.joinable() != m_usePipelinedLoop ||
+                m_framePipeline.GetDepth() != m_maxFramesInFlight ||
+                hasReloads) {
+                simLock.unlock(); // the update thread may be waiting for it
+                StopUpdateThread();
+                m_framePipeline.Reset(m_maxFramesInFlight);
+                if (hasReloads && m_hotReload.Apply())
+                    OnHotReload();
+                if (m_usePipelinedLoop)
+                    StartUpdateThread();
+                simLock.lock();
+            }
+
+            if (!m_usePipelinedLoop) {
+                RenderSnapshot *snapshot = m_framePipeline.BeginWrite();
+                snapshot->inputTime = Clock::now();
+                Update(ImGui::GetIO().DeltaTime);
+                BuildSnapshot(*snapshot);
+                m_framePipeline.EndWrite();
+            }
+            simLock.unlock();
+
+            const RenderSnapshot *snapshot = m_framePipeline.BeginRead();
+            m_frameStats.framesInFlight = m_framePipeline.GetQueuedFrames();
+
+            m_frameArena.Reset();
+            Render(*snapshot); // <- ߿: 츮  
 
             // GUI 
             ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
 
             // GUI  Ŀ Present() ȣ
             m_swapChain->Present(1, 0);
+
+            const auto now = Clock::now();
+            m_frameStats.Add(Ms(now - lastPresent).count(),
+                             Ms(now - snapshot->inputTime).count());
+            lastPresent = now;
+            m_framePipeline.EndRead();
+
+            // Everything since the last present, of all threads: messages,
+            // Update() and BuildSnapshot() here or on the update thread,
+            // Render() and the GUI
+            const uint64_t allocations = AllocationCounter::GetAllocations();
+            m_frameStats.frameAllocations = allocations - lastAllocations;
+            lastAllocations = allocations;
+
+            if (m_allocationCheckFrames > 0) {
+                if (checkedFrames >= 0 && m_frameStats.frameAllocations)
+                    allocatingFrames++;
+                if (++checkedFrames == m_allocationCheckFrames) {
+                    std::cout << allocatingFrames << " of "
+                              << m_allocationCheckFrames
+                              << " frames allocated"
+                              << std::endl;
+                    PostQuitMessage(0);
+                }
+            }
         }
     }
 
-    return 0;
+    StopUpdateThread();
+
+    return allocatingFrames ? -1 : 0;
+}
+
+void AppBase::StartUpdateThread() {
+    m_updateThread = std::thread(&AppBase::UpdateThreadMain, this);
+}
+
+void AppBase::StopUpdateThread() {
+    if (m_updateThread.joinable()) {
+        m_framePipeline.Close();
+        m_updateThread.join();
+    }
+}
+
+void AppBase::UpdateThreadMain() {
+    using Clock = std::chrono::high_resolution_clock;
+
+    auto prevTime = Clock::now();
+    while (RenderSnapshot *snapshot = m_framePipeline.BeginWrite()) {
+        {
+            std::lock_guard<std::mutex> lock(m_simMutex);
+
+            const auto now = Clock::now();
+            const float dt =
+                std::chrono::duration<float>(now - prevTime).count();
+            prevTime = now;
+
+            snapshot->inputTime = now;
+            Update(dt);
+            BuildSnapshot(*snapshot);
+        }
+        m_framePipeline.EndWrite();
+    }
 }
 
 void AppBase::OnMouseMove(int mouseX, int mouseY) {
@@ -189,6 +299,8 @@ LRESULT AppBase::MsgProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam) {
 }
 
 bool AppBase::Initialize() {
+    JobSystem::Initialize();
+
     if (!InitMainWindow())
         return false;
 
@@ -366,7 +478,9 @@ void AppBase::SetMainViewport() {
     m_context->RSSetViewports(1, &m_screenViewport);
 }
 
-void AppBase::SetShadowViewport() {
+void AppBase::SetShadowViewport() { SetShadowViewport(m_context); }
+
+void AppBase::SetShadowViewport(ComPtr<ID3D11DeviceContext> &context) {
 
     // Set the viewport
     D3D11_VIEWPORT shadowViewport;
@@ -378,29 +492,39 @@ void AppBase::SetShadowViewport() {
     shadowViewport.MinDepth = 0.0f;
     shadowViewport.MaxDepth = 1.0f;
 
-    m_context->RSSetViewports(1, &shadowViewport);
+    context->RSSetViewports(1, &shadowViewport);
 }
 
 void AppBase::SetGlobalConsts(ComPtr<ID3D11Buffer> &globalConstsGPU) {
+    SetGlobalConsts(m_context, globalConstsGPU);
+}
+
+void AppBase::SetGlobalConsts(ComPtr<ID3D11DeviceContext> &context,
+                              ComPtr<ID3D11Buffer> &globalConstsGPU) {
     // ̴ ϰ  register(b1)
-    m_context->VSSetConstantBuffers(1, 1, globalConstsGPU.GetAddressOf());
-    m_context->PSSetConstantBuffers(1, 1, globalConstsGPU.GetAddressOf());
-    m_context->GSSetConstantBuffers(1, 1, globalConstsGPU.GetAddressOf());
+    context->VSSetConstantBuffers(1, 1, globalConstsGPU.GetAddressOf());
+    context->PSSetConstantBuffers(1, 1, globalConstsGPU.GetAddressOf());
+    context->GSSetConstantBuffers(1, 1, globalConstsGPU.GetAddressOf());
 }
 
 void AppBase::SetPipelineState(const GraphicsPSO &pso) {
-    m_context->VSSetShader(pso.m_vertexShader.Get(), 0, 0);
-    m_context->PSSetShader(pso.m_pixelShader.Get(), 0, 0);
-    // m_context->HSSetShader(pso.m_hullShader.Get(), 0, 0);
-    // m_context->DSSetShader(pso.m_domainShader.Get(), 0, 0);
-    m_context->GSSetShader(pso.m_geometryShader.Get(), 0, 0);
-    m_context->IASetInputLayout(pso.m_inputLayout.Get());
-    m_context->RSSetState(pso.m_rasterizerState.Get());
-    m_context->OMSetBlendState(pso.m_blendState.Get(), pso.m_blendFactor,
-                               0xffffffff);
-    m_context->OMSetDepthStencilState(pso.m_depthStencilState.Get(),
-                                      pso.m_stencilRef);
-    m_context->IASetPrimitiveTopology(pso.m_primitiveTopology);
+    SetPipelineState(m_context, pso);
+}
+
+void AppBase::SetPipelineState(ComPtr<ID3D11DeviceContext> &context,
+                               const GraphicsPSO &pso) {
+    context->VSSetShader(pso.m_vertexShader.Get(), 0, 0);
+    context->PSSetShader(pso.m_pixelShader.Get(), 0, 0);
+    // context->HSSetShader(pso.m_hullShader.Get(), 0, 0);
+    // context->DSSetShader(pso.m_domainShader.Get(), 0, 0);
+    context->GSSetShader(pso.m_geometryShader.Get(), 0, 0);
+    context->IASetInputLayout(pso.m_inputLayout.Get());
+    context->RSSetState(pso.m_rasterizerState.Get());
+    context->OMSetBlendState(pso.m_blendState.Get(), pso.m_blendFactor,
+                             0xffffffff);
+    context->OMSetDepthStencilState(pso.m_depthStencilState.Get(),
+                                    pso.m_stencilRef);
+    context->IASetPrimitiveTopology(pso.m_primitiveTopology);
 }
 
 void AppBase::CreateBuffers() {
@@ -444,43 +568,6 @@ void AppBase::CreateBuffers() {
     // ThrowIfFailed(m_device->CreateRenderTargetView(m_floatBuffer.Get(), NULL,
     //                                                m_floatRTV.GetAddressOf()));
 
-    // NO MSAA RTV / SRV for PostPrecessing
-    D3D11_TEXTURE2D_DESC desc;
-    backBuffer->GetDesc(&desc);
-    desc.MipLevels = desc.ArraySize = 1;
-    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
-    desc.Format = DXGI_FORMAT_R16G16B16A16_FLOAT;
-    desc.Usage = D3D11_USAGE_DEFAULT; // It can copy from staging texture.
-    desc.MiscFlags = 0;
-    desc.CPUAccessFlags = 0;
-    desc.SampleDesc.Count = 1;
-    desc.SampleDesc.Quality = 0;
-
-    ThrowIfFailed(m_device->CreateTexture2D(&desc, NULL,
-                                            m_resolvedBuffer.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateRenderTargetView(
-        m_resolvedBuffer.Get(), NULL, m_resolvedRTV.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateShaderResourceView(
-        m_resolvedBuffer.Get(), NULL, m_resolvedSRV.GetAddressOf()));
-
-    // NO MSAA RTV / SRV for CubeMap
-    ThrowIfFailed(
-        m_device->CreateTexture2D(&desc, NULL, m_cubeMapBuffer.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateRenderTargetView(
-        m_cubeMapBuffer.Get(), NULL, m_cubeMapRTV.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateShaderResourceView(
-        m_cubeMapBuffer.Get(), NULL, m_cubeMapSRV.GetAddressOf()));
-
-    // NO MSAA RTV / SRV for CubeMap
-    ThrowIfFailed(m_device->CreateTexture2D(
-        &desc, NULL, m_cubeMapStencilBuffer.GetAddressOf()));
-    ThrowIfFailed(
-        m_device->CreateRenderTargetView(m_cubeMapStencilBuffer.Get(), NULL,
-                                         m_cubeMapStencilRTV.GetAddressOf()));
-    ThrowIfFailed(
-        m_device->CreateShaderResourceView(m_cubeMapStencilBuffer.Get(), NULL,
-                                           m_cubeMapStencilSRV.GetAddressOf()));
-
     // G-Buffer
     ThrowIfFailed(m_gBuffer.Init(m_device, m_screenWidth, m_screenHeight));
 
@@ -488,6 +575,7 @@ void AppBase::CreateBuffers() {
     // 0  1  յϰ Ÿ  ϱ  յ 
     std::uniform_real_distribution<float> randomFloats(0.0f, 1.0f);
     std::default_random_engine generator;
+    ssaoNoise.clear();
     for (int i = 0; i < 16; i++) {
         Vector3 tmp = Vector3(randomFloats(generator) * 2.0f - 1.0f,
                               randomFloats(generator) * 2.0f - 1.0f, 0.0f);
@@ -503,29 +591,130 @@ void AppBase::CreateBuffers() {
         float scale = (float)i / 64.0f;
         scale = lerp(0.1f, 1.0f, scale * scale);
         _sample *= scale;
-        kernel.samples[i] = _sample;
+        kernel.samples[i] = Vector4(_sample.x, _sample.y, _sample.z, 0.0f);
     }
     D3D11Utils::CreateConstBuffer(m_device, kernel, m_kernelSamplesGPU);
     D3D11Utils::CreateTexture2D(m_device, ssaoNoise, m_ssaoNoise,
                                 m_ssaoNoiseSRV);
 
-    // SSAO
-    ThrowIfFailed(
-        m_device->CreateTexture2D(&desc, NULL, m_ssaoTex.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateRenderTargetView(m_ssaoTex.Get(), NULL,
-                                                   m_ssaoRTV.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateShaderResourceView(m_ssaoTex.Get(), NULL,
-                                                     m_ssaoSRV.GetAddressOf()));
+    CreateTransientTargets();
+    CreateSsaoBuffers();
+    CreateDepthBuffers();
+}
 
-    // SSAO Blur
-    ThrowIfFailed(
-        m_device->CreateTexture2D(&desc, NULL, m_ssaoBlurTex.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateRenderTargetView(
-        m_ssaoBlurTex.Get(), NULL, m_ssaoBlurRTV.GetAddressOf()));
-    ThrowIfFailed(m_device->CreateShaderResourceView(
-        m_ssaoBlurTex.Get(), NULL, m_ssaoBlurSRV.GetAddressOf()));
+void AppBase::CreateTransientTargets() {
+    const UINT width = UINT(m_screenWidth);
+    const UINT height = UINT(m_screenHeight);
+    const UINT colorBind =
+        D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    // The SSAO targets share a key, so they can share textures.
+    const UINT aoBind = colorBind | D3D11_BIND_UNORDERED_ACCESS;
+    const auto colorDesc = RenderTargetPool::MakeDesc(
+        width, height, DXGI_FORMAT_R16G16B16A16_FLOAT, colorBind);
+    const auto aoDesc = RenderTargetPool::MakeDesc(
+        width, height, DXGI_FORMAT_R8_UNORM, aoBind);
+
+    auto &graph = m_frameGraph;
+    auto &res = m_frameResources;
+    graph.Clear();
+    res.backBuffer = graph.ImportResource("BackBuffer");
+    res.depthStencil = graph.ImportResource("DepthStencil");
+    res.shadowAtlas = graph.ImportResource("ShadowAtlas");
+    res.cascadeShadowMap = graph.ImportResource("CascadeShadowMap");
+    res.albedoAO = graph.ImportResource("AlbedoAO");
+    res.normalMaterial = graph.ImportResource("NormalMaterial");
+    res.depth = graph.ImportResource("Depth");
+    res.ssaoHistory = graph.ImportResource("SSAOHistory");
+    res.lighting = graph.CreateResource("Lighting", colorDesc);
+    res.cubeMap = graph.CreateResource("CubeMap", colorDesc);
+    res.ssao = graph.CreateResource("SSAO", aoDesc);
+    res.ssaoBlurTemp = graph.CreateResource("SSAOBlurTemp", aoDesc);
+    res.ssaoBlur = graph.CreateResource("SSAOBlur", aoDesc);
+    AddFramePasses();
+    graph.Compile();
+
+    // Resources no pass uses get no texture.
+    m_targetPool.Reset();
+    vector<uint32_t> handles(graph.GetNumResources(), UINT32_MAX);
+    for (uint32_t r = 0; r < graph.GetNumResources(); r++) {
+        const auto &lifetime = graph.GetLifetime(r);
+        if (!graph.IsTransient(r) || !lifetime.IsUsed())
+            continue;
+        const auto &desc = graph.GetDesc(r);
+        handles[r] = m_targetPool.Request(
+            desc.width, desc.height, DXGI_FORMAT(desc.format), desc.bindFlags,
+            lifetime.firstPass, lifetime.lastPass, desc.sampleCount);
+    }
+    m_targetPool.Allocate(m_device);
 
-    CreateDepthBuffers();
+    m_frameTargets.assign(graph.GetNumResources(), PooledTarget());
+    for (uint32_t r = 0; r < graph.GetNumResources(); r++) {
+        if (handles[r] != UINT32_MAX)
+            m_frameTargets[r] = m_targetPool.Get(handles[r]);
+    }
+
+    const auto &resolvedTarget = m_frameTargets[res.lighting];
+    m_resolvedBuffer = resolvedTarget.texture;
+    m_resolvedRTV = resolvedTarget.rtv;
+    m_resolvedSRV = resolvedTarget.srv;
+
+    const auto &cubeMapTarget = m_frameTargets[res.cubeMap];
+    m_cubeMapBuffer = cubeMapTarget.texture;
+    m_cubeMapRTV = cubeMapTarget.rtv;
+    m_cubeMapSRV = cubeMapTarget.srv;
+
+    const auto &ssaoBlurTarget = m_frameTargets[res.ssaoBlur];
+    m_ssaoBlurTex = ssaoBlurTarget.texture;
+    m_ssaoBlurRTV = ssaoBlurTarget.rtv;
+    m_ssaoBlurSRV = ssaoBlurTarget.srv;
+    m_ssaoBlurUAV = ssaoBlurTarget.uav;
+
+    const auto &ssaoTarget = m_frameTargets[res.ssao];
+    m_ssaoTex = ssaoTarget.texture;
+    m_ssaoRTV = ssaoTarget.rtv;
+    m_ssaoSRV = ssaoTarget.srv;
+
+    const auto &ssaoBlurTempTarget = m_frameTargets[res.ssaoBlurTemp];
+    m_ssaoBlurTempTex = ssaoBlurTempTarget.texture;
+    m_ssaoBlurTempSRV = ssaoBlurTempTarget.srv;
+    m_ssaoBlurTempUAV = ssaoBlurTempTarget.uav;
+}
+
+void AppBase::CreateSsaoBuffers() {
+    m_ssaoWidth = (m_screenWidth + m_ssaoScale - 1) / m_ssaoScale;
+    m_ssaoHeight = (m_screenHeight + m_ssaoScale - 1) / m_ssaoScale;
+    m_ssaoBufferVersion++;
+
+    D3D11_TEXTURE2D_DESC desc;
+    ZeroMemory(&desc, sizeof(desc));
+    desc.Width = m_ssaoWidth;
+    desc.Height = m_ssaoHeight;
+    desc.MipLevels = desc.ArraySize = 1;
+    desc.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.SampleDesc.Count = 1;
+
+    for (int i = 0; i < 2; i++) {
+        desc.Format = DXGI_FORMAT_R8_UNORM;
+        ThrowIfFailed(m_device->CreateTexture2D(
+            &desc, NULL, m_ssaoHistoryTex[i].ReleaseAndGetAddressOf()));
+        ThrowIfFailed(m_device->CreateRenderTargetView(
+            m_ssaoHistoryTex[i].Get(), NULL,
+            m_ssaoHistoryRTV[i].ReleaseAndGetAddressOf()));
+        ThrowIfFailed(m_device->CreateShaderResourceView(
+            m_ssaoHistoryTex[i].Get(), NULL,
+            m_ssaoHistorySRV[i].ReleaseAndGetAddressOf()));
+
+        desc.Format = DXGI_FORMAT_R32_FLOAT;
+        ThrowIfFailed(m_device->CreateTexture2D(
+            &desc, NULL, m_ssaoDepthTex[i].ReleaseAndGetAddressOf()));
+        ThrowIfFailed(m_device->CreateRenderTargetView(
+            m_ssaoDepthTex[i].Get(), NULL,
+            m_ssaoDepthRTV[i].ReleaseAndGetAddressOf()));
+        ThrowIfFailed(m_device->CreateShaderResourceView(
+            m_ssaoDepthTex[i].Get(), NULL,
+            m_ssaoDepthSRV[i].ReleaseAndGetAddressOf()));
+    }
 }
 
 //  ü  ϴ Const Ʈ
@@ -552,8 +741,7 @@ void AppBase::UpdateGlobalConstants(const Vector3 &eyeWorld,
     // m_reflectGlobalConstsCPU.invViewProj =
     //     m_reflectGlobalConstsCPU.viewProj.Invert();
 
-    D3D11Utils::UpdateBuffer(m_device, m_context, m_globalConstsCPU,
-                             m_globalConstsGPU);
+    // GPU ۴ Render() κ ƮѴ.
     // D3D11Utils::UpdateBuffer(m_device, m_context, m_reflectGlobalConstsCPU,
     //                          m_reflectGlobalConstsGPU);
 }
@@ -593,18 +781,17 @@ void AppBase::CreateDepthBuffers() {
     ThrowIfFailed(m_device->CreateTexture2D(&desc, NULL,
                                             m_depthOnlyBuffer.GetAddressOf()));
 
-    // Shadow 
+    // Shadow atlas
+    desc.Width = m_shadowAtlasSize;
+    desc.Height = m_shadowAtlasSize;
+    ThrowIfFailed(m_device->CreateTexture2D(
+        &desc, NULL, m_shadowAtlasBuffer.GetAddressOf()));
+    // cascaded shadow map
     desc.Width = m_shadowWidth;
     desc.Height = m_shadowHeight;
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        ThrowIfFailed(m_device->CreateTexture2D(
-            &desc, NULL, m_shadowOnlyBuffers[i].GetAddressOf()));
-    }
-    // shadowCubeMap
-    desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
-    desc.ArraySize = 6;
+    desc.ArraySize = NUM_CASCADES;
     ThrowIfFailed(m_device->CreateTexture2D(
-        &desc, NULL, m_shadowCubeBuffers.GetAddressOf()));
+        &desc, NULL, m_cascadeShadowBuffer.GetAddressOf()));
 
     D3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc;
     ZeroMemory(&dsvDesc, sizeof(dsvDesc));
@@ -613,21 +800,21 @@ void AppBase::CreateDepthBuffers() {
     ThrowIfFailed(m_device->CreateDepthStencilView(
         m_depthOnlyBuffer.Get(), &dsvDesc, m_depthOnlyDSV.GetAddressOf()));
 
-    // Shadow 
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        ThrowIfFailed(m_device->CreateDepthStencilView(
-            m_shadowOnlyBuffers[i].Get(), &dsvDesc,
-            m_shadowOnlyDSVs[i].GetAddressOf()));
-    }
+    // Shadow atlas
+    ThrowIfFailed(m_device->CreateDepthStencilView(
+        m_shadowAtlasBuffer.Get(), &dsvDesc, m_shadowAtlasDSV.GetAddressOf()));
 
     dsvDesc.Format = DXGI_FORMAT_D32_FLOAT;
     dsvDesc.ViewDimension = D3D11_DSV_DIMENSION_TEXTURE2DARRAY;
-    dsvDesc.Texture2DArray.ArraySize = 6;
-    dsvDesc.Texture2DArray.FirstArraySlice = 0;
+    dsvDesc.Texture2DArray.ArraySize = 1;
     dsvDesc.Texture2DArray.MipSlice = 0;
     dsvDesc.Flags = 0;
-    ThrowIfFailed(m_device->CreateDepthStencilView(
-        m_shadowCubeBuffers.Get(), &dsvDesc, m_shadowCubeDSVs.GetAddressOf()));
+    for (int i = 0; i < NUM_CASCADES; i++) {
+        dsvDesc.Texture2DArray.FirstArraySlice = i;
+        ThrowIfFailed(m_device->CreateDepthStencilView(
+            m_cascadeShadowBuffer.Get(), &dsvDesc,
+            m_cascadeShadowDSVs[i].GetAddressOf()));
+    }
 
     D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
     ZeroMemory(&srvDesc, sizeof(srvDesc));
@@ -638,22 +825,21 @@ void AppBase::CreateDepthBuffers() {
     ThrowIfFailed(m_device->CreateShaderResourceView(
         m_depthOnlyBuffer.Get(), &srvDesc, m_depthOnlySRV.GetAddressOf()));
 
-    // Shadow 
-    srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        ThrowIfFailed(m_device->CreateShaderResourceView(
-            m_shadowOnlyBuffers[i].Get(), &srvDesc,
-            m_shadowOnlySRVs[i].GetAddressOf()));
-    }
+    // Shadow atlas
+    ThrowIfFailed(m_device->CreateShaderResourceView(
+        m_shadowAtlasBuffer.Get(), &srvDesc, m_shadowAtlasSRV.GetAddressOf()));
 
-    // shadowCube 
+    // cascaded shadow map 
     ZeroMemory(&srvDesc, sizeof(srvDesc));
     srvDesc.Format = DXGI_FORMAT_R32_FLOAT;
-    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
-    srvDesc.TextureCube.MostDetailedMip = 0;
-    srvDesc.TextureCube.MipLevels = 1;
+    srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+    srvDesc.Texture2DArray.MipLevels = 1;
+    srvDesc.Texture2DArray.ArraySize = NUM_CASCADES;
     ThrowIfFailed(m_device->CreateShaderResourceView(
-        m_shadowCubeBuffers.Get(), &srvDesc, m_shadowCubeSRVs.GetAddressOf()));
+        m_cascadeShadowBuffer.Get(), &srvDesc,
+        m_cascadeShadowSRV.GetAddressOf()));
+
+    m_shadowMapVersion++;
 }
 
 } // namespace jRenderer
\ No newline at end of file
@@ -5,13 +5,20 @@
 #include <imgui_impl_dx11.h>
 #include <imgui_impl_win32.h>
 #include <iostream>
+#include <mutex>
+#include <thread>
 #include <vector>
 
 #include "Camera.h"
 #include "ConstantBuffers.h"
 #include "D3D11Utils.h"
+#include "FrameGraph.h"
+#include "FramePipeline.h"
 #include "GBuffer.h"
 #include "GraphicsPSO.h"
+#include "HotReload.h"
+#include "MemoryArena.h"
+#include "RenderTargetPool.h"
 
 namespace jRenderer {
 
@@ -23,6 +30,25 @@ using std::shared_ptr;
 using std::vector;
 using std::wstring;
 
+// Resources of AppBase::m_frameGraph
+struct FrameResources {
+    // Imported, they live outside the frame.
+    uint32_t backBuffer;
+    uint32_t depthStencil; // m_depthStencilView, the skybox stencil
+    uint32_t shadowAtlas;
+    uint32_t cascadeShadowMap;
+    uint32_t albedoAO;
+    uint32_t normalMaterial;
+    uint32_t depth; // of the G-buffer
+    uint32_t ssaoHistory;
+    // Transient, pooled in m_targetPool by their lifetimes
+    uint32_t lighting;
+    uint32_t cubeMap;
+    uint32_t ssao; // upsampled to the screen
+    uint32_t ssaoBlurTemp;
+    uint32_t ssaoBlur;
+};
+
 class AppBase {
   public:
     AppBase();
@@ -34,8 +60,12 @@ class AppBase {
     virtual bool Initialize();
     virtual void UpdateGUI() = 0;
     virtual void Update(float dt) = 0;
-    virtual void Render() = 0;
+    // Copies what Render() needs, so Update() can move on to the next frame.
+    virtual void BuildSnapshot(RenderSnapshot &snapshot) = 0;
+    virtual void Render(const RenderSnapshot &snapshot) = 0;
     virtual void OnMouseMove(int mouseX, int mouseY);
+    // After m_hotReload swapped resources in, before the next Update()
+    virtual void OnHotReload() {}
     virtual LRESULT MsgProc(HWND hwnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
     void InitCubemaps(wstring basePath, wstring envFilename,
@@ -44,8 +74,19 @@ class AppBase {
     void UpdateGlobalConstants(const Vector3 &eyeWorld, const Matrix &viewRow,
                                const Matrix &projRow);
     void SetGlobalConsts(ComPtr<ID3D11Buffer> &globalConstsGPU);
+    void SetGlobalConsts(ComPtr<ID3D11DeviceContext> &context,
+                         ComPtr<ID3D11Buffer> &globalConstsGPU);
     void CreateDepthBuffers();
+    void CreateSsaoBuffers();
+    // Builds and compiles m_frameGraph for the current settings, then
+    // requests the intermediate targets from m_targetPool with the
+    // lifetimes of the graph. Again whenever the passes or sizes change.
+    void CreateTransientTargets();
+    // Declares the passes of the frame on m_frameResources
+    virtual void AddFramePasses() = 0;
     void SetPipelineState(const GraphicsPSO &pso);
+    void SetPipelineState(ComPtr<ID3D11DeviceContext> &context,
+                          const GraphicsPSO &pso);
     bool UpdateMouseControl(const BoundingSphere &bs, Quaternion &q,
                             Vector3 &dragTranslation, Vector3 &pickPoint);
 
@@ -56,6 +97,10 @@ class AppBase {
     void CreateBuffers();
     void SetMainViewport();
     void SetShadowViewport();
+    void SetShadowViewport(ComPtr<ID3D11DeviceContext> &context);
+    void StartUpdateThread();
+    void StopUpdateThread();
+    void UpdateThreadMain();
 
   public:
     int m_screenWidth;
@@ -78,12 +123,14 @@ class AppBase {
     ComPtr<ID3D11RenderTargetView> m_resolvedRTV;
     ComPtr<ID3D11ShaderResourceView> m_resolvedSRV;
 
-    // CubeMap
-    ComPtr<ID3D11Texture2D> m_cubeMapStencilBuffer;
-    ComPtr<ID3D11RenderTargetView> m_cubeMapStencilRTV;
-    ComPtr<ID3D11ShaderResourceView> m_cubeMapStencilSRV;
+    // Frame graph of Render(), the intermediate targets and the views
+    // below are from m_targetPool.
+    FrameGraph m_frameGraph;
+    FrameResources m_frameResources = {};
+    vector<PooledTarget> m_frameTargets; // per graph resource
+    RenderTargetPool m_targetPool;
 
-    // CubeMap2
+    // CubeMap
     ComPtr<ID3D11Texture2D> m_cubeMapBuffer;
     ComPtr<ID3D11RenderTargetView> m_cubeMapRTV;
     ComPtr<ID3D11ShaderResourceView> m_cubeMapSRV;
@@ -109,6 +156,25 @@ class AppBase {
     ComPtr<ID3D11Texture2D> m_ssaoBlurTex;
     ComPtr<ID3D11RenderTargetView> m_ssaoBlurRTV;
     ComPtr<ID3D11ShaderResourceView> m_ssaoBlurSRV;
+    ComPtr<ID3D11UnorderedAccessView> m_ssaoBlurUAV;
+    bool m_useComputeSsaoBlur = true; // or the pixel shader
+    // Horizontal pass of the compute blur
+    ComPtr<ID3D11Texture2D> m_ssaoBlurTempTex;
+    ComPtr<ID3D11ShaderResourceView> m_ssaoBlurTempSRV;
+    ComPtr<ID3D11UnorderedAccessView> m_ssaoBlurTempUAV;
+
+    // SSAO at 1/m_ssaoScale of the screen, AO and view depth. Two of each,
+    // the targets of the last frame are the history of this one.
+    int m_ssaoScale = 2;
+    uint32_t m_ssaoWidth = 0;
+    uint32_t m_ssaoHeight = 0;
+    uint32_t m_ssaoBufferVersion = 0; // the history is lost on changes
+    ComPtr<ID3D11Texture2D> m_ssaoHistoryTex[2];
+    ComPtr<ID3D11RenderTargetView> m_ssaoHistoryRTV[2];
+    ComPtr<ID3D11ShaderResourceView> m_ssaoHistorySRV[2];
+    ComPtr<ID3D11Texture2D> m_ssaoDepthTex[2];
+    ComPtr<ID3D11RenderTargetView> m_ssaoDepthRTV[2];
+    ComPtr<ID3D11ShaderResourceView> m_ssaoDepthSRV[2];
 
         // Camera Class
         Camera m_camera;
@@ -135,15 +201,19 @@ class AppBase {
     GlobalConstants m_shadowGlobalConstsCPU[MAX_LIGHTS];
     ComPtr<ID3D11Buffer> m_shadowGlobalConstsGPU[MAX_LIGHTS];
 
-    // Shadow Buffer
-    ComPtr<ID3D11Texture2D> m_shadowOnlyBuffers[MAX_LIGHTS]; // No MSAA
-    ComPtr<ID3D11DepthStencilView> m_shadowOnlyDSVs[MAX_LIGHTS];
-    ComPtr<ID3D11ShaderResourceView> m_shadowOnlySRVs[MAX_LIGHTS];
+    // Changes whenever the shadow maps are recreated
+    uint32_t m_shadowMapVersion = 0;
+
+    // Shadow atlas, spot lights and the 6 faces of point lights as tiles
+    int m_shadowAtlasSize = 4096;
+    ComPtr<ID3D11Texture2D> m_shadowAtlasBuffer; // No MSAA
+    ComPtr<ID3D11DepthStencilView> m_shadowAtlasDSV;
+    ComPtr<ID3D11ShaderResourceView> m_shadowAtlasSRV;
 
-    // Shadow CubeMap
-    ComPtr<ID3D11Texture2D> m_shadowCubeBuffers; // No MSAA
-    ComPtr<ID3D11DepthStencilView> m_shadowCubeDSVs;
-    ComPtr<ID3D11ShaderResourceView> m_shadowCubeSRVs;
+    // Cascaded shadow map, one array slice per cascade
+    ComPtr<ID3D11Texture2D> m_cascadeShadowBuffer; // No MSAA
+    ComPtr<ID3D11DepthStencilView> m_cascadeShadowDSVs[NUM_CASCADES];
+    ComPtr<ID3D11ShaderResourceView> m_cascadeShadowSRV;
 
     ShadowLightTransform m_pointLightTransformCPU[MAX_LIGHTS];
     ComPtr<ID3D11Buffer> m_pointLightTransformGPU[MAX_LIGHTS];
@@ -167,6 +237,26 @@ class AppBase {
     GBuffer m_gBuffer;
 
     bool m_lightRotate = false;
+
+    // Frame Pipeline
+    // Pipelined: an update thread simulates frame N+1 while this thread
+    // renders frame N, at most m_maxFramesInFlight frames ahead.
+    bool m_usePipelinedLoop = false;
+    int m_maxFramesInFlight = 1;
+    // --check-allocations: Run() quits after this many frames past the
+    // warm-up and fails if any of them allocated, in the update or the
+    // render, with either loop.
+    int m_allocationCheckFrames = 0;
+    FramePipeline m_framePipeline;
+    FramePipelineStats m_frameStats;
+    // Per frame data of Render(), reset before each frame. Grows to the
+    // largest frame, after that it doesn't allocate.
+    LinearArena m_frameArena{"Frame", 1024 * 1024};
+    std::mutex m_simMutex; // Update() vs. messages and UpdateGUI()
+    std::thread m_updateThread;
+
+    // Shaders and assets rebuilt on file changes, swapped in by Run()
+    HotReload m_hotReload;
 };
 
 } // namespace jRenderer
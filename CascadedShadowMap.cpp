@@ -0,0 +1,136 @@
+#include "CascadedShadowMap.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jRenderer {
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+void CascadedShadowMap::ComputeSplits(float nearZ, float farZ, float lambda,
+                                      int count, float *splits) {
+    for (int i = 0; i <= count; i++) {
+        const float t = float(i) / float(count);
+        const float logSplit = nearZ * std::pow(farZ / nearZ, t);
+        const float uniformSplit = nearZ + (farZ - nearZ) * t;
+        splits[i] = lambda * logSplit + (1.0f - lambda) * uniformSplit;
+    }
+    splits[0] = nearZ;
+    splits[count] = farZ;
+}
+
+void CascadedShadowMap::Update(const Matrix &viewRow, const Matrix &projRow,
+                               const Vector3 &lightDir, int resolution) {
+    m_resolution = resolution;
+
+    // Camera near/far from the projection, ndc * w = z * _33 + _43
+    const Matrix &p = projRow;
+    auto depthToView = [&](float d) {
+        return (d * p._44 - p._43) / (p._33 - d * p._34);
+    };
+    const float cameraNear = depthToView(0.0f);
+    const float cameraFar = depthToView(1.0f);
+    const float farZ = std::min(cameraFar, m_maxDistance);
+
+    float splits[NUM_CASCADES + 1];
+    ComputeSplits(cameraNear, farZ, m_lambda, NUM_CASCADES, splits);
+
+    // View space corners of the camera frustum on the near and far plane.
+    // Fitting in view space gives the same radius every frame, only the
+    // center is moved to world space.
+    const Matrix invProj = projRow.Invert();
+    const Matrix invView = viewRow.Invert();
+    const float ndc[4][2] = {{-1, -1}, {1, -1}, {1, 1}, {-1, 1}};
+    Vector3 nearCorners[4];
+    Vector3 farCorners[4];
+    for (int k = 0; k < 4; k++) {
+        const Vector4 n = Vector4::Transform(
+            Vector4(ndc[k][0], ndc[k][1], 0.0f, 1.0f), invProj);
+        const Vector4 f = Vector4::Transform(
+            Vector4(ndc[k][0], ndc[k][1], 1.0f, 1.0f), invProj);
+        nearCorners[k] = Vector3(n.x, n.y, n.z) / n.w;
+        farCorners[k] = Vector3(f.x, f.y, f.z) / f.w;
+    }
+
+    Vector3 dir = lightDir;
+    dir.Normalize();
+    const Vector3 up = std::abs(dir.y) > 0.99f ? Vector3(0.0f, 0.0f, 1.0f)
+                                               : Vector3(0.0f, 1.0f, 0.0f);
+
+    for (int c = 0; c < NUM_CASCADES; c++) {
+        auto &cascade = m_cascades[c];
+        cascade.splitNear = splits[c];
+        cascade.splitFar = splits[c + 1];
+
+        // View depth is linear along each corner ray.
+        const float t0 = (splits[c] - cameraNear) / (cameraFar - cameraNear);
+        const float t1 =
+            (splits[c + 1] - cameraNear) / (cameraFar - cameraNear);
+        Vector3 corners[8];
+        Vector3 center(0.0f);
+        for (int k = 0; k < 4; k++) {
+            corners[k] = Vector3::Lerp(nearCorners[k], farCorners[k], t0);
+            corners[k + 4] = Vector3::Lerp(nearCorners[k], farCorners[k], t1);
+            center += corners[k] + corners[k + 4];
+        }
+        center /= 8.0f;
+
+        float radius = 0.0f;
+        for (const auto &corner : corners)
+            radius = std::max(radius, (corner - center).Length());
+        cascade.radius = std::ceil(radius * 16.0f) / 16.0f;
+        cascade.center = Vector3::Transform(center, invView);
+
+        const float r = cascade.radius;
+        const Vector3 eye = cascade.center - dir * (r + m_casterDistance);
+        cascade.viewRow = XMMatrixLookAtLH(eye, cascade.center, up);
+        cascade.projRow = XMMatrixOrthographicOffCenterLH(
+            -r, r, -r, r, 0.0f, 2.0f * r + m_casterDistance);
+
+        // The light view only translates from frame to frame. Moving the
+        // projection so that the world origin lands on a texel keeps every
+        // texel in place, so the edges don't shimmer.
+        const float halfRes = float(resolution) * 0.5f;
+        const Vector4 origin = Vector4::Transform(
+            Vector4(0.0f, 0.0f, 0.0f, 1.0f),
+            cascade.viewRow * cascade.projRow);
+        const float x = origin.x * halfRes;
+        const float y = origin.y * halfRes;
+        cascade.projRow._41 += (std::round(x) - x) / halfRes;
+        cascade.projRow._42 += (std::round(y) - y) / halfRes;
+
+        cascade.viewProjRow = cascade.viewRow * cascade.projRow;
+        cascade.frustum = Frustum::FromViewProj(cascade.viewProjRow);
+    }
+}
+
+uint32_t CascadedShadowMap::GetCasterMask(const Vector3 &boxMin,
+                                          const Vector3 &boxMax) const {
+    uint32_t mask = 0;
+    for (int c = 0; c < NUM_CASCADES; c++) {
+        if (m_cascades[c].frustum.Intersects(boxMin, boxMax))
+            mask |= 1u << c;
+    }
+    return mask;
+}
+
+void CascadedShadowMap::GetConstants(const Matrix &viewRow,
+                                     ShadowCascadeConstants &consts) const {
+    // clip xy [-1, 1] -> uv [0, 1], y down
+    Matrix clipToUV;
+    clipToUV._11 = 0.5f;
+    clipToUV._22 = -0.5f;
+    clipToUV._41 = 0.5f;
+    clipToUV._42 = 0.5f;
+
+    const Matrix invView = viewRow.Invert();
+    for (int c = 0; c < NUM_CASCADES; c++) {
+        consts.viewToShadow[c] =
+            (invView * m_cascades[c].viewProjRow * clipToUV).Transpose();
+        consts.splitFar[c] = m_cascades[c].splitFar;
+    }
+    consts.texelSize = 1.0f / float(m_resolution);
+}
+
+} // namespace jRenderer
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+
+#include "ConstantBuffers.h"
+#include "Culling.h"
+
+// ref
+// Parallel-Split Shadow Maps on Programmable GPUs (GPU Gems 3, ch. 10)
+// https://developer.nvidia.com/gpugems/gpugems3/part-ii-light-and-shadows/chapter-10-parallel-split-shadow-maps-programmable-gpus
+// Stable cascades: https://therealmjp.github.io/posts/shadow-maps/
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+
+struct ShadowCascade {
+    float splitNear = 0.0f; // camera view depth
+    float splitFar = 0.0f;
+
+    // Bounding sphere of the camera frustum slice, world space. The radius
+    // doesn't change when the camera rotates, so neither does the scale.
+    Vector3 center;
+    float radius = 0.0f;
+
+    Matrix viewRow;
+    Matrix projRow; // orthographic, origin snapped to the texel grid
+    Matrix viewProjRow;
+    Frustum frustum; // caster culling
+};
+
+// Splits the camera frustum for a directional light. Only math, no GPU.
+class CascadedShadowMap {
+  public:
+    // Practical split scheme: lambda blends the logarithmic (1) and the
+    // uniform (0) split. splits[0] = nearZ, splits[count] = farZ.
+    static void ComputeSplits(float nearZ, float farZ, float lambda,
+                              int count, float *splits);
+
+    // lightDir is the world space direction the light travels in.
+    // resolution is the width and height of one cascade.
+    void Update(const Matrix &viewRow, const Matrix &projRow,
+                const Vector3 &lightDir, int resolution);
+
+    const ShadowCascade &GetCascade(int i) const { return m_cascades[i]; }
+
+    // Bit i is set when the AABB may cast a shadow into cascade i.
+    uint32_t GetCasterMask(const Vector3 &boxMin,
+                           const Vector3 &boxMax) const;
+
+    // For the lighting pass, camera view space to each cascade.
+    void GetConstants(const Matrix &viewRow,
+                      ShadowCascadeConstants &consts) const;
+
+    float m_lambda = 0.75f;
+    float m_maxDistance = 30.0f;    // shadows end here or at the far plane
+    float m_casterDistance = 20.0f; // room for casters towards the light
+
+  private:
+    ShadowCascade m_cascades[NUM_CASCADES];
+    int m_resolution = 2048;
+};
+
+} // namespace jRenderer
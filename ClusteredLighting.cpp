@@ -0,0 +1,243 @@
+#include "ClusteredLighting.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "CpuFeatures.h"
+#include "JobSystem.h"
+
+namespace jRenderer {
+
+void LightClusterGrid::SetDimensions(uint32_t dimX, uint32_t dimY,
+                                     uint32_t dimZ) {
+    m_dimX = std::max(dimX, 1u);
+    m_dimY = std::max(dimY, 1u);
+    m_dimZ = std::max(dimZ, 1u);
+    m_isBuilt = false;
+}
+
+void LightClusterGrid::Build(const Matrix &projRow) {
+    if (m_isBuilt && projRow == m_projRow)
+        return;
+    m_projRow = projRow;
+    m_isBuilt = true;
+
+    // NDC -> view space, from ndc * w = view * P with w = z * _34 + _44.
+    // The same formulas work for perspective and orthographic projections.
+    const Matrix &p = projRow;
+    auto depthToView = [&](float d) {
+        return (d * p._44 - p._43) / (p._33 - d * p._34);
+    };
+    auto ndcToViewX = [&](float ndc, float z) {
+        return (ndc * (z * p._34 + p._44) - z * p._31 - p._41) / p._11;
+    };
+    auto ndcToViewY = [&](float ndc, float z) {
+        return (ndc * (z * p._34 + p._44) - z * p._32 - p._42) / p._22;
+    };
+
+    m_nearZ = std::max(depthToView(0.0f), 1e-4f);
+    m_farZ = std::max(depthToView(1.0f), m_nearZ * 1.01f);
+
+    m_boxMin.resize(GetClusterCount());
+    m_boxMax.resize(GetClusterCount());
+    m_slices.resize(m_dimZ);
+
+    for (uint32_t z = 0; z < m_dimZ; z++) {
+        // Exponential slices, so clusters are roughly cube shaped.
+        const float zNear =
+            m_nearZ * std::pow(m_farZ / m_nearZ, float(z) / m_dimZ);
+        const float zFar =
+            m_nearZ * std::pow(m_farZ / m_nearZ, float(z + 1) / m_dimZ);
+
+        for (uint32_t y = 0; y < m_dimY; y++) {
+            const float ndcY0 = 1.0f - 2.0f * float(y + 1) / m_dimY;
+            const float ndcY1 = 1.0f - 2.0f * float(y) / m_dimY;
+
+            for (uint32_t x = 0; x < m_dimX; x++) {
+                const float ndcX0 = -1.0f + 2.0f * float(x) / m_dimX;
+                const float ndcX1 = -1.0f + 2.0f * float(x + 1) / m_dimX;
+
+                const float xs[4] = {
+                    ndcToViewX(ndcX0, zNear), ndcToViewX(ndcX1, zNear),
+                    ndcToViewX(ndcX0, zFar), ndcToViewX(ndcX1, zFar)};
+                const float ys[4] = {
+                    ndcToViewY(ndcY0, zNear), ndcToViewY(ndcY1, zNear),
+                    ndcToViewY(ndcY0, zFar), ndcToViewY(ndcY1, zFar)};
+
+                const uint32_t cluster = x + m_dimX * (y + m_dimY * z);
+                m_boxMin[cluster] =
+                    Vector3(*std::min_element(xs, xs + 4),
+                            *std::min_element(ys, ys + 4), zNear);
+                m_boxMax[cluster] =
+                    Vector3(*std::max_element(xs, xs + 4),
+                            *std::max_element(ys, ys + 4), zFar);
+            }
+        }
+    }
+}
+
+ClusterConstants LightClusterGrid::GetConstants() const {
+    ClusterConstants consts;
+    consts.dimX = m_dimX;
+    consts.dimY = m_dimY;
+    consts.dimZ = m_dimZ;
+    consts.numLights = m_lights ? uint32_t(m_lights->size()) : 0;
+
+    const float logRatio = std::log(m_farZ / m_nearZ);
+    consts.sliceScale = float(m_dimZ) / logRatio;
+    consts.sliceBias = -float(m_dimZ) * std::log(m_nearZ) / logRatio;
+    return consts;
+}
+
+void LightClusterGrid::GetClusterBounds(uint32_t cluster, Vector3 &boxMin,
+                                        Vector3 &boxMax) const {
+    boxMin = m_boxMin[cluster];
+    boxMax = m_boxMax[cluster];
+}
+
+void LightClusterGrid::PrepareLights(const std::vector<ClusterLight> &lights) {
+    m_lights = &lights;
+    m_globalLights.clear();
+    m_localLights.clear();
+    for (uint32_t i = 0; i < uint32_t(lights.size()); i++) {
+        if (lights[i].type & LIGHT_DIRECTIONAL)
+            m_globalLights.push_back(i);
+        else if (lights[i].type & (LIGHT_POINT | LIGHT_SPOT))
+            m_localLights.push_back(i);
+    }
+}
+
+void LightClusterGrid::BinSlice(uint32_t z, bool useSimd) {
+    auto &slice = m_slices[z];
+    const uint32_t numTiles = m_dimX * m_dimY;
+    const uint32_t first = z * numTiles;
+    const float zNear = m_boxMin[first].z;
+    const float zFar = m_boxMax[first].z;
+
+    // Lights that overlap the depth range of this slice
+    slice.x.clear();
+    slice.y.clear();
+    slice.z.clear();
+    slice.radiusSq.clear();
+    slice.lightIndex.clear();
+    for (const auto i : m_localLights) {
+        const auto &light = (*m_lights)[i];
+        if (light.position.z + light.range < zNear ||
+            light.position.z - light.range > zFar)
+            continue;
+        slice.x.push_back(light.position.x);
+        slice.y.push_back(light.position.y);
+        slice.z.push_back(light.position.z);
+        slice.radiusSq.push_back(light.range * light.range);
+        slice.lightIndex.push_back(i);
+    }
+    const size_t numCandidates = slice.x.size();
+
+    // Padding never passes the test, distance^2 >= 0 > -1
+    while (slice.x.size() % 8 != 0) {
+        slice.x.push_back(0.0f);
+        slice.y.push_back(0.0f);
+        slice.z.push_back(0.0f);
+        slice.radiusSq.push_back(-1.0f);
+        slice.lightIndex.push_back(0);
+    }
+
+    slice.ranges.resize(numTiles);
+    slice.lightIndices.clear();
+    for (uint32_t t = 0; t < numTiles; t++) {
+        const Vector3 &boxMin = m_boxMin[first + t];
+        const Vector3 &boxMax = m_boxMax[first + t];
+
+        auto &range = slice.ranges[t];
+        range.offset = uint32_t(slice.lightIndices.size());
+        slice.lightIndices.insert(slice.lightIndices.end(),
+                                  m_globalLights.begin(),
+                                  m_globalLights.end());
+
+        // Sphere vs AABB: squared distance from the center to the box
+        size_t i = 0;
+        if (useSimd) {
+            // Room for every candidate, trimmed to the ones that passed
+            const size_t end = slice.lightIndices.size();
+            slice.lightIndices.resize(end + slice.x.size());
+            const uint32_t count = CullLightsAvx2(
+                slice.x.data(), slice.y.data(), slice.z.data(),
+                slice.radiusSq.data(), slice.lightIndex.data(),
+                slice.x.size(), &boxMin.x, &boxMax.x,
+                slice.lightIndices.data() + end);
+            slice.lightIndices.resize(end + count);
+            i = numCandidates;
+        }
+        for (; i < numCandidates; i++) {
+            const float dx = std::max(std::max(boxMin.x - slice.x[i], 0.0f),
+                                      slice.x[i] - boxMax.x);
+            const float dy = std::max(std::max(boxMin.y - slice.y[i], 0.0f),
+                                      slice.y[i] - boxMax.y);
+            const float dz = std::max(std::max(boxMin.z - slice.z[i], 0.0f),
+                                      slice.z[i] - boxMax.z);
+            const float distSq = (dx * dx + dy * dy) + dz * dz;
+            if (distSq <= slice.radiusSq[i])
+                slice.lightIndices.push_back(slice.lightIndex[i]);
+        }
+
+        range.count = uint32_t(slice.lightIndices.size()) - range.offset;
+    }
+}
+
+void LightClusterGrid::MergeSlices() {
+    const uint32_t numTiles = m_dimX * m_dimY;
+    m_ranges.resize(GetClusterCount());
+    m_lightIndices.clear();
+
+    for (uint32_t z = 0; z < m_dimZ; z++) {
+        const auto &slice = m_slices[z];
+        const uint32_t base = uint32_t(m_lightIndices.size());
+        for (uint32_t t = 0; t < numTiles; t++) {
+            auto &range = m_ranges[z * numTiles + t];
+            range.offset = base + slice.ranges[t].offset;
+            range.count = slice.ranges[t].count;
+            m_stats.maxPerCluster =
+                std::max(m_stats.maxPerCluster, range.count);
+        }
+        m_lightIndices.insert(m_lightIndices.end(), slice.lightIndices.begin(),
+                              slice.lightIndices.end());
+    }
+
+    m_stats.lights = uint32_t(m_lights->size());
+    m_stats.clusters = GetClusterCount();
+    m_stats.lightIndices = uint32_t(m_lightIndices.size());
+}
+
+void LightClusterGrid::Bin(const std::vector<ClusterLight> &lights) {
+    using Clock = std::chrono::high_resolution_clock;
+    const auto start = Clock::now();
+    m_stats.Reset();
+    if (!m_isBuilt)
+        return;
+
+    PrepareLights(lights);
+    const bool useSimd = HasAvx2();
+    JobSystem::ParallelFor(m_dimZ, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t z = begin; z < end; z++)
+            BinSlice(z, useSimd);
+    });
+    MergeSlices();
+
+    m_stats.binMs =
+        std::chrono::duration<float, std::milli>(Clock::now() - start)
+            .count();
+}
+
+void LightClusterGrid::BinReference(const std::vector<ClusterLight> &lights) {
+    m_stats.Reset();
+    if (!m_isBuilt)
+        return;
+
+    PrepareLights(lights);
+    for (uint32_t z = 0; z < m_dimZ; z++)
+        BinSlice(z, false);
+    MergeSlices();
+}
+
+} // namespace jRenderer
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <vector>
+
+#include "ConstantBuffers.h"
+
+// ref
+// Clustered Deferred and Forward Shading (Olsson et al., HPG 2012)
+// https://www.cse.chalmers.se/~uffe/clustered_shading_preprint.pdf
+// http://www.aortiz.me/2018/12/21/CG.html
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+
+// Light list of one cluster, [offset, offset + count) in the index list.
+struct ClusterRange {
+    uint32_t offset = 0;
+    uint32_t count = 0;
+};
+
+struct LightClusterStats {
+    uint32_t lights = 0;
+    uint32_t clusters = 0;
+    uint32_t lightIndices = 0; // sum of all cluster lists
+    uint32_t maxPerCluster = 0;
+    float binMs = 0.0f;
+
+    void Reset() { *this = LightClusterStats(); }
+};
+
+// Writes to out the lightIndex of the spheres (center x, y, z, radiusSq)
+// that overlap the box and returns how many. count is padded to 8. In
+// ClusteredLightingAvx2.cpp, the only file built for AVX2, so only call it
+// when HasAvx2().
+uint32_t CullLightsAvx2(const float *x, const float *y, const float *z,
+                        const float *radiusSq, const uint32_t *lightIndex,
+                        size_t count, const float *boxMin,
+                        const float *boxMax, uint32_t *out);
+
+// View space froxel grid: dimX x dimY screen tiles, dimZ exponential depth
+// slices between the near and far plane of the projection. Lights are
+// binned by their bounding sphere on the CPU, directional lights go to
+// every cluster. Cluster index = x + dimX * (y + dimY * z), y from the top.
+class LightClusterGrid {
+  public:
+    void SetDimensions(uint32_t dimX, uint32_t dimY, uint32_t dimZ);
+
+    // Rebuilds the cluster bounds when the projection changed.
+    void Build(const Matrix &projRow);
+
+    // lights are in view space. Depth slices are binned in parallel on the
+    // job system, 8 lights at a time when the CPU has AVX2.
+    void Bin(const std::vector<ClusterLight> &lights);
+
+    // Single threaded scalar version of Bin(), gives the same lists.
+    // For validating the fast path.
+    void BinReference(const std::vector<ClusterLight> &lights);
+
+    ClusterConstants GetConstants() const;
+    uint32_t GetClusterCount() const { return m_dimX * m_dimY * m_dimZ; }
+    const std::vector<ClusterRange> &GetRanges() const { return m_ranges; }
+    const std::vector<uint32_t> &GetLightIndices() const {
+        return m_lightIndices;
+    }
+    void GetClusterBounds(uint32_t cluster, Vector3 &boxMin,
+                          Vector3 &boxMax) const;
+
+    LightClusterStats m_stats;
+
+  private:
+    struct Slice {
+        // Candidate lights of this slice, SoA and padded to 8
+        std::vector<float> x, y, z, radiusSq;
+        std::vector<uint32_t> lightIndex;
+
+        // Output with offsets relative to this slice
+        std::vector<ClusterRange> ranges;
+        std::vector<uint32_t> lightIndices;
+    };
+
+    void PrepareLights(const std::vector<ClusterLight> &lights);
+    void BinSlice(uint32_t z, bool useSimd);
+    void MergeSlices();
+
+    uint32_t m_dimX = 16;
+    uint32_t m_dimY = 9;
+    uint32_t m_dimZ = 24;
+    float m_nearZ = 0.0f;
+    float m_farZ = 0.0f;
+    Matrix m_projRow;
+    bool m_isBuilt = false;
+
+    std::vector<Vector3> m_boxMin; // per cluster, view space
+    std::vector<Vector3> m_boxMax;
+
+    std::vector<uint32_t> m_globalLights; // directional
+    std::vector<uint32_t> m_localLights;  // point, spot
+    const std::vector<ClusterLight> *m_lights = nullptr;
+    std::vector<Slice> m_slices;
+
+    std::vector<ClusterRange> m_ranges;
+    std::vector<uint32_t> m_lightIndices;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,57 @@
+#include "ClusteredLighting.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace jRenderer {
+
+// Built with /arch:AVX2 (-mavx2). Nothing from std here, the linker could
+// pick the AVX2 copies of inline functions for the other files too.
+uint32_t CullLightsAvx2(const float *x, const float *y, const float *z,
+                        const float *radiusSq, const uint32_t *lightIndex,
+                        size_t count, const float *boxMin,
+                        const float *boxMax, uint32_t *out) {
+    uint32_t numPassed = 0;
+#if defined(_M_X64) || defined(__x86_64__)
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 minX = _mm256_set1_ps(boxMin[0]);
+    const __m256 minY = _mm256_set1_ps(boxMin[1]);
+    const __m256 minZ = _mm256_set1_ps(boxMin[2]);
+    const __m256 maxX = _mm256_set1_ps(boxMax[0]);
+    const __m256 maxY = _mm256_set1_ps(boxMax[1]);
+    const __m256 maxZ = _mm256_set1_ps(boxMax[2]);
+
+    // Sphere vs AABB: squared distance from the center to the box
+    for (size_t i = 0; i < count; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(x + i);
+        const __m256 cy = _mm256_loadu_ps(y + i);
+        const __m256 cz = _mm256_loadu_ps(z + i);
+        const __m256 dx =
+            _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minX, cx), zero),
+                          _mm256_sub_ps(cx, maxX));
+        const __m256 dy =
+            _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minY, cy), zero),
+                          _mm256_sub_ps(cy, maxY));
+        const __m256 dz =
+            _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(minZ, cz), zero),
+                          _mm256_sub_ps(cz, maxZ));
+        const __m256 distSq = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+            _mm256_mul_ps(dz, dz));
+        int mask = _mm256_movemask_ps(_mm256_cmp_ps(
+            distSq, _mm256_loadu_ps(radiusSq + i), _CMP_LE_OQ));
+
+        for (int lane = 0; mask; lane++, mask >>= 1) {
+            if (mask & 1)
+                out[numPassed++] = lightIndex[i + size_t(lane)];
+        }
+    }
+#else
+    (void)x, (void)y, (void)z, (void)radiusSq, (void)lightIndex, (void)count;
+    (void)boxMin, (void)boxMax, (void)out;
+#endif
+    return numPassed;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,111 @@
+#include "CommandRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include "D3D11Utils.h"
+#include "JobSystem.h"
+
+namespace jRenderer {
+
+void PassRecorder::Partition(const std::vector<uint64_t> &costs,
+                             uint32_t maxBatches, uint64_t minBatchCost,
+                             std::vector<RecordingBatch> &batches) {
+    batches.clear();
+    if (costs.empty())
+        return;
+
+    uint64_t total = 0;
+    for (const auto c : costs)
+        total += c;
+
+    maxBatches = std::max(maxBatches, 1u);
+    const uint64_t target =
+        std::max((total + maxBatches - 1) / maxBatches, minBatchCost);
+
+    RecordingBatch batch;
+    for (uint32_t i = 0; i < uint32_t(costs.size()); i++) {
+        batch.cost += costs[i];
+        batch.end = i + 1;
+
+        // The last batch takes whatever is left.
+        if (batch.cost >= target && batches.size() + 1 < maxBatches) {
+            batches.push_back(batch);
+            batch = RecordingBatch();
+            batch.begin = batch.end = i + 1;
+        }
+    }
+    if (batch.end > batch.begin)
+        batches.push_back(batch);
+}
+
+void PassRecorder::Record(
+    const std::vector<RecordingBatch> &batches,
+    FunctionRef<void(uint32_t, const RecordingBatch &)> record,
+    FunctionRef<void(uint32_t)> submit) {
+    JobSystem::ParallelFor(uint32_t(batches.size()), 1,
+                           [&](uint32_t begin, uint32_t end) {
+                               for (uint32_t i = begin; i < end; i++)
+                                   record(i, batches[i]);
+                           });
+
+    for (uint32_t i = 0; i < uint32_t(batches.size()); i++)
+        submit(i);
+}
+
+void DeferredContextRecorder::Initialize(ComPtr<ID3D11Device> &device,
+                                         uint32_t maxBatches) {
+    m_contexts.resize(std::max(maxBatches, 1u));
+    m_commandLists.resize(m_contexts.size());
+    for (auto &context : m_contexts) {
+        ThrowIfFailed(
+            device->CreateDeferredContext(0, context.GetAddressOf()));
+    }
+}
+
+void DeferredContextRecorder::RecordPass(ComPtr<ID3D11DeviceContext> &immediate,
+                                         const std::vector<uint64_t> &costs,
+                                         SetupFunc setup, DrawFunc draw) {
+    using Clock = std::chrono::high_resolution_clock;
+    using Ms = std::chrono::duration<float, std::milli>;
+
+    const auto start = Clock::now();
+    m_stats.passes++;
+    m_stats.draws += uint32_t(costs.size());
+
+    PassRecorder::Partition(costs,
+                            m_useParallel ? uint32_t(m_contexts.size()) : 1,
+                            m_minBatchCost, m_batches);
+
+    if (m_batches.size() <= 1) {
+        setup(immediate);
+        draw(immediate, 0, uint32_t(costs.size()));
+        m_stats.batches++;
+        m_stats.recordMs += Ms(Clock::now() - start).count();
+        return;
+    }
+
+    float executeMs = 0.0f;
+    PassRecorder::Record(
+        m_batches,
+        [&](uint32_t i, const RecordingBatch &batch) {
+            auto &context = m_contexts[i];
+            setup(context);
+            draw(context, batch.begin, batch.end);
+            ThrowIfFailed(context->FinishCommandList(
+                FALSE, m_commandLists[i].ReleaseAndGetAddressOf()));
+        },
+        [&](uint32_t i) {
+            const auto executeStart = Clock::now();
+            // TRUE: the immediate context keeps its state for the next pass
+            immediate->ExecuteCommandList(m_commandLists[i].Get(), TRUE);
+            m_commandLists[i].Reset();
+            executeMs += Ms(Clock::now() - executeStart).count();
+        });
+
+    m_stats.batches += uint32_t(m_batches.size());
+    m_stats.executeMs += executeMs;
+    m_stats.recordMs += Ms(Clock::now() - start).count();
+}
+
+} // namespace jRenderer
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <cstdint>
+#include <d3d11.h>
+#include <vector>
+#include <wrl/client.h> // ComPtr
+
+#include "FunctionRef.h"
+
+// ref
+// https://learn.microsoft.com/en-us/windows/win32/direct3d11/overviews-direct3d-11-render-multi-thread-render
+
+namespace jRenderer {
+
+using Microsoft::WRL::ComPtr;
+
+// Contiguous range [begin, end) of a draw list, recorded as one unit.
+struct RecordingBatch {
+    uint32_t begin = 0;
+    uint32_t end = 0;
+    uint64_t cost = 0;
+};
+
+struct RecordingStats {
+    uint32_t passes = 0;
+    uint32_t batches = 0;
+    uint32_t draws = 0;
+    float recordMs = 0.0f;  // main thread time spent in RecordPass()
+    float executeMs = 0.0f; // part of it spent in ExecuteCommandList()
+
+    void Reset() { *this = RecordingStats(); }
+};
+
+// GPU independent part: how a draw list is split and in which order the
+// batches are submitted.
+class PassRecorder {
+  public:
+    // Splits the list into at most maxBatches contiguous batches of about
+    // equal cost, but not smaller than minBatchCost. Keeps the draw order.
+    static void Partition(const std::vector<uint64_t> &costs,
+                          uint32_t maxBatches, uint64_t minBatchCost,
+                          std::vector<RecordingBatch> &batches);
+
+    // record(i, batch) runs on the job system, submit(i) then runs on the
+    // calling thread for i = 0, 1, 2 ... so the output order matches the
+    // serial order.
+    static void
+    Record(const std::vector<RecordingBatch> &batches,
+           FunctionRef<void(uint32_t, const RecordingBatch &)> record,
+           FunctionRef<void(uint32_t)> submit);
+};
+
+// Records a pass on D3D11 deferred contexts, one per batch, and executes
+// the command lists on the immediate context. Falls back to the immediate
+// context when the pass is too small to split.
+class DeferredContextRecorder {
+  public:
+    using SetupFunc = FunctionRef<void(ComPtr<ID3D11DeviceContext> &)>;
+    using DrawFunc = FunctionRef<void(ComPtr<ID3D11DeviceContext> &,
+                                      uint32_t begin, uint32_t end)>;
+
+    void Initialize(ComPtr<ID3D11Device> &device, uint32_t maxBatches);
+
+    // setup binds the pass state (deferred contexts start from the default
+    // state), draw records the items [begin, end). Clears belong to the
+    // caller, on the immediate context.
+    void RecordPass(ComPtr<ID3D11DeviceContext> &immediate,
+                    const std::vector<uint64_t> &costs, SetupFunc setup,
+                    DrawFunc draw);
+
+    bool m_useParallel = true;
+    uint64_t m_minBatchCost = 20000; // indices
+    RecordingStats m_stats;
+
+  private:
+    std::vector<ComPtr<ID3D11DeviceContext>> m_contexts;
+    std::vector<ComPtr<ID3D11CommandList>> m_commandLists;
+    std::vector<RecordingBatch> m_batches;
+};
+
+} // namespace jRenderer
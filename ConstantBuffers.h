@@ -12,12 +12,17 @@
 #define LIGHT_SHADOW 0x10
 
 #define MAX_SAMPLES 64
+#define SSAO_BLUR_RADIUS 4 // SSAOBlurCS.hlsli, 9 taps per pass
+#define SSAO_BLUR_TILE 128 // pixels per thread group
+#define NUM_CASCADES 4 // directional light shadow cascades
+#define MAX_SHADOW_FACES (MAX_LIGHTS * 6) // shadow atlas, 6 per light
 
 namespace jRenderer {
 
 using DirectX::SimpleMath::Matrix;
 using DirectX::SimpleMath::Vector2;
 using DirectX::SimpleMath::Vector3;
+using DirectX::SimpleMath::Vector4;
 
 // It's usually used in Vertex/Geometry Shader.  
 __declspec(align(256)) struct MeshConstants {
@@ -119,9 +124,64 @@ __declspec(align(256)) struct InstancedConsts {
     int useInstancing = 0;
 };
 
+// It should be same as "ClusteredLighting.hlsli"
+// Light in view space, one element of the clustered light buffer (t19).
+struct ClusterLight {
+    Vector3 position;
+    float range = 0.0f; // bounding sphere radius used for binning
+    Vector3 direction;
+    float spotPower = 0.0f;
+    Vector3 radiance; // lightColor * radiance
+    uint32_t type = LIGHT_OFF;
+    float fallOffStart = 0.0f;
+    float fallOffEnd = 0.0f;
+    int shadowIndex = -1; // faces in ShadowAtlasConstants, -1: no shadow
+    float dummy = 0.0f;
+};
+
+// register(b4), DeferredLightingPS.hlsl
+__declspec(align(256)) struct ClusterConstants {
+    uint32_t dimX = 16;
+    uint32_t dimY = 9;
+    uint32_t dimZ = 24;
+    uint32_t numLights = 0;
+    float sliceScale = 0.0f; // slice = log(viewZ) * sliceScale + sliceBias
+    float sliceBias = 0.0f;
+    Vector2 dummy;
+};
+
+// register(b5), DeferredLightingPS.hlsl
+__declspec(align(256)) struct ShadowCascadeConstants {
+    Matrix viewToShadow[NUM_CASCADES]; // camera view -> cascade uv, depth
+    float splitFar[NUM_CASCADES];      // camera view depth, float4 in HLSL
+    float texelSize = 0.0f;            // 1 / cascade resolution
+    float depthBias = 0.001f;
+    int lightIndex = -1; // -1: no cascades this frame
+    float dummy = 0.0f;
+};
+
+// register(b6), DeferredLightingPS.hlsl
+// Face f of light i is at i * 6 + f, spot and directional lights only use
+// face 0.
+__declspec(align(256)) struct ShadowAtlasConstants {
+    Matrix viewToFace[MAX_SHADOW_FACES]; // camera view -> atlas uv, depth
+    Vector4 faceRects[MAX_SHADOW_FACES]; // uv min xy, max zw
+    float texelSize = 0.0f;              // 1 / atlas resolution
+    float depthBias = 0.0005f;
+    Vector2 dummy;
+};
+
+// Per-instance vertex data, ShadowCubeMapInstancedVS.hlsl
+struct ShadowFaceInstance {
+    uint32_t face = 0;          // cube face, also the viewport index
+    uint32_t modelInstance = 0; // index into InstancedConsts::instanceMat
+};
+
 // 
 struct ShadowLightTransform {
     Matrix shadowViewProj[6];
+    uint32_t faceMask = 0x3f; // cube faces the GS draws into
+    uint32_t dummy[3];
 };
 
 // register(b3), PostEffectsPS.hlsl
@@ -135,9 +195,33 @@ __declspec(align(256)) struct PostEffectsConstants {
     float exposure = 1.0f;
 };
 
+// register(b2), SSAO.hlsl
+// float4 per sample, HLSL pads every array element to 16 bytes.
 struct Vector3kernelSampleConstants {
-    Vector3 samples[MAX_SAMPLES];
-    float dummy[MAX_SAMPLES];
+    Vector4 samples[MAX_SAMPLES]; // w unused
+};
+
+// register(b3), SSAO.hlsl and SSAOUpsample.hlsl
+// The AO is computed at 1/scale of the screen with sampleCount of the
+// kernel samples, i * sampleStride + sampleOffset. The offset is rotated
+// every frame and the frames are blended in the AO history.
+__declspec(align(256)) struct SsaoConstants {
+    Matrix viewToPrevClip; // camera view -> clip space of the last frame
+    uint32_t aoWidth = 0;
+    uint32_t aoHeight = 0;
+    uint32_t screenWidth = 0;
+    uint32_t screenHeight = 0;
+    uint32_t scale = 2; // screen / AO resolution, 1, 2 or 4
+    uint32_t sampleCount = 16;
+    uint32_t sampleStride = MAX_SAMPLES / 16;
+    uint32_t sampleOffset = 0;
+    float radius = 0.1f;
+    float bias = 0.0005f;
+    float power = 2.0f;          // contrast of the final AO
+    float temporalAlpha = 0.25f; // weight of the new frame, 1: no history
+    float depthSigma = 0.05f;    // relative view depth, history and upsample
+    uint32_t historyValid = 0;
+    Vector2 dummy;
 };
 
 } // namespace jRenderer
\ No newline at end of file
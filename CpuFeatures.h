@@ -0,0 +1,10 @@
+#pragma once
+
+namespace jRenderer {
+
+// True when the CPU and the OS support AVX2. Only the files built with
+// /arch:AVX2 use it, and only after checking this. Cached after the first
+// call.
+bool HasAvx2();
+
+} // namespace jRenderer
@@ -0,0 +1,190 @@
+#include "Culling.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jRenderer {
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+
+Vector4 Column(const Matrix &m, int c) {
+    return Vector4(m.m[0][c], m.m[1][c], m.m[2][c], m.m[3][c]);
+}
+
+Vector4 NormalizePlane(const Vector4 &p) {
+    const float len = std::sqrt(p.x * p.x + p.y * p.y + p.z * p.z);
+    return len > 0.0f ? p * (1.0f / len) : p;
+}
+
+// The conservative projection of a box is the bound of its 8 corners.
+// Returns false if any corner is behind the near plane.
+bool ProjectBox(const Vector3 &boxMin, const Vector3 &boxMax,
+                const Matrix &viewProjRow, float &uvMinX, float &uvMinY,
+                float &uvMaxX, float &uvMaxY, float &minDepth) {
+    uvMinX = uvMinY = 1.0f;
+    uvMaxX = uvMaxY = 0.0f;
+    minDepth = 1.0f;
+
+    for (int i = 0; i < 8; i++) {
+        const Vector3 corner((i & 1) ? boxMax.x : boxMin.x,
+                             (i & 2) ? boxMax.y : boxMin.y,
+                             (i & 4) ? boxMax.z : boxMin.z);
+        const Vector4 clip =
+            Vector4::Transform(Vector4(corner, 1.0f), viewProjRow);
+        if (clip.w <= 1e-5f)
+            return false;
+
+        const float invW = 1.0f / clip.w;
+        const float u = clip.x * invW * 0.5f + 0.5f;
+        const float v = -clip.y * invW * 0.5f + 0.5f;
+        uvMinX = std::min(uvMinX, u);
+        uvMinY = std::min(uvMinY, v);
+        uvMaxX = std::max(uvMaxX, u);
+        uvMaxY = std::max(uvMaxY, v);
+        minDepth = std::min(minDepth, clip.z * invW);
+    }
+
+    uvMinX = std::clamp(uvMinX, 0.0f, 1.0f);
+    uvMinY = std::clamp(uvMinY, 0.0f, 1.0f);
+    uvMaxX = std::clamp(uvMaxX, 0.0f, 1.0f);
+    uvMaxY = std::clamp(uvMaxY, 0.0f, 1.0f);
+    return true;
+}
+
+} // namespace
+
+Frustum Frustum::FromViewProj(const Matrix &viewProjRow) {
+    // Gribb/Hartmann plane extraction
+    // clip = v * M, so each clip component is a dot with a column of M.
+    const Vector4 c0 = Column(viewProjRow, 0);
+    const Vector4 c1 = Column(viewProjRow, 1);
+    const Vector4 c2 = Column(viewProjRow, 2);
+    const Vector4 c3 = Column(viewProjRow, 3);
+
+    Frustum f;
+    f.planes[LEFT] = NormalizePlane(c3 + c0);
+    f.planes[RIGHT] = NormalizePlane(c3 - c0);
+    f.planes[BOTTOM] = NormalizePlane(c3 + c1);
+    f.planes[TOP] = NormalizePlane(c3 - c1);
+    f.planes[NEAR_PLANE] = NormalizePlane(c2); // D3D: 0 <= z
+    f.planes[FAR_PLANE] = NormalizePlane(c3 - c2);
+    return f;
+}
+
+bool Frustum::Intersects(const Vector3 &center, float radius) const {
+    for (int i = 0; i < COUNT; i++) {
+        const Vector4 &p = planes[i];
+        if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+            return false;
+    }
+    return true;
+}
+
+bool Frustum::Intersects(const Vector3 &boxMin, const Vector3 &boxMax) const {
+    for (int i = 0; i < COUNT; i++) {
+        const Vector4 &p = planes[i];
+        // Only the corner farthest along the plane normal matters.
+        const float x = p.x >= 0.0f ? boxMax.x : boxMin.x;
+        const float y = p.y >= 0.0f ? boxMax.y : boxMin.y;
+        const float z = p.z >= 0.0f ? boxMax.z : boxMin.z;
+        if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+            return false;
+    }
+    return true;
+}
+
+void HiZBuffer::Clear() {
+    m_levels.clear();
+    m_widths.clear();
+    m_heights.clear();
+}
+
+void HiZBuffer::Build(const float *depth, int width, int height) {
+    Clear();
+    if (!depth || width <= 0 || height <= 0)
+        return;
+
+    m_levels.emplace_back(depth, depth + size_t(width) * height);
+    m_widths.push_back(width);
+    m_heights.push_back(height);
+
+    while (width > 1 || height > 1) {
+        const int w = std::max(1, (width + 1) / 2);
+        const int h = std::max(1, (height + 1) / 2);
+        const std::vector<float> &src = m_levels.back();
+        std::vector<float> dst(size_t(w) * h);
+
+        for (int y = 0; y < h; y++) {
+            for (int x = 0; x < w; x++) {
+                const int x0 = std::min(2 * x, width - 1);
+                const int x1 = std::min(2 * x + 1, width - 1);
+                const int y0 = std::min(2 * y, height - 1);
+                const int y1 = std::min(2 * y + 1, height - 1);
+                dst[size_t(y) * w + x] =
+                    std::max(std::max(src[size_t(y0) * width + x0],
+                                      src[size_t(y0) * width + x1]),
+                             std::max(src[size_t(y1) * width + x0],
+                                      src[size_t(y1) * width + x1]));
+            }
+        }
+
+        m_levels.push_back(std::move(dst));
+        m_widths.push_back(w);
+        m_heights.push_back(h);
+        width = w;
+        height = h;
+    }
+}
+
+bool HiZBuffer::IsOccluded(float uvMinX, float uvMinY, float uvMaxX,
+                           float uvMaxY, float minDepth) const {
+    if (!IsValid())
+        return false;
+
+    // Pick the level where the rect covers at most 2x2 texels.
+    const float pixelW = (uvMaxX - uvMinX) * m_widths[0];
+    const float pixelH = (uvMaxY - uvMinY) * m_heights[0];
+    int level = int(std::ceil(std::log2(std::max(std::max(pixelW, pixelH),
+                                                 1.0f))));
+    level = std::clamp(level, 0, int(m_levels.size()) - 1);
+
+    const int w = m_widths[level];
+    const int h = m_heights[level];
+    const int x0 = std::clamp(int(uvMinX * w), 0, w - 1);
+    const int x1 = std::clamp(int(uvMaxX * w), 0, w - 1);
+    const int y0 = std::clamp(int(uvMinY * h), 0, h - 1);
+    const int y1 = std::clamp(int(uvMaxY * h), 0, h - 1);
+
+    const std::vector<float> &depth = m_levels[level];
+    for (int y = y0; y <= y1; y++) {
+        for (int x = x0; x <= x1; x++) {
+            if (minDepth <= depth[size_t(y) * w + x])
+                return false;
+        }
+    }
+    return true;
+}
+
+bool HiZBuffer::IsSphereOccluded(const Vector3 &center, float radius,
+                                 const Matrix &viewProjRow) const {
+    return IsBoxOccluded(center - Vector3(radius), center + Vector3(radius),
+                         viewProjRow);
+}
+
+bool HiZBuffer::IsBoxOccluded(const Vector3 &boxMin, const Vector3 &boxMax,
+                              const Matrix &viewProjRow) const {
+    if (!IsValid())
+        return false;
+
+    float uvMinX, uvMinY, uvMaxX, uvMaxY, minDepth;
+    if (!ProjectBox(boxMin, boxMax, viewProjRow, uvMinX, uvMinY, uvMaxX,
+                    uvMaxY, minDepth))
+        return false; // crosses the near plane, never occluded
+
+    return IsOccluded(uvMinX, uvMinY, uvMaxX, uvMaxY, minDepth);
+}
+
+} // namespace jRenderer
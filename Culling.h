@@ -0,0 +1,59 @@
+#pragma once
+
+#include <directxtk/SimpleMath.h>
+#include <vector>
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Plane;
+using DirectX::SimpleMath::Vector3;
+using DirectX::SimpleMath::Vector4;
+
+// View frustum as six inward-facing planes.
+// Planes are extracted from a row-major (v * M) view-projection matrix with
+// D3D clip space, so z is in [0, 1].
+struct Frustum {
+    enum { LEFT = 0, RIGHT, BOTTOM, TOP, NEAR_PLANE, FAR_PLANE, COUNT };
+
+    static Frustum FromViewProj(const Matrix &viewProjRow);
+
+    bool Intersects(const Vector3 &center, float radius) const;
+    bool Intersects(const Vector3 &boxMin, const Vector3 &boxMax) const;
+
+    Vector4 planes[COUNT];
+};
+
+// Hierarchical depth buffer on the CPU.
+// Level 0 is the source depth, each next level keeps the farthest (max) depth
+// of a 2x2 footprint so a single texel covers a conservative depth range.
+class HiZBuffer {
+  public:
+    void Build(const float *depth, int width, int height);
+    void Clear();
+
+    bool IsValid() const { return !m_levels.empty(); }
+    int GetWidth() const { return m_widths.empty() ? 0 : m_widths[0]; }
+    int GetHeight() const { return m_heights.empty() ? 0 : m_heights[0]; }
+
+    // Screen rect in [0, 1] uv (top-left origin), nearest depth of the object
+    // in [0, 1]. Returns true if everything inside the rect is in front of
+    // minDepth.
+    bool IsOccluded(float uvMinX, float uvMinY, float uvMaxX, float uvMaxY,
+                    float minDepth) const;
+
+    // Projects a world space sphere with viewProj and tests it.
+    bool IsSphereOccluded(const Vector3 &center, float radius,
+                          const Matrix &viewProjRow) const;
+
+    // Projects a world space AABB with viewProj and tests it.
+    bool IsBoxOccluded(const Vector3 &boxMin, const Vector3 &boxMax,
+                       const Matrix &viewProjRow) const;
+
+  private:
+    std::vector<std::vector<float>> m_levels;
+    std::vector<int> m_widths;
+    std::vector<int> m_heights;
+};
+
+} // namespace jRenderer
@@ -7,6 +7,7 @@
 #include <directxtk/DDSTextureLoader.h> // for reading cubemap
 #include <dxgi.h>                       // DXGIFactory
 #include <dxgi1_4.h>                    // DXGIFactory4
+#include <filesystem>
 #include <fp16.h>
 #include <iostream>                      
          
@@ -45,6 +46,13 @@ void ReadImage(const std::string filename, std::vector<uint8_t> &image,
 
     unsigned char *img =
         stbi_load(filename.c_str(), &width, &height, &channels, 0);
+    // Missing, or still being written when it is reloaded
+    if (!img) {
+        cout << "Cannot read " << filename << endl;
+        width = height = 0;
+        image.clear();
+        return;
+    }
 
     cout << filename << " " << width << " " << height << " " << channels
          << endl;
@@ -179,28 +187,91 @@ void CreateTextureHelper(ComPtr<ID3D11Device> &device,
     // HLSL ̴ ȿ SampleLevel() 
 }
 
-void D3D11Utils::CreateComputeShader(ComPtr<ID3D11Device>& device, const wstring& filename,
-    ComPtr<ID3D11ComputeShader>& m_computeShader) {
+bool D3DShaderCompiler::Compile(const ShaderKey &key,
+                                vector<uint8_t> &bytecode, string &errors) {
+    vector<D3D_SHADER_MACRO> macros;
+    for (const auto &define : key.defines)
+        macros.push_back({define.first.c_str(), define.second.c_str()});
+    macros.push_back({NULL, NULL});
+
+    ComPtr<ID3DBlob> shaderBlob;
+    ComPtr<ID3DBlob> errorBlob;
+
+    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
+    HRESULT hr = D3DCompileFromFile(
+        filesystem::path(key.filename).wstring().c_str(), macros.data(),
+        D3D_COMPILE_STANDARD_FILE_INCLUDE, key.entryPoint.c_str(),
+        key.profile.c_str(), key.flags, 0, &shaderBlob, &errorBlob);
+
+    CheckResult(hr, errorBlob.Get());
+    if (errorBlob) {
+        errors.assign((const char *)errorBlob->GetBufferPointer(),
+                      errorBlob->GetBufferSize());
+    }
+    if (FAILED(hr))
+        return false;
 
-    ID3DBlob *shaderBlob;  
-    ID3DBlob *errorBlob;              
+    const auto *code = (const uint8_t *)shaderBlob->GetBufferPointer();
+    bytecode.assign(code, code + shaderBlob->GetBufferSize());
+    return true;
+}
 
-    UINT compileFlags = 0;
+ShaderCache &D3D11Utils::GetShaderCache() {
+    static D3DShaderCompiler compiler;
+    static ShaderCache cache(&compiler);
+    return cache;
+}
+
+ShaderArchive &D3D11Utils::GetShaderArchive() {
+    static ShaderArchive archive;
+    return archive;
+}
+
+ShaderBatch &D3D11Utils::GetShaderBatch() {
+    static ShaderBatch batch;
+    return batch;
+}
+
+ShaderKey D3D11Utils::MakeShaderKey(const wstring &filename,
+                                    const char *entryPoint,
+                                    const char *profile) {
+    ShaderKey key;
+    key.filename = filesystem::path(filename).generic_string();
+    key.entryPoint = entryPoint;
+    key.profile = profile;
 #if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
+    key.flags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
+    return key;
+}
 
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-        "cs_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
+void D3D11Utils::GetShaderBytecode(const wstring &filename,
+                                   const char *entryPoint, const char *profile,
+                                   ShaderBytecode &bytecode) {
+    GetShaderBytecode(MakeShaderKey(filename, entryPoint, profile), bytecode);
+}
+
+void D3D11Utils::GetShaderBytecode(const ShaderKey &key,
+                                   ShaderBytecode &bytecode) {
+    // Points into the batch, like a blob of the archive
+    if (const auto *compiled = GetShaderBatch().Find(key)) {
+        bytecode.storage.clear();
+        bytecode.data = compiled->data;
+        bytecode.size = compiled->size;
+        return;
+    }
+    if (!GetShaderCache().GetBytecode(key, bytecode))
+        ThrowIfFailed(E_FAIL);
+}
 
-    CheckResult(hr, errorBlob);
+void D3D11Utils::CreateComputeShader(
+    ComPtr<ID3D11Device> &device, const wstring &filename,
+    ComPtr<ID3D11ComputeShader> &m_computeShader) {
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "main", "cs_5_0", bytecode);
 
-    ThrowIfFailed(device->CreateComputeShader(shaderBlob->GetBufferPointer(),
-                                              shaderBlob->GetBufferSize(), NULL,
-                                              &m_computeShader));
+    ThrowIfFailed(device->CreateComputeShader(
+        bytecode.data, bytecode.size, NULL, &m_computeShader));
 }
 
 void D3D11Utils::CreateVertexShaderAndInputLayout(
@@ -208,30 +279,16 @@ void D3D11Utils::CreateVertexShaderAndInputLayout(
     const vector<D3D11_INPUT_ELEMENT_DESC> &inputElements,
     ComPtr<ID3D11VertexShader> &m_vertexShader,
     ComPtr<ID3D11InputLayout> &m_inputLayout) {
-
-    ID3DBlob *shaderBlob;
-    ID3DBlob *errorBlob;
-
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
     // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-        "vs_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob);
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "main", "vs_5_0", bytecode);
 
-    device->CreateVertexShader(shaderBlob->GetBufferPointer(),
-                               shaderBlob->GetBufferSize(), NULL,
-                               &m_vertexShader);
+    ThrowIfFailed(device->CreateVertexShader(bytecode.data, bytecode.size,
+                                             NULL, &m_vertexShader));
 
-    device->CreateInputLayout(inputElements.data(), UINT(inputElements.size()),
-                              shaderBlob->GetBufferPointer(),
-                              shaderBlob->GetBufferSize(), &m_inputLayout);
+    ThrowIfFailed(device->CreateInputLayout(
+        inputElements.data(), UINT(inputElements.size()), bytecode.data,
+        bytecode.size, &m_inputLayout));
 }
 
 void D3D11Utils::CreateVertexShaderAndInputLayoutSum(
@@ -239,149 +296,66 @@ void D3D11Utils::CreateVertexShaderAndInputLayoutSum(
     const vector<D3D11_INPUT_ELEMENT_DESC> &inputElements,
     ComPtr<ID3D11VertexShader> &m_vertexShader,
     ComPtr<ID3D11InputLayout> &m_inputLayout) {
+    // VS and PS in one file
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "VSmain", "vs_5_0", bytecode);
 
-    ID3DBlob *shaderBlob;
-    ID3DBlob *errorBlob;
+    ThrowIfFailed(device->CreateVertexShader(bytecode.data, bytecode.size,
+                                             NULL, &m_vertexShader));
 
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "VSmain",
-        "vs_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob);
-
-    device->CreateVertexShader(shaderBlob->GetBufferPointer(),
-                               shaderBlob->GetBufferSize(), NULL,
-                               &m_vertexShader);
-     
-    device->CreateInputLayout(inputElements.data(), UINT(inputElements.size()),
-                              shaderBlob->GetBufferPointer(),
-                              shaderBlob->GetBufferSize(), &m_inputLayout);
+    ThrowIfFailed(device->CreateInputLayout(
+        inputElements.data(), UINT(inputElements.size()), bytecode.data,
+        bytecode.size, &m_inputLayout));
 }
 
 void D3D11Utils::CreateHullShader(ComPtr<ID3D11Device> &device,
                                   const wstring &filename,
                                   ComPtr<ID3D11HullShader> &m_hullShader) {
-    ComPtr<ID3DBlob> shaderBlob;
-    ComPtr<ID3DBlob> errorBlob;
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "main", "hs_5_0", bytecode);
 
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-        "hs_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob.Get());
-
-    device->CreateHullShader(shaderBlob->GetBufferPointer(),
-                             shaderBlob->GetBufferSize(), NULL, &m_hullShader);
+    ThrowIfFailed(device->CreateHullShader(bytecode.data, bytecode.size,
+                                           NULL, &m_hullShader));
 }
 
 void D3D11Utils::CreateDomainShader(
     ComPtr<ID3D11Device> &device, const wstring &filename,
     ComPtr<ID3D11DomainShader> &m_domainShader) {
-    ComPtr<ID3DBlob> shaderBlob;
-    ComPtr<ID3DBlob> errorBlob;
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "main", "ds_5_0", bytecode);
 
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-        "ds_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob.Get());
-
-    device->CreateDomainShader(shaderBlob->GetBufferPointer(),
-                               shaderBlob->GetBufferSize(), NULL,
-                               &m_domainShader);
+    ThrowIfFailed(device->CreateDomainShader(bytecode.data, bytecode.size,
+                                             NULL, &m_domainShader));
 }
 
 void D3D11Utils::CreateGeometryShader(
     ComPtr<ID3D11Device> &device, const wstring &filename,
     ComPtr<ID3D11GeometryShader> &m_geometryShader) {
-    ComPtr<ID3DBlob> shaderBlob;
-    ComPtr<ID3DBlob> errorBlob;
-
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "main", "gs_5_0", bytecode);
 
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-        "gs_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob.Get());
-
-    device->CreateGeometryShader(shaderBlob->GetBufferPointer(),
-                                 shaderBlob->GetBufferSize(), NULL,
-                                 &m_geometryShader);
+    ThrowIfFailed(device->CreateGeometryShader(
+        bytecode.data, bytecode.size, NULL, &m_geometryShader));
 }
 
 void D3D11Utils::CreatePixelShader(ComPtr<ID3D11Device> &device,
                                    const wstring &filename,
                                    ComPtr<ID3D11PixelShader> &m_pixelShader) {
-    ComPtr<ID3DBlob> shaderBlob;
-    ComPtr<ID3DBlob> errorBlob;
-
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "main", "ps_5_0", bytecode);
 
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "main",
-        "ps_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob.Get());
-
-    device->CreatePixelShader(shaderBlob->GetBufferPointer(),
-                              shaderBlob->GetBufferSize(), NULL,
-                              &m_pixelShader);
+    ThrowIfFailed(device->CreatePixelShader(bytecode.data, bytecode.size,
+                                            NULL, &m_pixelShader));
 }
-                             
+
 void D3D11Utils::CreatePixelShaderSum(ComPtr<ID3D11Device> &device,
                                    const wstring &filename,
                                    ComPtr<ID3D11PixelShader> &m_pixelShader) {
-    ComPtr<ID3DBlob> shaderBlob;
-    ComPtr<ID3DBlob> errorBlob;
-
-    UINT compileFlags = 0;
-#if defined(DEBUG) || defined(_DEBUG)
-    compileFlags = D3DCOMPILE_DEBUG | D3DCOMPILE_SKIP_OPTIMIZATION;
-#endif
-
-    // shader's first name is "main"
-    // D3D_COMPILE_STANDARD_FILE_INCLUDE : This can use "include" in shader
-    HRESULT hr = D3DCompileFromFile(
-        filename.c_str(), 0, D3D_COMPILE_STANDARD_FILE_INCLUDE, "PSmain",
-        "ps_5_0", compileFlags, 0, &shaderBlob, &errorBlob);
-
-    CheckResult(hr, errorBlob.Get());
+    ShaderBytecode bytecode;
+    GetShaderBytecode(filename, "PSmain", "ps_5_0", bytecode);
 
-    device->CreatePixelShader(shaderBlob->GetBufferPointer(),
-                              shaderBlob->GetBufferSize(), NULL,
-                              &m_pixelShader);
+    ThrowIfFailed(device->CreatePixelShader(bytecode.data, bytecode.size,
+                                            NULL, &m_pixelShader));
 }
 
 void D3D11Utils::CreateIndexBuffer(ComPtr<ID3D11Device> &device,
@@ -409,10 +383,18 @@ void D3D11Utils::CreateMetallicRoughnessTexture(
     ComPtr<ID3D11Device> &device, ComPtr<ID3D11DeviceContext> &context,
     const std::string metallicFilename, const std::string roughnessFilename,
     ComPtr<ID3D11Texture2D> &texture, ComPtr<ID3D11ShaderResourceView> &srv) {
+    TextureImage image;
+    ReadMetallicRoughnessTexture(metallicFilename, roughnessFilename, image);
+    CreateTexture(device, context, image, texture, srv);
+}
+
+void D3D11Utils::ReadMetallicRoughnessTexture(
+    const std::string metallicFilename, const std::string roughnessFilename,
+    TextureImage &image) {
 
     // GLTF  ̹  
     if (!metallicFilename.empty() && (metallicFilename == roughnessFilename)) {
-        CreateTexture(device, context, metallicFilename, false, texture, srv);
+        ReadTexture(metallicFilename, false, image);
     } else {
         //     о ݴϴ.
 
@@ -449,8 +431,10 @@ void D3D11Utils::CreateMetallicRoughnessTexture(
                 combinedImage[4 * i + 2] = mImage[4 * i]; // Blue = Metalness
         }
 
-        CreateTextureHelper(device, context, mWidth, mHeight, combinedImage,
-                            DXGI_FORMAT_R8G8B8A8_UNORM, texture, srv);
+        image.width = mWidth;
+        image.height = mHeight;
+        image.format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        image.pixels = std::move(combinedImage);
     }
 }
 
@@ -459,9 +443,16 @@ void D3D11Utils::CreateTexture(ComPtr<ID3D11Device> &device,
                                const std::string filename, const bool usSRGB,
                                ComPtr<ID3D11Texture2D> &tex,
                                ComPtr<ID3D11ShaderResourceView> &srv) {
+    TextureImage image;
+    ReadTexture(filename, usSRGB, image);
+    CreateTexture(device, context, image, tex, srv);
+}
+
+void D3D11Utils::ReadTexture(const std::string filename, const bool usSRGB,
+                             TextureImage &image) {
 
     int width = 0, height = 0;
-    std::vector<uint8_t> image;
+    std::vector<uint8_t> pixels;
     DXGI_FORMAT pixelFormat =
         usSRGB ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
 
@@ -469,13 +460,24 @@ void D3D11Utils::CreateTexture(ComPtr<ID3D11Device> &device,
     std::transform(ext.begin(), ext.end(), ext.begin(), std::tolower);
 
     if (ext == "exr") {
-        ReadEXRImage(filename, image, width, height, pixelFormat);
+        ReadEXRImage(filename, pixels, width, height, pixelFormat);
     } else {
-        ReadImage(filename, image, width, height);
+        ReadImage(filename, pixels, width, height);
     }
 
-    CreateTextureHelper(device, context, width, height, image, pixelFormat, tex,
-                        srv);
+    image.width = width;
+    image.height = height;
+    image.format = pixelFormat;
+    image.pixels = std::move(pixels);
+}
+
+void D3D11Utils::CreateTexture(ComPtr<ID3D11Device> &device,
+                               ComPtr<ID3D11DeviceContext> &context,
+                               const TextureImage &image,
+                               ComPtr<ID3D11Texture2D> &texture,
+                               ComPtr<ID3D11ShaderResourceView> &srv) {
+    CreateTextureHelper(device, context, image.width, image.height,
+                        image.pixels, image.format, texture, srv);
 }
 
 void D3D11Utils::CreateDDSTexture(
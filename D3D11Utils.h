@@ -10,6 +10,10 @@
 #include <windows.h>
 #include <wrl/client.h> // Comptr
 
+#include "ShaderArchive.h"
+#include "ShaderBatch.h"
+#include "ShaderCache.h"
+
 #define SAFE_RELEASE(p)                                                        \
     {                                                                          \
         if ((p)) {                                                             \
@@ -32,8 +36,43 @@ inline void ThrowIfFailed(HRESULT hr) {
     }
 }
 
+// Decoded pixels of a texture. Reading them is most of the time a texture
+// takes and needs no device, so it may run on any thread.
+struct TextureImage {
+    int width = 0;
+    int height = 0;
+    DXGI_FORMAT format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    vector<uint8_t> pixels;
+};
+
+// D3DCompileFromFile with the standard include handler
+class D3DShaderCompiler : public ShaderCompiler {
+  public:
+    bool Compile(const ShaderKey &key, vector<uint8_t> &bytecode,
+                 std::string &errors) override;
+};
+
 class D3D11Utils {
   public:
+    // The Create*Shader() functions load their bytecode from it, and only
+    // compile what isn't cached yet.
+    static ShaderCache &GetShaderCache();
+    // Shaders.pak, open when InitShaders() found it. The cache looks
+    // shaders up in it first.
+    static ShaderArchive &GetShaderArchive();
+    // Compiled ahead on the job system, GetShaderBytecode() looks here
+    // before the cache until the batch is cleared.
+    static ShaderBatch &GetShaderBatch();
+    // With the compile flags of this build
+    static ShaderKey MakeShaderKey(const wstring &filename,
+                                   const char *entryPoint, const char *profile);
+    // Throws when the shader doesn't compile
+    static void GetShaderBytecode(const wstring &filename,
+                                  const char *entryPoint, const char *profile,
+                                  ShaderBytecode &bytecode);
+    static void GetShaderBytecode(const ShaderKey &key,
+                                  ShaderBytecode &bytecode);
+
     static Vector3 GetTangent(Vector3 edge1, Vector3 edge2, Vector2 deltaTex1,
                               Vector2 deltaTex2) {
         const float f =
@@ -180,6 +219,87 @@ class D3D11Utils {
         context->Unmap(buffer.Get(), NULL);
     }
 
+    // Dynamic StructuredBuffer for the shaders. (Re)created with some
+    // headroom when the data doesn't fit.
+    template <typename T_ELEMENT>
+    static void UpdateStructuredBuffer(ComPtr<ID3D11Device> &device,
+                                       ComPtr<ID3D11DeviceContext> &context,
+                                       const vector<T_ELEMENT> &elements,
+                                       ComPtr<ID3D11Buffer> &buffer,
+                                       ComPtr<ID3D11ShaderResourceView> &srv) {
+        D3D11_BUFFER_DESC desc;
+        ZeroMemory(&desc, sizeof(desc));
+        if (buffer)
+            buffer->GetDesc(&desc);
+
+        const UINT numElements = std::max(UINT(elements.size()), 1u);
+        if (!buffer || desc.ByteWidth < numElements * sizeof(T_ELEMENT)) {
+            const UINT capacity = std::max(
+                numElements, UINT(desc.ByteWidth / sizeof(T_ELEMENT) * 2));
+
+            ZeroMemory(&desc, sizeof(desc));
+            desc.ByteWidth = UINT(capacity * sizeof(T_ELEMENT));
+            desc.Usage = D3D11_USAGE_DYNAMIC;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            desc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+            desc.StructureByteStride = sizeof(T_ELEMENT);
+            ThrowIfFailed(device->CreateBuffer(
+                &desc, NULL, buffer.ReleaseAndGetAddressOf()));
+
+            D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+            ZeroMemory(&srvDesc, sizeof(srvDesc));
+            srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+            srvDesc.Buffer.NumElements = capacity;
+            ThrowIfFailed(device->CreateShaderResourceView(
+                buffer.Get(), &srvDesc, srv.ReleaseAndGetAddressOf()));
+        }
+
+        if (elements.empty())
+            return;
+
+        D3D11_MAPPED_SUBRESOURCE ms;
+        context->Map(buffer.Get(), NULL, D3D11_MAP_WRITE_DISCARD, NULL, &ms);
+        memcpy(ms.pData, elements.data(), elements.size() * sizeof(T_ELEMENT));
+        context->Unmap(buffer.Get(), NULL);
+    }
+
+    // Dynamic vertex buffer, e.g. per-instance data that changes every
+    // pass. (Re)created with some headroom when the data doesn't fit.
+    template <typename T_VERTEX>
+    static void UpdateVertexBuffer(ComPtr<ID3D11Device> &device,
+                                   ComPtr<ID3D11DeviceContext> &context,
+                                   const vector<T_VERTEX> &vertices,
+                                   ComPtr<ID3D11Buffer> &buffer) {
+        D3D11_BUFFER_DESC desc;
+        ZeroMemory(&desc, sizeof(desc));
+        if (buffer)
+            buffer->GetDesc(&desc);
+
+        const UINT numVertices = std::max(UINT(vertices.size()), 1u);
+        if (!buffer || desc.ByteWidth < numVertices * sizeof(T_VERTEX)) {
+            const UINT capacity = std::max(
+                numVertices, UINT(desc.ByteWidth / sizeof(T_VERTEX) * 2));
+
+            ZeroMemory(&desc, sizeof(desc));
+            desc.ByteWidth = UINT(capacity * sizeof(T_VERTEX));
+            desc.Usage = D3D11_USAGE_DYNAMIC;
+            desc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+            desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+            ThrowIfFailed(device->CreateBuffer(
+                &desc, NULL, buffer.ReleaseAndGetAddressOf()));
+        }
+
+        if (vertices.empty())
+            return;
+
+        D3D11_MAPPED_SUBRESOURCE ms;
+        context->Map(buffer.Get(), NULL, D3D11_MAP_WRITE_DISCARD, NULL, &ms);
+        memcpy(ms.pData, vertices.data(), vertices.size() * sizeof(T_VERTEX));
+        context->Unmap(buffer.Get(), NULL);
+    }
+
     static void
     CreateTexture(ComPtr<ID3D11Device> &device,
                   ComPtr<ID3D11DeviceContext> &context,
@@ -193,6 +313,19 @@ class D3D11Utils {
         const std::string roughnessFilename, ComPtr<ID3D11Texture2D> &texture,
         ComPtr<ID3D11ShaderResourceView> &srv);
 
+    // The two halves of the functions above: the read on any thread, then
+    // the upload and mips on the context's thread.
+    static void ReadTexture(const std::string filename, const bool usSRGB,
+                            TextureImage &image);
+    static void ReadMetallicRoughnessTexture(
+        const std::string metallicFilename,
+        const std::string roughnessFilename, TextureImage &image);
+    static void CreateTexture(ComPtr<ID3D11Device> &device,
+                              ComPtr<ID3D11DeviceContext> &context,
+                              const TextureImage &image,
+                              ComPtr<ID3D11Texture2D> &texture,
+                              ComPtr<ID3D11ShaderResourceView> &srv);
+
     static void
     CreateTextureArray(ComPtr<ID3D11Device> &device,
                        ComPtr<ID3D11DeviceContext> &context,
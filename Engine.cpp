@@ -1,14 +1,18 @@
 #include "Engine.h"
 
 #include <DirectXCollision.h> //   浹 꿡 
+#include <chrono>
 #include <directxtk/DDSTextureLoader.h>
 #include <directxtk/SimpleMath.h>
+#include <fstream>
 #include <random>
 #include <tuple>
 #include <vector>
 
 #include "GeometryGenerator.h"
 #include "GraphicsCommon.h"
+#include "Hash.h"
+#include "JobSystem.h"
 
 namespace jRenderer {
 
@@ -23,6 +27,9 @@ bool Engine::Initialize() {
     if (!AppBase::Initialize())
         return false;
 
+    m_recorder.Initialize(m_device, uint32_t(JobSystem::GetThreadCount()));
+    m_shadowCache.Resize(SHADOW_SLOT_CASCADES + NUM_CASCADES);
+
     // SkyBox texture Init
     AppBase::InitCubemaps(L"Assets/CubeMap/", L"blueroomEnvHDR.dds",
                           L"blueroomSpecularHDR.dds", L"blueroomDiffuseHDR.dds",
@@ -31,16 +38,16 @@ bool Engine::Initialize() {
     // ó ڽ
     {
         MeshData screenBox = GeometryGenerator::MakeSquare();
-        m_screenSquare =
-            make_shared<Model>(m_device, m_context, vector{screenBox}, 0);
+        m_screenSquare = MakePooled<Model>("Model", m_device, m_context,
+                                           vector{screenBox}, 0);
     }
 
     //  н ׸ ڽ
     {
         MeshData screenSquare = GeometryGenerator::MakeSquare(0.2f);
         for (int i = 0; i < 4; i++) {
-            m_screenRenderPass[i] = make_shared<Model>(m_device, m_context,
-                                                       vector{screenSquare}, 0);
+            m_screenRenderPass[i] = MakePooled<Model>(
+                "Model", m_device, m_context, vector{screenSquare}, 0);
             m_screenRenderPass[i]->UpdateWorldRow(Matrix::CreateTranslation(
                 Vector3(-0.75f, 0.7f - (0.4f * (float)i), 0.0f)));
         }
@@ -54,8 +61,8 @@ bool Engine::Initialize() {
     {
         MeshData skyBoxMesh = GeometryGenerator::MakeBox(25.0f);
         std::reverse(skyBoxMesh.indices.begin(), skyBoxMesh.indices.end());
-        m_skybox =
-            make_shared<Model>(m_device, m_context, vector{skyBoxMesh}, 0);
+        m_skybox = MakePooled<Model>("Model", m_device, m_context,
+                                     vector{skyBoxMesh}, 0);
 
         m_skybox->m_materialConstsCPU.albedoFactor = Vector3(1.0f);
         m_skybox->m_materialConstsCPU.roughnessFactor = 0.3f;
@@ -73,53 +80,52 @@ bool Engine::Initialize() {
         ground.normalTextureFilename =
             "Assets/Bricks075A/Bricks075A_1K-JPG_NormalDX.jpg";
 
-        m_ground[0] =
-            make_shared<Model>(m_device, m_context, vector{ground}, 0);
-        m_ground[0]->UpdateWorldRow(
-            Matrix::CreateRotationX(1.0f / 2.0f * 3.141592f) *
-            Matrix::CreateTranslation(Vector3(0.0f, -2.5f, 0.0f)));
+        m_ground[0] = MakePooled<Model>("Model", m_device, m_context,
+                                        vector{ground}, 0);
         m_ground[0]->m_materialConstsCPU.albedoFactor =
             Vector3(0.4f, 0.5f, 0.2f);
                                       
-        m_basicList.push_back(m_ground[0]);
+        AddToScene(m_ground[0],
+                   Matrix::CreateRotationX(1.0f / 2.0f * 3.141592f) *
+                       Matrix::CreateTranslation(Vector3(0.0f, -2.5f, 0.0f)));
 
-        m_ground[1] = make_shared<Model>(m_device, m_context, vector{box}, 0);
+        m_ground[1] =
+            MakePooled<Model>("Model", m_device, m_context, vector{box}, 0);
         m_ground[1]->m_materialConstsCPU.roughnessFactor = 0.3f;
         m_ground[1]->m_materialConstsCPU.metallicFactor = 0.8f;
-        m_ground[1]->UpdateWorldRow(
-            Matrix::CreateTranslation(Vector3(0.0f, 0.0f, 5.0f)));
         m_ground[1]->m_materialConstsCPU.albedoFactor =
             Vector3(0.1f, 0.1f, 0.3f);
 
-        m_basicList.push_back(m_ground[1]);
+        AddToScene(m_ground[1],
+                   Matrix::CreateTranslation(Vector3(0.0f, 0.0f, 5.0f)),
+                   SCENE_VISIBLE | SCENE_CAST_SHADOW | SCENE_OCCLUDER);
 
-        m_ground[2] = make_shared<Model>(m_device, m_context, vector{box}, 0);
-        m_ground[2]->UpdateWorldRow(
-            Matrix::CreateTranslation(Vector3(5.0f, 0.0f, 0.0f)));
+        m_ground[2] =
+            MakePooled<Model>("Model", m_device, m_context, vector{box}, 0);
         m_ground[2]->m_materialConstsCPU.albedoFactor =
             Vector3(0.8f, 0.1f, 0.3f);
 
-        m_basicList.push_back(m_ground[2]);
+        AddToScene(m_ground[2],
+                   Matrix::CreateTranslation(Vector3(5.0f, 0.0f, 0.0f)),
+                   SCENE_VISIBLE | SCENE_CAST_SHADOW | SCENE_OCCLUDER);
     }
 
     // Main Object
     {
-        auto meshes = Model::ReadFromFile("Assets/DamagedHelmet/",
-                                          "DamagedHelmet.gltf", false);
-
         // Vector3 center(0.0f, 0.5f, 0.0f);
         // m_mainObj = make_shared<Model>(m_device, m_context, meshes);
         /*auto meshes = GeometryGenerator::MakeBox(0.2f);*/
 
+        // From the file, so a hot reload can read it again
         Vector3 center(0.0f, 0.5f, 1.0f);
-        m_mainObj = make_shared<Model>(m_device, m_context, vector{meshes}, 0);
+        m_mainObj = MakePooled<Model>("Model", m_device, m_context,
+                                      "Assets/DamagedHelmet/",
+                                      "DamagedHelmet.gltf");
 
         m_mainObj->m_materialConstsCPU.invertNormalMapY = true; // GLTF true
         m_mainObj->m_materialConstsCPU.albedoFactor = Vector3(0.9f, 0.2f, 0.2f);
         m_mainObj->m_materialConstsCPU.roughnessFactor = 0.3f;
         m_mainObj->m_materialConstsCPU.metallicFactor = 0.8f;
-        m_mainObj->UpdateWorldRow(Matrix::CreateTranslation(center));
-        m_mainObj->m_castShadow = true;
 
         for (int i = 0; i < 1; i++) {
             m_mainObj->m_instancedConstsCPU.instanceMat[i] =
@@ -131,7 +137,8 @@ bool Engine::Initialize() {
         m_mainBoundingSphere = BoundingSphere(center, 0.5f);
         m_mainObj->UpdateConstantBuffers(m_device, m_context);
 
-        m_basicList.push_back(m_mainObj);
+        m_mainHandle =
+            AddToScene(m_mainObj, Matrix::CreateTranslation(center));
     }
 
     //  obj
@@ -151,19 +158,19 @@ bool Engine::Initialize() {
         //    "Assets/rustediron/rustediron2_normal.png";
 
         Vector3 center(-3.5f, 0.5f, 0.0f);
-        m_boxObj = make_shared<Model>(m_device, m_context, vector{meshes}, 0);
+        m_boxObj = MakePooled<Model>("Model", m_device, m_context,
+                                     vector{meshes}, 0);
         m_boxObj->m_materialConstsCPU.albedoFactor = Vector3(0.8f);
         m_boxObj->m_materialConstsCPU.roughnessFactor = 1.0f;
         m_boxObj->m_materialConstsCPU.metallicFactor = 0.2f;
-        m_boxObj->UpdateWorldRow(
-            Matrix::CreateScale(5.0f) *
-            Matrix::CreateRotationY(1.0f / 2.0f * 3.141592f) *
-            Matrix::CreateTranslation(center));
         m_boxObj->m_materialConstsCPU.invertNormalMapY = false; // GLTF true
 
         m_boxObj->UpdateConstantBuffers(m_device, m_context);
 
-        m_basicList.push_back(m_boxObj);
+        AddToScene(m_boxObj,
+                   Matrix::CreateScale(5.0f) *
+                       Matrix::CreateRotationY(1.0f / 2.0f * 3.141592f) *
+                       Matrix::CreateTranslation(center));
     }
 
     // light setting
@@ -201,25 +208,181 @@ bool Engine::Initialize() {
     {
         for (int i = 0; i < MAX_LIGHTS; i++) {
             MeshData sphere = GeometryGenerator::MakeSphere(1.0f, 20, 20);
-            m_lightSphere[i] =
-                make_shared<Model>(m_device, m_context, vector{sphere}, 0);
-            m_lightSphere[i]->UpdateWorldRow(Matrix::CreateTranslation(
-                m_globalConstsCPU.lights[i].position));
+            m_lightSphere[i] = MakePooled<Model>("Model", m_device, m_context,
+                                                 vector{sphere}, 0);
             m_lightSphere[i]->m_materialConstsCPU.albedoFactor =
                 m_globalConstsCPU.lights[i].lightColor;
             m_lightSphere[i]->m_materialConstsCPU.emissionFactor =
                 Vector3(1.0f, 0.0f, 0.0f);
-            m_lightSphere[i]->m_castShadow = false;
 
-            if (m_globalConstsCPU.lights[i].type == LIGHT_OFF)
-                m_lightSphere[i]->m_isVisible = false;
+            const bool isVisible =
+                m_globalConstsCPU.lights[i].type != LIGHT_OFF;
+            m_lightSphereHandles[i] = AddToScene(
+                m_lightSphere[i],
+                Matrix::CreateTranslation(m_globalConstsCPU.lights[i].position),
+                uint8_t(isVisible ? SCENE_VISIBLE : 0));
+        }
+    }
+    // Clustered lighting: many small point lights around the scene
+    {
+        std::mt19937 gen(0);
+        std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+        m_extraLights.resize(MAX_EXTRA_LIGHTS);
+        for (auto &light : m_extraLights) {
+            light.type = LIGHT_POINT;
+            light.position = Vector3(-6.0f + 12.0f * dist(gen),
+                                     0.1f + 2.0f * dist(gen),
+                                     -4.0f + 8.0f * dist(gen));
+            light.fallOffEnd = 0.5f + dist(gen); // range
+            light.radiance = Vector3(1.0f);
+            light.lightColor = Vector3(dist(gen), dist(gen), dist(gen));
+        }
 
-            m_basicList.push_back(m_lightSphere[i]);
+        D3D11Utils::CreateConstBuffer(m_device, ClusterConstants(),
+                                      m_clusterConstsGPU);
+    }
+    // Cascaded shadow map
+    {
+        for (int c = 0; c < NUM_CASCADES; c++) {
+            D3D11Utils::CreateConstBuffer(m_device, GlobalConstants(),
+                                          m_cascadeGlobalConstsGPU[c]);
         }
+        D3D11Utils::CreateConstBuffer(m_device, ShadowCascadeConstants(),
+                                      m_cascadeConstsGPU);
+    }
+    // Shadow atlas
+    {
+        m_shadowAtlas.Initialize(uint32_t(m_shadowAtlasSize),
+                                 SHADOW_ATLAS_MIN_TILE);
+        D3D11Utils::CreateConstBuffer(m_device, ShadowAtlasConstants(),
+                                      m_shadowAtlasConstsGPU);
     }
+    // SSAO, the targets are made with the other screen buffers
+    D3D11Utils::CreateConstBuffer(m_device, m_ssaoConstsCPU, m_ssaoConstsGPU);
+
+    // Registered now, watched once the GUI turns it on
+    Graphics::AddShaderReloads(m_hotReload, m_device);
+    for (const auto &model : m_scene.m_models)
+        Model::AddReloads(model, m_hotReload, m_device, m_context);
+
+    BuildMaterialTable();
     return true;
 }
 
+SceneHandle Engine::AddToScene(const shared_ptr<Model> &model,
+                               const Matrix &worldRow, uint8_t flags) {
+    return m_scene.Add(model, worldRow, model->m_boundingBoxMin,
+                       model->m_boundingBoxMax, flags);
+}
+
+void Engine::OnHotReload() {
+    // A caster's mesh or the depth shaders may have changed.
+    m_shadowCache.Invalidate();
+    // A reloaded model may have new bounds too
+    for (uint32_t k = 0; k < m_scene.GetSize(); k++) {
+        const auto &model = m_scene.m_models[k];
+        m_scene.SetLocalBounds(k, model->m_boundingBoxMin,
+                               model->m_boundingBoxMax);
+    }
+    // The arrays hold copies of the maps
+    BuildMaterialTable();
+}
+
+void Engine::BuildMaterialTable() {
+    // MaterialSlot order
+    const uint32_t meshSlots[NUM_MATERIAL_SLOTS] = {
+        MESH_ALBEDO_TEXTURE, MESH_NORMAL_TEXTURE, MESH_AO_TEXTURE,
+        MESH_METALLIC_ROUGHNESS_TEXTURE, MESH_EMISSIVE_TEXTURE};
+
+    m_materialTable.Clear();
+    vector<ID3D11Texture2D *> textures; // per texture id of the table
+    for (const auto &model : m_scene.m_models) {
+        for (size_t m = 0; m < model->m_meshes.size(); m++) {
+            Mesh &mesh = *model->m_meshes[m];
+            ID3D11Texture2D *meshTextures[NUM_MATERIAL_SLOTS] = {
+                mesh.albedoTexture.Get(), mesh.normalTexture.Get(),
+                mesh.aoTexture.Get(), mesh.metallicRoughnessTexture.Get(),
+                mesh.emissiveTexture.Get()};
+            std::array<uint32_t, NUM_MATERIAL_SLOTS> maps;
+            for (uint32_t s = 0; s < NUM_MATERIAL_SLOTS; s++) {
+                ID3D11Texture2D *texture = meshTextures[s];
+                if (!texture) {
+                    maps[s] = MATERIAL_NO_MAP;
+                    continue;
+                }
+                D3D11_TEXTURE2D_DESC desc;
+                texture->GetDesc(&desc);
+                MaterialTextureDesc arrayDesc;
+                arrayDesc.width = desc.Width;
+                arrayDesc.height = desc.Height;
+                arrayDesc.mipLevels = desc.MipLevels;
+                arrayDesc.format = uint32_t(desc.Format);
+
+                // Meshes that read the same file share its layer
+                std::string key = std::to_string(uintptr_t(texture));
+                if (m < model->m_textureSources.size()) {
+                    const auto &source =
+                        model->m_textureSources[m][meshSlots[s]];
+                    if (!source.IsEmpty()) {
+                        key = source.filename + '|' +
+                              source.roughnessFilename +
+                              (source.isSRGB ? "|sRGB" : "");
+                    }
+                }
+                maps[s] = m_materialTable.AddTexture(key, arrayDesc);
+                if (maps[s] == textures.size())
+                    textures.push_back(texture);
+            }
+            mesh.material = m_materialTable.AddMaterial(maps);
+        }
+    }
+    m_materialTable.Build();
+
+    const auto &arrays = m_materialTable.GetArrays();
+    for (uint32_t a = 0; a < MAX_MATERIAL_ARRAYS; a++) {
+        m_materialArrays[a].Reset();
+        m_materialArraySRVs[a].Reset();
+        if (a >= arrays.size())
+            continue;
+
+        const auto &array = arrays[a];
+        D3D11_TEXTURE2D_DESC desc;
+        ZeroMemory(&desc, sizeof(desc));
+        desc.Width = array.desc.width;
+        desc.Height = array.desc.height;
+        desc.MipLevels = array.desc.mipLevels;
+        desc.ArraySize = UINT(array.textures.size());
+        desc.Format = DXGI_FORMAT(array.desc.format);
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        ThrowIfFailed(m_device->CreateTexture2D(
+            &desc, NULL, m_materialArrays[a].GetAddressOf()));
+        // The maps are single textures, their subresources are the mips.
+        for (UINT layer = 0; layer < desc.ArraySize; layer++) {
+            for (UINT mip = 0; mip < desc.MipLevels; mip++) {
+                m_context->CopySubresourceRegion(
+                    m_materialArrays[a].Get(),
+                    D3D11CalcSubresource(mip, layer, desc.MipLevels), 0, 0, 0,
+                    textures[array.textures[layer]], mip, NULL);
+            }
+        }
+
+        D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc;
+        ZeroMemory(&srvDesc, sizeof(srvDesc));
+        srvDesc.Format = desc.Format;
+        srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2DARRAY;
+        srvDesc.Texture2DArray.MipLevels = desc.MipLevels;
+        srvDesc.Texture2DArray.ArraySize = desc.ArraySize;
+        ThrowIfFailed(m_device->CreateShaderResourceView(
+            m_materialArrays[a].Get(), &srvDesc,
+            m_materialArraySRVs[a].GetAddressOf()));
+    }
+    D3D11Utils::UpdateStructuredBuffer(m_device, m_context,
+                                       m_materialTable.GetMaterials(),
+                                       m_materialsGPU, m_materialsSRV);
+}
+
 void Engine::Update(float dt) {
     // camera moving
     m_camera.UpdateKeyboard(dt, m_keyPressed);
@@ -232,98 +395,54 @@ void Engine::Update(float dt) {
     // Update Global ConstantBuffer
     AppBase::UpdateGlobalConstants(eyeWorld, viewRow, projRow);
 
-    //   ׸
-    for (int i = 0; i < MAX_LIGHTS; i++) {
-        const auto &light = m_globalConstsCPU.lights[i];
-        if (light.type & LIGHT_SHADOW) {
-
-            Vector3 up = Vector3(0.0f, 1.0f, 0.0f);
-            //    upDir dot  -1 ٸ, װ 
-            // ̰ 180 ٴ ̾߱, upDir 
-            // Ѵ.
-            if (abs(up.Dot(light.direction) + 1.0f) < 1e-5)
-                up = Vector3(1.0f, 0.0f, 0.0f);
-
-            // https://learn.microsoft.com/ko-kr/windows/win32/api/directxmath/nf-directxmath-xmmatrixperspectivefovlh
-            Matrix lightProjRow = XMMatrixPerspectiveFovLH(
-                XMConvertToRadians(120.0f), 1.0f, 0.01f, 25.0f);
-            // Matrix lightProjRow = XMMatrixOrthographicOffCenterLH(
-            //         -10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 100.0f);
-            //  lightProjRow =
-            //  XMMatrixOrthographicLH(20.0f, 20.0f, 1.0f, 7.5f);
-
-            // https://learn.microsoft.com/ko-kr/windows/win32/api/directxmath/nf-directxmath-xmmatrixlookatlh
-            Vector3 targetVec = (light.position + light.direction);
-            targetVec.Normalize();
-            Matrix lightViewRow =
-                XMMatrixLookAtLH(light.position, targetVec, up);
-                  
-            m_shadowGlobalConstsCPU[i].eyeWorld = light.position;
-            m_shadowGlobalConstsCPU[i].view = lightViewRow.Transpose();
-            m_shadowGlobalConstsCPU[i].proj = lightProjRow.Transpose();
-            m_shadowGlobalConstsCPU[i].invProj = 
-                lightProjRow.Invert().Transpose();
-            m_shadowGlobalConstsCPU[i].viewProj =
-                (lightViewRow * lightProjRow).Transpose();                 
-
-            if (light.type & LIGHT_POINT) {
-                Matrix pointLightProjRow = XMMatrixPerspectiveFovLH(
-                    XMConvertToRadians(90.0f), 1.0f, 1.0f, 50.0f);
-                Vector3 directions[6] = {
-                    {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
-                    {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
-                    {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
-                Vector3 upDir[6] = {{0.0f, 1.0f, 0.0f},  {0.0f, 1.0f, 0.0f},
-                                    {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f, 1.0f},
-                                    {0.0f, 1.0f, 1.0f},  {0.0f, 1.0f, 0.0f}};
-
-                for (int face = 0; face < 6; ++face) {
-                    lightViewRow = XMMatrixLookAtLH(
-                        light.position, light.position + directions[face],
-                        upDir[face]);
-                    m_pointLightTransformCPU[i].shadowViewProj[face] =
-                        (lightViewRow * pointLightProjRow).Transpose();
-                }
-                D3D11Utils::UpdateBuffer(m_device, m_context,
-                                         m_pointLightTransformCPU[i],
-                                         m_pointLightTransformGPU[i]);
-            }
-            // for (int x = 0; x < 4; x++) // loop 3 times for three lines
-            //{
-            //     for (int y = 0; y < 4;
-            //          y++) // loop for the three elements on the line
-            //     {
-            //         Matrix temp =
-            //         m_pointLightTransformCPU[2].shadowViewProj[1]; cout <<
-            //         temp.m[x][y] << " "; // display the
-            //                                      // current element
-            //                                      // out of
-            //                                      // the array
-            //     }
-            //     cout << endl; // when the inner loop is done, go to a new
-            //     line
-            // }
-
-            D3D11Utils::UpdateBuffer(m_device, m_context,
-                                     m_shadowGlobalConstsCPU[i],
-                                     m_shadowGlobalConstsGPU[i]);
+    // The benchmark re-creates the pool, so only the thread that owns it
+    // (not the pipelined update thread) may run it.
+    // Hot reload rebuilds run on the job system too, they wait.
+    if (m_runJobBenchmark && JobSystem::GetThreadIndex() == 0) {
+        m_runJobBenchmark = false;
+        auto pause = m_hotReload.Pause();
+        BenchmarkJobScaling(eyeWorld, viewRow, projRow);
+    }
+    if (m_runCompileBenchmark && JobSystem::GetThreadIndex() == 0) {
+        m_runCompileBenchmark = false;
+        auto pause = m_hotReload.Pause();
+        m_compileScaling = ShaderBatch::Benchmark(64, 20);
+    }
 
-            // ׸ڸ    ʿ
-            m_globalConstsCPU.lights[i].viewProj =
-                m_shadowGlobalConstsCPU[i].viewProj;
-            m_globalConstsCPU.lights[i].invProj =
-                m_shadowGlobalConstsCPU[i].invProj;
+    //   ׸
+    // Lights are independent, so the matrices are computed in parallel.
+    // They are uploaded in Render() from the snapshot.
+    // The first directional shadow light uses cascades.
+    m_cascadeLight = -1;
+    for (int i = 0; i < MAX_LIGHTS && m_useCascades; i++) {
+        const auto type = m_globalConstsCPU.lights[i].type;
+        if ((type & LIGHT_DIRECTIONAL) && (type & LIGHT_SHADOW)) {
+            m_cascadeLight = i;
+            break;
         }
     }
+    JobSystem::ParallelFor(MAX_LIGHTS, 1, [&](uint32_t begin, uint32_t end) {
+        for (uint32_t i = begin; i < end; i++) {
+            if (int(i) == m_cascadeLight)
+                UpdateCascades(viewRow, projRow);
+            else
+                UpdateShadowMatrices(int(i));
+        }
+    });
+    UpdateShadowAtlas(eyeWorld, viewRow, projRow);
 
     //  ġ ݿ
     for (int i = 0; i < MAX_LIGHTS; i++) {
-        m_lightSphere[i]->UpdateWorldRow(
+        m_scene.SetWorldRow(
+            m_lightSphereHandles[i],
             Matrix::CreateScale(
                 std::max(0.01f, m_globalConstsCPU.lights[i].radius)) *
-            Matrix::CreateTranslation(m_globalConstsCPU.lights[i].position));
+                Matrix::CreateTranslation(
+                    m_globalConstsCPU.lights[i].position));
     }
 
+    UpdateLightClusters(viewRow, projRow);
+
     static float prevRatio = 0.0f;
     static Vector3 prevPos(0.0f);
     static Vector3 prevVector(0.0f);
@@ -416,136 +535,1350 @@ void Engine::Update(float dt) {
         }
     }
 
-    Vector3 transition = m_mainObj->m_worldRow.Translation();
-    m_mainObj->m_worldRow.Translation(Vector3(0.0f));
-    m_mainObj->UpdateWorldRow(
-        m_mainObj->m_worldRow * Matrix::CreateFromQuaternion(q) *
-        Matrix::CreateTranslation(dragTranslation + transition));
-    m_mainBoundingSphere.Center = m_mainObj->m_worldRow.Translation();
+    Matrix mainWorldRow = m_scene.GetWorldRow(m_mainHandle);
+    Vector3 transition = mainWorldRow.Translation();
+    mainWorldRow.Translation(Vector3(0.0f));
+    mainWorldRow = mainWorldRow * Matrix::CreateFromQuaternion(q) *
+                   Matrix::CreateTranslation(dragTranslation + transition);
+    m_scene.SetWorldRow(m_mainHandle, mainWorldRow);
+    m_mainBoundingSphere.Center = mainWorldRow.Translation();
+
+    // After everything moved for this frame, so the world IT rows and the
+    // bounds the culling reads match the world rows.
+    m_scene.UpdateTransforms();
+    CullOccludedModels(viewRow, projRow);
+    CullClusters(eyeWorld, viewRow, projRow);
+    CullShadowCasters();
+}
+
+void Engine::BuildSnapshot(RenderSnapshot &snapshot) {
+    snapshot.eyeWorld = m_camera.GetEyePos();
+    snapshot.viewRow = m_camera.GetViewRow();
+    snapshot.projRow = m_camera.GetProjRow();
 
-    for (auto &i : m_basicList) {
-        i->UpdateConstantBuffers(m_device, m_context);
+    snapshot.globalConsts = m_globalConstsCPU;
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        snapshot.shadowGlobalConsts[i] = m_shadowGlobalConstsCPU[i];
+        snapshot.pointLightTransforms[i] = m_pointLightTransformCPU[i];
+        snapshot.shadowRenderMasks[i] = m_shadowRenderMasks[i];
+    }
+    std::copy(std::begin(m_shadowTiles), std::end(m_shadowTiles),
+              snapshot.shadowTiles);
+    snapshot.shadowAtlasConsts = m_shadowAtlasConstsCPU;
+
+    snapshot.clusterConsts = m_lightGrid.GetConstants();
+    snapshot.clusterLights = m_clusterLights;
+    snapshot.clusterRanges = m_lightGrid.GetRanges();
+    snapshot.clusterLightIndices = m_lightGrid.GetLightIndices();
+
+    snapshot.cascadeConsts = m_cascadeConstsCPU;
+    snapshot.cascadeConsts.lightIndex = m_cascadeLight;
+    for (int c = 0; c < NUM_CASCADES; c++)
+        snapshot.cascadeGlobalConsts[c] = m_cascadeGlobalConstsCPU[c];
+
+    // The constants come from the store, the rest from the models.
+    snapshot.numModels = 0;
+    for (uint32_t k = 0; k < m_scene.GetSize(); k++) {
+        const uint8_t flags = m_scene.m_flags[k];
+        const bool castShadow = flags & SCENE_CAST_SHADOW;
+        const bool isOccluded = flags & SCENE_OCCLUDED;
+        if (!(flags & SCENE_VISIBLE) || (isOccluded && !castShadow))
+            continue;
+        if (snapshot.numModels == snapshot.models.size())
+            snapshot.models.emplace_back();
+        auto &model = snapshot.models[snapshot.numModels++];
+        m_scene.m_models[k]->Capture(model);
+        model.meshConsts.world = m_scene.m_worldRows[k].Transpose();
+        model.meshConsts.worldIT = m_scene.m_worldITRows[k].Transpose();
+        model.isOccluded = isOccluded;
+        model.castShadow = castShadow;
+        for (int l = 0; l < MAX_LIGHTS; l++)
+            model.shadowMasks[l] = m_shadowMasks[k * MAX_LIGHTS + l];
     }
 }
 
-void Engine::Render() {
-    AppBase::SetMainViewport();
+void Engine::UploadSnapshot(const RenderSnapshot &snapshot) {
+    D3D11Utils::UpdateBuffer(m_device, m_context, snapshot.globalConsts,
+                             m_globalConstsGPU);
+
+    D3D11Utils::UpdateBuffer(m_device, m_context, snapshot.clusterConsts,
+                             m_clusterConstsGPU);
+    D3D11Utils::UpdateBuffer(m_device, m_context, snapshot.cascadeConsts,
+                             m_cascadeConstsGPU);
+    D3D11Utils::UpdateBuffer(m_device, m_context, snapshot.shadowAtlasConsts,
+                             m_shadowAtlasConstsGPU);
+    if (snapshot.cascadeConsts.lightIndex >= 0) {
+        for (int c = 0; c < NUM_CASCADES; c++) {
+            D3D11Utils::UpdateBuffer(m_device, m_context,
+                                     snapshot.cascadeGlobalConsts[c],
+                                     m_cascadeGlobalConstsGPU[c]);
+        }
+    }
+    D3D11Utils::UpdateStructuredBuffer(m_device, m_context,
+                                       snapshot.clusterLights,
+                                       m_clusterLightsGPU, m_clusterLightsSRV);
+    D3D11Utils::UpdateStructuredBuffer(m_device, m_context,
+                                       snapshot.clusterRanges,
+                                       m_clusterRangesGPU, m_clusterRangesSRV);
+    D3D11Utils::UpdateStructuredBuffer(
+        m_device, m_context, snapshot.clusterLightIndices,
+        m_clusterLightIndicesGPU, m_clusterLightIndicesSRV);
 
-    m_context->VSSetSamplers(0, UINT(Graphics::sampleStates.size()),
-                             Graphics::sampleStates.data());
-    m_context->PSSetSamplers(0, UINT(Graphics::sampleStates.size()),
-                             Graphics::sampleStates.data());
-    const float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        const auto &light = snapshot.globalConsts.lights[i];
+        if (light.type & LIGHT_SHADOW) {
+            D3D11Utils::UpdateBuffer(m_device, m_context,
+                                     snapshot.shadowGlobalConsts[i],
+                                     m_shadowGlobalConstsGPU[i]);
+        }
+    }
+
+    for (size_t i = 0; i < snapshot.numModels; i++) {
+        const auto &model = snapshot.models[i];
+        model.model->UpdateConstantBuffers(m_device, m_context, model);
+    }
+}
+
+void Engine::RenderModels(const RenderSnapshot &snapshot) {
+    for (size_t i = 0; i < snapshot.numModels; i++) {
+        const auto &model = snapshot.models[i];
+        if (!model.isOccluded)
+            model.model->Render(m_context, model);
+    }
+}
+
+void Engine::SetCommonStates(ComPtr<ID3D11DeviceContext> &context) {
+    context->VSSetSamplers(0, UINT(Graphics::sampleStates.size()),
+                           Graphics::sampleStates.data());
+    context->PSSetSamplers(0, UINT(Graphics::sampleStates.size()),
+                           Graphics::sampleStates.data());
     // for cubemap texture
-    vector<ID3D11ShaderResourceView *> commonSRVs = {
+    ID3D11ShaderResourceView *commonSRVs[] = {
         m_specularSRV.Get(), m_irradianceSRV.Get(), m_envSRV.Get(),
         m_brdfSRV.Get()};
-    m_context->PSSetShaderResources(10, UINT(commonSRVs.size()),
-                                    commonSRVs.data());
-    AppBase::SetGlobalConsts(m_globalConstsGPU);       
+    context->PSSetShaderResources(10, UINT(std::size(commonSRVs)),
+                                  commonSRVs);
+    AppBase::SetGlobalConsts(context, m_globalConstsGPU);
+}
 
-    vector<ID3D11RenderTargetView *> RTVs = {m_resolvedRTV.Get()};
+void Engine::RenderShadowMaps(const RenderSnapshot &snapshot) {
+    // Recreated maps don't hold anything the cache knows about.
+    const bool renderAll = m_renderedShadowMapVersion != m_shadowMapVersion;
+    m_renderedShadowMapVersion = m_shadowMapVersion;
 
-    // Cubemap  stencil     κпٰ ť ׸
-    m_context->ClearDepthStencilView(m_depthStencilView.Get(),
-                                     D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-                                     1.0f, 0);
-    m_context->OMSetRenderTargets(0, NULL, m_depthStencilView.Get());
-    AppBase::SetPipelineState(Graphics::stencilMaskPSO);
-    for (auto &i : m_basicList) {
-        i->Render(m_context);
-    }   
-    m_context->ClearRenderTargetView(m_cubeMapRTV.Get(), clearColor);
-    m_context->OMSetRenderTargets(1, m_cubeMapRTV.GetAddressOf(),
-                                  m_depthStencilView.Get());
-    AppBase::SetPipelineState(Graphics::reflectSolidPSO);
-    m_skybox->Render(m_context);
-     
-    // deferred lighting  G-Buffer 
-    if (true) {
-        AppBase::SetPipelineState(Graphics::gBufferPSO);
-        m_gBuffer.PreRender(m_context);
-        for (auto &i : m_basicList) {
-            i->Render(m_context);
-        }
-    } 
-
-    vector<ID3D11ShaderResourceView *> deferredLightingSRVs = {
-        m_gBuffer.GetColorView(), m_gBuffer.GetNormalView(), 
-        m_gBuffer.GetSpecPowerView(), m_gBuffer.GetDepthView()};
-
-    // 1. SSAO texture 
-    m_context->ClearDepthStencilView(m_depthStencilView.Get(),
-                                     D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-                                     1.0f, 0);
-    m_context->ClearRenderTargetView(m_ssaoRTV.Get(), clearColor);
-    m_context->OMSetRenderTargets(1, m_ssaoRTV.GetAddressOf(),
-                                  m_depthStencilView.Get());
-    AppBase::SetPipelineState(Graphics::ssaoPSO); 
-    m_context->PSGetConstantBuffers(2, 1, m_kernelSamplesGPU.GetAddressOf());
-    m_context->PSSetShaderResources(5, UINT(deferredLightingSRVs.size()),
-                                    deferredLightingSRVs.data());
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        const auto &light = snapshot.globalConsts.lights[i];
+        if (!(light.type & LIGHT_SHADOW))
+            continue;
+        // Faces that changed since they were last rendered
+        const uint32_t faces =
+            renderAll ? 0xffu : snapshot.shadowRenderMasks[i];
+        if (!faces)
+            continue;
+
+        if (i == snapshot.cascadeConsts.lightIndex) {
+            for (int c = 0; c < NUM_CASCADES; c++) {
+                if (!((faces >> c) & 1))
+                    continue;
+                m_context->ClearDepthStencilView(
+                    m_cascadeShadowDSVs[c].Get(), D3D11_CLEAR_DEPTH, 1.0f, 0);
+                RenderShadowPass(snapshot, m_cascadeShadowDSVs[c].Get(),
+                                 m_cascadeGlobalConstsGPU[c],
+                                 Graphics::depthOnlyPSO, nullptr, i, 1u << c,
+                                 nullptr, 0);
+            }
+            continue;
+        }
+
+        // The other lights render into their atlas tiles.
+        const ShadowTile *tiles = &snapshot.shadowTiles[i * 6];
+        if (!tiles[0].IsValid())
+            continue;
+        const bool isPoint = (light.type & LIGHT_POINT) != 0;
+        const int numFaces = isPoint ? 6 : 1;
+        D3D11_VIEWPORT viewports[6];
+        D3D11_VIEWPORT dirtyViewports[6];
+        UINT numDirty = 0;
+        for (int f = 0; f < numFaces; f++) {
+            auto &viewport = viewports[f];
+            viewport.TopLeftX = float(tiles[f].x);
+            viewport.TopLeftY = float(tiles[f].y);
+            viewport.Width = float(tiles[f].size);
+            viewport.Height = float(tiles[f].size);
+            viewport.MinDepth = 0.0f;
+            viewport.MaxDepth = 1.0f;
+            if ((faces >> f) & 1)
+                dirtyViewports[numDirty++] = viewport;
+        }
+        ClearShadowTiles(dirtyViewports, numDirty);
+
+        if (isPoint) {
+            ShadowLightTransform transforms = snapshot.pointLightTransforms[i];
+            transforms.faceMask = faces & 0x3f;
+            D3D11Utils::UpdateBuffer(m_device, m_context, transforms,
+                                     m_pointLightTransformGPU[i]);
+            if (m_useInstancedCubeShadows && Graphics::shadowCubeInstancedVS) {
+                RenderCubeShadowInstanced(snapshot, i, faces, viewports);
+            } else {
+                // point light GS ť 6   ׸.
+                // Each face goes to its own viewport, the GS skips the
+                // faces that are not in faceMask.
+                RenderShadowPass(snapshot, m_shadowAtlasDSV.Get(),
+                                 m_shadowGlobalConstsGPU[i],
+                                 Graphics::shadowCubeMapPSO,
+                                 m_pointLightTransformGPU[i].Get(), i, faces,
+                                 viewports, 6);
+            }
+        } else {
+            RenderShadowPass(snapshot, m_shadowAtlasDSV.Get(),
+                             m_shadowGlobalConstsGPU[i],
+                             Graphics::depthOnlyPSO, nullptr, i, 1u,
+                             viewports, 1);
+        }
+    }
+}
+
+void Engine::RenderCubeShadowInstanced(const RenderSnapshot &snapshot,
+                                       int lightIndex, uint32_t faces,
+                                       const D3D11_VIEWPORT *viewports) {
+    // The faces a caster touches come from CullShadowCasters(). Each one is
+    // an instance, so the GPU only sees the triangles of those faces.
+    m_shadowCasters.clear();
+    m_shadowCosts.clear();
+    m_shadowFaceInstances.clear();
+    // Per m_shadowCasters entry, its faces and first instance
+    uint32_t *faceCopies = m_frameArena.AllocateArray<uint32_t>(
+        snapshot.numModels, "Shadow casters");
+    uint32_t *faceStarts = m_frameArena.AllocateArray<uint32_t>(
+        snapshot.numModels, "Shadow casters");
+    for (uint32_t k = 0; k < uint32_t(snapshot.numModels); k++) {
+        const auto &model = snapshot.models[k];
+        const uint32_t mask = model.shadowMasks[lightIndex] & faces & 0x3f;
+        if (!mask)
+            continue;
+
+        const uint32_t instances = model.instancedConsts.useInstancing
+                                       ? uint32_t(model.model->m_instanceCount)
+                                       : 1u;
+        uint32_t copies = 0;
+        faceStarts[m_shadowCasters.size()] =
+            uint32_t(m_shadowFaceInstances.size());
+        for (uint32_t instance = 0; instance < instances; instance++) {
+            copies = 0;
+            for (uint32_t f = 0; f < 6; f++) {
+                if (!((mask >> f) & 1))
+                    continue;
+                ShadowFaceInstance faceInstance;
+                faceInstance.face = f;
+                faceInstance.modelInstance = instance;
+                m_shadowFaceInstances.push_back(faceInstance);
+                copies++;
+            }
+        }
+        faceCopies[m_shadowCasters.size()] = copies;
+        m_shadowCasters.push_back(k);
+        m_shadowCosts.push_back(model.shadowCost * copies);
+    }
+    if (m_shadowCasters.empty())
+        return;
+
+    D3D11Utils::UpdateVertexBuffer(m_device, m_context, m_shadowFaceInstances,
+                                   m_shadowFaceInstancesGPU);
+
+    m_recorder.RecordPass(
+        m_context, m_shadowCosts,
+        [&](ComPtr<ID3D11DeviceContext> &context) {
+            context->RSSetViewports(6, viewports);
+            AppBase::SetPipelineState(context,
+                                      Graphics::shadowCubeInstancedPSO);
+            AppBase::SetGlobalConsts(context,
+                                     m_shadowGlobalConstsGPU[lightIndex]);
+            context->VSSetConstantBuffers(
+                3, 1, m_pointLightTransformGPU[lightIndex].GetAddressOf());
+            const UINT stride = sizeof(ShadowFaceInstance);
+            const UINT offset = 0;
+            context->IASetVertexBuffers(
+                1, 1, m_shadowFaceInstancesGPU.GetAddressOf(), &stride,
+                &offset);
+            context->OMSetRenderTargets(0, NULL, m_shadowAtlasDSV.Get());
+        },
+        [&](ComPtr<ID3D11DeviceContext> &context, uint32_t begin,
+            uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                const auto &model = snapshot.models[m_shadowCasters[k]];
+                model.model->RenderCopies(context, model, faceCopies[k],
+                                          faceStarts[k]);
+            }
+        });
+}
+
+void Engine::ClearShadowTiles(const D3D11_VIEWPORT *viewports, UINT count) {
+    if (!count)
+        return;
+    // A DSV clear always covers the whole atlas, so a triangle at depth 1
+    // with the depth test off is drawn over each tile instead.
+    AppBase::SetPipelineState(Graphics::shadowTileClearPSO);
+    m_context->OMSetRenderTargets(0, NULL, m_shadowAtlasDSV.Get());
+    for (UINT k = 0; k < count; k++) {
+        m_context->RSSetViewports(1, &viewports[k]);
+        m_context->Draw(3, 0);
+    }
+}
+
+void Engine::RenderShadowPass(const RenderSnapshot &snapshot,
+                              ID3D11DepthStencilView *dsv,
+                              ComPtr<ID3D11Buffer> &globalConstsGPU,
+                              const GraphicsPSO &pso,
+                              ID3D11Buffer *shadowTransformsGPU,
+                              int lightIndex, uint32_t faces,
+                              const D3D11_VIEWPORT *viewports,
+                              UINT numViewports) {
+    m_shadowCasters.clear();
+    m_shadowCosts.clear();
+    for (uint32_t k = 0; k < uint32_t(snapshot.numModels); k++) {
+        const auto &model = snapshot.models[k];
+        if (!(model.shadowMasks[lightIndex] & faces))
+            continue;
+        m_shadowCasters.push_back(k);
+        m_shadowCosts.push_back(model.shadowCost);
+    }
+
+    m_recorder.RecordPass(
+        m_context, m_shadowCosts,
+        [&](ComPtr<ID3D11DeviceContext> &context) {
+            if (viewports)
+                context->RSSetViewports(numViewports, viewports);
+            else
+                AppBase::SetShadowViewport(context);
+            AppBase::SetPipelineState(context, pso);
+            AppBase::SetGlobalConsts(context, globalConstsGPU);
+            if (shadowTransformsGPU)
+                context->GSSetConstantBuffers(2, 1, &shadowTransformsGPU);
+            context->OMSetRenderTargets(0, NULL, dsv);
+        },
+        [&](ComPtr<ID3D11DeviceContext> &context, uint32_t begin,
+            uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                const auto &model = snapshot.models[m_shadowCasters[k]];
+                model.model->Render(context, model, false);
+            }
+        });
+}
+
+void Engine::RenderGBuffer(const RenderSnapshot &snapshot) {
+    // Per mesh, its maps and the material flags select the permutation.
+    const bool usePermutations = m_useMaterialPermutations;
+    // Only the meshes with a map outside the arrays bind their maps.
+    const bool useTable = m_useMaterialTable && m_materialsSRV;
+    auto &permutations = useTable ? Graphics::gBufferTablePermutations
+                                  : Graphics::gBufferPermutations;
+    const GraphicsPSO &pso =
+        useTable ? Graphics::gBufferTablePSO : Graphics::gBufferPSO;
+    ID3D11PixelShader *basePS =
+        useTable ? Graphics::gBufferTablePS.Get() : Graphics::gBufferPS.Get();
+    m_cameraDraws.clear();
+    for (uint32_t i = 0; i < uint32_t(snapshot.numModels); i++) {
+        const auto &model = snapshot.models[i];
+        if (model.isOccluded)
+            continue;
+        const auto &meshes = model.model->m_meshes;
+        for (uint32_t m = 0; m < uint32_t(meshes.size()); m++) {
+            const uint32_t features =
+                usePermutations ? MaterialPermutations::GetFeatures(
+                                      meshes[m]->features, model.materialConsts)
+                                : 0;
+            m_cameraDraws.push_back({features, i, m});
+        }
+    }
+    // Buckets of one pixel shader, still in model order within a bucket
+    if (usePermutations)
+        std::sort(m_cameraDraws.begin(), m_cameraDraws.end());
+
+    // The recording jobs only look the shaders up.
+    std::fill(std::begin(m_permutationMeshes), std::end(m_permutationMeshes),
+              0);
+    m_permutationBuckets = 0;
+    m_materialBindDraws = 0;
+    m_cameraCosts.clear();
+    m_cameraMaterials.clear();
+    // First m_cameraMaterials entry per m_cameraDraws entry
+    uint32_t *instanceStarts = m_frameArena.AllocateArray<uint32_t>(
+        m_cameraDraws.size(), "Camera draws");
+    for (size_t k = 0; k < m_cameraDraws.size(); k++) {
+        const auto &draw = m_cameraDraws[k];
+        if (usePermutations) {
+            if (k == 0 || draw.features != m_cameraDraws[k - 1].features) {
+                permutations.Get(draw.features);
+                m_permutationBuckets++;
+            }
+            m_permutationMeshes[draw.features]++;
+        }
+        const auto &model = snapshot.models[draw.model];
+        m_cameraCosts.push_back(model.model->GetDrawCost(model, draw.mesh));
+
+        // Every instance of the draw reads the same material.
+        const uint32_t material = model.model->m_meshes[draw.mesh]->material;
+        if (!useTable || !m_materialTable.IsPacked(material))
+            m_materialBindDraws++;
+        if (useTable) {
+            const uint32_t instances =
+                model.instancedConsts.useInstancing
+                    ? uint32_t(model.model->m_instanceCount)
+                    : 1u;
+            instanceStarts[k] = uint32_t(m_cameraMaterials.size());
+            m_cameraMaterials.insert(m_cameraMaterials.end(), instances,
+                                     material);
+        }
+    }
+    if (useTable && !m_cameraMaterials.empty()) {
+        D3D11Utils::UpdateVertexBuffer(m_device, m_context, m_cameraMaterials,
+                                       m_cameraMaterialsGPU);
+    }
+
+    m_recorder.RecordPass(
+        m_context, m_cameraCosts,
+        [&](ComPtr<ID3D11DeviceContext> &context) {
+            context->RSSetViewports(1, &m_screenViewport);
+            SetCommonStates(context);
+            AppBase::SetPipelineState(context, pso);
+            if (useTable) {
+                const UINT stride = sizeof(uint32_t);
+                const UINT offset = 0;
+                context->IASetVertexBuffers(
+                    1, 1, m_cameraMaterialsGPU.GetAddressOf(), &stride,
+                    &offset);
+                context->PSSetShaderResources(26, 1,
+                                              m_materialsSRV.GetAddressOf());
+                ID3D11ShaderResourceView *arraySRVs[MAX_MATERIAL_ARRAYS];
+                for (uint32_t a = 0; a < MAX_MATERIAL_ARRAYS; a++)
+                    arraySRVs[a] = m_materialArraySRVs[a].Get();
+                context->PSSetShaderResources(27, MAX_MATERIAL_ARRAYS,
+                                              arraySRVs);
+            }
+            m_gBuffer.Bind(context, m_resolvedRTV.Get());
+        },
+        [&](ComPtr<ID3D11DeviceContext> &context, uint32_t begin,
+            uint32_t end) {
+            ID3D11PixelShader *bound = basePS;
+            for (uint32_t k = begin; k < end; k++) {
+                const auto &draw = m_cameraDraws[k];
+                ID3D11PixelShader *shader =
+                    usePermutations ? permutations.Find(draw.features)
+                                    : basePS;
+                if (shader != bound) {
+                    context->PSSetShader(shader, 0, 0);
+                    bound = shader;
+                }
+                const auto &model = snapshot.models[draw.model];
+                if (useTable) {
+                    const uint32_t material =
+                        model.model->m_meshes[draw.mesh]->material;
+                    model.model->RenderMesh(
+                        context, model, draw.mesh, instanceStarts[k],
+                        !m_materialTable.IsPacked(material));
+                } else
+                    model.model->RenderMesh(context, model, draw.mesh);
+            }
+        });
+}
+
+void Engine::UpdateSsaoConstants(const RenderSnapshot &snapshot) {
+    auto &consts = m_ssaoConstsCPU;
+    consts.viewToPrevClip =
+        (snapshot.viewRow.Invert() * m_prevViewProjRow).Transpose();
+    consts.aoWidth = m_ssaoWidth;
+    consts.aoHeight = m_ssaoHeight;
+    consts.screenWidth = uint32_t(m_screenWidth);
+    consts.screenHeight = uint32_t(m_screenHeight);
+    consts.scale = uint32_t(m_ssaoScale);
+    consts.sampleCount = uint32_t(m_ssaoSampleCount);
+    consts.sampleStride = MAX_SAMPLES / consts.sampleCount;
+    // Without the history a fixed subset doesn't flicker.
+    consts.sampleOffset =
+        m_useSsaoTemporal ? m_ssaoFrame % consts.sampleStride : 0;
+    consts.historyValid = m_useSsaoTemporal && m_hasSsaoHistory &&
+                          m_ssaoHistoryVersion == m_ssaoBufferVersion;
+    D3D11Utils::UpdateBuffer(m_device, m_context, consts, m_ssaoConstsGPU);
+
+    m_prevViewProjRow = snapshot.viewRow * snapshot.projRow;
+    m_ssaoHistoryVersion = m_ssaoBufferVersion;
+    m_hasSsaoHistory = true;
+}
+
+ID3D11ShaderResourceView *Engine::RenderSSAO(const RenderSnapshot &snapshot) {
+    UpdateSsaoConstants(snapshot);
+    const int cur = m_ssaoFrame & 1;
+    const int prev = cur ^ 1;
+    m_ssaoFrame++;
+
+    D3D11_VIEWPORT viewport = m_screenViewport;
+    viewport.Width = float(m_ssaoWidth);
+    viewport.Height = float(m_ssaoHeight);
+    m_context->RSSetViewports(1, &viewport);
+
+    // AO and view depth, the targets of the last frame are the history
+    ID3D11RenderTargetView *aoRTVs[] = {m_ssaoHistoryRTV[cur].Get(),
+                                        m_ssaoDepthRTV[cur].Get()};
+    m_context->OMSetRenderTargets(2, aoRTVs, NULL);
+    AppBase::SetPipelineState(Graphics::ssaoPSO);
+    m_context->PSSetConstantBuffers(2, 1, m_kernelSamplesGPU.GetAddressOf());
+    m_context->PSSetConstantBuffers(3, 1, m_ssaoConstsGPU.GetAddressOf());
+    ID3D11ShaderResourceView *gBufferSRVs[] = {m_gBuffer.GetNormalView(),
+                                               nullptr,
+                                               m_gBuffer.GetDepthView()};
+    m_context->PSSetShaderResources(6, UINT(std::size(gBufferSRVs)),
+                                    gBufferSRVs);
     m_context->PSSetShaderResources(9, 1, m_ssaoNoiseSRV.GetAddressOf());
+    ID3D11ShaderResourceView *historySRVs[] = {m_ssaoHistorySRV[prev].Get(),
+                                               m_ssaoDepthSRV[prev].Get()};
+    m_context->PSSetShaderResources(24, 2, historySRVs);
     m_screenSquare->Render(m_context);
 
-    // 2. SSAO texture Blur
-    m_context->ClearDepthStencilView(m_depthStencilView.Get(),
-                                     D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-                                     1.0f, 0);
-    m_context->ClearRenderTargetView(m_ssaoBlurRTV.Get(), clearColor);
-    m_context->OMSetRenderTargets(1, m_ssaoBlurRTV.GetAddressOf(),
-                                  m_depthStencilView.Get());
-    AppBase::SetPipelineState(Graphics::ssaoBlurPSO);
-    m_context->PSSetShaderResources(5, 1, m_ssaoSRV.GetAddressOf());
-    m_screenSquare->Render(m_context); 
-
-    // AmbientEmission Pass
-    AppBase::SetPipelineState(Graphics::ambientEmissionPSO);
-    m_context->ClearRenderTargetView(m_resolvedRTV.Get(), clearColor);
-    m_context->ClearDepthStencilView(m_depthStencilView.Get(),
-                                     D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
-                                     1.0f, 0);
-    m_context->OMSetRenderTargets(1, m_resolvedRTV.GetAddressOf(),
-                                  m_depthStencilView.Get());
-    m_context->PSSetShaderResources(5, UINT(deferredLightingSRVs.size()),
-                                    deferredLightingSRVs.data());
-    m_context->PSSetShaderResources(9, 1, m_ssaoBlurSRV.GetAddressOf());
-    m_screenSquare->Render(m_context);
+    AppBase::SetMainViewport();
+    ID3D11ShaderResourceView *aoSRV = m_ssaoHistorySRV[cur].Get();
+    if (m_ssaoScale > 1) {
+        // Depth-aware upsample to the screen
+        m_context->OMSetRenderTargets(1, m_ssaoRTV.GetAddressOf(), NULL);
+        AppBase::SetPipelineState(Graphics::ssaoUpsamplePSO);
+        ID3D11ShaderResourceView *aoSRVs[] = {m_ssaoHistorySRV[cur].Get(),
+                                              m_ssaoDepthSRV[cur].Get()};
+        m_context->PSSetShaderResources(24, 2, aoSRVs);
+        m_screenSquare->Render(m_context);
+        aoSRV = m_ssaoSRV.Get();
+    }
 
-    // deferred lighting 
-    AppBase::SetPipelineState(Graphics::deferredLightingPSO);
-    m_context->ClearDepthStencilView(m_depthStencilView.Get(), 
-                                     D3D11_CLEAR_DEPTH,
-                                     1.0f, 0);
-    m_context->OMSetRenderTargets(1, m_resolvedRTV.GetAddressOf(),
-                                  m_depthStencilView.Get());
-    m_context->PSSetShaderResources(5, UINT(deferredLightingSRVs.size()),
-                                    deferredLightingSRVs.data());
-    m_screenSquare->Render(m_context);
+    // The history is a render target again next frame. Both frames are one
+    // imported resource of the frame graph, so it can't unbind them.
+    ID3D11ShaderResourceView *nullSRVs[2] = {};
+    m_context->PSSetShaderResources(24, 2, nullSRVs);
+    return aoSRV;
+}
 
-    m_context->ClearRenderTargetView(m_backBufferRTV.Get(), clearColor);
-    m_context->OMSetRenderTargets(1, m_backBufferRTV.GetAddressOf(), NULL);
+void Engine::BlurSSAO(ID3D11ShaderResourceView *input,
+                      ID3D11UnorderedAccessView *output, bool horizontal) {
+    // The AO was a render target
+    if (horizontal)
+        m_context->OMSetRenderTargets(0, NULL, NULL);
+    m_context->CSSetConstantBuffers(1, 1, m_globalConstsGPU.GetAddressOf());
+    m_context->CSSetConstantBuffers(3, 1, m_ssaoConstsGPU.GetAddressOf());
+
+    const UINT width = UINT(m_screenWidth);
+    const UINT height = UINT(m_screenHeight);
+    ID3D11ShaderResourceView *srvs[2] = {input, m_gBuffer.GetDepthView()};
+    ID3D11UnorderedAccessView *nullUAV = nullptr;
+
+    // The frame graph unbinds the SRVs.
+    m_context->CSSetShaderResources(0, 2, srvs);
+    m_context->CSSetUnorderedAccessViews(0, 1, &output, NULL);
+    if (horizontal) {
+        m_context->CSSetShader(Graphics::ssaoBlurHorizontalCS.Get(), 0, 0);
+        m_context->Dispatch((width + SSAO_BLUR_TILE - 1) / SSAO_BLUR_TILE,
+                            height, 1);
+    } else {
+        m_context->CSSetShader(Graphics::ssaoBlurVerticalCS.Get(), 0, 0);
+        m_context->Dispatch(
+            width, (height + SSAO_BLUR_TILE - 1) / SSAO_BLUR_TILE, 1);
+    }
+    m_context->CSSetUnorderedAccessViews(0, 1, &nullUAV, NULL);
+    m_context->CSSetShader(NULL, 0, 0);
+}
 
-    vector<ID3D11ShaderResourceView *> postEffectSRVs = {
-        m_resolvedSRV.Get(), m_gBuffer.GetDepthView(), m_cubeMapSRV.Get()};
+void Engine::ReadBackTexture(
+    ID3D11Texture2D *texture,
+    const std::function<void(UINT, const uint8_t *)> &readRow) {
+    D3D11_TEXTURE2D_DESC desc;
+    texture->GetDesc(&desc);
+    desc.BindFlags = 0;
+    desc.MiscFlags = 0;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+    desc.Usage = D3D11_USAGE_STAGING;
+    ComPtr<ID3D11Texture2D> stagingTexture;
+    ThrowIfFailed(
+        m_device->CreateTexture2D(&desc, NULL, stagingTexture.GetAddressOf()));
+    m_context->CopyResource(stagingTexture.Get(), texture);
+
+    D3D11_MAPPED_SUBRESOURCE ms;
+    ThrowIfFailed(
+        m_context->Map(stagingTexture.Get(), 0, D3D11_MAP_READ, 0, &ms));
+    for (UINT y = 0; y < desc.Height; y++)
+        readRow(y, (const uint8_t *)ms.pData + y * ms.RowPitch);
+    m_context->Unmap(stagingTexture.Get(), 0);
+}
 
-    AppBase::SetPipelineState(Graphics::postEffectsPSO);
-    AppBase::SetGlobalConsts(m_globalConstsGPU);
-    m_context->PSSetConstantBuffers(2, 1,
-                                    m_postEffectsConstsGPU.GetAddressOf());
-    m_context->PSSetShaderResources(5, UINT(postEffectSRVs.size()),
-                                    postEffectSRVs.data());
-    m_screenSquare->Render(m_context);
+void Engine::ReadBackAO(ID3D11Texture2D *texture, vector<float> &ao) {
+    // R8_UNORM
+    const UINT width = m_gBufferCapture.width;
+    ao.resize(size_t(width) * m_gBufferCapture.height);
+    ReadBackTexture(texture, [&](UINT y, const uint8_t *row) {
+        for (UINT x = 0; x < width; x++)
+            ao[y * width + x] = float(row[x]) / 255.0f;
+    });
+}
+
+void Engine::CaptureGBuffer(const Matrix &projRow,
+                            ID3D11ShaderResourceView *aoSRV) {
+    auto &capture = m_gBufferCapture;
+    capture.width = uint32_t(m_screenWidth);
+    capture.height = uint32_t(m_screenHeight);
+    capture.projRow = projRow;
+    const UINT width = capture.width;
+    const size_t numPixels = size_t(width) * capture.height;
+    capture.depth.resize(numPixels);
+    capture.normal.resize(numPixels);
+
+    // D24_UNORM_S8_UINT, depth in the low 24 bits
+    ReadBackTexture(m_gBuffer.GetDepthTexture(),
+                    [&](UINT y, const uint8_t *row) {
+                        const uint32_t *texels = (const uint32_t *)row;
+                        for (UINT x = 0; x < width; x++) {
+                            capture.depth[y * width + x] =
+                                float(texels[x] & 0xffffff) / float(0xffffff);
+                        }
+                    });
+
+    // R10G10B10A2_UNORM, octahedral view space normal
+    ReadBackTexture(m_gBuffer.GetNormalTexture(),
+                    [&](UINT y, const uint8_t *row) {
+                        const uint32_t *texels = (const uint32_t *)row;
+                        for (UINT x = 0; x < width; x++) {
+                            float roughness, metallic;
+                            GBufferPacking::UnpackNormalMaterial(
+                                texels[x], capture.normal[y * width + x],
+                                roughness, metallic);
+                        }
+                    });
+
+    capture.ao.clear();
+    capture.blurredAO.clear();
+    if (aoSRV) {
+        ComPtr<ID3D11Resource> resource;
+        aoSRV->GetResource(resource.GetAddressOf());
+        ComPtr<ID3D11Texture2D> aoTexture;
+        ThrowIfFailed(resource.As(&aoTexture));
+        ReadBackAO(aoTexture.Get(), capture.ao);
+    }
+}
+
+void Engine::UpdateLightClusters(const Matrix &viewRow,
+                                 const Matrix &projRow) {
+    // The grid and the shader work in view space.
+    const Light *cascadeLight =
+        m_cascadeLight >= 0 ? &m_globalConstsCPU.lights[m_cascadeLight]
+                            : nullptr;
+    m_clusterLights.clear();
+    auto addLight = [&](const Light &light, int shadowIndex) {
+        if (light.type == LIGHT_OFF)
+            return;
+        ClusterLight clusterLight;
+        clusterLight.position = Vector3::Transform(light.position, viewRow);
+        clusterLight.direction =
+            Vector3::TransformNormal(light.direction, viewRow);
+        clusterLight.range = light.fallOffEnd;
+        clusterLight.spotPower = light.spotPower;
+        clusterLight.radiance = light.radiance * light.lightColor;
+        clusterLight.type = light.type;
+        // Only the cascade light keeps LIGHT_SHADOW, other directional
+        // lights use their atlas tile.
+        if ((light.type & LIGHT_DIRECTIONAL) && &light != cascadeLight)
+            clusterLight.type &= ~LIGHT_SHADOW;
+        clusterLight.fallOffStart = light.fallOffStart;
+        clusterLight.fallOffEnd = light.fallOffEnd;
+        clusterLight.shadowIndex = shadowIndex;
+        m_clusterLights.push_back(clusterLight);
+    };
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        // Only lights with tiles in the atlas, see UpdateShadowAtlas()
+        addLight(m_globalConstsCPU.lights[i],
+                 m_shadowTiles[i * 6].IsValid() ? i : -1);
+    }
+    for (int i = 0; i < m_numExtraLights; i++)
+        addLight(m_extraLights[i], -1);
+
+    m_lightGrid.Build(projRow);
+    m_lightGrid.Bin(m_clusterLights);
+}
+
+void Engine::UpdateCascades(const Matrix &viewRow, const Matrix &projRow) {
+    auto &light = m_globalConstsCPU.lights[m_cascadeLight];
+    m_cascades.Update(viewRow, projRow, light.direction, m_shadowWidth);
+
+    for (int c = 0; c < NUM_CASCADES; c++) {
+        const auto &cascade = m_cascades.GetCascade(c);
+        auto &consts = m_cascadeGlobalConstsCPU[c];
+        consts.eyeWorld = cascade.center;
+        consts.view = cascade.viewRow.Transpose();
+        consts.proj = cascade.projRow.Transpose();
+        consts.invProj = cascade.projRow.Invert().Transpose();
+        consts.viewProj = cascade.viewProjRow.Transpose();
+    }
+    m_cascades.GetConstants(viewRow, m_cascadeConstsCPU);
+    light.viewProj = m_cascadeGlobalConstsCPU[0].viewProj;
+    light.invProj = m_cascadeGlobalConstsCPU[0].invProj;
+
+    // lights[i].viewProj was overwritten
+    m_hasShadowMatrices[m_cascadeLight] = false;
+}
+
+void Engine::UpdateShadowAtlas(const Vector3 &eyeWorld, const Matrix &viewRow,
+                               const Matrix &projRow) {
+    // A light gets the resolution of the screen area its range can cover,
+    // the half height of the view at the distance of the light.
+    m_atlasRequests.clear();
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        const auto &light = m_globalConstsCPU.lights[i];
+        // Directional lights get a tile when cascades are off.
+        if (!(light.type & LIGHT_SHADOW) || i == m_cascadeLight ||
+            !(light.type & (LIGHT_DIRECTIONAL | LIGHT_POINT | LIGHT_SPOT)))
+            continue;
+
+        const float dist = Vector3::Distance(eyeWorld, light.position);
+        const float viewHalfHeight =
+            (projRow._34 != 0.0f ? dist : 1.0f) / projRow._22;
+        const float coverage =
+            (light.type & LIGHT_DIRECTIONAL) || dist <= light.fallOffEnd
+                ? 1.0f
+                : std::min(1.0f, light.fallOffEnd / viewHalfHeight);
+        const float importance = m_shadowImportance[i];
+        const bool isPoint = (light.type & LIGHT_POINT) != 0;
+        // The 6 faces of a point light share the budget of one spot light.
+        const float texels = float(SHADOW_ATLAS_MAX_TILE) * coverage *
+                             importance * (isPoint ? 0.5f : 1.0f);
+
+        for (int f = 0; f < (isPoint ? 6 : 1); f++) {
+            ShadowAtlasRequest request;
+            request.key = uint32_t(i * 6 + f);
+            request.size = ShadowAtlas::SelectSize(
+                texels, m_shadowTiles[i * 6 + f].size, SHADOW_ATLAS_MIN_TILE,
+                SHADOW_ATLAS_MAX_TILE);
+            request.priority = coverage * importance;
+            m_atlasRequests.push_back(request);
+        }
+    }
+    m_shadowAtlas.Update(m_atlasRequests);
+
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        bool isComplete = true;
+        for (int f = 0; f < 6; f++) {
+            m_shadowTiles[i * 6 + f] = m_shadowAtlas.GetTile(i * 6 + f);
+            isComplete = isComplete && m_shadowTiles[i * 6 + f].IsValid();
+        }
+        // A point light without all of its faces has no shadow.
+        if ((m_globalConstsCPU.lights[i].type & LIGHT_POINT) && !isComplete) {
+            for (int f = 0; f < 6; f++)
+                m_shadowTiles[i * 6 + f] = ShadowTile();
+        }
+    }
+
+    // Camera view space -> uv and depth of the tiles
+    const Matrix invView = viewRow.Invert();
+    const float atlasSize = float(m_shadowAtlas.GetAllocator().GetAtlasSize());
+    const float halfTexel = 0.5f / atlasSize;
+    auto &consts = m_shadowAtlasConstsCPU;
+    for (int k = 0; k < MAX_SHADOW_FACES; k++) {
+        const ShadowTile &tile = m_shadowTiles[k];
+        if (!tile.IsValid()) {
+            consts.faceRects[k] = Vector4(0.0f);
+            continue;
+        }
+        const int i = k / 6;
+        const Matrix faceViewProj =
+            (m_globalConstsCPU.lights[i].type & LIGHT_POINT)
+                ? m_pointLightTransformCPU[i].shadowViewProj[k % 6].Transpose()
+                : m_shadowGlobalConstsCPU[i].viewProj.Transpose();
+
+        // clip xy [-1, 1] -> uv of the tile, y down
+        const float scale = float(tile.size) / atlasSize;
+        const Vector2 offset(float(tile.x) / atlasSize,
+                             float(tile.y) / atlasSize);
+        Matrix clipToTile;
+        clipToTile._11 = 0.5f * scale;
+        clipToTile._22 = -0.5f * scale;
+        clipToTile._41 = 0.5f * scale + offset.x;
+        clipToTile._42 = 0.5f * scale + offset.y;
+        consts.viewToFace[k] =
+            (invView * faceViewProj * clipToTile).Transpose();
+
+        // Bilinear taps stay inside of the tile
+        consts.faceRects[k] =
+            Vector4(offset.x + halfTexel, offset.y + halfTexel,
+                    offset.x + scale - halfTexel, offset.y + scale - halfTexel);
+    }
+    consts.texelSize = 1.0f / atlasSize;
+}
+
+void Engine::CullShadowCasters() {
+    m_shadowStats.Reset();
+
+    // Per caster: world bounds and everything that changes its depth
+    // The world bounds are the store's.
+    const size_t numModels = m_scene.GetSize();
+    m_isCaster.assign(numModels, 0);
+    m_casterSignatures.resize(numModels);
+    m_shadowMasks.assign(numModels * MAX_LIGHTS, 0);
+    for (size_t k = 0; k < numModels; k++) {
+        const uint8_t casterFlags = SCENE_VISIBLE | SCENE_CAST_SHADOW;
+        if ((m_scene.m_flags[k] & casterFlags) != casterFlags)
+            continue;
+        m_isCaster[k] = 1;
+
+        const auto &model = m_scene.m_models[k];
+        SignatureHash hash;
+        hash.Add(model.get());
+        hash.Add(m_scene.m_worldRows[k]);
+        hash.Add(model->m_meshConstsCPU.useHeightMap);
+        hash.Add(model->m_meshConstsCPU.heightScale);
+        if (model->m_instancedConstsCPU.useInstancing) {
+            hash.Add(model->m_instancedConstsCPU);
+            hash.Add(model->m_instanceCount);
+        }
+        m_casterSignatures[k] = hash.Get();
+    }
+
+    for (int i = 0; i < MAX_LIGHTS; i++) {
+        m_shadowRenderMasks[i] = 0;
+        const auto &light = m_globalConstsCPU.lights[i];
+
+        // Another light may render into the tiles of a light that lost
+        // them, so they are never clean when they come back.
+        const bool hasTiles = m_shadowTiles[i * 6].IsValid();
+        if (!hasTiles) {
+            for (int f = 0; f < 6; f++)
+                m_shadowCache.Update(i * 6 + f, 0);
+        }
+        if (!(light.type & LIGHT_SHADOW) || (!hasTiles && i != m_cascadeLight))
+            continue;
+
+        // Faces of the light and the cache slots of their textures
+        const bool isPoint = (light.type & LIGHT_POINT) && i != m_cascadeLight;
+        Matrix viewProjs[6];
+        int numFaces = 1;
+        int firstSlot = i * 6;
+        if (i == m_cascadeLight) {
+            numFaces = NUM_CASCADES;
+            firstSlot = SHADOW_SLOT_CASCADES;
+            for (int c = 0; c < NUM_CASCADES; c++)
+                viewProjs[c] = m_cascades.GetCascade(c).viewProjRow;
+        } else if (isPoint) {
+            numFaces = 6;
+            for (int f = 0; f < 6; f++) {
+                viewProjs[f] =
+                    m_pointLightTransformCPU[i].shadowViewProj[f].Transpose();
+            }
+        } else {
+            viewProjs[0] = m_shadowGlobalConstsCPU[i].viewProj.Transpose();
+        }
+
+        for (int f = 0; f < numFaces; f++) {
+            const Frustum frustum = Frustum::FromViewProj(viewProjs[f]);
+
+            // The atlas is shared, so the light and its tile are part of it.
+            SignatureHash hash;
+            hash.Add(i);
+            hash.Add(viewProjs[f]);
+            if (i != m_cascadeLight)
+                hash.Add(m_shadowTiles[i * 6 + f]);
+            for (size_t k = 0; k < numModels; k++) {
+                if (!m_isCaster[k])
+                    continue;
+                const Vector3 &boxMin = m_scene.m_worldBoxMins[k];
+                const Vector3 &boxMax = m_scene.m_worldBoxMaxs[k];
+                if (isPoint) {
+                    const Vector3 closest = Vector3::Max(
+                        boxMin, Vector3::Min(light.position, boxMax));
+                    if (Vector3::DistanceSquared(closest, light.position) >
+                        POINT_SHADOW_FAR * POINT_SHADOW_FAR) {
+                        m_shadowStats.culledCasters++;
+                        continue;
+                    }
+                }
+                if (!frustum.Intersects(boxMin, boxMax)) {
+                    m_shadowStats.culledCasters++;
+                    continue;
+                }
+                m_shadowMasks[k * MAX_LIGHTS + i] |= uint8_t(1 << f);
+                m_shadowStats.casters++;
+                if (isPoint)
+                    m_shadowStats.cubeFaces++;
+                hash.Add(uint32_t(k));
+                hash.Add(m_casterSignatures[k]);
+            }
+
+            // Always updated, so turning the cache on starts from the truth
+            const bool isDirty =
+                m_shadowCache.Update(firstSlot + f, hash.Get());
+            m_shadowStats.faces++;
+            if (isDirty || !m_useShadowCache)
+                m_shadowRenderMasks[i] |= 1u << f;
+            else
+                m_shadowStats.skippedFaces++;
+        }
+
+        for (size_t k = 0; k < numModels && isPoint; k++) {
+            if (m_shadowMasks[k * MAX_LIGHTS + i])
+                m_shadowStats.cubeCasters++;
+        }
+
+        m_shadowStats.lights++;
+        if (!m_shadowRenderMasks[i])
+            m_shadowStats.skippedLights++;
+    }
+
+    for (int c = 0; c < NUM_CASCADES; c++) {
+        m_cascadeCasters[c] = 0;
+        for (size_t k = 0; k < numModels && m_cascadeLight >= 0; k++) {
+            m_cascadeCasters[c] +=
+                (m_shadowMasks[k * MAX_LIGHTS + m_cascadeLight] >> c) & 1;
+        }
+    }
+}
+
+void Engine::UpdateShadowMatrices(int i) {
+    const auto &light = m_globalConstsCPU.lights[i];
+    if (!(light.type & LIGHT_SHADOW))
+        return;
+
+    // The matrices only depend on these, a light that didn't move keeps them.
+    auto &cached = m_shadowMatrixLights[i];
+    if (m_hasShadowMatrices[i] && cached.position == light.position &&
+        cached.direction == light.direction && cached.type == light.type)
+        return;
+    cached = light;
+    m_hasShadowMatrices[i] = true;
+
+    Vector3 up = Vector3(0.0f, 1.0f, 0.0f);
+    //    upDir dot  -1 ٸ, װ 
+    // ̰ 180 ٴ ̾߱, upDir 
+    // Ѵ.
+    if (abs(up.Dot(light.direction) + 1.0f) < 1e-5)
+        up = Vector3(1.0f, 0.0f, 0.0f);
+
+    // https://learn.microsoft.com/ko-kr/windows/win32/api/directxmath/nf-directxmath-xmmatrixperspectivefovlh
+    Matrix lightProjRow = XMMatrixPerspectiveFovLH(
+        XMConvertToRadians(120.0f), 1.0f, 0.01f, 25.0f);
+    // Matrix lightProjRow = XMMatrixOrthographicOffCenterLH(
+    //         -10.0f, 10.0f, -10.0f, 10.0f, 1.0f, 100.0f);
+    //  lightProjRow =
+    //  XMMatrixOrthographicLH(20.0f, 20.0f, 1.0f, 7.5f);
+
+    // https://learn.microsoft.com/ko-kr/windows/win32/api/directxmath/nf-directxmath-xmmatrixlookatlh
+    Vector3 targetVec = (light.position + light.direction);
+    targetVec.Normalize();
+    Matrix lightViewRow =
+        XMMatrixLookAtLH(light.position, targetVec, up);
+          
+    m_shadowGlobalConstsCPU[i].eyeWorld = light.position;
+    m_shadowGlobalConstsCPU[i].view = lightViewRow.Transpose();
+    m_shadowGlobalConstsCPU[i].proj = lightProjRow.Transpose();
+    m_shadowGlobalConstsCPU[i].invProj = 
+        lightProjRow.Invert().Transpose();
+    m_shadowGlobalConstsCPU[i].viewProj =
+        (lightViewRow * lightProjRow).Transpose();                 
+
+    if (light.type & LIGHT_POINT) {
+        Matrix pointLightProjRow = XMMatrixPerspectiveFovLH(
+            XMConvertToRadians(90.0f), 1.0f, 1.0f, POINT_SHADOW_FAR);
+        Vector3 directions[6] = {
+            {1.0f, 0.0f, 0.0f}, {-1.0f, 0.0f, 0.0f},
+            {0.0f, 1.0f, 0.0f}, {0.0f, -1.0f, 0.0f},
+            {0.0f, 0.0f, 1.0f}, {0.0f, 0.0f, -1.0f}};
+        Vector3 upDir[6] = {{0.0f, 1.0f, 0.0f},  {0.0f, 1.0f, 0.0f},
+                            {0.0f, 0.0f, -1.0f}, {0.0f, 0.0f, 1.0f},
+                            {0.0f, 1.0f, 1.0f},  {0.0f, 1.0f, 0.0f}};
+
+        for (int face = 0; face < 6; ++face) {
+            lightViewRow = XMMatrixLookAtLH(
+                light.position, light.position + directions[face],
+                upDir[face]);
+            m_pointLightTransformCPU[i].shadowViewProj[face] =
+                (lightViewRow * pointLightProjRow).Transpose();
+        }
+    }
+    // for (int x = 0; x < 4; x++) // loop 3 times for three lines
+    //{
+    //     for (int y = 0; y < 4;
+    //          y++) // loop for the three elements on the line
+    //     {
+    //         Matrix temp =
+    //         m_pointLightTransformCPU[2].shadowViewProj[1]; cout <<
+    //         temp.m[x][y] << " "; // display the
+    //                                      // current element
+    //                                      // out of
+    //                                      // the array
+    //     }
+    //     cout << endl; // when the inner loop is done, go to a new
+    //     line
+    // }
+
+    // ׸ڸ    ʿ
+    m_globalConstsCPU.lights[i].viewProj =
+        m_shadowGlobalConstsCPU[i].viewProj;
+    m_globalConstsCPU.lights[i].invProj =
+        m_shadowGlobalConstsCPU[i].invProj;
+}
+
+void Engine::BenchmarkJobScaling(const Vector3 &eyeWorld,
+                                 const Matrix &viewRow, const Matrix &projRow) {
+    // Runs the per frame CPU work (occlusion, cluster culling and shadow
+    // matrices) with 0..N workers. Occluder rasterization stays serial.
+    const int maxWorkers = JobSystem::GetWorkerCount();
+    const int numRepeats = 20;
+
+    m_jobScalingMs.clear();
+    for (int workers = 0; workers <= maxWorkers; workers++) {
+        JobSystem::Initialize(workers);
+
+        const auto start = std::chrono::high_resolution_clock::now();
+        for (int r = 0; r < numRepeats; r++) {
+            // Otherwise lights that didn't move keep their matrices.
+            for (int i = 0; i < MAX_LIGHTS; i++)
+                m_hasShadowMatrices[i] = false;
+            CullOccludedModels(viewRow, projRow);
+            CullClusters(eyeWorld, viewRow, projRow);
+            JobSystem::ParallelFor(MAX_LIGHTS, 1,
+                                   [&](uint32_t begin, uint32_t end) {
+                                       for (uint32_t i = begin; i < end; i++)
+                                           UpdateShadowMatrices(int(i));
+                                   });
+        }
+        const float ms = std::chrono::duration<float, std::milli>(
+                             std::chrono::high_resolution_clock::now() - start)
+                             .count() /
+                         numRepeats;
+        m_jobScalingMs.push_back(ms);
+
+        cout << "Job scaling: " << workers + 1 << " threads " << ms
+             << " ms/frame, x" << m_jobScalingMs[0] / ms << endl;
+    }
+
+    JobSystem::Initialize(maxWorkers);
+}
+
+void Engine::CullOccludedModels(const Matrix &viewRow, const Matrix &projRow) {
+    auto &flags = m_scene.m_flags;
+    if (!m_useOcclusionCulling) {
+        for (auto &f : flags)
+            f &= ~SCENE_OCCLUDED;
+        m_occlusion.m_stats.Reset();
+        return;
+    }
+
+    m_occlusion.BeginFrame(viewRow * projRow);
+
+    // 1. Occluders: flagged models, or any model large enough
+    for (uint32_t k = 0; k < m_scene.GetSize(); k++) {
+        if (!(flags[k] & SCENE_VISIBLE))
+            continue;
+
+        bool isOccluder = flags[k] & SCENE_OCCLUDER;
+        if (!isOccluder && m_autoSelectOccluders) {
+            const Vector3 size =
+                m_scene.m_worldBoxMaxs[k] - m_scene.m_worldBoxMins[k];
+            isOccluder = size.Length() * 0.5f >= m_autoOccluderRadius;
+        }
+
+        if (isOccluder) {
+            const auto &model = m_scene.m_models[k];
+            m_occlusion.RasterizeOccluder(model->m_occluderPositions,
+                                          model->m_occluderIndices,
+                                          m_scene.m_worldRows[k]);
+        }
+    }
+    m_occlusion.EndFrame();
+
+    // 2. Occludees, the tests only read the depth pyramid
+    const auto start = std::chrono::high_resolution_clock::now();
+    JobSystem::ParallelFor(
+        m_scene.GetSize(), 16, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                // Hidden objects aren't drawn, so they aren't tested.
+                if (!(flags[k] & SCENE_VISIBLE)) {
+                    flags[k] &= ~SCENE_OCCLUDED;
+                    continue;
+                }
+                const bool isVisible = m_occlusion.IsVisible(
+                    m_scene.m_worldBoxMins[k], m_scene.m_worldBoxMaxs[k]);
+                flags[k] = uint8_t(isVisible ? flags[k] & ~SCENE_OCCLUDED
+                                             : flags[k] | SCENE_OCCLUDED);
+            }
+        });
+
+    auto &stats = m_occlusion.m_stats;
+    for (const auto &f : flags) {
+        if (!(f & SCENE_VISIBLE))
+            continue;
+        stats.objectsTested++;
+        if (f & SCENE_OCCLUDED)
+            stats.objectsCulled++;
+    }
+    stats.testMs = std::chrono::duration<float, std::milli>(
+                       std::chrono::high_resolution_clock::now() - start)
+                       .count();
+}
+
+void Engine::CullClusters(const Vector3 &eyeWorld, const Matrix &viewRow,
+                          const Matrix &projRow) {
+    m_clusterStats.Reset();
+
+    if (!m_useClusterCulling) {
+        for (const auto &model : m_scene.m_models)
+            model->ResetClusterCulling();
+        return;
+    }
+
+    const bool useHiZ = m_useHiZCulling && m_useOcclusionCulling;
+    const auto view = ClusterCuller::MakeView(
+        viewRow, projRow, eyeWorld, useHiZ ? &m_occlusion.GetHiZ() : nullptr);
+    // Model::CullClusters() splits its meshes across the job system.
+    for (uint32_t k = 0; k < m_scene.GetSize(); k++) {
+        const auto &model = m_scene.m_models[k];
+        if (!(m_scene.m_flags[k] & SCENE_VISIBLE)) {
+            model->ResetClusterCulling();
+            continue;
+        }
+        model->CullClusters(view, m_scene.m_worldRows[k],
+                            m_scene.m_worldITRows[k], m_clusterStats,
+                            m_useConeCulling);
+    }
+}
+
+void Engine::AddFramePasses() {
+    auto &graph = m_frameGraph;
+    const auto &res = m_frameResources;
+    const auto PS = ShaderStage::Pixel;
+    const auto CS = ShaderStage::Compute;
+
+    // The cache keeps what the shadow maps hold across frames.
+    const uint32_t shadows = graph.AddPass(
+        "Shadows", [this] { RenderShadowMaps(*m_frameSnapshot); });
+    graph.Write(shadows, res.shadowAtlas, WriteMode::Load);
+    graph.Write(shadows, res.cascadeShadowMap, WriteMode::Load);
+
+    // Cubemap  stencil     κпٰ ť ׸
+    const uint32_t stencilMask = graph.AddPass("StencilMask", [this] {
+        AppBase::SetMainViewport();
+        SetCommonStates(m_context);
+        m_context->OMSetRenderTargets(0, NULL, m_depthStencilView.Get());
+        AppBase::SetPipelineState(Graphics::stencilMaskPSO);
+        RenderModels(*m_frameSnapshot);
+    });
+    graph.Write(stencilMask, res.depthStencil, WriteMode::Clear);
+
+    const uint32_t skybox = graph.AddPass("Skybox", [this] {
+        m_context->OMSetRenderTargets(1, m_cubeMapRTV.GetAddressOf(),
+                                      m_depthStencilView.Get());
+        AppBase::SetPipelineState(Graphics::reflectSolidPSO);
+        m_skybox->Render(m_context);
+    });
+    graph.Write(skybox, res.cubeMap, WriteMode::Clear);
+    graph.Write(skybox, res.depthStencil, WriteMode::Load);
+
+    // deferred lighting  G-Buffer 
+    // GBufferPS.hlsl writes the emission into the lighting target.
+    const uint32_t gBuffer = graph.AddPass(
+        "GBuffer", [this] { RenderGBuffer(*m_frameSnapshot); });
+    graph.Write(gBuffer, res.albedoAO, WriteMode::Clear);
+    graph.Write(gBuffer, res.normalMaterial, WriteMode::Clear);
+    graph.Write(gBuffer, res.depth, WriteMode::Clear);
+    graph.Write(gBuffer, res.lighting, WriteMode::Clear);
+
+    if (m_frameGraphSsao) {
+        // 1. SSAO texture 
+        const uint32_t ssao = graph.AddPass("SSAO", [this] {
+            m_ssaoInputSRV = RenderSSAO(*m_frameSnapshot);
+            // The blur target can share its texture with the AO.
+            if (m_captureThisFrame) {
+                CaptureGBuffer(m_frameSnapshot->projRow,
+                               m_useComputeSsaoBlur ? m_ssaoInputSRV
+                                                    : nullptr);
+            }
+        });
+        graph.Read(ssao, res.normalMaterial, PS, 6);
+        graph.Read(ssao, res.depth, PS, 8);
+        graph.Write(ssao, res.ssaoHistory);
+        // Without the upsample the blur reads the history.
+        const uint32_t ao = m_ssaoScale > 1 ? res.ssao : res.ssaoHistory;
+        if (m_ssaoScale > 1)
+            graph.Write(ssao, res.ssao);
+
+        // 2. SSAO texture Blur
+        if (m_useComputeSsaoBlur) {
+            const uint32_t blurX = graph.AddPass("SSAOBlurX", [this] {
+                BlurSSAO(m_ssaoInputSRV, m_ssaoBlurTempUAV.Get(), true);
+            });
+            graph.Read(blurX, ao, CS, 0);
+            graph.Read(blurX, res.depth, CS, 1);
+            graph.Write(blurX, res.ssaoBlurTemp);
+
+            const uint32_t blurY = graph.AddPass("SSAOBlurY", [this] {
+                BlurSSAO(m_ssaoBlurTempSRV.Get(), m_ssaoBlurUAV.Get(),
+                         false);
+                if (m_captureThisFrame)
+                    ReadBackAO(m_ssaoBlurTex.Get(),
+                               m_gBufferCapture.blurredAO);
+            });
+            graph.Read(blurY, res.ssaoBlurTemp, CS, 0);
+            graph.Read(blurY, res.depth, CS, 1);
+            graph.Write(blurY, res.ssaoBlur);
+        } else {
+            const uint32_t blur = graph.AddPass("SSAOBlur", [this] {
+                m_context->OMSetRenderTargets(
+                    1, m_ssaoBlurRTV.GetAddressOf(), NULL);
+                AppBase::SetPipelineState(Graphics::ssaoBlurPSO);
+                m_context->PSSetShaderResources(5, 1, &m_ssaoInputSRV);
+                m_screenSquare->Render(m_context);
+            });
+            graph.Read(blur, ao, PS, 5);
+            graph.Write(blur, res.ssaoBlur);
+        }
+    }
+
+    // deferred lighting, ambient and lights on top of the emission. It's
+    // fullscreen without depth test, so no depth buffer is bound.
+    const uint32_t lighting = graph.AddPass("Lighting", [this] {
+        AppBase::SetPipelineState(Graphics::deferredLightingPSO);
+        m_context->OMSetRenderTargets(1, m_resolvedRTV.GetAddressOf(), NULL);
+        ID3D11ShaderResourceView *gBufferSRVs[] = {
+            m_gBuffer.GetColorView(), m_gBuffer.GetNormalView(), nullptr,
+            m_gBuffer.GetDepthView(),
+            m_frameGraphSsao ? m_ssaoBlurSRV.Get() : nullptr};
+        m_context->PSSetShaderResources(5, UINT(std::size(gBufferSRVs)),
+                                        gBufferSRVs);
+        ID3D11ShaderResourceView *clusterSRVs[] = {
+            m_clusterLightsSRV.Get(), m_clusterRangesSRV.Get(),
+            m_clusterLightIndicesSRV.Get()};
+        m_context->PSSetShaderResources(19, UINT(std::size(clusterSRVs)),
+                                        clusterSRVs);
+        m_context->PSSetConstantBuffers(4, 1,
+                                        m_clusterConstsGPU.GetAddressOf());
+        m_context->PSSetShaderResources(22, 1,
+                                        m_cascadeShadowSRV.GetAddressOf());
+        m_context->PSSetConstantBuffers(5, 1,
+                                        m_cascadeConstsGPU.GetAddressOf());
+        m_context->PSSetShaderResources(23, 1,
+                                        m_shadowAtlasSRV.GetAddressOf());
+        m_context->PSSetConstantBuffers(
+            6, 1, m_shadowAtlasConstsGPU.GetAddressOf());
+        m_screenSquare->Render(m_context);
+    });
+    graph.Read(lighting, res.albedoAO, PS, 5);
+    graph.Read(lighting, res.normalMaterial, PS, 6);
+    graph.Read(lighting, res.depth, PS, 8);
+    if (m_frameGraphSsao)
+        graph.Read(lighting, res.ssaoBlur, PS, 9);
+    graph.Read(lighting, res.cascadeShadowMap, PS, 22);
+    graph.Read(lighting, res.shadowAtlas, PS, 23);
+    graph.Write(lighting, res.lighting, WriteMode::Load);
+
+    const uint32_t postEffects = graph.AddPass("PostEffects", [this] {
+        m_context->OMSetRenderTargets(1, m_backBufferRTV.GetAddressOf(),
+                                      NULL);
+        ID3D11ShaderResourceView *postEffectSRVs[] = {
+            m_resolvedSRV.Get(), m_gBuffer.GetDepthView(),
+            m_cubeMapSRV.Get()};
+        AppBase::SetPipelineState(Graphics::postEffectsPSO);
+        AppBase::SetGlobalConsts(m_globalConstsGPU);
+        m_context->PSSetConstantBuffers(
+            2, 1, m_postEffectsConstsGPU.GetAddressOf());
+        m_context->PSSetShaderResources(5, UINT(std::size(postEffectSRVs)),
+                                        postEffectSRVs);
+        m_screenSquare->Render(m_context);
+    });
+    graph.Read(postEffects, res.lighting, PS, 5);
+    graph.Read(postEffects, res.depth, PS, 6);
+    graph.Read(postEffects, res.cubeMap, PS, 7);
+    graph.Write(postEffects, res.backBuffer);
 
     // Render Pass
-    AppBase::SetPipelineState(Graphics::renderPassPSO);
-    AppBase::SetGlobalConsts(m_globalConstsGPU);
-    for (int i = 0; i < 3; i++) {
-        m_context->PSSetShaderResources(5, 1, &deferredLightingSRVs[i]);
-        m_screenRenderPass[i]->Render(m_context);
+    const uint32_t debugViews = graph.AddPass("DebugViews", [this] {
+        AppBase::SetPipelineState(Graphics::renderPassPSO);
+        AppBase::SetGlobalConsts(m_globalConstsGPU);
+        ID3D11ShaderResourceView *renderPassSRVs[4] = {
+            m_gBuffer.GetColorView(), m_gBuffer.GetNormalView(),
+            m_gBuffer.GetDepthView(),
+            m_frameGraphSsao ? m_ssaoBlurSRV.Get() : nullptr};
+        for (int i = 0; i < 4; i++) {
+            m_context->PSSetShaderResources(5, 1, &renderPassSRVs[i]);
+            m_screenRenderPass[i]->Render(m_context);
+        }
+    });
+    graph.Read(debugViews, res.albedoAO, PS, 5);
+    graph.Read(debugViews, res.normalMaterial, PS, 5);
+    graph.Read(debugViews, res.depth, PS, 5);
+    if (m_frameGraphSsao)
+        graph.Read(debugViews, res.ssaoBlur, PS, 5);
+    graph.Write(debugViews, res.backBuffer, WriteMode::Load);
+}
+
+void Engine::ClearFrameResource(uint32_t resource) {
+    const auto &res = m_frameResources;
+    const float clearColor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    const float zeros[4] = {};
+    if (resource == res.depthStencil) {
+        m_context->ClearDepthStencilView(
+            m_depthStencilView.Get(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
+            1.0f, 0);
+    } else if (resource == res.depth) {
+        m_context->ClearDepthStencilView(
+            m_gBuffer.GetDepthDSV(), D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL,
+            1.0f, 0);
+    } else if (resource == res.albedoAO) {
+        m_context->ClearRenderTargetView(m_gBuffer.GetColorRTV(), zeros);
+    } else if (resource == res.normalMaterial) {
+        m_context->ClearRenderTargetView(m_gBuffer.GetNormalRTV(), zeros);
+    } else if (resource == res.backBuffer) {
+        m_context->ClearRenderTargetView(m_backBufferRTV.Get(), clearColor);
+    } else if (m_frameTargets[resource].rtv) {
+        m_context->ClearRenderTargetView(m_frameTargets[resource].rtv.Get(),
+                                         clearColor);
+    }
+}
+
+void Engine::UnbindShaderResource(ShaderStage stage, uint32_t slot) {
+    ID3D11ShaderResourceView *nullSRV = nullptr;
+    if (stage == ShaderStage::Pixel)
+        m_context->PSSetShaderResources(slot, 1, &nullSRV);
+    else
+        m_context->CSSetShaderResources(slot, 1, &nullSRV);
+}
+
+void Engine::Render(const RenderSnapshot &snapshot) {
+    UploadSnapshot(snapshot);
+    m_recorder.m_stats.Reset();
+
+    // The passes depend on the switch, so the graph is built again.
+    const bool useSsao = snapshot.globalConsts.SSAO != 0;
+    if (useSsao != m_frameGraphSsao) {
+        m_frameGraphSsao = useSsao;
+        CreateTransientTargets();
+    }
+    if (!useSsao)
+        m_hasSsaoHistory = false;
+
+    // SsaoReference only has the compute blur
+    m_captureThisFrame = m_captureGBuffer;
+    m_captureGBuffer = false;
+
+    m_frameSnapshot = &snapshot;
+    m_frameGraph.Execute(
+        [this](uint32_t resource) { ClearFrameResource(resource); },
+        [this](ShaderStage stage, uint32_t slot) {
+            UnbindShaderResource(stage, slot);
+        });
+    m_frameSnapshot = nullptr;
+
+    if (m_captureThisFrame) {
+        if (!useSsao)
+            CaptureGBuffer(snapshot.projRow, nullptr);
+        SsaoConstants consts = m_ssaoConstsCPU;
+        consts.scale = uint32_t(m_ssaoScale);
+        consts.sampleCount = uint32_t(m_ssaoSampleCount);
+        if (!m_useSsaoTemporal)
+            consts.temporalAlpha = 1.0f;
+        SsaoReference reference(m_gBufferCapture, kernel.samples,
+                                ssaoNoise.data());
+        m_ssaoEval = reference.Evaluate(consts, uint32_t(m_ssaoEvalFrames));
+        m_hasSsaoEval = true;
     }
-    m_context->PSSetShaderResources(5, 1, m_ssaoBlurSRV.GetAddressOf());
-    m_screenRenderPass[3]->Render(m_context);
 }
 
 void Engine::UpdateGUI() {
@@ -555,6 +1888,196 @@ void Engine::UpdateGUI() {
         ImGui::Checkbox("Wireframe", &m_drawAsWire);
         ImGui::TreePop();
     }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Cluster Culling")) {
+        ImGui::Checkbox("Enable", &m_useClusterCulling);
+        ImGui::Checkbox("Backface Cone", &m_useConeCulling);
+        ImGui::Checkbox("Hi-Z", &m_useHiZCulling);
+        ImGui::Text("Clusters: %u (frustum %u, cone %u, hi-z %u)",
+                    m_clusterStats.clusters, m_clusterStats.frustumCulled,
+                    m_clusterStats.coneCulled, m_clusterStats.occlusionCulled);
+        ImGui::Text("Triangles: %llu / %llu (%.1f%% culled)",
+                    m_clusterStats.visibleTriangles, m_clusterStats.triangles,
+                    m_clusterStats.CulledRatio() * 100.0f);
+        ImGui::Text("Draw ranges: %u", m_clusterStats.drawRanges);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Occlusion Culling")) {
+        const auto &stats = m_occlusion.m_stats;
+        ImGui::Checkbox("Enable", &m_useOcclusionCulling);
+        ImGui::Checkbox("Auto Occluders", &m_autoSelectOccluders);
+        ImGui::SliderFloat("Occluder Radius", &m_autoOccluderRadius, 0.1f,
+                           10.0f);
+        ImGui::Text("Occluders: %u (%u triangles, %u rasterized)",
+                    stats.occluders, stats.occluderTriangles,
+                    stats.trianglesRasterized);
+        ImGui::Text("Objects culled: %u / %u", stats.objectsCulled,
+                    stats.objectsTested);
+        ImGui::Text("Rasterize %.3f ms, Test %.3f ms", stats.rasterizeMs,
+                    stats.testMs);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Frame Pipeline")) {
+        ImGui::Checkbox("Pipelined Update", &m_usePipelinedLoop);
+        ImGui::SliderInt("Frames In Flight", &m_maxFramesInFlight, 1, 3);
+        ImGui::Text("Frame %.2f ms (%.1f FPS)", m_frameStats.frameMs,
+                    1000.0f / std::max(m_frameStats.frameMs, 1e-3f));
+        ImGui::Text("Input latency %.2f ms", m_frameStats.latencyMs);
+        ImGui::Text("Queued frames: %d", m_frameStats.framesInFlight);
+        ImGui::Text("Frame allocations: %llu",
+                    m_frameStats.frameAllocations);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Scene Store")) {
+        ImGui::Text("Objects: %u", m_scene.GetSize());
+        if (ImGui::Button("Benchmark 100k Objects")) {
+            m_sceneBenchmark = SceneStore::Benchmark(100000, 20);
+            m_hasSceneBenchmark = true;
+        }
+        if (m_hasSceneBenchmark) {
+            const auto &result = m_sceneBenchmark;
+            ImGui::Text("Arrays: update %.2f ms, iterate %.3f ms",
+                        result.updateMs, result.iterateMs);
+            ImGui::Text("shared_ptr: update %.2f ms, iterate %.3f ms",
+                        result.pointerUpdateMs, result.pointerIterateMs);
+            ImGui::Text("%u of %u objects in the box", result.visible,
+                        result.objects);
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Memory")) {
+        bool isTracking = MemoryAllocator::IsTracking();
+        if (ImGui::Checkbox("Track Tags", &isTracking))
+            MemoryAllocator::SetTracking(isTracking);
+        // Frame, a scratch arena per thread that used one, the pools
+        MemoryAllocator::ForEach([](const MemoryAllocator &allocator) {
+            const MemoryStats stats = allocator.GetStats();
+            ImGui::Text("%s: %.1f / %.1f KB, peak %.1f KB", stats.name,
+                        stats.usedBytes / 1024.0, stats.capacity / 1024.0,
+                        stats.peakBytes / 1024.0);
+            ImGui::Text("  %llu allocations, %llu from the heap",
+                        stats.allocations, stats.heapAllocations);
+            for (const auto &tag : allocator.GetTagStats())
+                ImGui::Text("  %s: peak %.1f KB, %llu allocations", tag.tag,
+                            tag.peakBytes / 1024.0, tag.allocations);
+        });
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Cascaded Shadows")) {
+        ImGui::Checkbox("Use Cascades", &m_useCascades);
+        ImGui::SliderFloat("Split Lambda", &m_cascades.m_lambda, 0.0f, 1.0f);
+        ImGui::SliderFloat("Max Distance", &m_cascades.m_maxDistance, 5.0f,
+                           50.0f);
+        ImGui::SliderFloat("Depth Bias", &m_cascadeConstsCPU.depthBias,
+                           0.0f, 0.01f, "%.4f");
+        for (int c = 0; c < NUM_CASCADES; c++) {
+            ImGui::Text("Cascade %d: %.2f ~ %.2f, %u casters", c,
+                        m_cascades.GetCascade(c).splitNear,
+                        m_cascades.GetCascade(c).splitFar,
+                        m_cascadeCasters[c]);
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Shadow Cache")) {
+        const auto &stats = m_shadowStats;
+        ImGui::Checkbox("Use Shadow Cache", &m_useShadowCache);
+        ImGui::Text("Lights %u, skipped %u", stats.lights,
+                    stats.skippedLights);
+        ImGui::Text("Faces %u, skipped %u", stats.faces, stats.skippedFaces);
+        ImGui::Text("Casters %u, culled %u", stats.casters,
+                    stats.culledCasters);
+        if (Graphics::shadowCubeInstancedVS) {
+            ImGui::Checkbox("Instanced Cube Faces",
+                            &m_useInstancedCubeShadows);
+        } else {
+            ImGui::Text("Cube faces: GS (no viewport index in VS)");
+        }
+        // Without culling every cube caster would be drawn into 6 faces.
+        ImGui::Text("Cube casters %u, faces %u of %u", stats.cubeCasters,
+                    stats.cubeFaces, stats.cubeCasters * 6);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Shadow Atlas")) {
+        const auto &stats = m_shadowAtlas.m_stats;
+        for (int i = 0; i < MAX_LIGHTS; i++) {
+            const string label = "Importance " + std::to_string(i);
+            ImGui::SliderFloat(label.c_str(), &m_shadowImportance[i], 0.0f,
+                               2.0f);
+        }
+        ImGui::Text("Tiles %u, moved %u", stats.requests, stats.moved);
+        ImGui::Text("Downsized %u, failed %u", stats.downsized, stats.failed);
+        ImGui::Text("Occupancy %.1f %%, fragmentation %.2f",
+                    stats.occupancy * 100.0f, stats.fragmentation);
+        ImGui::Text("Largest free %u",
+                    m_shadowAtlas.GetAllocator().GetLargestFree());
+        if (ImGui::Button("Run Stress Test")) {
+            m_atlasStressValid = ShadowAtlas::RunStressTest(
+                4096, 128, 32, 2000, 1, m_atlasStressStats);
+            m_hasAtlasStressStats = true;
+        }
+        if (m_hasAtlasStressStats) {
+            const auto &s = m_atlasStressStats;
+            ImGui::Text("%s, churn %.2f %%, downsized %u, failed %u",
+                        m_atlasStressValid ? "Valid" : "OVERLAP",
+                        100.0f * float(s.moved) /
+                            float(std::max(s.requests, 1u)),
+                        s.downsized, s.failed);
+            ImGui::Text("Occupancy %.1f %%, fragmentation %.2f",
+                        s.occupancy * 100.0f, s.fragmentation);
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Clustered Lighting")) {
+        const auto &stats = m_lightGrid.m_stats;
+        ImGui::SliderInt("Extra Point Lights", &m_numExtraLights, 0,
+                         MAX_EXTRA_LIGHTS);
+        ImGui::Text("Lights %u, Clusters %u", stats.lights, stats.clusters);
+        ImGui::Text("Lights per cluster: avg %.2f, max %u",
+                    float(stats.lightIndices) /
+                        float(std::max(stats.clusters, 1u)),
+                    stats.maxPerCluster);
+        ImGui::Text("Binning %.3f ms", stats.binMs);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Command Recording")) {
+        const auto &stats = m_recorder.m_stats;
+        int minBatchCost = int(m_recorder.m_minBatchCost);
+        ImGui::Checkbox("Parallel Recording", &m_recorder.m_useParallel);
+        if (ImGui::SliderInt("Min Batch Indices", &minBatchCost, 1000,
+                             200000))
+            m_recorder.m_minBatchCost = uint64_t(minBatchCost);
+        ImGui::Text("Passes %u, Batches %u, Draws %u", stats.passes,
+                    stats.batches, stats.draws);
+        ImGui::Text("Record %.3f ms, Execute %.3f ms", stats.recordMs,
+                    stats.executeMs);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Job System")) {
+        ImGui::Text("Threads: %d", JobSystem::GetThreadCount());
+        // Update() only runs it on the main thread, see there.
+        if (m_usePipelinedLoop) {
+            m_runJobBenchmark = false;
+            ImGui::Text("Scaling Benchmark: off with Pipelined Update");
+        } else if (ImGui::Button("Run Scaling Benchmark")) {
+            m_runJobBenchmark = true;
+        }
+        for (size_t i = 0; i < m_jobScalingMs.size(); i++) {
+            ImGui::Text("%2d threads: %.3f ms (x%.2f)", int(i) + 1,
+                        m_jobScalingMs[i],
+                        m_jobScalingMs[0] / m_jobScalingMs[i]);
+        }
+        ImGui::TreePop();
+    }
     ImGui::SetNextItemOpen(true, ImGuiCond_Once);
     if (ImGui::TreeNode("Post-Processing")) {
         int flag = 0;
@@ -583,6 +2106,277 @@ void Engine::UpdateGUI() {
 
         ImGui::TreePop();
     }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("SSAO")) {
+        const char *resolutions[] = {"Full", "Half", "Quarter"};
+        if (ImGui::Combo("Resolution", &m_ssaoQuality, resolutions,
+                         IM_ARRAYSIZE(resolutions))) {
+            m_ssaoScale = 1 << m_ssaoQuality;
+            CreateSsaoBuffers();
+            CreateTransientTargets();
+        }
+        const char *sampleCounts[] = {"8", "16", "32", "64"};
+        int sampleIndex = 0;
+        while ((8 << sampleIndex) < m_ssaoSampleCount)
+            sampleIndex++;
+        if (ImGui::Combo("Samples", &sampleIndex, sampleCounts,
+                         IM_ARRAYSIZE(sampleCounts)))
+            m_ssaoSampleCount = 8 << sampleIndex;
+        ImGui::Checkbox("Temporal Accumulation", &m_useSsaoTemporal);
+        // The passes of the frame graph depend on the blur.
+        if (ImGui::Checkbox("Compute Blur", &m_useComputeSsaoBlur))
+            CreateTransientTargets();
+        ImGui::SliderFloat("New Frame Weight", &m_ssaoConstsCPU.temporalAlpha,
+                           0.05f, 1.0f);
+        ImGui::SliderFloat("Depth Sigma", &m_ssaoConstsCPU.depthSigma, 0.01f,
+                           0.5f);
+        ImGui::SliderFloat("Radius", &m_ssaoConstsCPU.radius, 0.01f, 1.0f);
+        ImGui::SliderFloat("Power", &m_ssaoConstsCPU.power, 0.5f, 4.0f);
+        ImGui::Text("AO %ux%u, %d of %d samples per frame", m_ssaoWidth,
+                    m_ssaoHeight, m_ssaoSampleCount, MAX_SAMPLES);
+        // 2 loads per pixel and pass, plus the apron of the tile
+        const float computeLoads =
+            4.0f * float(SSAO_BLUR_TILE + 2 * SSAO_BLUR_RADIUS) /
+            float(SSAO_BLUR_TILE);
+        ImGui::Text("Blur loads per pixel: compute %.2f, pixel shader 64",
+                    computeLoads);
+
+        ImGui::SliderInt("Evaluated Frames", &m_ssaoEvalFrames, 1, 64);
+        if (ImGui::Button("Capture G-Buffer and Evaluate"))
+            m_captureGBuffer = true;
+        if (m_hasSsaoEval) {
+            const auto &eval = m_ssaoEval;
+            ImGui::Text("1/%u resolution, %u samples, %u frames", eval.scale,
+                        eval.sampleCount, eval.frames);
+            ImGui::Text("Mean error %.4f (first frame %.4f), max %.3f",
+                        eval.meanError, eval.firstFrameMeanError,
+                        eval.maxError);
+            ImGui::Text("PSNR %.1f dB", eval.psnr);
+            ImGui::Text("CPU %.2f ms, reference %.2f ms", eval.testMs,
+                        eval.referenceMs);
+            ImGui::Text("Texture loads %.2fM, reference %.2fM",
+                        eval.testLoads * 1e-6, eval.referenceLoads * 1e-6);
+            if (eval.blurMaxError >= 0.0f) {
+                ImGui::Text("Blur vs CPU: mean %.5f, max %.4f, %.2f ms",
+                            eval.blurMeanError, eval.blurMaxError,
+                            eval.blurMs);
+            }
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Render Target Pool")) {
+        const auto &stats = m_targetPool.GetStats();
+        const float toMB = 1.0f / (1024.0f * 1024.0f);
+        ImGui::Text("%u targets in %u textures", stats.requests,
+                    stats.textures);
+        ImGui::Text("Pooled %.1f MB, naive %.1f MB", stats.pooledBytes * toMB,
+                    stats.naiveBytes * toMB);
+        ImGui::Text("Live peak %.1f MB", stats.livePeakBytes * toMB);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Frame Graph")) {
+        const auto &graph = m_frameGraph;
+        uint32_t clears = 0;
+        uint32_t unbinds = 0;
+        for (const auto &command : graph.GetCommands()) {
+            clears += command.type == FrameGraphCommand::Clear;
+            unbinds += command.type == FrameGraphCommand::Unbind;
+        }
+        ImGui::Text("%u of %u passes, %u clears, %u unbinds",
+                    uint32_t(graph.GetSchedule().size()),
+                    graph.GetNumPasses(), clears, unbinds);
+        for (uint32_t p = 0; p < graph.GetNumPasses(); p++) {
+            ImGui::Text("%s%s", graph.GetPassName(p).c_str(),
+                        graph.IsCulled(p) ? " (culled)" : "");
+        }
+        for (uint32_t r = 0; r < graph.GetNumResources(); r++) {
+            const auto &lifetime = graph.GetLifetime(r);
+            if (graph.IsTransient(r) && lifetime.IsUsed()) {
+                ImGui::Text("%s: passes %u-%u",
+                            graph.GetResourceName(r).c_str(),
+                            lifetime.firstPass, lifetime.lastPass);
+            }
+        }
+        if (ImGui::Button("Export Graphviz")) {
+            std::ofstream file("FrameGraph.dot");
+            file << graph.ExportGraphviz();
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Shader Cache")) {
+        // Of the startup, Graphics::InitShaders()
+        const auto stats = D3D11Utils::GetShaderCache().GetStats();
+        ImGui::Text("%u from the archive, %u hits, %u misses",
+                    stats.archiveHits, stats.hits, stats.misses);
+        ImGui::Text("Hit rate %.0f%%", stats.GetHitRate() * 100.0f);
+        ImGui::Text("Hash %.1f ms, load %.1f ms, compile %.1f ms",
+                    stats.hashMs, stats.loadMs, stats.compileMs);
+        ImGui::Text("Saved %.1f ms", stats.savedMs);
+        const auto &archive = D3D11Utils::GetShaderArchive();
+        if (archive.IsOpen()) {
+            ImGui::Text("%s: %u shaders", Graphics::SHADER_ARCHIVE,
+                        archive.GetNumShaders());
+        } else {
+            ImGui::Text("No %s, build with --build-shaders",
+                        Graphics::SHADER_ARCHIVE);
+        }
+        if (ImGui::Button("Benchmark Archive")) {
+            vector<string> names;
+            for (const auto &key : Graphics::GetShaderList())
+                names.push_back(ShaderArchive::GetName(key));
+            m_archiveBenchmark = ShaderArchive::Benchmark(
+                Graphics::SHADER_ARCHIVE, names, 1000);
+            m_hasArchiveBenchmark = true;
+        }
+        if (m_hasArchiveBenchmark) {
+            ImGui::Text("Open %.1f us, lookup %.0f ns, %u of %u found",
+                        m_archiveBenchmark.openUs, m_archiveBenchmark.lookupNs,
+                        m_archiveBenchmark.found,
+                        uint32_t(Graphics::GetShaderList().size()));
+        }
+        // A cold start of 64 shaders of 20 ms each, on the main thread like
+        // the job scaling benchmark
+        if (m_usePipelinedLoop) {
+            m_runCompileBenchmark = false;
+            ImGui::Text("Compile Benchmark: off with Pipelined Update");
+        } else if (ImGui::Button("Benchmark Parallel Compile")) {
+            m_runCompileBenchmark = true;
+        }
+        for (const auto &result : m_compileScaling) {
+            ImGui::Text("%u threads: %.0f ms, x%.2f", result.threads,
+                        result.wallMs, result.speedup);
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Hot Reload")) {
+        bool watch = m_hotReload.IsRunning();
+        if (ImGui::Checkbox("Watch Shaders and Assets", &watch)) {
+            if (watch) {
+                // An edited shader is compiled, not taken from the archive
+                auto &archive = D3D11Utils::GetShaderArchive();
+                D3D11Utils::GetShaderCache().SetArchive(
+                    archive.IsOpen() ? &archive : nullptr, true);
+                m_hotReload.Start({"Shaders", "Assets"});
+            } else {
+                m_hotReload.Stop();
+            }
+        }
+        const auto stats = m_hotReload.GetStats();
+        ImGui::Text("%u resources depend on %u files", stats.resources,
+                    stats.files);
+        ImGui::Text("%u changes: %u rebuilt, %u failed, %u swapped",
+                    stats.changes, stats.rebuilt, stats.failed,
+                    stats.swapped);
+        ImGui::Text("Last rebuild %.1f ms, swap %.2f ms", stats.lastRebuildMs,
+                    stats.lastApplyMs);
+        for (const auto &name : stats.lastRebuilt)
+            ImGui::BulletText("%s", name.c_str());
+        if (!stats.lastErrors.empty())
+            ImGui::TextWrapped("%s", stats.lastErrors.c_str());
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Pipeline States")) {
+        const auto stats = Graphics::stateCache.GetStats();
+        ImGui::Text("%u rasterizer, %u blend, %u depth stencil",
+                    stats.rasterizerStates, stats.blendStates,
+                    stats.depthStencilStates);
+        ImGui::Text("%u sampler, %u pipeline states", stats.samplerStates,
+                    stats.pipelineStates);
+        ImGui::Text("%llu hits, %llu misses, created in %.2f ms",
+                    (unsigned long long)stats.hits,
+                    (unsigned long long)stats.misses, stats.createMs);
+        ImGui::Text("%u stalls after loading: %.2f ms, max %.2f ms",
+                    stats.stalls, stats.stallMs, stats.maxStallMs);
+        // A pass asking for the G-buffer state by description
+        if (ImGui::Button("Benchmark Lookup")) {
+            const GraphicsPSODesc desc(Graphics::gBufferPSO);
+            Graphics::stateCache.GetPipelineState(desc);
+            const int count = 10000;
+            const auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < count; i++)
+                Graphics::stateCache.GetPipelineState(desc);
+            m_stateLookupNs = std::chrono::duration<float, std::nano>(
+                                  std::chrono::steady_clock::now() - start)
+                                  .count() /
+                              count;
+        }
+        if (m_stateLookupNs > 0.0f)
+            ImGui::Text("Lookup %.0f ns", m_stateLookupNs);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Material Table")) {
+        // Off: every draw binds its maps at t0 to t4
+        ImGui::Checkbox("Use Material Table", &m_useMaterialTable);
+        const auto stats = m_materialTable.GetStats();
+        ImGui::Text("%u maps in %u arrays, %u bound per draw",
+                    stats.textures, stats.arrays, stats.unpackedTextures);
+        ImGui::Text("%u materials, %u of them bind maps", stats.materials,
+                    stats.boundMaterials);
+        ImGui::Text("%u draws bound maps last frame", m_materialBindDraws);
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("Material Permutations")) {
+        // Off: one GBufferPS that reads the flags per pixel
+        ImGui::Checkbox("Use Permutations", &m_useMaterialPermutations);
+        const auto compiled = Graphics::gBufferPermutations.GetCompiled();
+        ImGui::Text("%u shader switches, %u compiled", m_permutationBuckets,
+                    uint32_t(compiled.size()));
+        // In use by this scene, meshes of the last frame
+        vector<uint32_t> used;
+        for (uint32_t i = 0; i < NUM_MATERIAL_PERMUTATIONS; i++) {
+            if (!m_permutationMeshes[i])
+                continue;
+            ImGui::Text("%2u %s: %u meshes", i,
+                        MaterialPermutations::GetName(i).c_str(),
+                        m_permutationMeshes[i]);
+            used.push_back(i);
+        }
+        // For the next --build-shaders, added to the saved list
+        if (ImGui::Button("Save Permutation List")) {
+            for (uint32_t features : MaterialPermutations::Load(
+                     Graphics::SHADER_PERMUTATIONS))
+                used.push_back(features);
+            std::sort(used.begin(), used.end());
+            used.erase(std::unique(used.begin(), used.end()), used.end());
+            MaterialPermutations::Save(Graphics::SHADER_PERMUTATIONS, used);
+        }
+        ImGui::TreePop();
+    }
+    ImGui::SetNextItemOpen(false, ImGuiCond_Once);
+    if (ImGui::TreeNode("G-Buffer Layouts")) {
+        // Bytes per pixel, the MB are for this resolution
+        const float toMB = float(m_screenWidth) * float(m_screenHeight) /
+                           (1024.0f * 1024.0f);
+        for (const auto &layout : GBufferPacking::GetLayouts()) {
+            const auto bandwidth = GBufferPacking::GetBandwidth(layout);
+            ImGui::Text("%s: %s", layout.name, layout.targets);
+            ImGui::Text("  %u B stored, %u B written, %u B read, %.1f MB",
+                        bandwidth.storageBytes, bandwidth.writeBytes,
+                        bandwidth.readBytes, bandwidth.TotalBytes() * toMB);
+        }
+        if (ImGui::Button("Measure Normal Accuracy")) {
+            m_normalErrors.clear();
+            for (auto encoding :
+                 {NormalEncoding::Unorm8Xyz, NormalEncoding::Octahedral8,
+                  NormalEncoding::Octahedral10, NormalEncoding::Octahedral16})
+                m_normalErrors.push_back(
+                    GBufferPacking::MeasureError(encoding, 1 << 20));
+        }
+        for (size_t i = 0; i < m_normalErrors.size(); i++) {
+            ImGui::Text("%s: mean %.4f, max %.4f degrees",
+                        GBufferPacking::GetName(NormalEncoding(i)),
+                        m_normalErrors[i].meanDegrees,
+                        m_normalErrors[i].maxDegrees);
+        }
+        ImGui::TreePop();
+    }
     ImGui::SetNextItemOpen(true, ImGuiCond_Once);
     if (ImGui::TreeNode("BOX")) {
         int flag = 0;
@@ -600,19 +2394,20 @@ void Engine::UpdateGUI() {
     if (ImGui::TreeNode("obj1")) {
         int flag = 0;
         // Move
-        Vector3 transition = m_mainObj->m_worldRow.Translation();
-        m_mainObj->m_worldRow.Translation(Vector3(0.0f));
+        Matrix worldRow = m_scene.GetWorldRow(m_mainHandle);
+        Vector3 transition = worldRow.Translation();
+        worldRow.Translation(Vector3(0.0f));
         ImGui::SliderFloat3("Position", &transition.x, -5.0f, 5.0f);
 
         // Rotation
         ImGui::SliderFloat3("Roation", &rotationGUI.x, 0.0f, 1.0f);
 
-        m_mainObj->UpdateWorldRow(m_mainObj->m_worldRow *
-                                  Matrix::CreateRotationY(rotationGUI.y) *
-                                  Matrix::CreateRotationX(-rotationGUI.x) *
-                                  Matrix::CreateRotationZ(rotationGUI.z) *
-                                  Matrix::CreateTranslation(transition));
-        m_mainBoundingSphere.Center = m_mainObj->m_worldRow.Translation();
+        worldRow = worldRow * Matrix::CreateRotationY(rotationGUI.y) *
+                   Matrix::CreateRotationX(-rotationGUI.x) *
+                   Matrix::CreateRotationZ(rotationGUI.z) *
+                   Matrix::CreateTranslation(transition);
+        m_scene.SetWorldRow(m_mainHandle, worldRow);
+        m_mainBoundingSphere.Center = worldRow.Translation();
 
         flag += ImGui::CheckboxFlags(
             "Normal Map", &m_mainObj->m_materialConstsCPU.useNormalMap, 1);
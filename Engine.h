@@ -2,11 +2,24 @@
 
 #include <algorithm>
 #include <directxtk/SimpleMath.h> 
+#include <functional>
 #include <iostream>
 #include <memory>
 
 #include "AppBase.h"
+#include "CascadedShadowMap.h"
+#include "ClusteredLighting.h"
+#include "CommandRecorder.h"
+#include "GBufferPacking.h"
+#include "MaterialPermutations.h"
+#include "MaterialTable.h"
+#include "Meshlet.h"
 #include "Model.h"
+#include "SceneStore.h"
+#include "ShadowAtlas.h"
+#include "ShadowCache.h"
+#include "SoftwareOcclusion.h"
+#include "SsaoReference.h"
 
 namespace jRenderer {
 
@@ -20,9 +33,73 @@ class Engine : public AppBase {
     virtual bool Initialize() override;
     virtual void UpdateGUI() override;
     virtual void Update(float dt) override;
-    virtual void Render() override;
+    virtual void BuildSnapshot(RenderSnapshot &snapshot) override;
+    virtual void Render(const RenderSnapshot &snapshot) override;
+    virtual void AddFramePasses() override;
+    virtual void OnHotReload() override;
+
+    void UploadSnapshot(const RenderSnapshot &snapshot);
+    void RenderModels(const RenderSnapshot &snapshot);
+    void SetCommonStates(ComPtr<ID3D11DeviceContext> &context);
+    void RenderShadowMaps(const RenderSnapshot &snapshot);
+    // Draws the casters of lightIndex that touch any of the faces.
+    // Without viewports the whole shadow map size is used.
+    void RenderShadowPass(const RenderSnapshot &snapshot,
+                          ID3D11DepthStencilView *dsv,
+                          ComPtr<ID3D11Buffer> &globalConstsGPU,
+                          const GraphicsPSO &pso,
+                          ID3D11Buffer *shadowTransformsGPU, int lightIndex,
+                          uint32_t faces, const D3D11_VIEWPORT *viewports,
+                          UINT numViewports);
+    // Point light faces as instances, selected by the vertex shader.
+    void RenderCubeShadowInstanced(const RenderSnapshot &snapshot,
+                                   int lightIndex, uint32_t faces,
+                                   const D3D11_VIEWPORT *viewports);
+    // Resets the depth of the tiles to 1.
+    void ClearShadowTiles(const D3D11_VIEWPORT *viewports, UINT count);
+    void RenderGBuffer(const RenderSnapshot &snapshot);
+    // Packs the maps of m_scene into the texture arrays, again after a
+    // hot reload replaced any of them.
+    void BuildMaterialTable();
+    // With the model space bounds of the model
+    SceneHandle AddToScene(const shared_ptr<Model> &model,
+                           const Matrix &worldRow,
+                           uint8_t flags = SCENE_VISIBLE | SCENE_CAST_SHADOW);
+    // The Clear and Unbind commands of m_frameGraph
+    void ClearFrameResource(uint32_t resource);
+    void UnbindShaderResource(ShaderStage stage, uint32_t slot);
+    // AO at 1/m_ssaoScale, upsampled to the screen. Returns the full
+    // resolution AO before the blur.
+    ID3D11ShaderResourceView *RenderSSAO(const RenderSnapshot &snapshot);
+    void UpdateSsaoConstants(const RenderSnapshot &snapshot);
+    // One pass of the separable bilateral blur into m_ssaoBlurTex, rows
+    // into m_ssaoBlurTempTex and then its columns.
+    void BlurSSAO(ID3D11ShaderResourceView *input,
+                  ID3D11UnorderedAccessView *output, bool horizontal);
+    // Reads back depth and normals for SsaoReference, and the AO before
+    // the blur unless aoSRV is null. The blurred AO is read by the caller
+    // after the blur.
+    void CaptureGBuffer(const Matrix &projRow,
+                        ID3D11ShaderResourceView *aoSRV);
+    // Copies the texture to a staging texture, readRow(y, row) per row
+    void ReadBackTexture(
+        ID3D11Texture2D *texture,
+        const std::function<void(UINT, const uint8_t *)> &readRow);
+    // R8_UNORM, at the size of m_gBufferCapture
+    void ReadBackAO(ID3D11Texture2D *texture, vector<float> &ao);
 
     void UpdateLights(float dt);
+    void UpdateShadowMatrices(int lightIndex);
+    void UpdateCascades(const Matrix &viewRow, const Matrix &projRow);
+    void UpdateShadowAtlas(const Vector3 &eyeWorld, const Matrix &viewRow,
+                           const Matrix &projRow);
+    void CullShadowCasters();
+    void UpdateLightClusters(const Matrix &viewRow, const Matrix &projRow);
+    void CullOccludedModels(const Matrix &viewRow, const Matrix &projRow);
+    void CullClusters(const Vector3 &eyeWorld, const Matrix &viewRow,
+                      const Matrix &projRow);
+    void BenchmarkJobScaling(const Vector3 &eyeWorld, const Matrix &viewRow,
+                             const Matrix &projRow);
 
   protected:
     shared_ptr<Model> m_ground[3];
@@ -52,7 +129,146 @@ class Engine : public AppBase {
     Vector3 rotationGUI = {0.0f, 0.0f, 0.0f};
 
     // ſ ƴ ü Ʈ (for ׸ )
-    vector<shared_ptr<Model>> m_basicList;
+    SceneStore m_scene;
+    SceneHandle m_mainHandle;
+    SceneHandle m_lightSphereHandles[MAX_LIGHTS];
+    SceneBenchmark m_sceneBenchmark;
+    bool m_hasSceneBenchmark = false;
+
+    // Cluster(Meshlet) Culling
+    bool m_useClusterCulling = true;
+    bool m_useConeCulling = true;
+    bool m_useHiZCulling = true; // reads the software occlusion depth
+    ClusterCullingStats m_clusterStats;
+
+    // Software Occlusion Culling
+    bool m_useOcclusionCulling = true;
+    bool m_autoSelectOccluders = true;
+    float m_autoOccluderRadius = 1.5f; // world space, half AABB diagonal
+    SoftwareOcclusion m_occlusion;
+
+    // Job System
+    bool m_runJobBenchmark = false;
+    vector<float> m_jobScalingMs; // index = number of workers
+
+    // Cascaded Shadow Map
+    bool m_useCascades = true;
+    int m_cascadeLight = -1; // light index, -1 when there is none
+    CascadedShadowMap m_cascades;
+    uint32_t m_cascadeCasters[NUM_CASCADES] = {};
+    GlobalConstants m_cascadeGlobalConstsCPU[NUM_CASCADES];
+    ComPtr<ID3D11Buffer> m_cascadeGlobalConstsGPU[NUM_CASCADES];
+    ShadowCascadeConstants m_cascadeConstsCPU;
+    ComPtr<ID3D11Buffer> m_cascadeConstsGPU;
+
+    // Shadow atlas, tile key = light * 6 + face
+    static constexpr uint32_t SHADOW_ATLAS_MIN_TILE = 128;
+    static constexpr uint32_t SHADOW_ATLAS_MAX_TILE = 2048;
+    float m_shadowImportance[MAX_LIGHTS] = {1.0f, 1.0f, 1.0f};
+    ShadowAtlas m_shadowAtlas;
+    vector<ShadowAtlasRequest> m_atlasRequests;
+    ShadowTile m_shadowTiles[MAX_SHADOW_FACES];
+    ShadowAtlasConstants m_shadowAtlasConstsCPU;
+    ComPtr<ID3D11Buffer> m_shadowAtlasConstsGPU;
+    ShadowAtlasStats m_atlasStressStats;
+    bool m_atlasStressValid = true;
+    bool m_hasAtlasStressStats = false;
+
+    // Shadow caster culling and caching
+    // Cache slots: the atlas tiles, then the cascades.
+    static constexpr int SHADOW_SLOT_CASCADES = MAX_SHADOW_FACES;
+    static constexpr float POINT_SHADOW_FAR = 50.0f;
+    bool m_useShadowCache = true;
+    ShadowCache m_shadowCache;
+    ShadowCacheStats m_shadowStats;
+    vector<uint8_t> m_isCaster; // per m_scene object
+    vector<uint64_t> m_casterSignatures;
+    vector<uint8_t> m_shadowMasks; // m_scene object * MAX_LIGHTS + light
+    uint32_t m_shadowRenderMasks[MAX_LIGHTS] = {}; // faces to render
+    uint32_t m_renderedShadowMapVersion = 0;       // render side
+    // Point lights draw a caster once per face it touches, as instances,
+    // instead of amplifying every triangle in the GS.
+    bool m_useInstancedCubeShadows = true;
+    vector<ShadowFaceInstance> m_shadowFaceInstances;
+    ComPtr<ID3D11Buffer> m_shadowFaceInstancesGPU;
+    // Shadow matrices are only rebuilt when the light moved.
+    Light m_shadowMatrixLights[MAX_LIGHTS];
+    bool m_hasShadowMatrices[MAX_LIGHTS] = {};
+
+    // Clustered Lighting
+    static constexpr int MAX_EXTRA_LIGHTS = 1024;
+    int m_numExtraLights = 256;
+    vector<Light> m_extraLights;          // world space, point lights
+    vector<ClusterLight> m_clusterLights; // view space, all lights
+    LightClusterGrid m_lightGrid;
+    ComPtr<ID3D11Buffer> m_clusterConstsGPU;
+    ComPtr<ID3D11Buffer> m_clusterLightsGPU;
+    ComPtr<ID3D11Buffer> m_clusterRangesGPU;
+    ComPtr<ID3D11Buffer> m_clusterLightIndicesGPU;
+    ComPtr<ID3D11ShaderResourceView> m_clusterLightsSRV;
+    ComPtr<ID3D11ShaderResourceView> m_clusterRangesSRV;
+    ComPtr<ID3D11ShaderResourceView> m_clusterLightIndicesSRV;
+
+    // SSAO quality, see SsaoConstants
+    int m_ssaoQuality = 1; // m_ssaoScale = 1 << m_ssaoQuality
+    int m_ssaoSampleCount = 16;
+    bool m_useSsaoTemporal = true;
+    SsaoConstants m_ssaoConstsCPU;
+    ComPtr<ID3D11Buffer> m_ssaoConstsGPU;
+    uint32_t m_ssaoFrame = 0;
+    uint32_t m_ssaoHistoryVersion = 0; // m_ssaoBufferVersion of the history
+    bool m_hasSsaoHistory = false;
+    Matrix m_prevViewProjRow;
+    // CPU reference over a captured G-buffer
+    bool m_captureGBuffer = false;
+    int m_ssaoEvalFrames = 16;
+    GBufferCapture m_gBufferCapture;
+    SsaoEvaluation m_ssaoEval;
+    bool m_hasSsaoEval = false;
+
+    // Frame graph, built again when the SSAO switch changes. The passes
+    // run with the snapshot of Render().
+    bool m_frameGraphSsao = false;
+    const RenderSnapshot *m_frameSnapshot = nullptr;
+    bool m_captureThisFrame = false;
+    ID3D11ShaderResourceView *m_ssaoInputSRV = nullptr; // AO before the blur
+
+    // Material permutations of the G-buffer pass, counts of the last frame
+    bool m_useMaterialPermutations = true;
+    uint32_t m_permutationMeshes[NUM_MATERIAL_PERMUTATIONS] = {};
+    uint32_t m_permutationBuckets = 0;
+
+    // Material table of the G-buffer pass, a draw reads its maps from the
+    // texture arrays by the material index of its instances.
+    bool m_useMaterialTable = true;
+    MaterialTable m_materialTable;
+    ComPtr<ID3D11Texture2D> m_materialArrays[MAX_MATERIAL_ARRAYS];
+    ComPtr<ID3D11ShaderResourceView> m_materialArraySRVs[MAX_MATERIAL_ARRAYS];
+    ComPtr<ID3D11Buffer> m_materialsGPU;
+    ComPtr<ID3D11ShaderResourceView> m_materialsSRV;
+    vector<uint32_t> m_cameraMaterials;      // per instance of the draws
+    ComPtr<ID3D11Buffer> m_cameraMaterialsGPU;
+    uint32_t m_materialBindDraws = 0; // last frame, binding t0 to t4
+
+    // Open and lookup times of Shaders.pak
+    ShaderArchiveBenchmark m_archiveBenchmark;
+    bool m_hasArchiveBenchmark = false;
+    // Re-creates the job system like m_runJobBenchmark
+    bool m_runCompileBenchmark = false;
+    vector<ShaderBatchBenchmark> m_compileScaling; // per thread count
+
+    // Of a hit in Graphics::stateCache, by the lookup benchmark
+    float m_stateLookupNs = 0.0f;
+
+    // G-buffer layout report, one error per NormalEncoding once measured
+    vector<NormalEncodingError> m_normalErrors;
+
+    // Deferred context recording of the G-buffer and shadow passes
+    DeferredContextRecorder m_recorder;
+    vector<MaterialDraw> m_cameraDraws; // one per mesh
+    vector<uint32_t> m_shadowCasters; // snapshot model indices
+    vector<uint64_t> m_cameraCosts;
+    vector<uint64_t> m_shadowCosts;
 };
 
 } // namespace hlab
@@ -0,0 +1,259 @@
+#include "FileWatcher.h"
+
+#include <filesystem>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace jRenderer {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::string JoinPath(const std::string &directory, const fs::path &name) {
+    return (fs::path(directory) / name).lexically_normal().generic_string();
+}
+
+} // namespace
+
+#ifdef _WIN32
+
+namespace {
+
+constexpr DWORD NOTIFY_FILTER = FILE_NOTIFY_CHANGE_FILE_NAME |
+                                FILE_NOTIFY_CHANGE_DIR_NAME |
+                                FILE_NOTIFY_CHANGE_LAST_WRITE;
+constexpr size_t NOTIFY_BUFFER_SIZE = 64 * 1024;
+
+} // namespace
+
+bool FileWatcher::Open(const std::vector<std::string> &directories) {
+    Close();
+    m_isWoken = false;
+    m_wakeEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+
+    // Reserved, the reads point into the buffers
+    m_directories.reserve(directories.size());
+    for (const auto &path : directories) {
+        HANDLE handle = CreateFileW(
+            fs::path(path).wstring().c_str(), FILE_LIST_DIRECTORY,
+            FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+            OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED,
+            NULL);
+        if (handle == INVALID_HANDLE_VALUE)
+            continue;
+        Directory directory;
+        directory.path = path;
+        directory.handle = handle;
+        directory.event = CreateEventA(NULL, TRUE, FALSE, NULL);
+        auto *overlapped = new OVERLAPPED();
+        overlapped->hEvent = directory.event;
+        directory.overlapped = overlapped;
+        directory.buffer.resize(NOTIFY_BUFFER_SIZE);
+        m_directories.push_back(std::move(directory));
+        if (!Read(m_directories.back())) {
+            m_directories.pop_back();
+            CloseHandle(handle);
+            CloseHandle(overlapped->hEvent);
+            delete overlapped;
+        }
+    }
+    m_isOpen = !m_directories.empty();
+    if (!m_isOpen)
+        Close();
+    return m_isOpen;
+}
+
+void FileWatcher::Close() {
+    for (auto &directory : m_directories) {
+        auto *overlapped = static_cast<OVERLAPPED *>(directory.overlapped);
+        // The read has to finish before its buffer goes away.
+        DWORD bytes = 0;
+        CancelIoEx(directory.handle, overlapped);
+        GetOverlappedResult(directory.handle, overlapped, &bytes, TRUE);
+        CloseHandle(directory.handle);
+        CloseHandle(directory.event);
+        delete overlapped;
+    }
+    m_directories.clear();
+    if (m_wakeEvent)
+        CloseHandle(m_wakeEvent);
+    m_wakeEvent = nullptr;
+    m_isOpen = false;
+}
+
+bool FileWatcher::Read(Directory &directory) {
+    return ReadDirectoryChangesW(
+        directory.handle, directory.buffer.data(),
+        DWORD(directory.buffer.size()), TRUE, NOTIFY_FILTER, NULL,
+        static_cast<OVERLAPPED *>(directory.overlapped), NULL);
+}
+
+bool FileWatcher::Wait(std::vector<std::string> &files, int timeoutMs) {
+    if (!m_isOpen || m_isWoken)
+        return false;
+
+    std::vector<HANDLE> events;
+    for (const auto &directory : m_directories)
+        events.push_back(directory.event);
+    events.push_back(m_wakeEvent);
+    const DWORD result =
+        WaitForMultipleObjects(DWORD(events.size()), events.data(), FALSE,
+                               timeoutMs < 0 ? INFINITE : DWORD(timeoutMs));
+    if (m_isWoken)
+        return false;
+    if (result == WAIT_TIMEOUT)
+        return true;
+    const DWORD index = result - WAIT_OBJECT_0;
+    if (index >= m_directories.size())
+        return false;
+
+    auto &directory = m_directories[index];
+    DWORD bytes = 0;
+    // No bytes when the buffer overflowed, those changes are lost.
+    if (GetOverlappedResult(directory.handle,
+                            static_cast<OVERLAPPED *>(directory.overlapped),
+                            &bytes, FALSE) &&
+        bytes) {
+        size_t offset = 0;
+        for (;;) {
+            const auto *info = reinterpret_cast<FILE_NOTIFY_INFORMATION *>(
+                directory.buffer.data() + offset);
+            if (info->Action == FILE_ACTION_ADDED ||
+                info->Action == FILE_ACTION_MODIFIED ||
+                info->Action == FILE_ACTION_RENAMED_NEW_NAME) {
+                const std::wstring name(info->FileName,
+                                        info->FileNameLength / sizeof(WCHAR));
+                files.push_back(JoinPath(directory.path, name));
+            }
+            if (!info->NextEntryOffset)
+                break;
+            offset += info->NextEntryOffset;
+        }
+    }
+    Read(directory);
+    return true;
+}
+
+void FileWatcher::Wake() {
+    m_isWoken = true;
+    if (m_wakeEvent)
+        SetEvent(m_wakeEvent);
+}
+
+#else
+
+namespace {
+
+constexpr uint32_t WATCH_MASK =
+    IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_ONLYDIR;
+
+} // namespace
+
+bool FileWatcher::Open(const std::vector<std::string> &directories) {
+    Close();
+    m_isWoken = false;
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0 || pipe2(m_wakePipe, O_NONBLOCK | O_CLOEXEC) != 0) {
+        Close();
+        return false;
+    }
+    for (const auto &path : directories)
+        AddTree(path);
+    m_isOpen = !m_directories.empty();
+    if (!m_isOpen)
+        Close();
+    return m_isOpen;
+}
+
+void FileWatcher::AddTree(const std::string &path) {
+    // inotify isn't recursive, every directory is watched on its own.
+    const int descriptor = inotify_add_watch(m_inotify, path.c_str(),
+                                             WATCH_MASK);
+    if (descriptor < 0)
+        return;
+    Directory directory;
+    directory.path = path;
+    directory.descriptor = descriptor;
+    m_directories.push_back(directory);
+
+    std::error_code error;
+    for (const auto &entry : fs::directory_iterator(path, error)) {
+        if (entry.is_directory(error))
+            AddTree(JoinPath(path, entry.path().filename()));
+    }
+}
+
+void FileWatcher::Close() {
+    if (m_inotify >= 0)
+        close(m_inotify); // removes the watches
+    for (int &end : m_wakePipe) {
+        if (end >= 0)
+            close(end);
+        end = -1;
+    }
+    m_inotify = -1;
+    m_directories.clear();
+    m_isOpen = false;
+}
+
+bool FileWatcher::Wait(std::vector<std::string> &files, int timeoutMs) {
+    if (!m_isOpen || m_isWoken)
+        return false;
+
+    pollfd descriptors[2] = {{m_inotify, POLLIN, 0},
+                             {m_wakePipe[0], POLLIN, 0}};
+    const int result = poll(descriptors, 2, timeoutMs);
+    if (m_isWoken)
+        return false;
+    if (result <= 0)
+        return true;
+
+    alignas(inotify_event) char buffer[16 * 1024];
+    for (;;) {
+        const ssize_t size = read(m_inotify, buffer, sizeof(buffer));
+        if (size <= 0)
+            break;
+        for (ssize_t offset = 0; offset < size;) {
+            const auto *event =
+                reinterpret_cast<const inotify_event *>(buffer + offset);
+            offset += sizeof(inotify_event) + event->len;
+            std::string path;
+            for (const auto &directory : m_directories) {
+                if (directory.descriptor == event->wd && event->len) {
+                    path = JoinPath(directory.path, event->name);
+                    break;
+                }
+            }
+            if (path.empty())
+                continue;
+            // New directories are watched, files in them come later.
+            if (event->mask & IN_ISDIR) {
+                if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                    AddTree(path);
+            } else if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                files.push_back(path);
+            }
+        }
+    }
+    return true;
+}
+
+void FileWatcher::Wake() {
+    m_isWoken = true;
+    if (m_wakePipe[1] >= 0) {
+        const char byte = 0;
+        [[maybe_unused]] const ssize_t written = write(m_wakePipe[1], &byte, 1);
+    }
+}
+
+#endif
+
+} // namespace jRenderer
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace jRenderer {
+
+// Changes to the files under some directories, with ReadDirectoryChangesW
+// on Windows and inotify elsewhere. The files are reported as the
+// directory given to Open() joined with the path below it, normalized with
+// '/', e.g. "Shaders/GBufferPS.hlsl".
+class FileWatcher {
+  public:
+    FileWatcher() = default;
+    ~FileWatcher() { Close(); }
+    FileWatcher(const FileWatcher &) = delete;
+    FileWatcher &operator=(const FileWatcher &) = delete;
+
+    // Watches the directories and everything below them. False when none
+    // of them could be watched.
+    bool Open(const std::vector<std::string> &directories);
+    // Not while another thread is in Wait(), Wake() it first
+    void Close();
+    bool IsOpen() const { return m_isOpen; }
+
+    // Appends the files written, created or renamed into place within
+    // timeoutMs, or nothing when the time ran out. Returns false once
+    // Wake() was called or the watcher isn't open.
+    bool Wait(std::vector<std::string> &files, int timeoutMs);
+    // Any thread, Wait() returns false from now on
+    void Wake();
+
+  private:
+    struct Directory {
+        std::string path;
+#ifdef _WIN32
+        void *handle = nullptr; // HANDLE of the directory
+        void *event = nullptr;  // HANDLE, signaled by the overlapped read
+        void *overlapped = nullptr;
+        std::vector<uint8_t> buffer;
+#else
+        int descriptor = -1; // inotify watch
+#endif
+    };
+#ifdef _WIN32
+    bool Read(Directory &directory);
+#else
+    void AddTree(const std::string &path);
+#endif
+
+    bool m_isOpen = false;
+    std::atomic<bool> m_isWoken = false;
+    std::vector<Directory> m_directories;
+#ifdef _WIN32
+    void *m_wakeEvent = nullptr; // HANDLE
+#else
+    int m_inotify = -1;
+    int m_wakePipe[2] = {-1, -1};
+#endif
+};
+
+} // namespace jRenderer
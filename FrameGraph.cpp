@@ -0,0 +1,227 @@
+#include "FrameGraph.h"
+
+#include <algorithm>
+#include <sstream>
+
+namespace jRenderer {
+
+uint32_t FrameGraph::ImportResource(const std::string &name) {
+    Resource resource;
+    resource.name = name;
+    resource.imported = true;
+    m_resources.push_back(resource);
+    return uint32_t(m_resources.size() - 1);
+}
+
+uint32_t FrameGraph::CreateResource(const std::string &name,
+                                    const TransientTextureDesc &desc) {
+    Resource resource;
+    resource.name = name;
+    resource.desc = desc;
+    m_resources.push_back(resource);
+    return uint32_t(m_resources.size() - 1);
+}
+
+uint32_t FrameGraph::AddPass(const std::string &name,
+                             std::function<void()> execute) {
+    Pass pass;
+    pass.name = name;
+    pass.execute = std::move(execute);
+    m_passes.push_back(std::move(pass));
+    return uint32_t(m_passes.size() - 1);
+}
+
+void FrameGraph::Read(uint32_t pass, uint32_t resource, ShaderStage stage,
+                      uint32_t slot) {
+    m_passes[pass].reads.push_back({resource, stage, slot});
+}
+
+void FrameGraph::Write(uint32_t pass, uint32_t resource, WriteMode mode) {
+    m_passes[pass].writes.push_back({resource, mode});
+}
+
+void FrameGraph::SetSideEffect(uint32_t pass) {
+    m_passes[pass].sideEffect = true;
+}
+
+void FrameGraph::Cull() {
+    // Backwards: a pass is needed when a later needed pass reads what it
+    // writes. A Load keeps the writers before it needed too.
+    std::vector<uint8_t> isNeeded(m_resources.size(), 0);
+    for (size_t p = m_passes.size(); p-- > 0;) {
+        auto &pass = m_passes[p];
+        bool keep = pass.sideEffect;
+        for (const auto &write : pass.writes) {
+            keep |= m_resources[write.resource].imported ||
+                    isNeeded[write.resource];
+        }
+        pass.culled = !keep;
+        if (!keep)
+            continue;
+
+        for (const auto &write : pass.writes)
+            isNeeded[write.resource] = write.mode == WriteMode::Load;
+        for (const auto &read : pass.reads)
+            isNeeded[read.resource] = 1;
+    }
+}
+
+// The SRV has to be unbound when the resource is written again, this frame
+// or the next, before another pass binds something else to the slot.
+bool FrameGraph::NeedsUnbind(size_t position, const ReadAccess &read) const {
+    const size_t count = m_schedule.size();
+    for (size_t k = 1; k <= count; k++) {
+        const auto &pass = m_passes[m_schedule[(position + k) % count]];
+        for (const auto &write : pass.writes) {
+            if (write.resource == read.resource)
+                return true;
+        }
+        for (const auto &other : pass.reads) {
+            if (other.stage == read.stage && other.slot == read.slot)
+                return false;
+        }
+    }
+    return false;
+}
+
+void FrameGraph::Compile() {
+    Cull();
+
+    m_schedule.clear();
+    for (uint32_t p = 0; p < uint32_t(m_passes.size()); p++) {
+        if (!m_passes[p].culled)
+            m_schedule.push_back(p);
+    }
+
+    for (auto &resource : m_resources)
+        resource.lifetime = Lifetime();
+    for (uint32_t i = 0; i < uint32_t(m_schedule.size()); i++) {
+        const auto &pass = m_passes[m_schedule[i]];
+        auto use = [&](uint32_t resource) {
+            auto &lifetime = m_resources[resource].lifetime;
+            lifetime.firstPass = std::min(lifetime.firstPass, i);
+            lifetime.lastPass = std::max(lifetime.lastPass, i);
+        };
+        for (const auto &read : pass.reads)
+            use(read.resource);
+        for (const auto &write : pass.writes)
+            use(write.resource);
+    }
+
+    m_commands.clear();
+    std::vector<uint8_t> isWritten(m_resources.size(), 0);
+    for (size_t i = 0; i < m_schedule.size(); i++) {
+        const uint32_t p = m_schedule[i];
+        const auto &pass = m_passes[p];
+
+        // A transient resource holds garbage until its first write.
+        for (const auto &write : pass.writes) {
+            const bool isUndefined = !m_resources[write.resource].imported &&
+                                     !isWritten[write.resource];
+            if (write.mode == WriteMode::Clear ||
+                (write.mode == WriteMode::Load && isUndefined))
+                m_commands.push_back(
+                    {FrameGraphCommand::Clear, write.resource});
+            isWritten[write.resource] = 1;
+        }
+
+        m_commands.push_back({FrameGraphCommand::Execute, p});
+
+        for (size_t r = 0; r < pass.reads.size(); r++) {
+            const auto &read = pass.reads[r];
+            // Once per slot, a pass may bind several resources to one.
+            bool isFirst = true;
+            for (size_t other = 0; other < r; other++) {
+                isFirst &= !(pass.reads[other].stage == read.stage &&
+                             pass.reads[other].slot == read.slot);
+            }
+            bool needsUnbind = false;
+            for (size_t other = r; other < pass.reads.size(); other++) {
+                if (pass.reads[other].stage == read.stage &&
+                    pass.reads[other].slot == read.slot)
+                    needsUnbind |= NeedsUnbind(i, pass.reads[other]);
+            }
+            if (isFirst && needsUnbind) {
+                m_commands.push_back(
+                    {FrameGraphCommand::Unbind, read.slot, read.stage});
+            }
+        }
+    }
+}
+
+void FrameGraph::Execute(FunctionRef<void(uint32_t resource)> clear,
+                         FunctionRef<void(ShaderStage, uint32_t)> unbind) {
+    for (const auto &command : m_commands) {
+        switch (command.type) {
+        case FrameGraphCommand::Clear:
+            clear(command.index);
+            break;
+        case FrameGraphCommand::Execute:
+            if (m_passes[command.index].execute)
+                m_passes[command.index].execute();
+            break;
+        case FrameGraphCommand::Unbind:
+            unbind(command.stage, command.index);
+            break;
+        }
+    }
+}
+
+std::string FrameGraph::ExportGraphviz() const {
+    const char *modeNames[] = {"discard", "clear", "load"};
+    std::ostringstream dot;
+    dot << "digraph FrameGraph {\n";
+    dot << "    rankdir=LR;\n";
+    dot << "    node [fontname=\"Helvetica\", fontsize=10];\n";
+    dot << "    edge [fontname=\"Helvetica\", fontsize=9];\n";
+
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        const auto &pass = m_passes[p];
+        dot << "    p" << p << " [shape=box, label=\"" << pass.name << "\"";
+        if (pass.culled)
+            dot << ", style=dashed, fontcolor=gray";
+        else
+            dot << ", style=filled, fillcolor=lightblue";
+        dot << "];\n";
+    }
+
+    for (size_t r = 0; r < m_resources.size(); r++) {
+        const auto &resource = m_resources[r];
+        dot << "    r" << r << " [shape=ellipse, label=\"" << resource.name;
+        if (!resource.imported) {
+            dot << "\\n" << resource.desc.width << "x" << resource.desc.height
+                << ", format " << resource.desc.format;
+        }
+        if (resource.lifetime.IsUsed()) {
+            dot << "\\npasses " << resource.lifetime.firstPass << "-"
+                << resource.lifetime.lastPass;
+        }
+        dot << "\"";
+        if (resource.imported)
+            dot << ", style=filled, fillcolor=lightgray";
+        dot << "];\n";
+    }
+
+    for (size_t p = 0; p < m_passes.size(); p++) {
+        for (const auto &read : m_passes[p].reads) {
+            dot << "    r" << read.resource << " -> p" << p << " [label=\""
+                << (read.stage == ShaderStage::Pixel ? "PS" : "CS") << " t"
+                << read.slot << "\"];\n";
+        }
+        for (const auto &write : m_passes[p].writes) {
+            dot << "    p" << p << " -> r" << write.resource << " [label=\""
+                << modeNames[int(write.mode)] << "\", color=red];\n";
+        }
+    }
+    dot << "}\n";
+    return dot.str();
+}
+
+void FrameGraph::Clear() {
+    m_passes.clear();
+    m_resources.clear();
+    m_schedule.clear();
+    m_commands.clear();
+}
+
+} // namespace jRenderer
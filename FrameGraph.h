@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "FunctionRef.h"
+#include "TransientAllocator.h"
+
+namespace jRenderer {
+
+enum class ShaderStage : uint8_t { Pixel, Compute };
+
+enum class WriteMode : uint8_t {
+    Discard, // every pixel is written, the old contents don't matter
+    Clear,   // only some pixels are written, cleared before the pass
+    Load,    // blends or depth tests with what the earlier passes wrote
+};
+
+// One step of the compiled frame
+struct FrameGraphCommand {
+    enum Type : uint8_t { Clear, Execute, Unbind };
+
+    Type type;
+    uint32_t index; // resource of Clear, pass of Execute, slot of Unbind
+    ShaderStage stage = ShaderStage::Pixel; // Unbind
+};
+
+// The passes of a frame with the resources they read and write. Compile()
+// culls the passes nothing needs, computes the lifetimes of the transient
+// resources and inserts the clears and the SRV unbinds. The passes run in
+// the order they were added, which is already a valid order because a
+// pass can only read what earlier passes wrote.
+//
+// Compile() doesn't touch D3D, the clears and unbinds go through the
+// callbacks of Execute().
+class FrameGraph {
+  public:
+    // Lives outside the graph: the back buffer, the G-buffer, histories.
+    // Passes writing it are never culled.
+    uint32_t ImportResource(const std::string &name);
+    // Lives only within the frame, allocated from the lifetime
+    uint32_t CreateResource(const std::string &name,
+                            const TransientTextureDesc &desc);
+
+    uint32_t AddPass(const std::string &name,
+                     std::function<void()> execute = nullptr);
+    // The pass binds the resource as an SRV at the slot
+    void Read(uint32_t pass, uint32_t resource, ShaderStage stage,
+              uint32_t slot);
+    void Write(uint32_t pass, uint32_t resource,
+               WriteMode mode = WriteMode::Discard);
+    // Never culled, e.g. reads back to the CPU
+    void SetSideEffect(uint32_t pass);
+
+    void Compile();
+    void Execute(FunctionRef<void(uint32_t resource)> clear,
+                 FunctionRef<void(ShaderStage, uint32_t)> unbind);
+
+    // The passes with what they read and write, as a Graphviz digraph
+    std::string ExportGraphviz() const;
+
+    void Clear();
+
+    struct Lifetime {
+        uint32_t firstPass = UINT32_MAX; // in the order of GetSchedule()
+        uint32_t lastPass = 0;
+        bool IsUsed() const { return firstPass != UINT32_MAX; }
+    };
+
+    uint32_t GetNumPasses() const { return uint32_t(m_passes.size()); }
+    uint32_t GetNumResources() const { return uint32_t(m_resources.size()); }
+    const std::string &GetPassName(uint32_t pass) const {
+        return m_passes[pass].name;
+    }
+    const std::string &GetResourceName(uint32_t resource) const {
+        return m_resources[resource].name;
+    }
+    bool IsCulled(uint32_t pass) const { return m_passes[pass].culled; }
+    bool IsTransient(uint32_t resource) const {
+        return !m_resources[resource].imported;
+    }
+    const TransientTextureDesc &GetDesc(uint32_t resource) const {
+        return m_resources[resource].desc;
+    }
+    const Lifetime &GetLifetime(uint32_t resource) const {
+        return m_resources[resource].lifetime;
+    }
+    const std::vector<uint32_t> &GetSchedule() const { return m_schedule; }
+    const std::vector<FrameGraphCommand> &GetCommands() const {
+        return m_commands;
+    }
+
+  private:
+    struct ReadAccess {
+        uint32_t resource;
+        ShaderStage stage;
+        uint32_t slot;
+    };
+    struct WriteAccess {
+        uint32_t resource;
+        WriteMode mode;
+    };
+    struct Pass {
+        std::string name;
+        std::function<void()> execute;
+        std::vector<ReadAccess> reads;
+        std::vector<WriteAccess> writes;
+        bool sideEffect = false;
+        bool culled = false;
+    };
+    struct Resource {
+        std::string name;
+        TransientTextureDesc desc;
+        bool imported = false;
+        Lifetime lifetime;
+    };
+
+    void Cull();
+    bool NeedsUnbind(size_t position, const ReadAccess &read) const;
+
+    std::vector<Pass> m_passes;
+    std::vector<Resource> m_resources;
+    std::vector<uint32_t> m_schedule; // passes that aren't culled
+    std::vector<FrameGraphCommand> m_commands;
+};
+
+} // namespace jRenderer
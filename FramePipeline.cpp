@@ -0,0 +1,69 @@
+#include "FramePipeline.h"
+
+#include <algorithm>
+
+namespace jRenderer {
+
+void FramePipeline::Reset(int depth) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_slots.resize(size_t(std::max(depth, 1)) + 1);
+    m_writeIndex = 0;
+    m_readIndex = 0;
+    m_queued = 0;
+    m_closed = false;
+}
+
+RenderSnapshot *FramePipeline::BeginWrite() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock,
+                   [this] { return m_closed || m_queued < m_slots.size(); });
+    if (m_closed)
+        return nullptr;
+
+    auto &slot = m_slots[m_writeIndex];
+    slot.frameIndex = m_frameIndex++;
+    return &slot;
+}
+
+void FramePipeline::EndWrite() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_writeIndex = (m_writeIndex + 1) % m_slots.size();
+        m_queued++;
+    }
+    m_changed.notify_all();
+}
+
+const RenderSnapshot *FramePipeline::BeginRead() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_changed.wait(lock, [this] { return m_closed || m_queued > 0; });
+    if (m_closed && m_queued == 0)
+        return nullptr;
+
+    return &m_slots[m_readIndex];
+}
+
+void FramePipeline::EndRead() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_readIndex = (m_readIndex + 1) % m_slots.size();
+        m_queued--;
+    }
+    m_changed.notify_all();
+}
+
+void FramePipeline::Close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_closed = true;
+    }
+    m_changed.notify_all();
+}
+
+int FramePipeline::GetQueuedFrames() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return int(m_queued);
+}
+
+} // namespace jRenderer
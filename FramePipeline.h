@@ -0,0 +1,119 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <mutex>
+#include <vector>
+
+#include "ClusteredLighting.h"
+#include "ConstantBuffers.h"
+#include "Meshlet.h"
+#include "ShadowAtlas.h"
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+
+class Model;
+
+// Everything the render side needs from a model for one frame.
+struct ModelSnapshot {
+    Model *model = nullptr;
+    MeshConstants meshConsts;
+    MaterialConstants materialConsts;
+    InstancedConsts instancedConsts;
+    bool isOccluded = false; // still captured when it casts shadows
+    bool castShadow = false;
+    // Bit f: casts into face f of the light, a cube face or a cascade
+    uint8_t shadowMasks[MAX_LIGHTS] = {};
+
+    // Indices drawn by the camera pass / a shadow pass, for load balancing
+    uint64_t drawCost = 0;
+    uint64_t shadowCost = 0;
+
+    // Per mesh, cluster culling result
+    std::vector<std::vector<IndexRange>> drawRanges;
+    std::vector<uint8_t> useDrawRanges;
+};
+
+// Immutable frame state produced by Update() and consumed by Render().
+// The vectors keep their capacity while the slot is reused.
+struct RenderSnapshot {
+    uint64_t frameIndex = 0;
+    std::chrono::high_resolution_clock::time_point inputTime;
+
+    Vector3 eyeWorld;
+    Matrix viewRow;
+    Matrix projRow;
+
+    GlobalConstants globalConsts;
+    GlobalConstants shadowGlobalConsts[MAX_LIGHTS];
+    ShadowLightTransform pointLightTransforms[MAX_LIGHTS];
+    uint32_t shadowRenderMasks[MAX_LIGHTS]; // faces that changed, per light
+    GlobalConstants cascadeGlobalConsts[NUM_CASCADES];
+    ShadowCascadeConstants cascadeConsts; // lightIndex -1: no cascades
+    ShadowTile shadowTiles[MAX_SHADOW_FACES]; // light * 6 + face
+    ShadowAtlasConstants shadowAtlasConsts;
+
+    // Clustered lighting, binned on the update side
+    ClusterConstants clusterConsts;
+    std::vector<ClusterLight> clusterLights;
+    std::vector<ClusterRange> clusterRanges;
+    std::vector<uint32_t> clusterLightIndices;
+
+    // Visible models, only the first numModels are valid.
+    std::vector<ModelSnapshot> models;
+    size_t numModels = 0;
+};
+
+struct FramePipelineStats {
+    float frameMs = 0.0f;   // time between two presented frames
+    float latencyMs = 0.0f; // input sampling to present
+    int framesInFlight = 0;
+    // operator new calls of all threads between the last two presents,
+    // the update and the render of a frame
+    uint64_t frameAllocations = 0;
+
+    // Exponential moving average, so the GUI numbers are readable
+    void Add(float frame, float latency) {
+        frameMs += (frame - frameMs) * 0.05f;
+        latencyMs += (latency - latencyMs) * 0.05f;
+    }
+};
+
+// Bounded ring of snapshots between the update and the render thread.
+// The writer can be at most 'depth' frames ahead of the frame being read.
+class FramePipeline {
+  public:
+    // Not while either side is inside Begin/End.
+    void Reset(int depth);
+
+    // Block until a slot is free / a frame is ready.
+    // Return nullptr once Close() was called.
+    RenderSnapshot *BeginWrite();
+    void EndWrite();
+    const RenderSnapshot *BeginRead();
+    void EndRead();
+
+    // Wakes up both sides, e.g. to stop the update thread.
+    void Close();
+
+    int GetDepth() const { return int(m_slots.size()) - 1; }
+    int GetQueuedFrames() const;
+
+  private:
+    std::vector<RenderSnapshot> m_slots; // depth + 1
+    size_t m_writeIndex = 0;
+    size_t m_readIndex = 0;
+    size_t m_queued = 0; // written and not released by the reader
+    uint64_t m_frameIndex = 0;
+    bool m_closed = false;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_changed;
+};
+
+} // namespace jRenderer
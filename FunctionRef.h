@@ -0,0 +1,40 @@
+#pragma once
+
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace jRenderer {
+
+template <typename Signature> class FunctionRef;
+
+// Non-owning reference to a callable, for callbacks that are only called
+// while the function that takes them runs. Unlike a std::function it never
+// allocates, however much a lambda captures. The callable has to outlive
+// the FunctionRef, a lambda passed as an argument lives until the call
+// returns.
+template <typename Result, typename... Args>
+class FunctionRef<Result(Args...)> {
+  public:
+    template <typename Callable,
+              typename = std::enable_if_t<!std::is_same_v<
+                  std::remove_cv_t<std::remove_reference_t<Callable>>,
+                  FunctionRef>>>
+    FunctionRef(Callable &&callable)
+        : m_callable(const_cast<void *>(
+              static_cast<const void *>(std::addressof(callable)))),
+          m_call([](void *callable, Args... args) -> Result {
+              return (*static_cast<std::remove_reference_t<Callable> *>(
+                  callable))(std::forward<Args>(args)...);
+          }) {}
+
+    Result operator()(Args... args) const {
+        return m_call(m_callable, std::forward<Args>(args)...);
+    }
+
+  private:
+    void *m_callable;
+    Result (*m_call)(void *, Args...);
+};
+
+} // namespace jRenderer
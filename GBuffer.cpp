@@ -4,12 +4,11 @@
 namespace jRenderer {
 
 GBuffer::GBuffer()
-    : m_pGBufferUnpackCB(NULL), m_depthStencilTex(NULL),
-      m_colorSpecIntensityTex(NULL), m_normalTex(NULL), m_specPowerTex(NULL),
-      m_depthStencilDSV(NULL), m_depthStencilReadOnlyDSV(NULL),
-      m_colorSpecIntensityRTV(NULL), m_normalRTV(NULL), m_specPowerRTV(NULL),
-      m_depthStencilSRV(NULL), m_colorSpecIntensitySRV(NULL), m_normalSRV(NULL),
-      m_specPowerSRV(NULL), m_depthStencilState(NULL) {}
+    : m_pGBufferUnpackCB(NULL), m_depthStencilTex(NULL), m_albedoAOTex(NULL),
+      m_normalTex(NULL), m_depthStencilDSV(NULL),
+      m_depthStencilReadOnlyDSV(NULL), m_albedoAORTV(NULL), m_normalRTV(NULL),
+      m_depthStencilSRV(NULL), m_albedoAOSRV(NULL), m_normalSRV(NULL),
+      m_depthStencilState(NULL) {}
 
 GBuffer::~GBuffer() {}
 
@@ -18,11 +17,11 @@ HRESULT GBuffer::Init(ComPtr<ID3D11Device> &g_pDevice, UINT width, UINT height)
 
     Deinit(); // Clear the previous targets
 
-    // Texture formats
+    // Texture formats, the layout is in Shaders/GBufferPacking.hlsli
     static const DXGI_FORMAT depthStencilTextureFormat = DXGI_FORMAT_R24G8_TYPELESS;
     static const DXGI_FORMAT basicColorTextureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
-    static const DXGI_FORMAT normalTextureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
-    static const DXGI_FORMAT specPowTextureFormat = DXGI_FORMAT_R8G8B8A8_UNORM;
+    static const DXGI_FORMAT normalTextureFormat =
+        DXGI_FORMAT_R10G10B10A2_UNORM;
 
     // Render View formats
     static const DXGI_FORMAT depthStencilRenderViewFormat =
@@ -30,9 +29,7 @@ HRESULT GBuffer::Init(ComPtr<ID3D11Device> &g_pDevice, UINT width, UINT height)
     static const DXGI_FORMAT basicColorRenderViewFormat =
         DXGI_FORMAT_R8G8B8A8_UNORM;
     static const DXGI_FORMAT normalRenderViewFormat =
-        DXGI_FORMAT_R8G8B8A8_UNORM;
-    static const DXGI_FORMAT specPowRenderViewFormat =
-        DXGI_FORMAT_R8G8B8A8_UNORM;
+        DXGI_FORMAT_R10G10B10A2_UNORM;
 
     // Resource view formats
     static const DXGI_FORMAT depthStencilResourceViewFormat =
@@ -40,9 +37,7 @@ HRESULT GBuffer::Init(ComPtr<ID3D11Device> &g_pDevice, UINT width, UINT height)
     static const DXGI_FORMAT basicColorResourceViewFormat =
         DXGI_FORMAT_R8G8B8A8_UNORM;
     static const DXGI_FORMAT normalResourceViewFormat =
-        DXGI_FORMAT_R8G8B8A8_UNORM;
-    static const DXGI_FORMAT specPowResourceViewFormat =
-        DXGI_FORMAT_R8G8B8A8_UNORM;
+        DXGI_FORMAT_R10G10B10A2_UNORM;
 
     // Allocate the depth stencil target
     D3D11_TEXTURE2D_DESC dtd = {
@@ -62,20 +57,15 @@ HRESULT GBuffer::Init(ComPtr<ID3D11Device> &g_pDevice, UINT width, UINT height)
     dtd.Format = depthStencilTextureFormat;
     ThrowIfFailed(g_pDevice->CreateTexture2D(&dtd, NULL, &m_depthStencilTex));
 
-    // Allocate the base color with specular intensity target
+    // Allocate the albedo with material AO target
     dtd.BindFlags = D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE;
     dtd.Format = basicColorTextureFormat; 
-    ThrowIfFailed(
-        g_pDevice->CreateTexture2D(&dtd, NULL, &m_colorSpecIntensityTex));
+    ThrowIfFailed(g_pDevice->CreateTexture2D(&dtd, NULL, &m_albedoAOTex));
 
-    // Allocate the base color with specular intensity target
+    // Allocate the normal with roughness and metallic target
     dtd.Format = normalTextureFormat;
     ThrowIfFailed(g_pDevice->CreateTexture2D(&dtd, NULL, &m_normalTex));
 
-    // Allocate the specular power target
-    dtd.Format = specPowTextureFormat;
-    ThrowIfFailed(g_pDevice->CreateTexture2D(&dtd, NULL, &m_specPowerTex));
-
     // Create the render target views
     D3D11_DEPTH_STENCIL_VIEW_DESC dsvd = {depthStencilRenderViewFormat,
                                           D3D11_DSV_DIMENSION_TEXTURE2D, 0};
@@ -89,17 +79,13 @@ HRESULT GBuffer::Init(ComPtr<ID3D11Device> &g_pDevice, UINT width, UINT height)
     D3D11_RENDER_TARGET_VIEW_DESC rtsvd = {basicColorRenderViewFormat,
                                            D3D11_RTV_DIMENSION_TEXTURE2D};
 
-    ThrowIfFailed(g_pDevice->CreateRenderTargetView(
-        m_colorSpecIntensityTex, &rtsvd, &m_colorSpecIntensityRTV));
+    ThrowIfFailed(g_pDevice->CreateRenderTargetView(m_albedoAOTex, &rtsvd,
+                                                    &m_albedoAORTV));
 
     rtsvd.Format = normalRenderViewFormat;
     ThrowIfFailed(
         g_pDevice->CreateRenderTargetView(m_normalTex, &rtsvd, &m_normalRTV));
 
-    rtsvd.Format = specPowRenderViewFormat;
-    ThrowIfFailed(g_pDevice->CreateRenderTargetView(m_specPowerTex, &rtsvd,
-                                                    &m_specPowerRTV));
-
     // Create the resource views
     D3D11_SHADER_RESOURCE_VIEW_DESC dsrvd = {
         depthStencilResourceViewFormat, D3D11_SRV_DIMENSION_TEXTURE2D, 0, 0};
@@ -108,17 +94,13 @@ HRESULT GBuffer::Init(ComPtr<ID3D11Device> &g_pDevice, UINT width, UINT height)
                                                       &m_depthStencilSRV));
 
     dsrvd.Format = basicColorResourceViewFormat;
-    ThrowIfFailed(g_pDevice->CreateShaderResourceView(
-        m_colorSpecIntensityTex, &dsrvd, &m_colorSpecIntensitySRV)); 
+    ThrowIfFailed(g_pDevice->CreateShaderResourceView(m_albedoAOTex, &dsrvd,
+                                                      &m_albedoAOSRV));
 
     dsrvd.Format = normalResourceViewFormat;
     ThrowIfFailed(
         g_pDevice->CreateShaderResourceView(m_normalTex, &dsrvd, &m_normalSRV));
 
-    dsrvd.Format = specPowResourceViewFormat;
-    ThrowIfFailed(g_pDevice->CreateShaderResourceView(m_specPowerTex, &dsrvd,
-                                                 &m_specPowerSRV));
-
     D3D11_DEPTH_STENCIL_DESC descDepth;
     descDepth.DepthEnable = TRUE;
     descDepth.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
@@ -142,37 +124,42 @@ void GBuffer::Deinit() {
 
     // Clear all allocated targets
     SAFE_RELEASE(m_depthStencilTex);
-    SAFE_RELEASE(m_colorSpecIntensityTex);
+    SAFE_RELEASE(m_albedoAOTex);
     SAFE_RELEASE(m_normalTex);
-    SAFE_RELEASE(m_specPowerTex);
 
     // Clear all views
     SAFE_RELEASE(m_depthStencilDSV);
     SAFE_RELEASE(m_depthStencilReadOnlyDSV);
-    SAFE_RELEASE(m_colorSpecIntensityRTV);
+    SAFE_RELEASE(m_albedoAORTV);
     SAFE_RELEASE(m_normalRTV);
-    SAFE_RELEASE(m_specPowerRTV);
     SAFE_RELEASE(m_depthStencilSRV);
-    SAFE_RELEASE(m_colorSpecIntensitySRV);
+    SAFE_RELEASE(m_albedoAOSRV);
     SAFE_RELEASE(m_normalSRV);
-    SAFE_RELEASE(m_specPowerSRV);
 
     // Clear the depth stencil state
     SAFE_RELEASE(m_depthStencilState);
 }
 
-void GBuffer::PreRender(ComPtr<ID3D11DeviceContext>& context) {
+void GBuffer::PreRender(ComPtr<ID3D11DeviceContext> &context,
+                        ID3D11RenderTargetView *lightingRTV) {
+    Clear(context);
+    Bind(context, lightingRTV);
+}
+
+void GBuffer::Clear(ComPtr<ID3D11DeviceContext> &context) {
     context->ClearDepthStencilView(
         m_depthStencilDSV, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.0f, 0.0f);
 
     // you only need to do this if your scene doesn't cover the whole visible area
     float clearColor[4] = {0.0f, 0.0f, 0.0f, 0.0f};
-    context->ClearRenderTargetView(m_colorSpecIntensityRTV, clearColor);
+    context->ClearRenderTargetView(m_albedoAORTV, clearColor);
     context->ClearRenderTargetView(m_normalRTV, clearColor);
-    context->ClearRenderTargetView(m_specPowerRTV, clearColor);
-     
-    ID3D11RenderTargetView *RTVs[3] = {m_colorSpecIntensityRTV, m_normalRTV,
-                                     m_specPowerRTV}; 
+}
+
+void GBuffer::Bind(ComPtr<ID3D11DeviceContext> &context,
+                   ID3D11RenderTargetView *lightingRTV) {
+    ID3D11RenderTargetView *RTVs[3] = {m_albedoAORTV, m_normalRTV,
+                                       lightingRTV};
     context->OMSetRenderTargets(3, RTVs, m_depthStencilDSV);
     context->OMSetDepthStencilState(m_depthStencilState, 1);
 }
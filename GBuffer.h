@@ -16,42 +16,50 @@ class GBuffer {
     HRESULT Init(ComPtr<ID3D11Device> &device, UINT width, UINT height);
     void Deinit();
 
-    void PreRender(ComPtr<ID3D11DeviceContext> &context);
+    void PreRender(ComPtr<ID3D11DeviceContext> &context,
+                   ID3D11RenderTargetView *lightingRTV);
+    // PreRender() split in two, so several contexts can bind the targets
+    // after a single clear.
+    void Clear(ComPtr<ID3D11DeviceContext> &context);
+    // The emission is written straight into lightingRTV, after the G-buffer
+    // targets (see Shaders/GBufferPacking.hlsli).
+    void Bind(ComPtr<ID3D11DeviceContext> &context,
+              ID3D11RenderTargetView *lightingRTV);
     void PostRender(ComPtr<ID3D11DeviceContext> &context);
 
-    ID3D11Texture2D *GetColorTexture() { return m_colorSpecIntensityTex; }
+    ID3D11Texture2D *GetColorTexture() { return m_albedoAOTex; }
+    ID3D11Texture2D *GetDepthTexture() { return m_depthStencilTex; }
+    ID3D11Texture2D *GetNormalTexture() { return m_normalTex; }
+    ID3D11RenderTargetView *GetColorRTV() { return m_albedoAORTV; }
+    ID3D11RenderTargetView *GetNormalRTV() { return m_normalRTV; }
     ID3D11DepthStencilView *GetDepthDSV() { return m_depthStencilDSV; }
     ID3D11DepthStencilView *GetDepthReadOnlyDSV() {
         return m_depthStencilReadOnlyDSV;
     }
 
     ID3D11ShaderResourceView *GetDepthView() { return m_depthStencilSRV; }
-    ID3D11ShaderResourceView *GetColorView() { return m_colorSpecIntensitySRV; }
+    ID3D11ShaderResourceView *GetColorView() { return m_albedoAOSRV; }
     ID3D11ShaderResourceView *GetNormalView() { return m_normalSRV; }
-    ID3D11ShaderResourceView *GetSpecPowerView() { return m_specPowerSRV; }
 
   private:
     ID3D11Buffer *m_pGBufferUnpackCB;
 
     // GBuffer Textures
     ID3D11Texture2D *m_depthStencilTex;
-    ID3D11Texture2D *m_colorSpecIntensityTex;
-    ID3D11Texture2D *m_normalTex;
-    ID3D11Texture2D *m_specPowerTex;
+    ID3D11Texture2D *m_albedoAOTex; // albedo, material AO
+    ID3D11Texture2D *m_normalTex;   // octahedral normal, roughness, metallic
 
     // GBuffer DSVs
     ID3D11DepthStencilView *m_depthStencilDSV;
     ID3D11DepthStencilView *m_depthStencilReadOnlyDSV;
     // GBuffer RTVs
-    ID3D11RenderTargetView *m_colorSpecIntensityRTV;
+    ID3D11RenderTargetView *m_albedoAORTV;
     ID3D11RenderTargetView *m_normalRTV;
-    ID3D11RenderTargetView *m_specPowerRTV;
 
     // GBuffer SRVs
     ID3D11ShaderResourceView *m_depthStencilSRV;
-    ID3D11ShaderResourceView *m_colorSpecIntensitySRV;
+    ID3D11ShaderResourceView *m_albedoAOSRV;
     ID3D11ShaderResourceView *m_normalSRV;
-    ID3D11ShaderResourceView *m_specPowerSRV;
 
     ID3D11DepthStencilState *m_depthStencilState;
 };
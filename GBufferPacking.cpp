@@ -0,0 +1,178 @@
+#include "GBufferPacking.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iterator>
+
+namespace jRenderer {
+
+namespace {
+
+const uint32_t DEPTH_BYTES = 4;    // D24_UNORM_S8_UINT
+const uint32_t LIGHTING_BYTES = 8; // R16G16B16A16_FLOAT
+
+float SignNotZero(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+} // namespace
+
+// ref: A Survey of Efficient Representations for Independent Unit Vectors
+//      (Cigolle et al., 2014)
+Vector2 GBufferPacking::EncodeOctahedral(Vector3 n) {
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    Vector2 f(n.x, n.y);
+    if (n.z < 0.0f) {
+        f = Vector2((1.0f - std::abs(n.y)) * SignNotZero(n.x),
+                    (1.0f - std::abs(n.x)) * SignNotZero(n.y));
+    }
+    return f * 0.5f + Vector2(0.5f);
+}
+
+Vector3 GBufferPacking::DecodeOctahedral(Vector2 f) {
+    f = f * 2.0f - Vector2(1.0f);
+    Vector3 n(f.x, f.y, 1.0f - std::abs(f.x) - std::abs(f.y));
+    const float t = std::clamp(-n.z, 0.0f, 1.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    n.Normalize();
+    return n;
+}
+
+uint32_t GBufferPacking::ToUnorm(float v, uint32_t bits) {
+    const float maxValue = float((1u << bits) - 1);
+    return uint32_t(std::clamp(v, 0.0f, 1.0f) * maxValue + 0.5f);
+}
+
+float GBufferPacking::FromUnorm(uint32_t v, uint32_t bits) {
+    return float(v) / float((1u << bits) - 1);
+}
+
+uint32_t GBufferPacking::PackNormalMaterial(const Vector3 &normal,
+                                            float roughness, float metallic) {
+    const Vector2 f = EncodeOctahedral(normal);
+    return ToUnorm(f.x, 10) | ToUnorm(f.y, 10) << 10 |
+           ToUnorm(roughness, 10) << 20 | ToUnorm(metallic, 2) << 30;
+}
+
+void GBufferPacking::UnpackNormalMaterial(uint32_t texel, Vector3 &normal,
+                                          float &roughness, float &metallic) {
+    normal = DecodeOctahedral(Vector2(FromUnorm(texel & 0x3ff, 10),
+                                      FromUnorm(texel >> 10 & 0x3ff, 10)));
+    roughness = FromUnorm(texel >> 20 & 0x3ff, 10);
+    metallic = FromUnorm(texel >> 30, 2);
+}
+
+Vector3 GBufferPacking::RoundTrip(NormalEncoding encoding,
+                                  const Vector3 &normal) {
+    auto quantize = [](float v, uint32_t bits) {
+        return FromUnorm(ToUnorm(v, bits), bits);
+    };
+    uint32_t bits = 8;
+    switch (encoding) {
+    case NormalEncoding::Unorm8Xyz: {
+        Vector3 n(quantize(normal.x * 0.5f + 0.5f, 8),
+                  quantize(normal.y * 0.5f + 0.5f, 8),
+                  quantize(normal.z * 0.5f + 0.5f, 8));
+        n = n * 2.0f - Vector3(1.0f);
+        n.Normalize();
+        return n;
+    }
+    case NormalEncoding::Octahedral8:
+        bits = 8;
+        break;
+    case NormalEncoding::Octahedral10:
+        bits = 10;
+        break;
+    case NormalEncoding::Octahedral16:
+        bits = 16;
+        break;
+    }
+    const Vector2 f = EncodeOctahedral(normal);
+    return DecodeOctahedral(Vector2(quantize(f.x, bits), quantize(f.y, bits)));
+}
+
+NormalEncodingError GBufferPacking::MeasureError(NormalEncoding encoding,
+                                                 uint32_t count) {
+    const float toDegrees = 180.0f / DirectX::XM_PI;
+    double sum = 0.0;
+    float maxError = 0.0f;
+    auto measure = [&](const Vector3 &normal) {
+        // atan2 keeps the precision of angles near 0, acos doesn't
+        const Vector3 decoded = RoundTrip(encoding, normal);
+        const float error =
+            std::atan2(normal.Cross(decoded).Length(), normal.Dot(decoded)) *
+            toDegrees;
+        sum += error;
+        maxError = std::max(maxError, error);
+    };
+
+    // Fibonacci sphere
+    const float goldenAngle = DirectX::XM_PI * (3.0f - std::sqrt(5.0f));
+    for (uint32_t i = 0; i < count; i++) {
+        const float z = 1.0f - (2.0f * float(i) + 1.0f) / float(count);
+        const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        const float phi = goldenAngle * float(i);
+        measure(Vector3(r * std::cos(phi), r * std::sin(phi), z));
+    }
+    // The corners and the folded edges of the octahedron
+    const Vector3 axes[] = {{1, 0, 0}, {-1, 0, 0}, {0, 1, 0},
+                            {0, -1, 0}, {0, 0, 1}, {0, 0, -1}};
+    for (const auto &axis : axes)
+        measure(axis);
+
+    NormalEncodingError result;
+    result.meanDegrees = float(sum / double(count + std::size(axes)));
+    result.maxDegrees = maxError;
+    return result;
+}
+
+const std::vector<GBufferLayout> &GBufferPacking::GetLayouts() {
+    static const std::vector<GBufferLayout> layouts = {
+        {"Old", "RGBA8 albedo rough, RGBA8 normal metal, RGBA8 emissive ao",
+         NormalEncoding::Unorm8Xyz, 12, 4, 4, false},
+        {"Octahedral, emissive target",
+         "RGBA8 albedo ao, RGB10A2 normal rough metal:2, RGBA8 emissive",
+         NormalEncoding::Octahedral10, 12, 4, 4, false},
+        {"Octahedral 16",
+         "RGBA8 albedo ao, RG16 normal, RG8 rough metal, emissive lit",
+         NormalEncoding::Octahedral16, 10, 0, 4, true},
+        {"Octahedral 10 (current)",
+         "RGBA8 albedo ao, RGB10A2 normal rough metal:2, emissive lit",
+         NormalEncoding::Octahedral10, 8, 0, 4, true},
+    };
+    return layouts;
+}
+
+GBufferBandwidth GBufferPacking::GetBandwidth(const GBufferLayout &layout) {
+    GBufferBandwidth result;
+    result.storageBytes = layout.targetBytes + DEPTH_BYTES;
+
+    // The emission is written once, by the G-buffer pass or the ambient
+    // pass, then the lights are blended on top.
+    result.writeBytes =
+        layout.targetBytes + DEPTH_BYTES + LIGHTING_BYTES + LIGHTING_BYTES;
+
+    // SSAO: normal and depth, lights: everything but the emission and the
+    // lighting target to blend with
+    result.readBytes =
+        layout.normalBytes + DEPTH_BYTES + layout.targetBytes -
+        layout.emissiveBytes + DEPTH_BYTES + LIGHTING_BYTES;
+    if (!layout.emissionInLighting)
+        result.readBytes += layout.targetBytes + DEPTH_BYTES; // ambient pass
+    return result;
+}
+
+const char *GBufferPacking::GetName(NormalEncoding encoding) {
+    switch (encoding) {
+    case NormalEncoding::Unorm8Xyz:
+        return "XYZ 8:8:8";
+    case NormalEncoding::Octahedral8:
+        return "Octahedral 8:8";
+    case NormalEncoding::Octahedral10:
+        return "Octahedral 10:10";
+    case NormalEncoding::Octahedral16:
+        return "Octahedral 16:16";
+    }
+    return "";
+}
+
+} // namespace jRenderer
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <vector>
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Vector2;
+using DirectX::SimpleMath::Vector3;
+
+// Ways to store the view space normal in the G-buffer
+enum class NormalEncoding {
+    Unorm8Xyz,    // xyz * 0.5 + 0.5, R8G8B8
+    Octahedral8,  // R8G8
+    Octahedral10, // R10G10 of R10G10B10A2, the current layout
+    Octahedral16, // R16G16
+};
+
+struct NormalEncodingError {
+    float meanDegrees = 0.0f;
+    float maxDegrees = 0.0f;
+};
+
+// One G-buffer layout option. All sizes are bytes per pixel.
+struct GBufferLayout {
+    const char *name;
+    const char *targets;
+    NormalEncoding normals;
+    uint32_t targetBytes;    // color targets of the G-buffer pass
+    uint32_t emissiveBytes;  // of targetBytes, the lights don't read them
+    uint32_t normalBytes;    // the target SSAO reads
+    bool emissionInLighting; // no ambient pass, see GBufferPS.hlsl
+};
+
+// Render target traffic per pixel from the G-buffer pass to the end of
+// the deferred lighting, without overdraw and compression.
+struct GBufferBandwidth {
+    uint32_t storageBytes = 0; // G-buffer targets and depth
+    uint32_t writeBytes = 0;
+    uint32_t readBytes = 0;
+
+    uint32_t TotalBytes() const { return writeBytes + readBytes; }
+};
+
+// CPU side of Shaders/GBufferPacking.hlsli, for reading the G-buffer back
+// and for comparing the layouts.
+class GBufferPacking {
+  public:
+    // Unit vector <-> [0, 1]^2, same as the shader
+    static Vector2 EncodeOctahedral(Vector3 n);
+    static Vector3 DecodeOctahedral(Vector2 f);
+
+    // Float -> UNORM like the output merger, rounded to the nearest
+    static uint32_t ToUnorm(float v, uint32_t bits);
+    static float FromUnorm(uint32_t v, uint32_t bits);
+
+    // One texel of the R10G10B10A2_UNORM normal target
+    static uint32_t PackNormalMaterial(const Vector3 &normal, float roughness,
+                                       float metallic);
+    static void UnpackNormalMaterial(uint32_t texel, Vector3 &normal,
+                                     float &roughness, float &metallic);
+
+    // The normal after it was written to and read from the G-buffer
+    static Vector3 RoundTrip(NormalEncoding encoding, const Vector3 &normal);
+
+    // Angle between the normal and RoundTrip() over 'count' directions
+    // spread evenly on the sphere
+    static NormalEncodingError MeasureError(NormalEncoding encoding,
+                                            uint32_t count);
+
+    static const std::vector<GBufferLayout> &GetLayouts();
+    static GBufferBandwidth GetBandwidth(const GBufferLayout &layout);
+    static const char *GetName(NormalEncoding encoding);
+};
+
+} // namespace jRenderer
@@ -1,7 +1,179 @@
 #include "GraphicsCommon.h"
 
+#include "HotReload.h"
+#include "JobSystem.h"
+
 namespace jRenderer {
 
+namespace {
+
+const vector<D3D11_INPUT_ELEMENT_DESC> basicIEs = {
+    {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
+     D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
+     D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0,
+     D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
+     D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"SV_InstanceID", 0, DXGI_FORMAT_R32_UINT, 0,
+     D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
+};
+
+const vector<D3D11_INPUT_ELEMENT_DESC> skyboxIE = {
+    {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
+     D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,
+     D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24,
+     D3D11_INPUT_PER_VERTEX_DATA, 0},
+    {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32,
+     D3D11_INPUT_PER_VERTEX_DATA, 0},
+};
+
+// The material of the draw as an instance stream in slot 1
+vector<D3D11_INPUT_ELEMENT_DESC> GetGBufferTableIEs() {
+    vector<D3D11_INPUT_ELEMENT_DESC> elements = basicIEs;
+    elements.push_back({"MATERIAL", 0, DXGI_FORMAT_R32_UINT, 1, 0,
+                        D3D11_INPUT_PER_INSTANCE_DATA, 1});
+    return elements;
+}
+
+vector<D3D11_INPUT_ELEMENT_DESC> GetShadowCubeInstancedIEs() {
+    vector<D3D11_INPUT_ELEMENT_DESC> elements = skyboxIE;
+    elements.push_back({"FACE", 0, DXGI_FORMAT_R32_UINT, 1, 0,
+                        D3D11_INPUT_PER_INSTANCE_DATA, 1});
+    elements.push_back({"FACE", 1, DXGI_FORMAT_R32_UINT, 1, 4,
+                        D3D11_INPUT_PER_INSTANCE_DATA, 1});
+    return elements;
+}
+
+// Rebuilt from the sources, not the archive that was built before the edit
+void AddShaderReload(
+    HotReload &hotReload, ComPtr<ID3D11Device> &device, const ShaderKey &key,
+    std::function<HRESULT(ID3D11Device *, const ShaderBytecode &,
+                          HotReload::Swap &)>
+        create) {
+    hotReload.Add(
+        ShaderArchive::GetName(key), ShaderCache::FindIncludes(key.filename),
+        [device, key, create](std::string &errors) -> HotReload::Swap {
+            ShaderBytecode bytecode;
+            if (!D3D11Utils::GetShaderCache().GetBytecode(key, bytecode,
+                                                          &errors))
+                return nullptr;
+            HotReload::Swap swap;
+            if (FAILED(create(device.Get(), bytecode, swap))) {
+                errors = "Can't create " + key.filename;
+                return nullptr;
+            }
+            return [swap, device]() mutable {
+                swap();
+                Graphics::InitPipelineStates(device);
+            };
+        },
+        [key] { return ShaderCache::FindIncludes(key.filename); });
+}
+
+void AddVertexShaderReload(HotReload &hotReload,
+                           ComPtr<ID3D11Device> &device,
+                           const wchar_t *filename, const char *entryPoint,
+                           const vector<D3D11_INPUT_ELEMENT_DESC> &elements,
+                           ComPtr<ID3D11VertexShader> &vertexShader,
+                           ComPtr<ID3D11InputLayout> &inputLayout) {
+    AddShaderReload(
+        hotReload, device,
+        D3D11Utils::MakeShaderKey(filename, entryPoint, "vs_5_0"),
+        [elements, &vertexShader, &inputLayout](
+            ID3D11Device *device, const ShaderBytecode &bytecode,
+            HotReload::Swap &swap) {
+            ComPtr<ID3D11VertexShader> shader;
+            ComPtr<ID3D11InputLayout> layout;
+            HRESULT hr = device->CreateVertexShader(
+                bytecode.data, bytecode.size, NULL, &shader);
+            if (SUCCEEDED(hr)) {
+                hr = device->CreateInputLayout(
+                    elements.data(), UINT(elements.size()), bytecode.data,
+                    bytecode.size, &layout);
+            }
+            swap = [&vertexShader, &inputLayout, shader, layout] {
+                vertexShader = shader;
+                inputLayout = layout;
+            };
+            return hr;
+        });
+}
+
+// ID3D11Device::CreatePixelShader() and the others without an input layout
+template <typename T>
+using CreateShaderMethod = HRESULT (STDMETHODCALLTYPE ID3D11Device::*)(
+    const void *, SIZE_T, ID3D11ClassLinkage *, T **);
+
+template <typename T>
+void AddShaderReload(HotReload &hotReload, ComPtr<ID3D11Device> &device,
+                     const wchar_t *filename, const char *entryPoint,
+                     const char *profile, CreateShaderMethod<T> create,
+                     ComPtr<T> &target) {
+    AddShaderReload(
+        hotReload, device,
+        D3D11Utils::MakeShaderKey(filename, entryPoint, profile),
+        [create, &target](ID3D11Device *device, const ShaderBytecode &bytecode,
+                          HotReload::Swap &swap) {
+            ComPtr<T> shader;
+            const HRESULT hr = (device->*create)(bytecode.data, bytecode.size,
+                                                 NULL, &shader);
+            swap = [&target, shader] { target = shader; };
+            return hr;
+        });
+}
+
+// The permutations compiled so far, all of them from the new source.
+// Masks first drawn after the rebuild are compiled by the pass.
+void AddPermutationsReload(HotReload &hotReload, ComPtr<ID3D11Device> &device,
+                           const std::string &name,
+                           PixelShaderPermutations &permutations) {
+    const ShaderKey baseKey = permutations.GetBaseKey();
+    const auto findIncludes = [baseKey] {
+        return ShaderCache::FindIncludes(baseKey.filename);
+    };
+    hotReload.Add(
+        name, findIncludes(),
+        [device, baseKey, &permutations](
+            std::string &errors) -> HotReload::Swap {
+            const vector<uint32_t> masks = permutations.GetCompiled();
+            vector<ComPtr<ID3D11PixelShader>> shaders(masks.size());
+            vector<std::string> shaderErrors(masks.size());
+            JobSystem::ParallelFor(
+                uint32_t(masks.size()), 1, [&](uint32_t begin, uint32_t end) {
+                    for (uint32_t i = begin; i < end; i++) {
+                        ShaderBytecode bytecode;
+                        if (D3D11Utils::GetShaderCache().GetBytecode(
+                                MaterialPermutations::MakeKey(baseKey,
+                                                              masks[i]),
+                                bytecode, &shaderErrors[i])) {
+                            device->CreatePixelShader(bytecode.data,
+                                                      bytecode.size, NULL,
+                                                      &shaders[i]);
+                        }
+                    }
+                });
+            for (size_t i = 0; i < masks.size(); i++) {
+                if (!shaders[i]) {
+                    errors = MaterialPermutations::GetName(masks[i]) + ":\n" +
+                             shaderErrors[i];
+                    return nullptr;
+                }
+            }
+            return [masks, shaders, &permutations] {
+                permutations.Reset();
+                for (size_t i = 0; i < masks.size(); i++)
+                    permutations.Set(masks[i], shaders[i]);
+            };
+        },
+        findIncludes);
+}
+
+} // namespace
+
 namespace Graphics {
 
 // Sampler States
@@ -26,10 +198,13 @@ ComPtr<ID3D11RasterizerState> postProcessingRS;
 ComPtr<ID3D11DepthStencilState> drawDSS;       // Ϲ ׸
 ComPtr<ID3D11DepthStencilState> maskDSS;       // ٽǹۿ ǥ
 ComPtr<ID3D11DepthStencilState> drawMaskedDSS; // ٽ ǥõ 
+ComPtr<ID3D11DepthStencilState> depthAlwaysDSS; //  
 
 // Blend States
 ComPtr<ID3D11BlendState> mirrorBS;
 
+PipelineStateCache stateCache;
+
 // Shaders
 ComPtr<ID3D11VertexShader> basicVS;
 ComPtr<ID3D11VertexShader> instancedVS;
@@ -38,10 +213,12 @@ ComPtr<ID3D11VertexShader> samplingVS;
 ComPtr<ID3D11VertexShader> normalVS;
 ComPtr<ID3D11VertexShader> depthOnlyVS;
 ComPtr<ID3D11VertexShader> shadowCubeMapVS;
+ComPtr<ID3D11VertexShader> shadowCubeInstancedVS; // null: not supported
+ComPtr<ID3D11VertexShader> shadowTileClearVS;
 ComPtr<ID3D11VertexShader> postEffectsVS;
 ComPtr<ID3D11VertexShader> ssaoVS;
 ComPtr<ID3D11VertexShader> ssaoBlurVS;
-ComPtr<ID3D11VertexShader> ambientEmissionVS;
+ComPtr<ID3D11VertexShader> ssaoUpsampleVS;
 
 ComPtr<ID3D11PixelShader> basicPS;
 ComPtr<ID3D11PixelShader> skyboxPS;
@@ -54,13 +231,21 @@ ComPtr<ID3D11PixelShader> shadowCubeMapPS;
 ComPtr<ID3D11PixelShader> postEffectsPS;
 ComPtr<ID3D11PixelShader> ssaoPS;
 ComPtr<ID3D11PixelShader> ssaoBlurPS;
-ComPtr<ID3D11PixelShader> ambientEmissionPS;
+ComPtr<ID3D11PixelShader> ssaoUpsamplePS;
 
 ComPtr<ID3D11GeometryShader> normalGS;
 ComPtr<ID3D11GeometryShader> shadowCubeMapGS;
 
+// Compute Shaders
+ComPtr<ID3D11ComputeShader> ssaoBlurHorizontalCS;
+ComPtr<ID3D11ComputeShader> ssaoBlurVerticalCS;
+
 ComPtr<ID3D11VertexShader> gBufferVS;
 ComPtr<ID3D11PixelShader> gBufferPS;
+PixelShaderPermutations gBufferPermutations;
+ComPtr<ID3D11VertexShader> gBufferTableVS;
+ComPtr<ID3D11PixelShader> gBufferTablePS;
+PixelShaderPermutations gBufferTablePermutations;
 ComPtr<ID3D11PixelShader> deferredLightingPS;
 
 // RenderPass
@@ -74,6 +259,8 @@ ComPtr<ID3D11InputLayout> samplingIL;
 ComPtr<ID3D11InputLayout> skyboxIL;
 ComPtr<ID3D11InputLayout> postProcessingIL;
 ComPtr<ID3D11InputLayout> nullIL;
+ComPtr<ID3D11InputLayout> shadowCubeInstancedIL;
+ComPtr<ID3D11InputLayout> gBufferTableIL;
 
 // Graphics Pipeline States
 GraphicsPSO defaultSolidPSO;
@@ -91,19 +278,23 @@ GraphicsPSO reflectSkyboxWirePSO;
 GraphicsPSO normalsPSO;
 GraphicsPSO depthOnlyPSO;
 GraphicsPSO shadowCubeMapPSO;
+GraphicsPSO shadowCubeInstancedPSO;
+GraphicsPSO shadowTileClearPSO;
 GraphicsPSO deferredLightingPSO;
 GraphicsPSO postEffectsPSO;
 GraphicsPSO postProcessingPSO;
 GraphicsPSO gBufferPSO;
+GraphicsPSO gBufferTablePSO;
 GraphicsPSO renderPassPSO;
 GraphicsPSO ssaoPSO;
 GraphicsPSO ssaoBlurPSO;
-GraphicsPSO ambientEmissionPSO;
+GraphicsPSO ssaoUpsamplePSO;
 
 } // namespace Graphics
 
 void Graphics::InitCommonStates(ComPtr<ID3D11Device> &device) {
 
+    stateCache.Initialize(device);
     InitShaders(device);
     InitSamplers(device);
     InitRasterizerStates(device);
@@ -123,28 +314,28 @@ void Graphics::InitSamplers(ComPtr<ID3D11Device> &device) {
     sampDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
     sampDesc.MinLOD = 0;
     sampDesc.MaxLOD = D3D11_FLOAT32_MAX;
-    device->CreateSamplerState(&sampDesc, linearWrapSS.GetAddressOf());
+    linearWrapSS = stateCache.GetSamplerState(sampDesc);
     sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_CLAMP;
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_CLAMP;
-    device->CreateSamplerState(&sampDesc, linearClampSS.GetAddressOf());
+    linearClampSS = stateCache.GetSamplerState(sampDesc);
 
     sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_BORDER;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
-    device->CreateSamplerState(&sampDesc, linearBorderSS.GetAddressOf());
+    linearBorderSS = stateCache.GetSamplerState(sampDesc);
 
     sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-    device->CreateSamplerState(&sampDesc, pointWrapSS.GetAddressOf());
+    pointWrapSS = stateCache.GetSamplerState(sampDesc);
 
     sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressV = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_WRAP;
     sampDesc.Filter = D3D11_FILTER_ANISOTROPIC;
-    device->CreateSamplerState(&sampDesc, anisotropicWrapSS.GetAddressOf());
+    anisotropicWrapSS = stateCache.GetSamplerState(sampDesc);
 
     // shadowPointSS
     sampDesc.AddressU = D3D11_TEXTURE_ADDRESS_BORDER;
@@ -152,7 +343,7 @@ void Graphics::InitSamplers(ComPtr<ID3D11Device> &device) {
     sampDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
     sampDesc.BorderColor[0] = 1.0f; // ū Z
     sampDesc.Filter = D3D11_FILTER_MIN_MAG_MIP_POINT;
-    device->CreateSamplerState(&sampDesc, shadowPointSS.GetAddressOf());
+    shadowPointSS = stateCache.GetSamplerState(sampDesc);
 
     // shadowCompareSS, ̴ ȿ SamplerComparisonState
     // Filter = "_COMPARISON_" 
@@ -163,7 +354,7 @@ void Graphics::InitSamplers(ComPtr<ID3D11Device> &device) {
     sampDesc.BorderColor[0] = 100.0f; // ū Z
     sampDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
     sampDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
-    device->CreateSamplerState(&sampDesc, shadowCompareSS.GetAddressOf());
+    shadowCompareSS = stateCache.GetSamplerState(sampDesc);
 
     // ÷  "Common.hlsli" ϰ ־ 
     sampleStates.push_back(linearWrapSS.Get());
@@ -185,8 +376,7 @@ void Graphics::InitRasterizerStates(ComPtr<ID3D11Device> &device) {
     rastDesc.FrontCounterClockwise = false;
     rastDesc.DepthClipEnable = true;
     rastDesc.MultisampleEnable = true;
-    ThrowIfFailed(
-        device->CreateRasterizerState(&rastDesc, solidRS.GetAddressOf()));
+    solidRS = stateCache.GetRasterizerState(rastDesc);
 
     //// ſ￡ ݻǸ ﰢ Winding ٲ  CCW ׷
     // rastDesc.FrontCounterClockwise = true;
@@ -194,12 +384,10 @@ void Graphics::InitRasterizerStates(ComPtr<ID3D11Device> &device) {
     //     device->CreateRasterizerState(&rastDesc, solidCCWRS.GetAddressOf()));
 
     rastDesc.FillMode = D3D11_FILL_MODE::D3D11_FILL_WIREFRAME;
-    ThrowIfFailed(
-        device->CreateRasterizerState(&rastDesc, wireCCWRS.GetAddressOf()));
+    wireCCWRS = stateCache.GetRasterizerState(rastDesc);
 
     rastDesc.FrontCounterClockwise = false;
-    ThrowIfFailed(
-        device->CreateRasterizerState(&rastDesc, wireRS.GetAddressOf()));
+    wireRS = stateCache.GetRasterizerState(rastDesc);
 
     ZeroMemory(&rastDesc, sizeof(D3D11_RASTERIZER_DESC));
     rastDesc.FillMode = D3D11_FILL_MODE::D3D11_FILL_SOLID;
@@ -208,16 +396,14 @@ void Graphics::InitRasterizerStates(ComPtr<ID3D11Device> &device) {
     rastDesc.DepthClipEnable = true;
     rastDesc.MultisampleEnable = true;
     rastDesc.DepthBias = 100.0f;
-    ThrowIfFailed(
-        device->CreateRasterizerState(&rastDesc, depthOnlyRS.GetAddressOf()));
+    depthOnlyRS = stateCache.GetRasterizerState(rastDesc);
 
     ZeroMemory(&rastDesc, sizeof(D3D11_RASTERIZER_DESC));
     rastDesc.FillMode = D3D11_FILL_MODE::D3D11_FILL_SOLID;
     rastDesc.CullMode = D3D11_CULL_MODE::D3D11_CULL_NONE;
     rastDesc.FrontCounterClockwise = false;
     rastDesc.DepthClipEnable = false;
-    ThrowIfFailed(device->CreateRasterizerState(
-        &rastDesc, postProcessingRS.GetAddressOf()));
+    postProcessingRS = stateCache.GetRasterizerState(rastDesc);
 }
 
 void Graphics::InitBlendStates(ComPtr<ID3D11Device> &device) {
@@ -244,8 +430,7 @@ void Graphics::InitBlendStates(ComPtr<ID3D11Device> &device) {
     mirrorBlendDesc.RenderTarget[0].RenderTargetWriteMask =
         D3D11_COLOR_WRITE_ENABLE_ALL;
 
-    ThrowIfFailed(
-        device->CreateBlendState(&mirrorBlendDesc, mirrorBS.GetAddressOf()));
+    mirrorBS = stateCache.GetBlendState(mirrorBlendDesc);
 }
 
 void Graphics::InitDepthStencilStates(ComPtr<ID3D11Device> &device) {
@@ -280,8 +465,7 @@ void Graphics::InitDepthStencilStates(ComPtr<ID3D11Device> &device) {
     dsDesc.BackFace.StencilPassOp = D3D11_STENCIL_OP_REPLACE;
     dsDesc.BackFace.StencilFunc = D3D11_COMPARISON_ALWAYS;
 
-    ThrowIfFailed(
-        device->CreateDepthStencilState(&dsDesc, drawDSS.GetAddressOf()));
+    drawDSS = stateCache.GetDepthStencilState(dsDesc);
 
     // Stencil 1 ǥִ DSS
     dsDesc.DepthEnable = true; // ̹ ׷ ü 
@@ -297,8 +481,7 @@ void Graphics::InitDepthStencilStates(ComPtr<ID3D11Device> &device) {
         D3D11_STENCIL_OP_REPLACE; // https://learn.microsoft.com/en-us/windows/win32/api/d3d11/ne-d3d11-d3d11_stencil_op
     dsDesc.FrontFace.StencilFunc = D3D11_COMPARISON_ALWAYS; // ׻ 
 
-    ThrowIfFailed(
-        device->CreateDepthStencilState(&dsDesc, maskDSS.GetAddressOf()));
+    maskDSS = stateCache.GetDepthStencilState(dsDesc);
 
     // Stencil 1 ǥ 쿡"" ׸ DSS
     // DepthBuffer ʱȭ · 
@@ -316,26 +499,144 @@ void Graphics::InitDepthStencilStates(ComPtr<ID3D11Device> &device) {
         D3D11_COMPARISON_EQUAL; // Ⱑ ߿! stencilRef  stencil
                                 // value 쿡 ׸  ֵ.
 
-    ThrowIfFailed(
-        device->CreateDepthStencilState(&dsDesc, drawMaskedDSS.GetAddressOf()));
+    drawMaskedDSS = stateCache.GetDepthStencilState(dsDesc);
+
+    // ̸ ׻  DSS, shadow atlas Ÿ ϳ   
+    ZeroMemory(&dsDesc, sizeof(dsDesc));
+    dsDesc.DepthEnable = true;
+    dsDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ALL;
+    dsDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+    dsDesc.StencilEnable = false;
+    depthAlwaysDSS = stateCache.GetDepthStencilState(dsDesc);
+}
+
+const vector<ShaderKey> &Graphics::GetShaderList() {
+    static const vector<ShaderKey> shaders = [] {
+        struct Shader {
+            const wchar_t *filename;
+            const char *entryPoint;
+            const char *profile;
+        };
+        const Shader list[] = {
+            {L"Shaders/BasicVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/SkyboxVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/DepthOnlyVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/ShadowCubeMapVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/GBufferVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/GBufferTableVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/ShadowCubeMapInstancedVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/ShadowTileClearVS.hlsl", "main", "vs_5_0"},
+            {L"Shaders/PostEffects.hlsl", "VSmain", "vs_5_0"},
+            {L"Shaders/SSAO.hlsl", "VSmain", "vs_5_0"},
+            {L"Shaders/SSAOBlur.hlsl", "VSmain", "vs_5_0"},
+            {L"Shaders/SSAOUpsample.hlsl", "VSmain", "vs_5_0"},
+            {L"Shaders/BasicPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/SkyboxPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/DepthOnlyPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/ShadowCubeMapPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/GBufferPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/GBufferTablePS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/DeferredLightingPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/PostEffects.hlsl", "PSmain", "ps_5_0"},
+            {L"Shaders/SSAO.hlsl", "PSmain", "ps_5_0"},
+            {L"Shaders/SSAOBlur.hlsl", "PSmain", "ps_5_0"},
+            {L"Shaders/SSAOUpsample.hlsl", "PSmain", "ps_5_0"},
+            {L"Shaders/SSAOBlurHorizontalCS.hlsl", "main", "cs_5_0"},
+            {L"Shaders/SSAOBlurVerticalCS.hlsl", "main", "cs_5_0"},
+            {L"Shaders/RenderPass/RenderPassPS.hlsl", "main", "ps_5_0"},
+            {L"Shaders/ShadowCubeMapGS.hlsl", "main", "gs_5_0"},
+        };
+        vector<ShaderKey> keys;
+        for (const auto &shader : list) {
+            keys.push_back(D3D11Utils::MakeShaderKey(
+                shader.filename, shader.entryPoint, shader.profile));
+        }
+        return keys;
+    }();
+    return shaders;
+}
+
+bool Graphics::BuildShaderArchive(const std::string &filename) {
+    // Straight from the sources and the disk cache, not the old archive
+    auto &cache = D3D11Utils::GetShaderCache();
+    cache.SetArchive(nullptr, false);
+    cache.ResetStats();
+
+    vector<ShaderKey> keys = GetShaderList();
+    const ShaderKey gBufferKey =
+        D3D11Utils::MakeShaderKey(L"Shaders/GBufferPS.hlsl", "main", "ps_5_0");
+    const ShaderKey gBufferTableKey = D3D11Utils::MakeShaderKey(
+        L"Shaders/GBufferTablePS.hlsl", "main", "ps_5_0");
+    for (uint32_t features : MaterialPermutations::Load(SHADER_PERMUTATIONS)) {
+        keys.push_back(MaterialPermutations::MakeKey(gBufferKey, features));
+        keys.push_back(
+            MaterialPermutations::MakeKey(gBufferTableKey, features));
+    }
+
+    ShaderBatch batch;
+    for (const auto &key : keys)
+        batch.Add(key);
+    if (!batch.Compile(cache)) {
+        std::cout << batch.GetErrors() << std::endl;
+        return false;
+    }
+
+    ShaderArchiveWriter writer;
+    for (const auto &key : keys) {
+        const auto *bytecode = batch.Find(key);
+        writer.Add(ShaderArchive::GetName(key), cache.ComputeHash(key),
+                   vector<uint8_t>(bytecode->data,
+                                   bytecode->data + bytecode->size));
+    }
+    if (!writer.Write(filename)) {
+        std::cout << "Can't write " << filename << std::endl;
+        return false;
+    }
+
+    const auto stats = cache.GetStats();
+    std::cout << filename << ": " << writer.GetNumShaders() << " shaders, "
+              << stats.misses << " compiled in " << batch.GetWallMs()
+              << " ms" << std::endl;
+    return true;
 }
 
 void Graphics::InitShaders(ComPtr<ID3D11Device> &device) {
 
-    // Shaders, InputLayouts
+    // Release builds trust the archive, debug builds check that its
+    // sources are the ones on disk.
+    auto &archive = D3D11Utils::GetShaderArchive();
+    if (archive.Open(SHADER_ARCHIVE)) {
+#if defined(DEBUG) || defined(_DEBUG)
+        D3D11Utils::GetShaderCache().SetArchive(&archive, true);
+#else
+        D3D11Utils::GetShaderCache().SetArchive(&archive, false);
+#endif
+    } else {
+        D3D11Utils::GetShaderCache().SetArchive(nullptr, false);
+    }
+    D3D11Utils::GetShaderCache().ResetStats();
+
+    // Every blob first, on the job system. The objects below are then
+    // created on this thread, input layouts after their vertex shaders.
+    const auto permutations = MaterialPermutations::Load(SHADER_PERMUTATIONS);
+    const ShaderKey gBufferKey =
+        D3D11Utils::MakeShaderKey(L"Shaders/GBufferPS.hlsl", "main", "ps_5_0");
+    const ShaderKey gBufferTableKey = D3D11Utils::MakeShaderKey(
+        L"Shaders/GBufferTablePS.hlsl", "main", "ps_5_0");
+    auto &batch = D3D11Utils::GetShaderBatch();
+    batch.Clear();
+    for (const auto &key : GetShaderList())
+        batch.Add(key);
+    for (uint32_t features : permutations) {
+        batch.Add(MaterialPermutations::MakeKey(gBufferKey, features));
+        batch.Add(MaterialPermutations::MakeKey(gBufferTableKey, features));
+    }
+    if (!batch.Compile(D3D11Utils::GetShaderCache())) {
+        std::cout << batch.GetErrors() << std::endl;
+        ThrowIfFailed(E_FAIL);
+    }
 
-    vector<D3D11_INPUT_ELEMENT_DESC> basicIEs = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-         D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
-         D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0,
-         D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0,
-         D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"SV_InstanceID", 0, DXGI_FORMAT_R32_UINT, 0,
-         D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0},
-    };
+    // Shaders, InputLayouts
 
     vector<D3D11_INPUT_ELEMENT_DESC> samplingIED = {
         {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
@@ -346,17 +647,6 @@ void Graphics::InitShaders(ComPtr<ID3D11Device> &device) {
          D3D11_INPUT_PER_VERTEX_DATA, 0},
     };
 
-    vector<D3D11_INPUT_ELEMENT_DESC> skyboxIE = {
-        {"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0,
-         D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12,
-         D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TEXCOORD", 0, DXGI_FORMAT_R32G32_FLOAT, 0, 24,
-         D3D11_INPUT_PER_VERTEX_DATA, 0},
-        {"TANGENT", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 32,
-         D3D11_INPUT_PER_VERTEX_DATA, 0},
-    };
-
     D3D11Utils::CreateVertexShaderAndInputLayout(
         device, L"Shaders/BasicVS.hlsl", basicIEs, basicVS, basicIL);
     // D3D11Utils::CreateVertexShaderAndInputLayout(device, L"NormalVS.hlsl",
@@ -373,6 +663,25 @@ void Graphics::InitShaders(ComPtr<ID3D11Device> &device) {
         skyboxIL);
     D3D11Utils::CreateVertexShaderAndInputLayout(
         device, L"Shaders/GBufferVS.hlsl", basicIEs, gBufferVS, basicIL);
+    D3D11Utils::CreateVertexShaderAndInputLayout(
+        device, L"Shaders/GBufferTableVS.hlsl", GetGBufferTableIEs(),
+        gBufferTableVS, gBufferTableIL);
+
+    // Point light shadows without the GS: the viewport index is written by
+    // the vertex shader, an optional feature of D3D11.3.
+    D3D11_FEATURE_DATA_D3D11_OPTIONS3 options3 = {};
+    if (SUCCEEDED(device->CheckFeatureSupport(D3D11_FEATURE_D3D11_OPTIONS3,
+                                              &options3, sizeof(options3))) &&
+        options3.VPAndRTArrayIndexFromAnyShaderFeedingRasterizer) {
+        D3D11Utils::CreateVertexShaderAndInputLayout(
+            device, L"Shaders/ShadowCubeMapInstancedVS.hlsl",
+            GetShadowCubeInstancedIEs(), shadowCubeInstancedVS,
+            shadowCubeInstancedIL);
+    }
+    // SV_VertexID only, no vertex buffer
+    D3D11Utils::CreateVertexShaderAndInputLayout(
+        device, L"Shaders/ShadowTileClearVS.hlsl", {}, shadowTileClearVS,
+        nullIL);
     D3D11Utils::CreateVertexShaderAndInputLayoutSum(
         device, L"Shaders/PostEffects.hlsl", skyboxIE, postEffectsVS, skyboxIL);
     D3D11Utils::CreateVertexShaderAndInputLayoutSum(
@@ -380,7 +689,7 @@ void Graphics::InitShaders(ComPtr<ID3D11Device> &device) {
     D3D11Utils::CreateVertexShaderAndInputLayoutSum(
         device, L"Shaders/SSAOBlur.hlsl", skyboxIE, ssaoBlurVS, skyboxIL);
     D3D11Utils::CreateVertexShaderAndInputLayoutSum(
-        device, L"Shaders/AmbientEmission.hlsl", skyboxIE, ambientEmissionVS,
+        device, L"Shaders/SSAOUpsample.hlsl", skyboxIE, ssaoUpsampleVS,
         skyboxIL);
 
     D3D11Utils::CreatePixelShader(device, L"Shaders/BasicPS.hlsl", basicPS);
@@ -391,15 +700,30 @@ void Graphics::InitShaders(ComPtr<ID3D11Device> &device) {
     D3D11Utils::CreatePixelShader(device, L"Shaders/ShadowCubeMapPS.hlsl",
                                   shadowCubeMapPS);
     D3D11Utils::CreatePixelShader(device, L"Shaders/GBufferPS.hlsl", gBufferPS);
+    D3D11Utils::CreatePixelShader(device, L"Shaders/GBufferTablePS.hlsl",
+                                  gBufferTablePS);
     D3D11Utils::CreatePixelShader(device, L"Shaders/DeferredLightingPS.hlsl",
                                   deferredLightingPS);
+    // Compiled by the G-buffer pass when a mask is first drawn, except the
+    // ones the scene saved
+    gBufferPermutations.Initialize(device, gBufferKey);
+    gBufferTablePermutations.Initialize(device, gBufferTableKey);
+    for (uint32_t features : permutations) {
+        gBufferPermutations.Get(features);
+        gBufferTablePermutations.Get(features);
+    }
     D3D11Utils::CreatePixelShaderSum(device, L"Shaders/PostEffects.hlsl",
                                      postEffectsPS);
     D3D11Utils::CreatePixelShaderSum(device, L"Shaders/SSAO.hlsl", ssaoPS);
     D3D11Utils::CreatePixelShaderSum(device, L"Shaders/SSAOBlur.hlsl",
                                      ssaoBlurPS);
-    D3D11Utils::CreatePixelShaderSum(device, L"Shaders/AmbientEmission.hlsl",
-                                     ambientEmissionPS);
+    D3D11Utils::CreatePixelShaderSum(device, L"Shaders/SSAOUpsample.hlsl",
+                                     ssaoUpsamplePS);
+
+    D3D11Utils::CreateComputeShader(
+        device, L"Shaders/SSAOBlurHorizontalCS.hlsl", ssaoBlurHorizontalCS);
+    D3D11Utils::CreateComputeShader(device, L"Shaders/SSAOBlurVerticalCS.hlsl",
+                                    ssaoBlurVerticalCS);
 
     D3D11Utils::CreatePixelShader(
         device, L"Shaders/RenderPass/RenderPassPS.hlsl", renderPassPS);
@@ -407,10 +731,93 @@ void Graphics::InitShaders(ComPtr<ID3D11Device> &device) {
     // D3D11Utils::CreateGeometryShader(device, L"NormalGS.hlsl", normalGS);
     D3D11Utils::CreateGeometryShader(device, L"Shaders/ShadowCubeMapGS.hlsl",
                                      shadowCubeMapGS);
+
+    const auto stats = D3D11Utils::GetShaderCache().GetStats();
+    std::cout << "Shader cache: " << stats.archiveHits << " from "
+              << SHADER_ARCHIVE << ", " << stats.hits << " hits, "
+              << stats.misses << " compiled in " << stats.compileMs
+              << " ms on " << JobSystem::GetThreadCount() << " threads, "
+              << batch.GetWallMs() << " ms wall, " << stats.savedMs
+              << " ms saved" << std::endl;
+    batch.Clear();
+}
+
+void Graphics::AddShaderReloads(HotReload &hotReload,
+                                ComPtr<ID3D11Device> &device) {
+    // The same shaders and layouts as InitShaders()
+    AddVertexShaderReload(hotReload, device, L"Shaders/BasicVS.hlsl", "main",
+                          basicIEs, basicVS, basicIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/SkyboxVS.hlsl", "main",
+                          skyboxIE, skyboxVS, skyboxIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/DepthOnlyVS.hlsl",
+                          "main", skyboxIE, depthOnlyVS, skyboxIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/ShadowCubeMapVS.hlsl",
+                          "main", skyboxIE, shadowCubeMapVS, skyboxIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/GBufferVS.hlsl",
+                          "main", basicIEs, gBufferVS, basicIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/GBufferTableVS.hlsl",
+                          "main", GetGBufferTableIEs(), gBufferTableVS,
+                          gBufferTableIL);
+    if (shadowCubeInstancedVS) {
+        AddVertexShaderReload(hotReload, device,
+                              L"Shaders/ShadowCubeMapInstancedVS.hlsl",
+                              "main", GetShadowCubeInstancedIEs(),
+                              shadowCubeInstancedVS, shadowCubeInstancedIL);
+    }
+    AddVertexShaderReload(hotReload, device, L"Shaders/ShadowTileClearVS.hlsl",
+                          "main", {}, shadowTileClearVS, nullIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/PostEffects.hlsl",
+                          "VSmain", skyboxIE, postEffectsVS, skyboxIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/SSAO.hlsl", "VSmain",
+                          skyboxIE, ssaoVS, skyboxIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/SSAOBlur.hlsl",
+                          "VSmain", skyboxIE, ssaoBlurVS, skyboxIL);
+    AddVertexShaderReload(hotReload, device, L"Shaders/SSAOUpsample.hlsl",
+                          "VSmain", skyboxIE, ssaoUpsampleVS, skyboxIL);
+
+    const struct {
+        const wchar_t *filename;
+        const char *entryPoint;
+        ComPtr<ID3D11PixelShader> &shader;
+    } pixelShaders[] = {
+        {L"Shaders/BasicPS.hlsl", "main", basicPS},
+        {L"Shaders/SkyboxPS.hlsl", "main", skyboxPS},
+        {L"Shaders/DepthOnlyPS.hlsl", "main", depthOnlyPS},
+        {L"Shaders/ShadowCubeMapPS.hlsl", "main", shadowCubeMapPS},
+        {L"Shaders/GBufferPS.hlsl", "main", gBufferPS},
+        {L"Shaders/GBufferTablePS.hlsl", "main", gBufferTablePS},
+        {L"Shaders/DeferredLightingPS.hlsl", "main", deferredLightingPS},
+        {L"Shaders/PostEffects.hlsl", "PSmain", postEffectsPS},
+        {L"Shaders/SSAO.hlsl", "PSmain", ssaoPS},
+        {L"Shaders/SSAOBlur.hlsl", "PSmain", ssaoBlurPS},
+        {L"Shaders/SSAOUpsample.hlsl", "PSmain", ssaoUpsamplePS},
+        {L"Shaders/RenderPass/RenderPassPS.hlsl", "main", renderPassPS},
+    };
+    for (const auto &ps : pixelShaders) {
+        AddShaderReload(hotReload, device, ps.filename, ps.entryPoint,
+                        "ps_5_0", &ID3D11Device::CreatePixelShader, ps.shader);
+    }
+    AddShaderReload(hotReload, device, L"Shaders/SSAOBlurHorizontalCS.hlsl",
+                    "main", "cs_5_0", &ID3D11Device::CreateComputeShader,
+                    ssaoBlurHorizontalCS);
+    AddShaderReload(hotReload, device, L"Shaders/SSAOBlurVerticalCS.hlsl",
+                    "main", "cs_5_0", &ID3D11Device::CreateComputeShader,
+                    ssaoBlurVerticalCS);
+    AddShaderReload(hotReload, device, L"Shaders/ShadowCubeMapGS.hlsl",
+                    "main", "gs_5_0", &ID3D11Device::CreateGeometryShader,
+                    shadowCubeMapGS);
+
+    AddPermutationsReload(hotReload, device, "GBufferPS permutations",
+                          gBufferPermutations);
+    AddPermutationsReload(hotReload, device, "GBufferTablePS permutations",
+                          gBufferTablePermutations);
 }
 
 void Graphics::InitPipelineStates(ComPtr<ID3D11Device> &device) {
 
+    // Cached pipeline states may hold shaders that were just replaced
+    stateCache.ClearPipelineStates();
+
     // defaultSolidPSO;
     defaultSolidPSO.m_vertexShader = basicVS;
     defaultSolidPSO.m_inputLayout = basicIL;
@@ -499,16 +906,29 @@ void Graphics::InitPipelineStates(ComPtr<ID3D11Device> &device) {
     shadowCubeMapPSO.m_pixelShader = shadowCubeMapPS;
     shadowCubeMapPSO.m_rasterizerState = depthOnlyRS;
 
+    // shadowCubeInstancedPSO: GS  νϽ ť  , depth only
+    shadowCubeInstancedPSO = defaultSolidPSO;
+    shadowCubeInstancedPSO.m_vertexShader = shadowCubeInstancedVS;
+    shadowCubeInstancedPSO.m_inputLayout = shadowCubeInstancedIL;
+    shadowCubeInstancedPSO.m_pixelShader = nullptr;
+    shadowCubeInstancedPSO.m_rasterizerState = depthOnlyRS;
+
+    // shadowTileClearPSO:  3 Ÿ  1.0 ä.
+    shadowTileClearPSO.m_vertexShader = shadowTileClearVS;
+    shadowTileClearPSO.m_inputLayout = nullIL;
+    shadowTileClearPSO.m_rasterizerState = postProcessingRS;
+    shadowTileClearPSO.m_depthStencilState = depthAlwaysDSS;
+
     // GBufferPSO
     gBufferPSO = defaultSolidPSO;
     gBufferPSO.m_vertexShader = gBufferVS;
     gBufferPSO.m_pixelShader = gBufferPS;
 
-    ambientEmissionPSO.m_vertexShader = ambientEmissionVS;
-    ambientEmissionPSO.m_pixelShader = ambientEmissionPS;
-    ambientEmissionPSO.m_inputLayout = skyboxIL;
-    ambientEmissionPSO.m_blendState = nullptr;
-    ambientEmissionPSO.m_rasterizerState = postProcessingRS;
+    // gBufferTablePSO:    ȣ νϽ Ʈ ޴´.
+    gBufferTablePSO = gBufferPSO;
+    gBufferTablePSO.m_vertexShader = gBufferTableVS;
+    gBufferTablePSO.m_inputLayout = gBufferTableIL;
+    gBufferTablePSO.m_pixelShader = gBufferTablePS;
 
     // DeferredLightingPSO
     deferredLightingPSO.m_vertexShader = postEffectsVS;
@@ -533,6 +953,10 @@ void Graphics::InitPipelineStates(ComPtr<ID3D11Device> &device) {
     ssaoBlurPSO.m_vertexShader = ssaoBlurVS;
     ssaoBlurPSO.m_pixelShader = ssaoBlurPS;
 
+    ssaoUpsamplePSO = postEffectsPSO;
+    ssaoUpsamplePSO.m_vertexShader = ssaoUpsampleVS;
+    ssaoUpsamplePSO.m_pixelShader = ssaoUpsamplePS;
+
     // RenderPassPSO
     renderPassPSO = postEffectsPSO;
     renderPassPSO.m_vertexShader = postEffectsVS;
@@ -546,6 +970,7 @@ void Graphics::InitPipelineStates(ComPtr<ID3D11Device> &device) {
 }
 
 void Graphics::ShutdownStates() {
+    stateCache.Shutdown();
     // defaultSolidPSO.m_vertexShader->Release();
     // skyboxSolidPSO.m_vertexShader->Release();
 }
@@ -1,7 +1,11 @@
 #include "GraphicsPSO.h"
+#include "MaterialPermutations.h"
+#include "PipelineStateCache.h"
 
 namespace jRenderer {
 
+class HotReload;
+
 namespace Graphics {
 
 // Samplers
@@ -23,6 +27,7 @@ extern ComPtr<ID3D11RasterizerState> postProcessingRS;
 extern ComPtr<ID3D11DepthStencilState> drawDSS; // Ϲ ׸
 extern ComPtr<ID3D11DepthStencilState> maskDSS; // ٽǹۿ ǥ
 extern ComPtr<ID3D11DepthStencilState> drawMaskedDSS; // ٽ ǥõ 
+extern ComPtr<ID3D11DepthStencilState> depthAlwaysDSS; //  
 
 // Shaders
 extern ComPtr<ID3D11VertexShader> basicVS;
@@ -32,10 +37,12 @@ extern ComPtr<ID3D11VertexShader> samplingVS;
 extern ComPtr<ID3D11VertexShader> normalVS;
 extern ComPtr<ID3D11VertexShader> depthOnlyVS;
 extern ComPtr<ID3D11VertexShader> shadowCubeMapVS;
+extern ComPtr<ID3D11VertexShader> shadowCubeInstancedVS; // null: no support
+extern ComPtr<ID3D11VertexShader> shadowTileClearVS;
 extern ComPtr<ID3D11VertexShader> postEffectsVS;
 extern ComPtr<ID3D11VertexShader> ssaoVS;
 extern ComPtr<ID3D11VertexShader> ssaoBlurVS;
-extern ComPtr<ID3D11VertexShader> ambientEmissionVS;
+extern ComPtr<ID3D11VertexShader> ssaoUpsampleVS;
 
 extern ComPtr<ID3D11PixelShader> basicPS;
 extern ComPtr<ID3D11PixelShader> skyboxPS;
@@ -48,15 +55,25 @@ extern ComPtr<ID3D11PixelShader> shadowCubeMapPS;
 extern ComPtr<ID3D11PixelShader> postEffectsPS;
 extern ComPtr<ID3D11PixelShader> ssaoPS;
 extern ComPtr<ID3D11PixelShader> ssaoBlurPS;
-extern ComPtr<ID3D11PixelShader> ambientEmissionPS;
+extern ComPtr<ID3D11PixelShader> ssaoUpsamplePS;
 
 extern ComPtr<ID3D11GeometryShader> normalGS;
 extern ComPtr<ID3D11GeometryShader> shadowCubeMapGS;
 
+// Compute Shaders
+extern ComPtr<ID3D11ComputeShader> ssaoBlurHorizontalCS;
+extern ComPtr<ID3D11ComputeShader> ssaoBlurVerticalCS;
+
 //Gbuffer
 extern ComPtr<ID3D11VertexShader> gBufferVS;
 extern ComPtr<ID3D11PixelShader> gBufferPS;
 extern ComPtr<ID3D11PixelShader> deferredLightingPS;
+// GBufferPS.hlsl per MaterialFeature mask, gBufferPS reads the flags
+extern PixelShaderPermutations gBufferPermutations;
+// The same with the material index per instance, see MaterialTable.h
+extern ComPtr<ID3D11VertexShader> gBufferTableVS;
+extern ComPtr<ID3D11PixelShader> gBufferTablePS;
+extern PixelShaderPermutations gBufferTablePermutations;
 
 // Render Pass
 extern ComPtr<ID3D11VertexShader> ScreenVS;
@@ -69,10 +86,16 @@ extern ComPtr<ID3D11InputLayout> samplingIL;
 extern ComPtr<ID3D11InputLayout> skyboxIL;
 extern ComPtr<ID3D11InputLayout> postProcessingIL;
 extern ComPtr<ID3D11InputLayout> nullIL;
+extern ComPtr<ID3D11InputLayout> shadowCubeInstancedIL;
+extern ComPtr<ID3D11InputLayout> gBufferTableIL;
 
 // Blend States
 extern ComPtr<ID3D11BlendState> mirrorBS;
 
+// The states above are created through it, passes may ask it for more at
+// runtime by description.
+extern PipelineStateCache stateCache;
+
 // Graphics Pipeline States
 extern GraphicsPSO defaultSolidPSO;
 extern GraphicsPSO defaultWirePSO;
@@ -89,14 +112,17 @@ extern GraphicsPSO reflectSkyboxWirePSO;
 extern GraphicsPSO normalsPSO;
 extern GraphicsPSO depthOnlyPSO;
 extern GraphicsPSO shadowCubeMapPSO;
+extern GraphicsPSO shadowCubeInstancedPSO;
+extern GraphicsPSO shadowTileClearPSO;
 extern GraphicsPSO deferredLightingPSO;
 extern GraphicsPSO postEffectsPSO;
 extern GraphicsPSO postProcessingPSO;
 extern GraphicsPSO gBufferPSO;
+extern GraphicsPSO gBufferTablePSO;
 extern GraphicsPSO renderPassPSO;
 extern GraphicsPSO ssaoPSO;
 extern GraphicsPSO ssaoBlurPSO;
-extern GraphicsPSO ambientEmissionPSO;
+extern GraphicsPSO ssaoUpsamplePSO;
 
 void InitCommonStates(ComPtr<ID3D11Device> &device);
 void ShutdownStates();
@@ -109,6 +135,21 @@ void InitDepthStencilStates(ComPtr<ID3D11Device> &device);
 void InitPipelineStates(ComPtr<ID3D11Device> &device);
 void InitShaders(ComPtr<ID3D11Device> &device);
 
+// Shaders.pak next to the Shaders directory, see BuildShaderArchive()
+constexpr const char *SHADER_ARCHIVE = "Shaders.pak";
+// The material permutations a scene used, see MaterialPermutations::Save()
+constexpr const char *SHADER_PERMUTATIONS = "ShaderPermutations.txt";
+// Every shader InitShaders() creates, with the flags of this build
+const vector<ShaderKey> &GetShaderList();
+// Compiles the shader list and the permutations of SHADER_PERMUTATIONS
+// into one archive, the post build step runs it with --build-shaders.
+// False when a shader doesn't compile.
+bool BuildShaderArchive(const std::string &filename);
+// Every shader of InitShaders() and the G-buffer permutations, rebuilt
+// when their file or an include changes. The swaps set up the pipeline
+// states again.
+void AddShaderReloads(HotReload &hotReload, ComPtr<ID3D11Device> &device);
+
 } // namespace Graphics
 
 } // namespace jRenderer
\ No newline at end of file
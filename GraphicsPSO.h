@@ -12,7 +12,6 @@ namespace jRenderer {
 
 class GraphicsPSO { 
   public:
-    void operator=(const GraphicsPSO &pso);
     void SetBlendFactor(const float blendFactor[4]);
 
   public:
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace jRenderer {
+
+// FNV-1a over raw bytes, for the signatures and cache keys of the shadow
+// cache, the shader caches and the pipeline state cache.
+class SignatureHash {
+  public:
+    void Add(const void *data, size_t size) {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        for (size_t i = 0; i < size; i++) {
+            m_hash ^= bytes[i];
+            m_hash *= 1099511628211ull;
+        }
+    }
+    template <typename T> void Add(const T &value) {
+        Add(&value, sizeof(value));
+    }
+    uint64_t Get() const { return m_hash; }
+
+  private:
+    uint64_t m_hash = 14695981039346656037ull;
+};
+
+} // namespace jRenderer
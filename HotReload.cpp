@@ -0,0 +1,206 @@
+#include "HotReload.h"
+
+#include <algorithm>
+#include <chrono>
+#include <exception>
+#include <filesystem>
+
+#include "JobSystem.h"
+
+namespace jRenderer {
+
+namespace {
+
+// Editors save in several writes, the rebuild waits until they stop.
+constexpr int DEBOUNCE_MS = 100;
+
+std::string NormalizePath(const std::string &path) {
+    return std::filesystem::path(path).lexically_normal().generic_string();
+}
+
+} // namespace
+
+void HotReload::Add(const std::string &name,
+                    const std::vector<std::string> &files, Rebuild rebuild,
+                    FindFiles findFiles) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_resourceIndices.find(name);
+    if (it == m_resourceIndices.end()) {
+        it = m_resourceIndices.emplace(name, uint32_t(m_resources.size()))
+                 .first;
+        Resource resource;
+        resource.name = name;
+        m_resources.push_back(std::move(resource));
+    }
+    auto &resource = m_resources[it->second];
+    resource.rebuild = std::move(rebuild);
+    resource.findFiles = std::move(findFiles);
+    SetFiles(it->second, files);
+    m_stats.resources = uint32_t(m_resources.size());
+}
+
+void HotReload::SetFiles(uint32_t resource,
+                         const std::vector<std::string> &files) {
+    for (const auto &file : m_resources[resource].files) {
+        auto &dependents = m_dependents[file];
+        dependents.erase(
+            std::remove(dependents.begin(), dependents.end(), resource),
+            dependents.end());
+        if (dependents.empty())
+            m_dependents.erase(file);
+    }
+    auto &normalized = m_resources[resource].files;
+    normalized.clear();
+    for (const auto &file : files) {
+        normalized.push_back(NormalizePath(file));
+        auto &dependents = m_dependents[normalized.back()];
+        if (std::find(dependents.begin(), dependents.end(), resource) ==
+            dependents.end())
+            dependents.push_back(resource);
+    }
+    m_stats.files = uint32_t(m_dependents.size());
+}
+
+bool HotReload::Start(const std::vector<std::string> &directories) {
+    Stop();
+    if (!m_watcher.Open(directories))
+        return false;
+    m_thread = std::thread(&HotReload::Run, this);
+    return true;
+}
+
+void HotReload::Stop() {
+    if (!m_thread.joinable())
+        return;
+    m_watcher.Wake();
+    m_thread.join();
+    m_watcher.Close();
+}
+
+void HotReload::Run() {
+    std::vector<std::string> changed;
+    while (m_watcher.Wait(changed, -1)) {
+        if (changed.empty())
+            continue;
+        size_t count;
+        do {
+            count = changed.size();
+            if (!m_watcher.Wait(changed, DEBOUNCE_MS))
+                return;
+        } while (changed.size() != count);
+        RebuildFiles(changed);
+        changed.clear();
+    }
+}
+
+uint32_t HotReload::RebuildFiles(const std::vector<std::string> &files) {
+    std::lock_guard<std::mutex> rebuildLock(m_rebuildMutex);
+
+    // The resources of the change, each once
+    std::vector<uint32_t> indices;
+    std::vector<Resource> resources;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (const auto &file : files) {
+            const auto it = m_dependents.find(NormalizePath(file));
+            if (it == m_dependents.end())
+                continue;
+            for (uint32_t index : it->second) {
+                if (std::find(indices.begin(), indices.end(), index) ==
+                    indices.end())
+                    indices.push_back(index);
+            }
+        }
+        std::sort(indices.begin(), indices.end());
+        for (uint32_t index : indices)
+            resources.push_back(m_resources[index]);
+    }
+    if (resources.empty())
+        return 0;
+
+    // In parallel, like the startup compile. A throw only fails the
+    // resource, the renderer keeps the old one.
+    const auto start = std::chrono::steady_clock::now();
+    std::vector<Swap> swaps(resources.size());
+    std::vector<std::string> errors(resources.size());
+    std::vector<std::vector<std::string>> newFiles(resources.size());
+    JobSystem::ParallelFor(
+        uint32_t(resources.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                try {
+                    swaps[i] = resources[i].rebuild(errors[i]);
+                } catch (const std::exception &e) {
+                    swaps[i] = nullptr;
+                    errors[i] = e.what();
+                }
+                if (swaps[i] && resources[i].findFiles)
+                    newFiles[i] = resources[i].findFiles();
+            }
+        });
+    const double rebuildMs = std::chrono::duration<double, std::milli>(
+                                 std::chrono::steady_clock::now() - start)
+                                 .count();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<Swap> change;
+    m_stats.changes++;
+    m_stats.lastRebuildMs = rebuildMs;
+    m_stats.lastRebuilt.clear();
+    m_stats.lastErrors.clear();
+    for (size_t i = 0; i < resources.size(); i++) {
+        m_stats.lastRebuilt.push_back(resources[i].name);
+        if (!swaps[i]) {
+            m_stats.failed++;
+            m_stats.lastErrors += resources[i].name + ":\n" + errors[i] + "\n";
+            continue;
+        }
+        m_stats.rebuilt++;
+        change.push_back(std::move(swaps[i]));
+        // Unless Add() replaced it meanwhile
+        if (resources[i].findFiles &&
+            m_resources[indices[i]].name == resources[i].name)
+            SetFiles(indices[i], newFiles[i]);
+    }
+    if (!change.empty())
+        m_pending.push_back(std::move(change));
+    return uint32_t(resources.size());
+}
+
+uint32_t HotReload::Apply() {
+    std::vector<std::vector<Swap>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pending.swap(m_pending);
+    }
+    if (pending.empty())
+        return 0;
+
+    const auto start = std::chrono::steady_clock::now();
+    uint32_t swapped = 0;
+    for (auto &change : pending) {
+        for (auto &swap : change) {
+            swap();
+            swapped++;
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.swapped += swapped;
+    m_stats.lastApplyMs = std::chrono::duration<double, std::milli>(
+                              std::chrono::steady_clock::now() - start)
+                              .count();
+    return swapped;
+}
+
+std::vector<std::string>
+HotReload::FindResources(const std::string &file) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::vector<std::string> names;
+    const auto it = m_dependents.find(NormalizePath(file));
+    if (it != m_dependents.end()) {
+        for (uint32_t index : it->second)
+            names.push_back(m_resources[index].name);
+    }
+    return names;
+}
+
+} // namespace jRenderer
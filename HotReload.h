@@ -0,0 +1,106 @@
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "FileWatcher.h"
+
+namespace jRenderer {
+
+struct HotReloadStats {
+    uint32_t resources = 0;
+    uint32_t files = 0;   // that some resource depends on
+    uint32_t changes = 0; // batches of changed files that hit a resource
+    uint32_t rebuilt = 0;
+    uint32_t failed = 0;  // the old resource was kept
+    uint32_t swapped = 0; // by Apply()
+    double lastRebuildMs = 0.0; // wall time of the rebuilds of a change
+    double lastApplyMs = 0.0;
+    std::vector<std::string> lastRebuilt; // names, of the last change
+    std::string lastErrors;
+};
+
+// Rebuilds the resources whose files changed, on a background thread, and
+// swaps them in between frames.
+// A resource names the files it is made of, which gives the dependency
+// graph from a file to the shaders, models and textures built from it.
+// Its rebuild runs on the watcher thread with the device only and returns
+// the swap, the part that touches the renderer. Apply() runs the swaps of
+// a change together, so a frame sees all of the change or none of it.
+class HotReload {
+  public:
+    using Swap = std::function<void()>;
+    // Returns no swap when it failed, with the reason in errors
+    using Rebuild = std::function<Swap(std::string &errors)>;
+    using FindFiles = std::function<std::vector<std::string>()>;
+
+    HotReload() = default;
+    ~HotReload() { Stop(); }
+    HotReload(const HotReload &) = delete;
+    HotReload &operator=(const HotReload &) = delete;
+
+    // Replaces the resource of the same name. findFiles, when given, is
+    // asked for the files again after each rebuild, e.g. for includes.
+    // Any thread, also from a swap.
+    void Add(const std::string &name, const std::vector<std::string> &files,
+             Rebuild rebuild, FindFiles findFiles = nullptr);
+
+    // Watches the directories on a thread of its own. The files of the
+    // resources are relative to the same working directory.
+    bool Start(const std::vector<std::string> &directories);
+    void Stop();
+    bool IsRunning() const { return m_thread.joinable(); }
+
+    // Rebuilds what depends on the files on the calling thread, as if they
+    // had changed. Returns the number of resources rebuilt.
+    uint32_t RebuildFiles(const std::vector<std::string> &files);
+
+    bool HasPending() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return !m_pending.empty();
+    }
+    // Runs the finished swaps, in the order of the changes. Between frames,
+    // on the thread that owns the device context.
+    uint32_t Apply();
+
+    // No rebuild runs while the lock is held, e.g. while the job system is
+    // created again.
+    std::unique_lock<std::mutex> Pause() {
+        return std::unique_lock<std::mutex>(m_rebuildMutex);
+    }
+
+    // The names of the resources that depend on the file
+    std::vector<std::string> FindResources(const std::string &file) const;
+    HotReloadStats GetStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+
+  private:
+    struct Resource {
+        std::string name;
+        std::vector<std::string> files;
+        Rebuild rebuild;
+        FindFiles findFiles;
+    };
+
+    void Run();
+    void SetFiles(uint32_t resource, const std::vector<std::string> &files);
+
+    FileWatcher m_watcher;
+    std::thread m_thread;
+    std::mutex m_rebuildMutex; // held by RebuildFiles()
+
+    mutable std::mutex m_mutex; // everything below
+    std::vector<Resource> m_resources;
+    std::unordered_map<std::string, uint32_t> m_resourceIndices; // by name
+    std::unordered_map<std::string, std::vector<uint32_t>> m_dependents;
+    std::vector<std::vector<Swap>> m_pending; // per change
+    HotReloadStats m_stats;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,304 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace jRenderer {
+
+struct Job {
+    std::function<void()> function;
+    JobCounter *signal = nullptr;
+};
+
+namespace {
+
+// Single owner pushes and pops at the bottom, thieves take from the top.
+// Fixed capacity, Push() fails when full.
+class WorkStealingDeque {
+  public:
+    static constexpr int64_t CAPACITY = 4096; // power of 2
+    static constexpr int64_t MASK = CAPACITY - 1;
+
+    bool Push(Job *job) {
+        const int64_t b = m_bottom.load(std::memory_order_relaxed);
+        const int64_t t = m_top.load(std::memory_order_acquire);
+        if (b - t >= CAPACITY)
+            return false;
+
+        m_buffer[b & MASK].store(job, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Job *Pop() {
+        const int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) { // empty
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        Job *job = m_buffer[b & MASK].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last job, race against thieves.
+            if (!m_top.compare_exchange_strong(t, t + 1,
+                                               std::memory_order_seq_cst,
+                                               std::memory_order_relaxed))
+                job = nullptr;
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return job;
+    }
+
+    Job *Steal() {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        const int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return nullptr;
+
+        Job *job = m_buffer[t & MASK].load(std::memory_order_relaxed);
+        if (!m_top.compare_exchange_strong(t, t + 1,
+                                           std::memory_order_seq_cst,
+                                           std::memory_order_relaxed))
+            return nullptr;
+        return job;
+    }
+
+  private:
+    alignas(64) std::atomic<int64_t> m_top = 0;
+    alignas(64) std::atomic<int64_t> m_bottom = 0;
+    std::atomic<Job *> m_buffer[CAPACITY] = {};
+};
+
+std::vector<std::unique_ptr<WorkStealingDeque>> g_queues; // per thread
+std::vector<std::thread> g_workers;
+std::atomic<bool> g_running = false;
+
+// Jobs submitted from threads without a deque or from a full deque
+std::mutex g_externalMutex;
+std::deque<Job *> g_externalJobs;
+
+// Queued jobs that are not taken yet, idle workers sleep while it is 0
+std::atomic<int> g_pendingJobs = 0;
+std::mutex g_sleepMutex;
+std::condition_variable g_wakeUp;
+
+thread_local int t_threadIndex = -1;
+
+// Finished jobs, Run() takes them before it allocates a new one
+std::mutex g_jobPoolMutex;
+std::vector<Job *> g_freeJobs;
+
+Job *AllocateJob() {
+    {
+        std::lock_guard<std::mutex> lock(g_jobPoolMutex);
+        if (!g_freeJobs.empty()) {
+            Job *job = g_freeJobs.back();
+            g_freeJobs.pop_back();
+            return job;
+        }
+    }
+    return new Job;
+}
+
+void FreeJob(Job *job) {
+    job->function = nullptr; // releases what the function captured
+    job->signal = nullptr;
+    std::lock_guard<std::mutex> lock(g_jobPoolMutex);
+    g_freeJobs.push_back(job);
+}
+
+void Submit(Job *job) {
+    g_pendingJobs.fetch_add(1, std::memory_order_release);
+
+    if (t_threadIndex < 0 || !g_queues[t_threadIndex]->Push(job)) {
+        std::lock_guard<std::mutex> lock(g_externalMutex);
+        g_externalJobs.push_back(job);
+    }
+
+    // Taking the lock orders this against a worker that is about to sleep.
+    { std::lock_guard<std::mutex> lock(g_sleepMutex); }
+    g_wakeUp.notify_one();
+}
+
+Job *TakeJob(int threadIndex) {
+    Job *job = nullptr;
+    const int numQueues = int(g_queues.size());
+
+    if (threadIndex >= 0)
+        job = g_queues[threadIndex]->Pop();
+
+    // Steal, starting from the next thread so thieves spread out
+    for (int i = 1; !job && i <= numQueues; i++) {
+        const int victim = (std::max(threadIndex, 0) + i) % numQueues;
+        if (victim != threadIndex)
+            job = g_queues[victim]->Steal();
+    }
+
+    if (!job) {
+        std::lock_guard<std::mutex> lock(g_externalMutex);
+        if (!g_externalJobs.empty()) {
+            job = g_externalJobs.front();
+            g_externalJobs.pop_front();
+        }
+    }
+
+    if (job)
+        g_pendingJobs.fetch_sub(1, std::memory_order_acq_rel);
+    return job;
+}
+
+} // namespace
+
+void JobSystem::Execute(Job *job) {
+    job->function();
+    if (job->signal)
+        Finish(*job->signal);
+    FreeJob(job);
+}
+
+void JobSystem::Finish(JobCounter &counter) {
+    std::vector<Job *> ready;
+    {
+        std::lock_guard<std::mutex> lock(counter.m_mutex);
+        if (counter.m_value.fetch_sub(1, std::memory_order_acq_rel) == 1)
+            ready.swap(counter.m_waitingJobs);
+    }
+    // The counter may be destroyed from here on.
+    for (auto *job : ready)
+        Submit(job);
+}
+
+void JobSystem::WorkerMain(int threadIndex) {
+    t_threadIndex = threadIndex;
+
+    while (g_running.load(std::memory_order_acquire)) {
+        if (Job *job = TakeJob(threadIndex)) {
+            Execute(job);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(g_sleepMutex);
+        g_wakeUp.wait(lock, [] {
+            return g_pendingJobs.load(std::memory_order_acquire) > 0 ||
+                   !g_running.load(std::memory_order_acquire);
+        });
+    }
+
+    t_threadIndex = -1;
+}
+
+void JobSystem::Initialize(int numWorkers) {
+    Shutdown();
+
+    if (numWorkers < 0)
+        numWorkers = std::max(int(std::thread::hardware_concurrency()) - 1, 0);
+
+    for (int i = 0; i <= numWorkers; i++)
+        g_queues.push_back(std::make_unique<WorkStealingDeque>());
+
+    t_threadIndex = 0;
+    g_running = true;
+    for (int i = 1; i <= numWorkers; i++)
+        g_workers.emplace_back(WorkerMain, i);
+}
+
+void JobSystem::Shutdown() {
+    if (g_queues.empty())
+        return;
+
+    // Drain what is left so no counter waits forever.
+    while (Job *job = TakeJob(t_threadIndex))
+        Execute(job);
+
+    {
+        std::lock_guard<std::mutex> lock(g_sleepMutex);
+        g_running = false;
+    }
+    g_wakeUp.notify_all();
+    for (auto &worker : g_workers)
+        worker.join();
+
+    g_workers.clear();
+    g_queues.clear();
+    t_threadIndex = -1;
+
+    std::lock_guard<std::mutex> lock(g_jobPoolMutex);
+    for (auto *job : g_freeJobs)
+        delete job;
+    g_freeJobs.clear();
+}
+
+void JobSystem::Run(std::function<void()> function, JobCounter *signal,
+                    JobCounter *dependency) {
+    Job *job = AllocateJob();
+    job->function = std::move(function);
+    job->signal = signal;
+    if (signal)
+        signal->m_value.fetch_add(1, std::memory_order_acq_rel);
+
+    // Not initialized: run in place, dependencies are already done.
+    if (g_queues.empty()) {
+        Execute(job);
+        return;
+    }
+
+    if (dependency) {
+        std::lock_guard<std::mutex> lock(dependency->m_mutex);
+        if (!dependency->IsDone()) {
+            dependency->m_waitingJobs.push_back(job);
+            return;
+        }
+    }
+
+    Submit(job);
+}
+
+void JobSystem::Wait(JobCounter &counter) {
+    while (!counter.IsDone()) {
+        if (Job *job = TakeJob(t_threadIndex))
+            Execute(job);
+        else
+            std::this_thread::yield();
+    }
+
+    // Finish() may still hold the lock after the count reached zero.
+    std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+void JobSystem::ParallelFor(uint32_t count, uint32_t grainSize,
+                            FunctionRef<void(uint32_t, uint32_t)> function) {
+    if (count == 0)
+        return;
+
+    grainSize = std::max(grainSize, 1u);
+    const uint32_t numBatches = (count + grainSize - 1) / grainSize;
+    if (numBatches == 1 || g_workers.empty()) {
+        function(0, count);
+        return;
+    }
+
+    JobCounter counter;
+    for (uint32_t i = 1; i < numBatches; i++) {
+        const uint32_t begin = i * grainSize;
+        const uint32_t end = std::min(begin + grainSize, count);
+        Run([&function, begin, end]() { function(begin, end); }, &counter);
+    }
+    function(0, grainSize);
+
+    Wait(counter);
+}
+
+int JobSystem::GetWorkerCount() { return int(g_workers.size()); }
+
+int JobSystem::GetThreadIndex() { return t_threadIndex; }
+
+} // namespace jRenderer
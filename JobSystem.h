@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+#include "FunctionRef.h"
+
+// ref
+// Correct and Efficient Work-Stealing for Weak Memory Models (Le et al.)
+// https://fzn.fr/readings/ppopp13.pdf
+// Parallelizing the Naughty Dog Engine Using Fibers (GDC 2015)
+
+namespace jRenderer {
+
+struct Job;
+
+// Number of unfinished jobs. Jobs that depend on a counter are parked on it
+// and submitted when it drops to zero.
+// Call JobSystem::Wait() on it before it goes out of scope.
+class JobCounter {
+  public:
+    bool IsDone() const { return m_value.load(std::memory_order_acquire) == 0; }
+
+  private:
+    friend class JobSystem;
+
+    std::atomic<int> m_value = 0;
+    std::mutex m_mutex;
+    std::vector<Job *> m_waitingJobs;
+};
+
+// Fixed worker pool. Every thread owns a Chase-Lev deque, idle threads steal
+// from the top of the others. The thread that calls Initialize() is thread
+// 0, workers are 1..N. Other threads may submit and wait too.
+class JobSystem {
+  public:
+    // numWorkers < 0 : hardware threads - 1
+    static void Initialize(int numWorkers = -1);
+    static void Shutdown();
+
+    // signal is incremented now and decremented when the job has finished.
+    // The job does not start before dependency is done.
+    static void Run(std::function<void()> function,
+                    JobCounter *signal = nullptr,
+                    JobCounter *dependency = nullptr);
+
+    // Executes queued jobs until the counter is done.
+    static void Wait(JobCounter &counter);
+
+    // Calls function(begin, end) over [0, count) in batches of grainSize.
+    // The calling thread runs the first batch. Doesn't allocate once the
+    // job pool has grown to the number of batches.
+    static void ParallelFor(uint32_t count, uint32_t grainSize,
+                            FunctionRef<void(uint32_t, uint32_t)> function);
+
+    static int GetWorkerCount();
+    static int GetThreadCount() { return GetWorkerCount() + 1; }
+    static int GetThreadIndex(); // -1 if not a job system thread
+
+  private:
+    static void Execute(Job *job);
+    static void Finish(JobCounter &counter);
+    static void WorkerMain(int threadIndex);
+};
+
+} // namespace jRenderer
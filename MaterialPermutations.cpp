@@ -0,0 +1,113 @@
+#include "MaterialPermutations.h"
+
+#include <fstream>
+
+namespace jRenderer {
+
+uint32_t MaterialPermutations::GetFeatures(uint32_t meshFeatures,
+                                           const MaterialConstants &material) {
+    uint32_t enabled = 0;
+    if (material.useAlbedoMap)
+        enabled |= MATERIAL_ALBEDO_MAP;
+    if (material.useNormalMap)
+        enabled |= MATERIAL_NORMAL_MAP;
+    if (material.useAOMap)
+        enabled |= MATERIAL_AO_MAP;
+    if (material.useMetallicMap)
+        enabled |= MATERIAL_METALLIC_MAP;
+    if (material.useRoughnessMap)
+        enabled |= MATERIAL_ROUGHNESS_MAP;
+    if (material.useEmissiveMap)
+        enabled |= MATERIAL_EMISSIVE_MAP;
+
+    uint32_t features = meshFeatures & enabled;
+    // Without a normal map the flip doesn't change the shader.
+    if (material.invertNormalMapY && (features & MATERIAL_NORMAL_MAP))
+        features |= MATERIAL_INVERT_NORMAL_Y;
+    return features;
+}
+
+std::string MaterialPermutations::GetName(uint32_t features) {
+    const char *names[NUM_MATERIAL_FEATURES] = {
+        "Albedo", "Normal", "AO", "Metallic", "Roughness", "Emissive",
+        "InvertY"};
+    std::string name;
+    for (uint32_t i = 0; i < NUM_MATERIAL_FEATURES; i++) {
+        if (features & (1 << i)) {
+            if (!name.empty())
+                name += "|";
+            name += names[i];
+        }
+    }
+    return name.empty() ? "None" : name;
+}
+
+ShaderKey MaterialPermutations::MakeKey(const ShaderKey &base,
+                                        uint32_t features) {
+    ShaderKey key = base;
+    key.defines.push_back({"MATERIAL_PERMUTATION", std::to_string(features)});
+    return key;
+}
+
+bool MaterialPermutations::Save(const std::string &filename,
+                                const std::vector<uint32_t> &features) {
+    std::ofstream file(filename);
+    for (uint32_t mask : features)
+        file << mask << "\n";
+    return bool(file);
+}
+
+std::vector<uint32_t> MaterialPermutations::Load(const std::string &filename) {
+    std::vector<uint32_t> features;
+    std::ifstream file(filename);
+    uint32_t mask;
+    while (file >> mask) {
+        if (mask < NUM_MATERIAL_PERMUTATIONS)
+            features.push_back(mask);
+    }
+    return features;
+}
+
+void PixelShaderPermutations::Initialize(ComPtr<ID3D11Device> &device,
+                                         const ShaderKey &base) {
+    m_device = device;
+    m_base = base;
+    Reset();
+}
+
+void PixelShaderPermutations::Reset() {
+    for (auto &shader : m_shaders)
+        shader.Reset();
+    for (auto &mask : m_compiledMasks)
+        mask = 0;
+}
+
+void PixelShaderPermutations::Set(uint32_t features,
+                                  ComPtr<ID3D11PixelShader> shader) {
+    m_shaders[features] = shader;
+    m_compiledMasks[features / 64] |= uint64_t(1) << (features % 64);
+}
+
+ID3D11PixelShader *PixelShaderPermutations::Get(uint32_t features) {
+    auto &shader = m_shaders[features];
+    if (!shader) {
+        ShaderBytecode bytecode;
+        D3D11Utils::GetShaderBytecode(
+            MaterialPermutations::MakeKey(m_base, features), bytecode);
+        ThrowIfFailed(m_device->CreatePixelShader(
+            bytecode.data, bytecode.size, NULL, shader.GetAddressOf()));
+        m_compiledMasks[features / 64] |= uint64_t(1) << (features % 64);
+    }
+    return shader.Get();
+}
+
+std::vector<uint32_t> PixelShaderPermutations::GetCompiled() const {
+    std::vector<uint32_t> features;
+    for (uint32_t i = 0; i < NUM_MATERIAL_PERMUTATIONS; i++) {
+        if (m_compiledMasks[i / 64] & (uint64_t(1) << (i % 64)))
+            features.push_back(i);
+    }
+    return features;
+}
+
+} // namespace jRenderer
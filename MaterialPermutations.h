@@ -0,0 +1,91 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ConstantBuffers.h"
+#include "D3D11Utils.h"
+
+namespace jRenderer {
+
+// Bits of a material permutation, same as Shaders/MaterialFeatures.hlsli
+enum MaterialFeature : uint32_t {
+    MATERIAL_ALBEDO_MAP = 1 << 0,
+    MATERIAL_NORMAL_MAP = 1 << 1,
+    MATERIAL_AO_MAP = 1 << 2,
+    MATERIAL_METALLIC_MAP = 1 << 3,
+    MATERIAL_ROUGHNESS_MAP = 1 << 4,
+    MATERIAL_EMISSIVE_MAP = 1 << 5,
+    MATERIAL_INVERT_NORMAL_Y = 1 << 6, // only with MATERIAL_NORMAL_MAP
+};
+
+constexpr uint32_t NUM_MATERIAL_FEATURES = 7;
+constexpr uint32_t NUM_MATERIAL_PERMUTATIONS = 1 << NUM_MATERIAL_FEATURES;
+
+class MaterialPermutations {
+  public:
+    // meshFeatures are the maps the mesh has textures for, Mesh::features.
+    // Of those, the ones the material turns on, so a map without a texture
+    // is never sampled.
+    static uint32_t GetFeatures(uint32_t meshFeatures,
+                                const MaterialConstants &material);
+    // "Albedo|Normal|InvertY", "None" without features
+    static std::string GetName(uint32_t features);
+    // The base shader with MATERIAL_PERMUTATION defined
+    static ShaderKey MakeKey(const ShaderKey &base, uint32_t features);
+
+    // One mask per line, Graphics::BuildShaderArchive() adds the listed
+    // permutations to the archive.
+    static bool Save(const std::string &filename,
+                     const std::vector<uint32_t> &features);
+    static std::vector<uint32_t> Load(const std::string &filename);
+};
+
+// A mesh of a pass, sorted by features so draws with the same
+// permutation are next to each other
+struct MaterialDraw {
+    uint32_t features;
+    uint32_t model; // snapshot model index
+    uint32_t mesh;
+
+    bool operator<(const MaterialDraw &other) const {
+        if (features != other.features)
+            return features < other.features;
+        return model != other.model ? model < other.model
+                                    : mesh < other.mesh;
+    }
+};
+
+// The pixel shaders of one file, compiled per feature mask on first use
+class PixelShaderPermutations {
+  public:
+    void Initialize(ComPtr<ID3D11Device> &device, const ShaderKey &base);
+
+    // Compiles it through the shader cache the first time. Not thread safe,
+    // get the shaders of a pass before its recording jobs start.
+    ID3D11PixelShader *Get(uint32_t features);
+    // Null when it isn't compiled yet
+    ID3D11PixelShader *Find(uint32_t features) const {
+        return m_shaders[features].Get();
+    }
+
+    const ShaderKey &GetBaseKey() const { return m_base; }
+    // The masks compiled so far, in mask order. Any thread, a hot reload
+    // compiles them again from the new source.
+    std::vector<uint32_t> GetCompiled() const;
+
+    // Drops every shader, then sets one. Between frames, like Get().
+    void Reset();
+    void Set(uint32_t features, ComPtr<ID3D11PixelShader> shader);
+
+  private:
+    ComPtr<ID3D11Device> m_device;
+    ShaderKey m_base;
+    ComPtr<ID3D11PixelShader> m_shaders[NUM_MATERIAL_PERMUTATIONS];
+    // Bit f of m_compiledMasks[f / 64] is set when m_shaders[f] is
+    std::atomic<uint64_t> m_compiledMasks[NUM_MATERIAL_PERMUTATIONS / 64] = {};
+};
+
+} // namespace jRenderer
@@ -0,0 +1,105 @@
+#include "MaterialTable.h"
+
+#include <algorithm>
+
+namespace jRenderer {
+
+void MaterialTable::Clear() {
+    m_textureIds.clear();
+    m_textures.clear();
+    m_locations.clear();
+    m_materialIds.clear();
+    m_materialMaps.clear();
+    m_arrays.clear();
+    m_materials.clear();
+    m_isPacked.clear();
+}
+
+uint32_t MaterialTable::AddTexture(const std::string &key,
+                                   const MaterialTextureDesc &desc) {
+    const auto found = m_textureIds.find(key);
+    if (found != m_textureIds.end())
+        return found->second;
+    const uint32_t id = uint32_t(m_textures.size());
+    m_textureIds.emplace(key, id);
+    m_textures.push_back(desc);
+    return id;
+}
+
+uint32_t MaterialTable::AddMaterial(
+    const std::array<uint32_t, NUM_MATERIAL_SLOTS> &textures) {
+    const auto found = m_materialIds.find(textures);
+    if (found != m_materialIds.end())
+        return found->second;
+    const uint32_t id = uint32_t(m_materialMaps.size());
+    m_materialIds.emplace(textures, id);
+    m_materialMaps.push_back(textures);
+    return id;
+}
+
+void MaterialTable::Build(uint32_t maxArrays) {
+    // Textures per desc, in the order they were added
+    std::map<MaterialTextureDesc, std::vector<uint32_t>> groups;
+    for (uint32_t i = 0; i < uint32_t(m_textures.size()); i++)
+        groups[m_textures[i]].push_back(i);
+
+    std::vector<MaterialTextureArray> candidates;
+    for (const auto &group : groups) {
+        const auto &textures = group.second;
+        for (size_t begin = 0; begin < textures.size();
+             begin += MAX_MATERIAL_ARRAY_LAYERS) {
+            const size_t end = std::min(
+                textures.size(), begin + size_t(MAX_MATERIAL_ARRAY_LAYERS));
+            MaterialTextureArray array;
+            array.desc = group.first;
+            array.textures.assign(textures.begin() + begin,
+                                  textures.begin() + end);
+            candidates.push_back(std::move(array));
+        }
+    }
+    // The arrays that save the most binds
+    std::stable_sort(candidates.begin(), candidates.end(),
+                     [](const auto &a, const auto &b) {
+                         return a.textures.size() > b.textures.size();
+                     });
+    if (candidates.size() > maxArrays)
+        candidates.resize(maxArrays);
+    m_arrays = std::move(candidates);
+
+    m_locations.assign(m_textures.size(), MATERIAL_BOUND_MAP);
+    for (uint32_t a = 0; a < uint32_t(m_arrays.size()); a++) {
+        const auto &textures = m_arrays[a].textures;
+        for (uint32_t layer = 0; layer < uint32_t(textures.size()); layer++)
+            m_locations[textures[layer]] = Pack(a, layer);
+    }
+
+    m_materials.resize(m_materialMaps.size());
+    m_isPacked.resize(m_materialMaps.size());
+    for (size_t m = 0; m < m_materialMaps.size(); m++) {
+        MaterialData &material = m_materials[m];
+        material = MaterialData();
+        m_isPacked[m] = 1;
+        for (uint32_t s = 0; s < NUM_MATERIAL_SLOTS; s++) {
+            const uint32_t texture = m_materialMaps[m][s];
+            material.maps[s] = texture == MATERIAL_NO_MAP
+                                   ? MATERIAL_NO_MAP
+                                   : m_locations[texture];
+            if (material.maps[s] == MATERIAL_BOUND_MAP)
+                m_isPacked[m] = 0;
+        }
+    }
+}
+
+MaterialTableStats MaterialTable::GetStats() const {
+    MaterialTableStats stats;
+    stats.textures = uint32_t(m_textures.size());
+    stats.materials = uint32_t(m_materialMaps.size());
+    stats.arrays = uint32_t(m_arrays.size());
+    stats.unpackedTextures = uint32_t(std::count(
+        m_locations.begin(), m_locations.end(), MATERIAL_BOUND_MAP));
+    stats.boundMaterials = uint32_t(
+        std::count(m_isPacked.begin(), m_isPacked.end(), uint8_t(0)));
+    return stats;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace jRenderer {
+
+// The maps of a material, in the order of t0 to t4 of GBufferPS.hlsl
+enum MaterialSlot : uint32_t {
+    MATERIAL_SLOT_ALBEDO,
+    MATERIAL_SLOT_NORMAL,
+    MATERIAL_SLOT_AO,
+    MATERIAL_SLOT_METALLIC_ROUGHNESS,
+    MATERIAL_SLOT_EMISSIVE,
+    NUM_MATERIAL_SLOTS
+};
+
+// Same as Shaders/MaterialTable.hlsli
+constexpr uint32_t MAX_MATERIAL_ARRAYS = 8;
+constexpr uint32_t MAX_MATERIAL_ARRAY_LAYERS = 2048; // D3D11 limit
+// MaterialData::maps besides array << 16 | layer
+constexpr uint32_t MATERIAL_NO_MAP = 0xffffffff;    // never sampled
+constexpr uint32_t MATERIAL_BOUND_MAP = 0xfffffffe; // at t0 to t4 per draw
+
+// Textures share an array when all of it matches
+struct MaterialTextureDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t mipLevels = 0;
+    uint32_t format = 0; // DXGI_FORMAT
+
+    bool operator<(const MaterialTextureDesc &other) const {
+        if (width != other.width)
+            return width < other.width;
+        if (height != other.height)
+            return height < other.height;
+        if (mipLevels != other.mipLevels)
+            return mipLevels < other.mipLevels;
+        return format < other.format;
+    }
+};
+
+// An element of the materials StructuredBuffer
+struct MaterialData {
+    uint32_t maps[NUM_MATERIAL_SLOTS];
+    uint32_t padding[3];
+};
+static_assert(sizeof(MaterialData) == 32, "Same as MaterialTable.hlsli");
+
+// One Texture2DArray, the textures of Add() per layer
+struct MaterialTextureArray {
+    MaterialTextureDesc desc;
+    std::vector<uint32_t> textures;
+};
+
+struct MaterialTableStats {
+    uint32_t textures = 0; // unique ones
+    uint32_t materials = 0;
+    uint32_t arrays = 0;
+    uint32_t unpackedTextures = 0;  // past MAX_MATERIAL_ARRAYS
+    uint32_t boundMaterials = 0;    // with a map bound per draw
+};
+
+// Groups the textures of the meshes into Texture2DArrays by size, mips and
+// format, and gives each mesh the index of its material, the array and
+// layer of each of its maps. A draw then only needs that index instead of
+// binding its maps. No D3D here, the renderer copies the textures into the
+// arrays as laid out by Build().
+class MaterialTable {
+  public:
+    void Clear();
+
+    // The id of the texture with this key, e.g. its file. Added with desc
+    // the first time, so meshes that read the same file share a layer.
+    uint32_t AddTexture(const std::string &key,
+                        const MaterialTextureDesc &desc);
+    // Per slot an AddTexture() id or MATERIAL_NO_MAP. Returns the index of
+    // the material, meshes with the same maps share one.
+    uint32_t AddMaterial(
+        const std::array<uint32_t, NUM_MATERIAL_SLOTS> &textures);
+
+    // Packs the textures into at most maxArrays arrays, the largest groups
+    // first. The rest stay bound per draw.
+    void Build(uint32_t maxArrays = MAX_MATERIAL_ARRAYS);
+
+    // After Build()
+    const std::vector<MaterialTextureArray> &GetArrays() const {
+        return m_arrays;
+    }
+    const std::vector<MaterialData> &GetMaterials() const {
+        return m_materials;
+    }
+    // False when a map of the material is MATERIAL_BOUND_MAP
+    bool IsPacked(uint32_t material) const {
+        return m_isPacked[material] != 0;
+    }
+    MaterialTableStats GetStats() const;
+
+    static uint32_t Pack(uint32_t array, uint32_t layer) {
+        return array << 16 | layer;
+    }
+
+  private:
+    std::unordered_map<std::string, uint32_t> m_textureIds;
+    std::vector<MaterialTextureDesc> m_textures;
+    std::vector<uint32_t> m_locations; // per texture, Pack() or BOUND
+    std::map<std::array<uint32_t, NUM_MATERIAL_SLOTS>, uint32_t>
+        m_materialIds;
+    std::vector<std::array<uint32_t, NUM_MATERIAL_SLOTS>> m_materialMaps;
+
+    std::vector<MaterialTextureArray> m_arrays;
+    std::vector<MaterialData> m_materials;
+    std::vector<uint8_t> m_isPacked;
+};
+
+} // namespace jRenderer
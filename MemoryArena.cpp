@@ -0,0 +1,246 @@
+#include "MemoryArena.h"
+
+#include <algorithm>
+
+namespace jRenderer {
+
+namespace {
+
+constexpr size_t SCRATCH_CAPACITY = 4 * 1024 * 1024;
+
+struct AllocatorList {
+    std::mutex mutex;
+    std::vector<const MemoryAllocator *> allocators;
+};
+
+// Constructed by the first allocator, so it outlives the static pools
+AllocatorList &GetAllocatorList() {
+    static AllocatorList list;
+    return list;
+}
+
+void UpdatePeak(std::atomic<uint64_t> &peak, uint64_t value) {
+    uint64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current &&
+           !peak.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed))
+        ;
+}
+
+} // namespace
+
+std::atomic<bool> MemoryAllocator::s_isTracking = false;
+
+MemoryAllocator::MemoryAllocator(const char *name) : m_name(name) {
+    auto &list = GetAllocatorList();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    list.allocators.push_back(this);
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    auto &list = GetAllocatorList();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    list.allocators.erase(std::find(list.allocators.begin(),
+                                    list.allocators.end(), this));
+}
+
+MemoryStats MemoryAllocator::GetStats() const {
+    MemoryStats stats;
+    stats.name = m_name;
+    stats.capacity = m_capacity.load(std::memory_order_relaxed);
+    stats.usedBytes = m_usedBytes.load(std::memory_order_relaxed);
+    stats.peakBytes = m_peakBytes.load(std::memory_order_relaxed);
+    stats.allocations = m_allocations.load(std::memory_order_relaxed);
+    stats.heapAllocations =
+        m_heapAllocations.load(std::memory_order_relaxed);
+    return stats;
+}
+
+std::vector<MemoryTagStats> MemoryAllocator::GetTagStats() const {
+    std::lock_guard<std::mutex> lock(m_tagMutex);
+    return m_tags;
+}
+
+void MemoryAllocator::SetTracking(bool isTracking) {
+    s_isTracking.store(isTracking, std::memory_order_relaxed);
+}
+
+void MemoryAllocator::ForEach(
+    FunctionRef<void(const MemoryAllocator &)> visit) {
+    auto &list = GetAllocatorList();
+    std::lock_guard<std::mutex> lock(list.mutex);
+    for (const MemoryAllocator *allocator : list.allocators)
+        visit(*allocator);
+}
+
+void MemoryAllocator::CountAllocation(const char *tag, uint64_t bytes) {
+    const uint64_t used =
+        m_usedBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    UpdatePeak(m_peakBytes, used);
+    m_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (!IsTracking())
+        return;
+
+    std::lock_guard<std::mutex> lock(m_tagMutex);
+    if (!tag)
+        tag = m_name;
+    auto found = std::find_if(m_tags.begin(), m_tags.end(),
+                              [&](const auto &t) { return t.tag == tag; });
+    if (found == m_tags.end()) {
+        m_tags.push_back(MemoryTagStats());
+        found = m_tags.end() - 1;
+        found->tag = tag;
+    }
+    found->usedBytes += bytes;
+    found->peakBytes = std::max(found->peakBytes, found->usedBytes);
+    found->allocations++;
+}
+
+void MemoryAllocator::CountFree(const char *tag, uint64_t bytes) {
+    m_usedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+    if (!IsTracking())
+        return;
+    std::lock_guard<std::mutex> lock(m_tagMutex);
+    if (!tag)
+        tag = m_name;
+    // Missing when tracking was turned on after the allocation
+    for (auto &t : m_tags)
+        if (t.tag == tag)
+            t.usedBytes -= std::min(t.usedBytes, bytes);
+}
+
+void MemoryAllocator::CountRewind(uint64_t bytes) {
+    m_usedBytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryAllocator::CountHeapAllocation(uint64_t bytes) {
+    m_capacity.fetch_add(bytes, std::memory_order_relaxed);
+    m_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void MemoryAllocator::CountHeapFree(uint64_t bytes) {
+    m_capacity.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void MemoryAllocator::CountReset() {
+    m_usedBytes.store(0, std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(m_tagMutex);
+    for (auto &t : m_tags)
+        t.usedBytes = 0;
+}
+
+LinearArena::LinearArena(const char *name, size_t capacity)
+    : MemoryAllocator(name) {
+    AddBlock(capacity);
+}
+
+void LinearArena::AddBlock(size_t size) {
+    Block block;
+    block.memory = std::make_unique<uint8_t[]>(size);
+    block.size = size;
+    m_blocks.push_back(std::move(block));
+    CountHeapAllocation(size);
+}
+
+void *LinearArena::Allocate(size_t size, size_t alignment, const char *tag) {
+    while (true) {
+        const Block &block = m_blocks[m_block];
+        const uintptr_t base = uintptr_t(block.memory.get());
+        const uintptr_t aligned =
+            (base + m_offset + alignment - 1) & ~uintptr_t(alignment - 1);
+        const size_t end = size_t(aligned - base) + size;
+        if (end <= block.size) {
+            m_allocatedBytes += end - m_offset;
+            CountAllocation(tag, end - m_offset);
+            m_offset = end;
+            return reinterpret_cast<void *>(aligned);
+        }
+        // Blocks past the current one are left from before a Rewind()
+        if (m_block + 1 == m_blocks.size())
+            AddBlock(std::max(size + alignment, m_blocks.back().size));
+        m_block++;
+        m_offset = 0;
+    }
+}
+
+void LinearArena::Rewind(const Marker &marker) {
+    m_block = marker.block;
+    m_offset = marker.offset;
+    if (marker.usedBytes > 0) {
+        CountRewind(m_allocatedBytes - marker.usedBytes);
+        m_allocatedBytes = marker.usedBytes;
+        return;
+    }
+
+    CountReset();
+    m_allocatedBytes = 0;
+    m_block = 0;
+    m_offset = 0;
+    // Empty, so the blocks can be merged to fit all of it next time
+    if (m_blocks.size() > 1) {
+        size_t capacity = 0;
+        for (const Block &block : m_blocks) {
+            capacity += block.size;
+            CountHeapFree(block.size);
+        }
+        m_blocks.clear();
+        AddBlock(capacity);
+    }
+}
+
+LinearArena &GetScratchArena() {
+    thread_local LinearArena arena("Scratch", SCRATCH_CAPACITY);
+    return arena;
+}
+
+BlockPool::BlockPool(const char *name, size_t blockSize, size_t alignment,
+                     size_t blocksPerChunk)
+    : MemoryAllocator(name),
+      m_blockSize((std::max(blockSize, sizeof(FreeBlock)) + alignment - 1) /
+                  alignment * alignment),
+      m_alignment(alignment), m_blocksPerChunk(blocksPerChunk) {}
+
+BlockPool::~BlockPool() {
+    for (void *chunk : m_chunks)
+        ::operator delete(chunk, std::align_val_t(m_alignment));
+}
+
+void BlockPool::AddChunk() {
+    // Aligned for types like the constant buffers of Model
+    uint8_t *chunk = static_cast<uint8_t *>(::operator new(
+        m_blockSize * m_blocksPerChunk, std::align_val_t(m_alignment)));
+    m_chunks.push_back(chunk);
+    CountHeapAllocation(m_blockSize * m_blocksPerChunk);
+    // Linked back to front, so blocks are handed out in address order
+    for (size_t i = m_blocksPerChunk; i-- > 0;) {
+        FreeBlock *block = reinterpret_cast<FreeBlock *>(chunk + i *
+                                                         m_blockSize);
+        block->next = m_freeBlocks;
+        m_freeBlocks = block;
+    }
+}
+
+void *BlockPool::Allocate(const char *tag) {
+    FreeBlock *block;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_freeBlocks)
+            AddChunk();
+        block = m_freeBlocks;
+        m_freeBlocks = block->next;
+    }
+    CountAllocation(tag, m_blockSize);
+    return block;
+}
+
+void BlockPool::Free(void *block, const char *tag) {
+    if (!block)
+        return;
+    CountFree(tag, m_blockSize);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    FreeBlock *freeBlock = static_cast<FreeBlock *>(block);
+    freeBlock->next = m_freeBlocks;
+    m_freeBlocks = freeBlock;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,223 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "FunctionRef.h"
+
+namespace jRenderer {
+
+struct MemoryStats {
+    const char *name = "";
+    uint64_t capacity = 0;        // bytes taken from the heap
+    uint64_t usedBytes = 0;       // handed out now
+    uint64_t peakBytes = 0;       // since the start
+    uint64_t allocations = 0;     // since the start
+    uint64_t heapAllocations = 0; // new blocks or chunks, 0 once warm
+};
+
+// Bytes per tag, only counted while tracking is on
+struct MemoryTagStats {
+    const char *tag = nullptr;
+    uint64_t usedBytes = 0;
+    uint64_t peakBytes = 0;
+    uint64_t allocations = 0;
+};
+
+// Base of the allocators below, counts their usage. All allocators alive
+// are listed for the GUI. Tags are compared by pointer, pass literals.
+class MemoryAllocator {
+  public:
+    explicit MemoryAllocator(const char *name);
+    virtual ~MemoryAllocator();
+    MemoryAllocator(const MemoryAllocator &) = delete;
+    MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+    const char *GetName() const { return m_name; }
+    MemoryStats GetStats() const;
+    std::vector<MemoryTagStats> GetTagStats() const;
+
+    // Off by default, counting per tag takes a lock per allocation.
+    static void SetTracking(bool isTracking);
+    static bool IsTracking() {
+        return s_isTracking.load(std::memory_order_relaxed);
+    }
+    static void ForEach(FunctionRef<void(const MemoryAllocator &)> visit);
+
+  protected:
+    void CountAllocation(const char *tag, uint64_t bytes);
+    void CountFree(const char *tag, uint64_t bytes);
+    // Freed without tags, they stay counted until CountReset()
+    void CountRewind(uint64_t bytes);
+    void CountHeapAllocation(uint64_t bytes);
+    void CountHeapFree(uint64_t bytes);
+    // Everything handed out was freed at once
+    void CountReset();
+
+  private:
+    const char *m_name;
+    std::atomic<uint64_t> m_capacity = 0;
+    std::atomic<uint64_t> m_usedBytes = 0;
+    std::atomic<uint64_t> m_peakBytes = 0;
+    std::atomic<uint64_t> m_allocations = 0;
+    std::atomic<uint64_t> m_heapAllocations = 0;
+
+    mutable std::mutex m_tagMutex;
+    std::vector<MemoryTagStats> m_tags;
+
+    static std::atomic<bool> s_isTracking;
+};
+
+// Bump allocator, Reset() frees everything at once. No destructors run, so
+// only trivially destructible data goes in. When the block is full, more
+// blocks come from the heap and are merged into one at the next Reset(),
+// so a warm arena doesn't allocate. Single threaded.
+class LinearArena : public MemoryAllocator {
+  public:
+    // Rewind() frees what was allocated after GetMarker()
+    struct Marker {
+        size_t block = 0;
+        size_t offset = 0;
+        size_t usedBytes = 0;
+    };
+
+    LinearArena(const char *name, size_t capacity);
+
+    void *Allocate(size_t size, size_t alignment = alignof(std::max_align_t),
+                   const char *tag = nullptr);
+    // Default initialized, i.e. left as is for plain data
+    template <typename T>
+    T *AllocateArray(size_t count, const char *tag = nullptr) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "Reset() doesn't run destructors");
+        T *data = static_cast<T *>(Allocate(sizeof(T) * count, alignof(T),
+                                            tag));
+        std::uninitialized_default_construct_n(data, count);
+        return data;
+    }
+
+    void Reset() { Rewind(Marker()); }
+    Marker GetMarker() const { return {m_block, m_offset, m_allocatedBytes}; }
+    void Rewind(const Marker &marker);
+
+  private:
+    struct Block {
+        std::unique_ptr<uint8_t[]> memory;
+        size_t size = 0;
+    };
+    void AddBlock(size_t size);
+
+    std::vector<Block> m_blocks;
+    size_t m_block = 0;
+    size_t m_offset = 0;
+    size_t m_allocatedBytes = 0;
+};
+
+// The arena of the calling thread, for temporary data of the loaders and
+// jobs. Take a ScratchScope around its use.
+LinearArena &GetScratchArena();
+
+// Frees what was allocated from the scratch arena in the scope when it ends
+class ScratchScope {
+  public:
+    ScratchScope()
+        : m_arena(GetScratchArena()), m_marker(m_arena.GetMarker()) {}
+    ~ScratchScope() { m_arena.Rewind(m_marker); }
+    ScratchScope(const ScratchScope &) = delete;
+    ScratchScope &operator=(const ScratchScope &) = delete;
+
+    template <typename T>
+    T *AllocateArray(size_t count, const char *tag = nullptr) {
+        return m_arena.AllocateArray<T>(count, tag);
+    }
+
+  private:
+    LinearArena &m_arena;
+    LinearArena::Marker m_marker;
+};
+
+// Blocks of one size, carved from chunks and reused through a free list.
+// Chunks are only returned to the heap with the pool. Thread safe.
+class BlockPool : public MemoryAllocator {
+  public:
+    BlockPool(const char *name, size_t blockSize, size_t alignment,
+              size_t blocksPerChunk);
+    ~BlockPool();
+
+    void *Allocate(const char *tag = nullptr);
+    void Free(void *block, const char *tag = nullptr);
+
+  private:
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+    void AddChunk();
+
+    const size_t m_blockSize;
+    const size_t m_alignment;
+    const size_t m_blocksPerChunk;
+    std::mutex m_mutex;
+    FreeBlock *m_freeBlocks = nullptr;
+    std::vector<void *> m_chunks;
+};
+
+// Standard allocator over a BlockPool per allocated type, e.g. for
+// std::allocate_shared, which puts the object and its reference counts in
+// one block. The pool is named after the first allocator that uses it.
+template <typename T> class PoolAllocator {
+  public:
+    using value_type = T;
+
+    static constexpr size_t BLOCKS_PER_CHUNK = 64;
+
+    explicit PoolAllocator(const char *name) : m_name(name) {}
+    template <typename U>
+    PoolAllocator(const PoolAllocator<U> &other) : m_name(other.GetName()) {}
+
+    T *allocate(size_t count) {
+        if (count != 1)
+            return static_cast<T *>(::operator new(
+                sizeof(T) * count, std::align_val_t(alignof(T))));
+        return static_cast<T *>(GetPool().Allocate(m_name));
+    }
+    void deallocate(T *data, size_t count) {
+        if (count != 1)
+            ::operator delete(data, std::align_val_t(alignof(T)));
+        else
+            GetPool().Free(data, m_name);
+    }
+
+    const char *GetName() const { return m_name; }
+
+    template <typename U> bool operator==(const PoolAllocator<U> &) const {
+        return true;
+    }
+    template <typename U> bool operator!=(const PoolAllocator<U> &) const {
+        return false;
+    }
+
+  private:
+    BlockPool &GetPool() const {
+        static BlockPool pool(m_name, sizeof(T), alignof(T),
+                              BLOCKS_PER_CHUNK);
+        return pool;
+    }
+
+    const char *m_name;
+};
+
+// std::make_shared from the pool of T
+template <typename T, typename... Args>
+std::shared_ptr<T> MakePooled(const char *name, Args &&...args) {
+    return std::allocate_shared<T>(PoolAllocator<T>(name),
+                                   std::forward<Args>(args)...);
+}
+
+} // namespace jRenderer
@@ -8,6 +8,8 @@
 #include <windows.h>
 #include <wrl/client.h> // ComPtr
 
+#include "Meshlet.h"
+
 namespace jRenderer { 
 
 using Microsoft::WRL::ComPtr;
@@ -36,11 +38,18 @@ struct Mesh {
     ComPtr<ID3D11ShaderResourceView> heightSRV;
     ComPtr<ID3D11ShaderResourceView> aoSRV;
     ComPtr<ID3D11ShaderResourceView> metallicRoughnessSRV;
+    uint32_t features = 0; // MaterialFeature bits of the maps it has
+    uint32_t material = 0; // in Engine's MaterialTable, when it was built
 
     UINT indexCount = 0; // Number of indiecs = 3 * number of triangles
     UINT vertexCount = 0;
     UINT strides = 0;
     UINT offsets = 0;
+
+    // Cluster culling
+    std::vector<Meshlet> meshlets;
+    std::vector<IndexRange> drawRanges; // Updated by cluster culling per frame
+    bool useDrawRanges = false;
 };
 
 }
\ No newline at end of file
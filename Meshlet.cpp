@@ -0,0 +1,211 @@
+#include "Meshlet.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace jRenderer {
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+void MeshletBuilder::Build(const MeshData &meshData,
+                           std::vector<Meshlet> &meshlets,
+                           uint32_t maxVertices, uint32_t maxTriangles) {
+    meshlets.clear();
+
+    const std::vector<uint32_t> &indices = meshData.indices;
+    const size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // Greedy clustering in index buffer order.
+    // Index buffers from the loader are already roughly locality-ordered, so
+    // this keeps neighbouring triangles together without an adjacency pass.
+    // The stamp array marks which vertices belong to the current meshlet.
+    std::vector<uint32_t> stamp(meshData.vertices.size(), UINT32_MAX);
+    uint32_t meshletIndex = 0;
+
+    Meshlet current;
+    for (size_t t = 0; t < triangleCount; t++) {
+        const uint32_t *tri = &indices[t * 3];
+
+        uint32_t newVertices = 0;
+        for (int k = 0; k < 3; k++) {
+            if (stamp[tri[k]] != meshletIndex)
+                newVertices++;
+        }
+
+        const uint32_t triangles = current.indexCount / 3;
+        if (current.vertexCount + newVertices > maxVertices ||
+            triangles + 1 > maxTriangles) {
+            meshlets.push_back(current);
+            meshletIndex++;
+
+            current = Meshlet();
+            current.indexOffset = uint32_t(t * 3);
+            newVertices = 3;
+            if (tri[0] == tri[1] || tri[0] == tri[2])
+                newVertices--;
+            if (tri[1] == tri[2])
+                newVertices--;
+        }
+
+        for (int k = 0; k < 3; k++)
+            stamp[tri[k]] = meshletIndex;
+
+        current.vertexCount += newVertices;
+        current.indexCount += 3;
+    }
+    meshlets.push_back(current);
+
+    // Triangles were consumed in order, so only the bounds remain.
+    for (auto &m : meshlets)
+        ComputeBounds(meshData, m);
+}
+
+void MeshletBuilder::ComputeBounds(const MeshData &meshData,
+                                   Meshlet &meshlet) {
+    const std::vector<uint32_t> &indices = meshData.indices;
+    const std::vector<Vertex> &vertices = meshData.vertices;
+    const uint32_t begin = meshlet.indexOffset;
+    const uint32_t end = meshlet.indexOffset + meshlet.indexCount;
+
+    // Bounding sphere: AABB center, then the farthest vertex
+    Vector3 vmin(FLT_MAX), vmax(-FLT_MAX);
+    for (uint32_t i = begin; i < end; i++) {
+        vmin = Vector3::Min(vmin, vertices[indices[i]].position);
+        vmax = Vector3::Max(vmax, vertices[indices[i]].position);
+    }
+    meshlet.center = (vmin + vmax) * 0.5f;
+    meshlet.radius = 0.0f;
+    for (uint32_t i = begin; i < end; i++) {
+        meshlet.radius =
+            std::max(meshlet.radius,
+                     Vector3::Distance(meshlet.center,
+                                       vertices[indices[i]].position));
+    }
+
+    // Normal cone: average face normal, then the widest deviation from it
+    std::vector<Vector3> normals;
+    normals.reserve(meshlet.indexCount / 3);
+    Vector3 axis(0.0f);
+    for (uint32_t i = begin; i < end; i += 3) {
+        const Vector3 &p0 = vertices[indices[i]].position;
+        const Vector3 &p1 = vertices[indices[i + 1]].position;
+        const Vector3 &p2 = vertices[indices[i + 2]].position;
+        // Left-handed, clockwise front faces
+        Vector3 n = (p1 - p0).Cross(p2 - p0);
+        if (n.LengthSquared() < 1e-20f)
+            continue; // degenerate triangle
+        n.Normalize();
+        normals.push_back(n);
+        axis += n;
+    }
+
+    meshlet.coneAxis = Vector3(0.0f);
+    meshlet.coneApex = meshlet.center;
+    meshlet.coneCutoff = 1.0f;
+    if (normals.empty() || axis.LengthSquared() < 1e-12f)
+        return;
+    axis.Normalize();
+
+    float minDot = 1.0f;
+    for (const auto &n : normals)
+        minDot = std::min(minDot, n.Dot(axis));
+
+    // Wider than ~84 degrees is not worth testing.
+    if (minDot <= 0.1f)
+        return;
+
+    // Move the apex back so the cone contains every triangle plane.
+    float maxT = 0.0f;
+    size_t n = 0;
+    for (uint32_t i = begin; i < end; i += 3) {
+        const Vector3 &p0 = vertices[indices[i]].position;
+        const Vector3 &p1 = vertices[indices[i + 1]].position;
+        const Vector3 &p2 = vertices[indices[i + 2]].position;
+        if ((p1 - p0).Cross(p2 - p0).LengthSquared() < 1e-20f)
+            continue;
+        const Vector3 &normal = normals[n++];
+        const float dc = (meshlet.center - p0).Dot(normal);
+        const float dn = axis.Dot(normal);
+        maxT = std::max(maxT, dc / dn);
+    }
+
+    meshlet.coneAxis = axis;
+    meshlet.coneApex = meshlet.center - axis * maxT;
+    meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+ClusterCuller::View ClusterCuller::MakeView(const Matrix &viewRow,
+                                            const Matrix &projRow,
+                                            const Vector3 &eyeWorld,
+                                            const HiZBuffer *hiZ) {
+    View view;
+    view.viewProjRow = viewRow * projRow;
+    view.frustum = Frustum::FromViewProj(view.viewProjRow);
+    view.eyeWorld = eyeWorld;
+    view.hiZ = (hiZ && hiZ->IsValid()) ? hiZ : nullptr;
+    return view;
+}
+
+void ClusterCuller::Cull(const View &view, const Matrix &worldRow,
+                         const Matrix &worldITRow,
+                         const std::vector<Meshlet> &meshlets,
+                         std::vector<IndexRange> &ranges,
+                         ClusterCullingStats &stats, bool useConeCulling) {
+    ranges.clear();
+
+    // Scale the radius by the largest axis so non-uniform scale stays
+    // conservative.
+    const float scale = std::sqrt(
+        std::max(std::max(worldRow.Right().LengthSquared(),
+                          worldRow.Up().LengthSquared()),
+                 worldRow.Backward().LengthSquared()));
+
+    for (const auto &m : meshlets) {
+        const uint32_t triangles = m.indexCount / 3;
+        stats.clusters++;
+        stats.triangles += triangles;
+
+        const Vector3 center = Vector3::Transform(m.center, worldRow);
+        const float radius = m.radius * scale;
+
+        if (!view.frustum.Intersects(center, radius)) {
+            stats.frustumCulled++;
+            continue;
+        }
+
+        if (useConeCulling && m.coneCutoff < 1.0f) {
+            const Vector3 apex = Vector3::Transform(m.coneApex, worldRow);
+            Vector3 axis = Vector3::TransformNormal(m.coneAxis, worldITRow);
+            axis.Normalize();
+            Vector3 dir = apex - view.eyeWorld;
+            dir.Normalize();
+            if (dir.Dot(axis) >= m.coneCutoff) {
+                stats.coneCulled++;
+                continue;
+            }
+        }
+
+        if (view.hiZ &&
+            view.hiZ->IsSphereOccluded(center, radius, view.viewProjRow)) {
+            stats.occlusionCulled++;
+            continue;
+        }
+
+        stats.visibleTriangles += triangles;
+        if (!ranges.empty() && ranges.back().startIndex +
+                                       ranges.back().indexCount ==
+                                   m.indexOffset) {
+            ranges.back().indexCount += m.indexCount;
+        } else {
+            ranges.push_back({m.indexOffset, m.indexCount});
+        }
+    }
+
+    stats.drawRanges += uint32_t(ranges.size());
+}
+
+} // namespace jRenderer
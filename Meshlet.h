@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <vector>
+
+#include "Culling.h"
+#include "MeshData.h"
+
+// ref
+// https://github.com/zeux/meshoptimizer (meshopt_buildMeshlets,
+// meshopt_computeMeshletBounds)
+
+#define MESHLET_MAX_VERTICES 64
+#define MESHLET_MAX_TRIANGLES 124
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+
+// A cluster of triangles that is culled as a unit.
+// Each meshlet covers a contiguous range of the mesh's index buffer.
+struct Meshlet {
+    uint32_t indexOffset = 0;
+    uint32_t indexCount = 0;
+    uint32_t vertexCount = 0; // unique vertices referenced
+
+    // Bounding sphere (model space)
+    Vector3 center = Vector3(0.0f);
+    float radius = 0.0f;
+
+    // Normal cone (model space). cutoff >= 1 means the cone is degenerate
+    // and the meshlet never gets backface culled.
+    Vector3 coneApex = Vector3(0.0f);
+    Vector3 coneAxis = Vector3(0.0f);
+    float coneCutoff = 1.0f;
+};
+
+// DrawIndexed(indexCount, startIndex, 0)
+struct IndexRange {
+    uint32_t startIndex = 0;
+    uint32_t indexCount = 0;
+};
+
+struct ClusterCullingStats {
+    uint32_t clusters = 0;
+    uint32_t frustumCulled = 0;
+    uint32_t coneCulled = 0;
+    uint32_t occlusionCulled = 0;
+    uint64_t triangles = 0;
+    uint64_t visibleTriangles = 0;
+    uint32_t drawRanges = 0;
+
+    void Reset() { *this = ClusterCullingStats(); }
+    void Add(const ClusterCullingStats &other) {
+        clusters += other.clusters;
+        frustumCulled += other.frustumCulled;
+        coneCulled += other.coneCulled;
+        occlusionCulled += other.occlusionCulled;
+        triangles += other.triangles;
+        visibleTriangles += other.visibleTriangles;
+        drawRanges += other.drawRanges;
+    }
+    float CulledRatio() const {
+        return triangles ? 1.0f - float(visibleTriangles) / float(triangles)
+                         : 0.0f;
+    }
+};
+
+class MeshletBuilder {
+  public:
+    // Splits the mesh into meshlets in index buffer order, so the index
+    // buffer can be used as is and every meshlet is a contiguous range.
+    static void Build(const MeshData &meshData,
+                      std::vector<Meshlet> &meshlets,
+                      uint32_t maxVertices = MESHLET_MAX_VERTICES,
+                      uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+
+    static void ComputeBounds(const MeshData &meshData, Meshlet &meshlet);
+};
+
+class ClusterCuller {
+  public:
+    struct View {
+        Frustum frustum;
+        Matrix viewProjRow;
+        Vector3 eyeWorld;
+        const HiZBuffer *hiZ = nullptr; // optional
+    };
+
+    static View MakeView(const Matrix &viewRow, const Matrix &projRow,
+                         const Vector3 &eyeWorld,
+                         const HiZBuffer *hiZ = nullptr);
+
+    // Culls the meshlets of one mesh and writes compacted index ranges.
+    // Adjacent visible meshlets are merged into a single range.
+    static void Cull(const View &view, const Matrix &worldRow,
+                     const Matrix &worldITRow,
+                     const std::vector<Meshlet> &meshlets,
+                     std::vector<IndexRange> &ranges,
+                     ClusterCullingStats &stats, bool useConeCulling = true);
+};
+
+} // namespace jRenderer
@@ -1,7 +1,66 @@
 #include "Model.h"
 
+#include <cfloat>
+#include <cstdio>
+#include <filesystem>
+#include <mutex>
+
+#include "HotReload.h"
+#include "JobSystem.h"
+#include "MaterialPermutations.h"
+#include "MemoryArena.h"
+
 namespace jRenderer {
 
+namespace fs = std::filesystem;
+
+namespace {
+
+void GetTextureSlot(Mesh &mesh, uint32_t slot,
+                    ComPtr<ID3D11Texture2D> *&texture,
+                    ComPtr<ID3D11ShaderResourceView> *&srv) {
+    switch (slot) {
+    case MESH_ALBEDO_TEXTURE:
+        texture = &mesh.albedoTexture;
+        srv = &mesh.albedoSRV;
+        break;
+    case MESH_EMISSIVE_TEXTURE:
+        texture = &mesh.emissiveTexture;
+        srv = &mesh.emissiveSRV;
+        break;
+    case MESH_NORMAL_TEXTURE:
+        texture = &mesh.normalTexture;
+        srv = &mesh.normalSRV;
+        break;
+    case MESH_HEIGHT_TEXTURE:
+        texture = &mesh.heightTexture;
+        srv = &mesh.heightSRV;
+        break;
+    case MESH_AO_TEXTURE:
+        texture = &mesh.aoTexture;
+        srv = &mesh.aoSRV;
+        break;
+    default:
+        texture = &mesh.metallicRoughnessTexture;
+        srv = &mesh.metallicRoughnessSRV;
+        break;
+    }
+}
+
+void ReadTexture(const MeshTextureSource &source, uint32_t slot,
+                 TextureImage &image) {
+    if (source.IsEmpty())
+        return;
+    if (slot == MESH_METALLIC_ROUGHNESS_TEXTURE) {
+        D3D11Utils::ReadMetallicRoughnessTexture(
+            source.filename, source.roughnessFilename, image);
+    } else {
+        D3D11Utils::ReadTexture(source.filename, source.isSRGB, image);
+    }
+}
+
+} // namespace
+
 vector<MeshData> Model::ReadFromFile(std::string basePath, std::string filename,
                                      bool revertNormals) {
 
@@ -57,6 +116,8 @@ void Model::Initialize(ComPtr<ID3D11Device> &device,
                        const std::string &basePath,
                        const std::string &filename) {
 
+    m_basePath = basePath;
+    m_filename = filename;
     auto meshes = Model::ReadFromFile(basePath, filename);
 
     Initialize(device, context, meshes);
@@ -79,8 +140,64 @@ void Model::Initialize(ComPtr<ID3D11Device> &device,
         m_instancedConstsCPU.useInstancing = 1;
     }
 
-    for (const auto &meshData : meshes) {
-        auto newMesh = std::make_shared<Mesh>();
+    ModelBuild build = Build(device, meshes);
+    Apply(device, context, build);
+}
+
+ModelBuild Model::Build(ComPtr<ID3D11Device> &device,
+                        const std::vector<MeshData> &meshes) const {
+    ModelBuild build;
+    build.sources.resize(meshes.size());
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const auto &meshData = meshes[m];
+        auto &sources = build.sources[m];
+        sources[MESH_ALBEDO_TEXTURE] = {meshData.albedoTextureFilename, "",
+                                        true};
+        sources[MESH_EMISSIVE_TEXTURE] = {meshData.emissiveTextureFilename,
+                                          "", true};
+        sources[MESH_NORMAL_TEXTURE] = {meshData.normalTextureFilename};
+        sources[MESH_HEIGHT_TEXTURE] = {meshData.heightTextureFilename};
+        sources[MESH_AO_TEXTURE] = {meshData.aoTextureFilename};
+        // GLTF  Metallic Roughness  ؽ翡 
+        // Green : Roughness, Blue : Metallic(Metalness)
+        sources[MESH_METALLIC_ROUGHNESS_TEXTURE] = {
+            meshData.metallicTextureFilename,
+            meshData.roughnessTextureFilename};
+    }
+
+    // Clusterizing and decoding the maps are CPU only, so they run in
+    // parallel before the loop below.
+    vector<vector<Meshlet>> meshlets(meshes.size());
+    JobSystem::ParallelFor(
+        uint32_t(meshes.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++)
+                MeshletBuilder::Build(meshes[i], meshlets[i]);
+        });
+    build.images.resize(meshes.size());
+    JobSystem::ParallelFor(
+        uint32_t(meshes.size() * NUM_MESH_TEXTURES), 1,
+        [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                const uint32_t m = i / NUM_MESH_TEXTURES;
+                const uint32_t slot = i % NUM_MESH_TEXTURES;
+                ReadTexture(build.sources[m][slot], slot,
+                            build.images[m][slot]);
+            }
+        });
+
+    Vector3 vmin(FLT_MAX), vmax(-FLT_MAX);
+    for (size_t m = 0; m < meshes.size(); m++) {
+        const auto &meshData = meshes[m];
+        const uint32_t baseVertex = uint32_t(build.occluderPositions.size());
+        for (const auto &v : meshData.vertices) {
+            vmin = Vector3::Min(vmin, v.position);
+            vmax = Vector3::Max(vmax, v.position);
+            build.occluderPositions.push_back(v.position);
+        }
+        for (const auto &i : meshData.indices)
+            build.occluderIndices.push_back(baseVertex + i);
+
+        auto newMesh = MakePooled<Mesh>("Mesh");
         D3D11Utils::CreateVertexBuffer(device, meshData.vertices,
                                        newMesh->vertexBuffer);
         newMesh->indexCount = UINT(meshData.indices.size());
@@ -88,76 +205,179 @@ void Model::Initialize(ComPtr<ID3D11Device> &device,
         newMesh->strides = UINT(sizeof(Vertex));
         D3D11Utils::CreateIndexBuffer(device, meshData.indices,
                                       newMesh->indexBuffer);
+        newMesh->meshlets = std::move(meshlets[m]);
+
+        if (!meshData.albedoTextureFilename.empty())
+            newMesh->features |= MATERIAL_ALBEDO_MAP;
+        if (!meshData.emissiveTextureFilename.empty())
+            newMesh->features |= MATERIAL_EMISSIVE_MAP;
+        if (!meshData.normalTextureFilename.empty())
+            newMesh->features |= MATERIAL_NORMAL_MAP;
+        if (!meshData.aoTextureFilename.empty())
+            newMesh->features |= MATERIAL_AO_MAP;
+        if (!meshData.metallicTextureFilename.empty())
+            newMesh->features |= MATERIAL_METALLIC_MAP;
+        if (!meshData.roughnessTextureFilename.empty())
+            newMesh->features |= MATERIAL_ROUGHNESS_MAP;
 
-        if (!meshData.albedoTextureFilename.empty()) {
-            D3D11Utils::CreateTexture(
-                device, context, meshData.albedoTextureFilename, true,
-                newMesh->albedoTexture, newMesh->albedoSRV);
-            m_materialConstsCPU.useAlbedoMap = true;
-        }
+        newMesh->vertexConstBuffer = m_meshConstsGPU;
+        newMesh->pixelConstBuffer = m_materialConstsGPU;
 
-        if (!meshData.emissiveTextureFilename.empty()) {
-            D3D11Utils::CreateTexture(
-                device, context, meshData.emissiveTextureFilename, true,
-                newMesh->emissiveTexture, newMesh->emissiveSRV);
-            m_materialConstsCPU.useEmissiveMap = true;
-        }
+        build.meshes.push_back(newMesh);
+    }
 
-        if (!meshData.normalTextureFilename.empty()) {
-            D3D11Utils::CreateTexture(  
-                device, context, meshData.normalTextureFilename, false,
-                newMesh->normalTexture, newMesh->normalSRV);
-            m_materialConstsCPU.useNormalMap = true;
-        }
+    if (!build.occluderPositions.empty()) {
+        build.boundingBoxMin = vmin;
+        build.boundingBoxMax = vmax;
+    }
+    return build;
+}
 
-        if (!meshData.heightTextureFilename.empty()) {
-            D3D11Utils::CreateTexture(
-                device, context, meshData.heightTextureFilename, false,
-                newMesh->heightTexture, newMesh->heightSRV);
-            m_meshConstsCPU.useHeightMap = true;
+void Model::Apply(ComPtr<ID3D11Device> &device,
+                  ComPtr<ID3D11DeviceContext> &context, ModelBuild &build) {
+    for (size_t m = 0; m < build.meshes.size(); m++) {
+        auto &mesh = *build.meshes[m];
+        for (uint32_t slot = 0; slot < NUM_MESH_TEXTURES; slot++) {
+            const auto &image = build.images[m][slot];
+            if (image.pixels.empty())
+                continue;
+            ComPtr<ID3D11Texture2D> *texture;
+            ComPtr<ID3D11ShaderResourceView> *srv;
+            GetTextureSlot(mesh, slot, texture, srv);
+            D3D11Utils::CreateTexture(device, context, image, *texture, *srv);
         }
 
-        if (!meshData.aoTextureFilename.empty()) {
-            D3D11Utils::CreateTexture(device, context,
-                                      meshData.aoTextureFilename, false,
-                                      newMesh->aoTexture, newMesh->aoSRV);
+        const uint32_t features = mesh.features;
+        if (features & MATERIAL_ALBEDO_MAP)
+            m_materialConstsCPU.useAlbedoMap = true;
+        if (features & MATERIAL_EMISSIVE_MAP)
+            m_materialConstsCPU.useEmissiveMap = true;
+        if (features & MATERIAL_NORMAL_MAP)
+            m_materialConstsCPU.useNormalMap = true;
+        if (!build.sources[m][MESH_HEIGHT_TEXTURE].IsEmpty())
+            m_meshConstsCPU.useHeightMap = true;
+        if (features & MATERIAL_AO_MAP)
             m_materialConstsCPU.useAOMap = true;
-        }
-
-        // GLTF  Metallic Roughness  ؽ翡 
-        // Green : Roughness, Blue : Metallic(Metalness)
-        if (!meshData.metallicTextureFilename.empty() ||
-            !meshData.roughnessTextureFilename.empty()) {
-            D3D11Utils::CreateMetallicRoughnessTexture(
-                device, context, meshData.metallicTextureFilename,
-                meshData.roughnessTextureFilename,
-                newMesh->metallicRoughnessTexture,
-                newMesh->metallicRoughnessSRV);
-        }
-
-        if (!meshData.metallicTextureFilename.empty()) {
+        if (features & MATERIAL_METALLIC_MAP)
             m_materialConstsCPU.useMetallicMap = true;
-        }
-
-        if (!meshData.roughnessTextureFilename.empty()) {
+        if (features & MATERIAL_ROUGHNESS_MAP)
             m_materialConstsCPU.useRoughnessMap = true;
-        }
+    }
+    build.images.clear();
+
+    m_meshes = std::move(build.meshes);
+    m_textureSources = std::move(build.sources);
+    m_occluderPositions = std::move(build.occluderPositions);
+    m_occluderIndices = std::move(build.occluderIndices);
+    m_boundingBoxMin = build.boundingBoxMin;
+    m_boundingBoxMax = build.boundingBoxMax;
+}
 
-        newMesh->vertexConstBuffer = m_meshConstsGPU;
-        newMesh->pixelConstBuffer = m_materialConstsGPU;
+void Model::AddReloads(const shared_ptr<Model> &model, HotReload &hotReload,
+                       ComPtr<ID3D11Device> &device,
+                       ComPtr<ID3D11DeviceContext> &context) {
+    AddTextureReloads(model, hotReload, device, context);
+    if (model->m_filename.empty())
+        return;
+
+    // The file and what it loads next to it by the same name, the .bin of
+    // a GLTF file
+    const std::string basePath = model->m_basePath;
+    const std::string filename = model->m_filename;
+    const fs::path path = fs::path(basePath) / filename;
+    std::vector<std::string> files = {path.generic_string()};
+    std::error_code error;
+    for (const auto &entry :
+         fs::directory_iterator(path.parent_path(), error)) {
+        if (entry.path().stem() == path.stem() &&
+            entry.path().filename() != path.filename())
+            files.push_back(entry.path().generic_string());
+    }
+
+    const std::weak_ptr<Model> weak = model;
+    hotReload.Add(
+        "Model " + path.generic_string(), files,
+        [weak, device, context, basePath, filename,
+         &hotReload](std::string &errors) mutable -> HotReload::Swap {
+            auto model = weak.lock();
+            if (!model)
+                return nullptr;
+            auto meshes = Model::ReadFromFile(basePath, filename);
+            if (meshes.empty()) {
+                errors = "No meshes in " + basePath + filename;
+                return nullptr;
+            }
+            auto build =
+                std::make_shared<ModelBuild>(model->Build(device, meshes));
+            return [weak, device, context, build, &hotReload]() mutable {
+                if (auto model = weak.lock()) {
+                    model->Apply(device, context, *build);
+                    // The maps of the new meshes
+                    AddTextureReloads(model, hotReload, device, context);
+                }
+            };
+        });
+}
 
-        this->m_meshes.push_back(newMesh);
+void Model::AddTextureReloads(const shared_ptr<Model> &model,
+                              HotReload &hotReload,
+                              ComPtr<ID3D11Device> &device,
+                              ComPtr<ID3D11DeviceContext> &context) {
+    static const char *slotNames[NUM_MESH_TEXTURES] = {
+        "albedo", "emissive", "normal", "height", "ao", "metallicRoughness"};
+    char prefix[64];
+    snprintf(prefix, sizeof(prefix), "Model %p mesh ", (void *)model.get());
+
+    const std::weak_ptr<Model> weak = model;
+    for (size_t m = 0; m < model->m_textureSources.size(); m++) {
+        for (uint32_t slot = 0; slot < NUM_MESH_TEXTURES; slot++) {
+            const auto &source = model->m_textureSources[m][slot];
+            if (source.IsEmpty())
+                continue;
+            std::vector<std::string> files;
+            if (!source.filename.empty())
+                files.push_back(source.filename);
+            if (!source.roughnessFilename.empty())
+                files.push_back(source.roughnessFilename);
+            hotReload.Add(
+                prefix + std::to_string(m) + " " + slotNames[slot], files,
+                [weak, device, context, source, m,
+                 slot](std::string &errors) mutable -> HotReload::Swap {
+                    auto image = std::make_shared<TextureImage>();
+                    ReadTexture(source, slot, *image);
+                    if (image->pixels.empty()) {
+                        errors = "Can't read " + source.filename;
+                        return nullptr;
+                    }
+                    return [weak, device, context, source, m, slot,
+                            image]() mutable {
+                        // Unless the model was reloaded without the map
+                        auto model = weak.lock();
+                        if (!model || m >= model->m_meshes.size() ||
+                            !(model->m_textureSources[m][slot] == source))
+                            return;
+                        ComPtr<ID3D11Texture2D> *texture;
+                        ComPtr<ID3D11ShaderResourceView> *srv;
+                        GetTextureSlot(*model->m_meshes[m], slot, texture,
+                                       srv);
+                        ComPtr<ID3D11Texture2D> newTexture;
+                        ComPtr<ID3D11ShaderResourceView> newSRV;
+                        D3D11Utils::CreateTexture(device, context, *image,
+                                                  newTexture, newSRV);
+                        *texture = newTexture;
+                        *srv = newSRV;
+                    };
+                });
+        }
     }
 }
 
 void Model::UpdateConstantBuffers(ComPtr<ID3D11Device> &device,
                                   ComPtr<ID3D11DeviceContext> &context) {
-    if (m_isVisible) {
-        D3D11Utils::UpdateBuffer(device, context, m_meshConstsCPU,
-                                 m_meshConstsGPU);
-        D3D11Utils::UpdateBuffer(device, context, m_materialConstsCPU,
-                                 m_materialConstsGPU);
-    }
+    D3D11Utils::UpdateBuffer(device, context, m_meshConstsCPU,
+                             m_meshConstsGPU);
+    D3D11Utils::UpdateBuffer(device, context, m_materialConstsCPU,
+                             m_materialConstsGPU);
     if (m_instancedConstsCPU.useInstancing) {
         D3D11Utils::UpdateBuffer(device, context, m_instancedConstsCPU,
                                  m_instancedConstsGPU);
@@ -165,38 +385,144 @@ void Model::UpdateConstantBuffers(ComPtr<ID3D11Device> &device,
 }
 
 void Model::Render(ComPtr<ID3D11DeviceContext> &context) {
-    if (m_isVisible) {
-        context->VSSetConstantBuffers(2, 1,
-                                      m_instancedConstsGPU.GetAddressOf());
-        for (const auto &mesh : m_meshes) {
-            context->VSSetConstantBuffers(
-                0, 1, mesh->vertexConstBuffer.GetAddressOf());
-            context->PSSetConstantBuffers(
-                0, 1, mesh->pixelConstBuffer.GetAddressOf());
-
-            context->VSSetShaderResources(0, 1, mesh->heightSRV.GetAddressOf());
-
-            // ü    ؽ  (t0 ͽ)
-            vector<ID3D11ShaderResourceView *> resViews = {
-                mesh->albedoSRV.Get(), mesh->normalSRV.Get(), mesh->aoSRV.Get(),
-                mesh->metallicRoughnessSRV.Get(), mesh->emissiveSRV.Get()};
-
-            context->PSSetShaderResources(0, UINT(resViews.size()),
-                                          resViews.data());
-
-            context->IASetVertexBuffers(0, 1, mesh->vertexBuffer.GetAddressOf(),
-                                        &mesh->strides, &mesh->offsets);
-            context->IASetIndexBuffer(mesh->indexBuffer.Get(),
-                                      DXGI_FORMAT_R32_UINT, 0);
-            if (!m_instancedConstsCPU.useInstancing)
-                context->DrawIndexed(mesh->indexCount, 0, 0);
-            else if (m_instancedConstsCPU.useInstancing)
-                context->DrawIndexedInstanced(mesh->indexCount, m_instanceCount,
-                                              0, 0, 0);
-        }
+    context->VSSetConstantBuffers(2, 1, m_instancedConstsGPU.GetAddressOf());
+    for (const auto &mesh : m_meshes) {
+        RenderMesh(context, *mesh,
+                   mesh->useDrawRanges ? &mesh->drawRanges : nullptr,
+                   m_instancedConstsCPU.useInstancing);
+    }
+}
+
+void Model::Capture(ModelSnapshot &snapshot) {
+    snapshot.model = this;
+    snapshot.meshConsts = m_meshConstsCPU;
+    snapshot.materialConsts = m_materialConstsCPU;
+    snapshot.instancedConsts = m_instancedConstsCPU;
+
+    const uint64_t instances =
+        m_instancedConstsCPU.useInstancing ? m_instanceCount : 1;
+    snapshot.drawCost = 0;
+    snapshot.shadowCost = 0;
+
+    // resize() keeps the inner vectors, so their memory is reused.
+    snapshot.drawRanges.resize(m_meshes.size());
+    snapshot.useDrawRanges.resize(m_meshes.size());
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        const auto &mesh = m_meshes[i];
+        snapshot.useDrawRanges[i] = mesh->useDrawRanges;
+        snapshot.shadowCost += mesh->indexCount * instances;
+        if (mesh->useDrawRanges) {
+            snapshot.drawRanges[i] = mesh->drawRanges;
+            for (const auto &range : mesh->drawRanges)
+                snapshot.drawCost += range.indexCount;
+        } else
+            snapshot.drawCost += mesh->indexCount * instances;
+    }
+}
+
+void Model::UpdateConstantBuffers(ComPtr<ID3D11Device> &device,
+                                  ComPtr<ID3D11DeviceContext> &context,
+                                  const ModelSnapshot &snapshot) {
+    D3D11Utils::UpdateBuffer(device, context, snapshot.meshConsts,
+                             m_meshConstsGPU);
+    D3D11Utils::UpdateBuffer(device, context, snapshot.materialConsts,
+                             m_materialConstsGPU);
+    if (snapshot.instancedConsts.useInstancing) {
+        D3D11Utils::UpdateBuffer(device, context, snapshot.instancedConsts,
+                                 m_instancedConstsGPU);
+    }
+}
+
+void Model::Render(ComPtr<ID3D11DeviceContext> &context,
+                   const ModelSnapshot &snapshot, bool useDrawRanges) {
+    context->VSSetConstantBuffers(2, 1, m_instancedConstsGPU.GetAddressOf());
+    for (size_t i = 0; i < m_meshes.size(); i++) {
+        RenderMesh(context, *m_meshes[i],
+                   useDrawRanges && snapshot.useDrawRanges[i]
+                       ? &snapshot.drawRanges[i]
+                       : nullptr,
+                   snapshot.instancedConsts.useInstancing);
     }
 }
 
+void Model::RenderMesh(ComPtr<ID3D11DeviceContext> &context,
+                       const ModelSnapshot &snapshot, size_t meshIndex,
+                       UINT startInstance, bool bindMaps) {
+    context->VSSetConstantBuffers(2, 1, m_instancedConstsGPU.GetAddressOf());
+    RenderMesh(context, *m_meshes[meshIndex],
+               snapshot.useDrawRanges[meshIndex]
+                   ? &snapshot.drawRanges[meshIndex]
+                   : nullptr,
+               snapshot.instancedConsts.useInstancing, startInstance,
+               bindMaps);
+}
+
+uint64_t Model::GetDrawCost(const ModelSnapshot &snapshot,
+                            size_t meshIndex) const {
+    if (!snapshot.useDrawRanges[meshIndex]) {
+        const uint64_t instances =
+            snapshot.instancedConsts.useInstancing ? m_instanceCount : 1;
+        return m_meshes[meshIndex]->indexCount * instances;
+    }
+    uint64_t cost = 0;
+    for (const auto &range : snapshot.drawRanges[meshIndex])
+        cost += range.indexCount;
+    return cost;
+}
+
+void Model::RenderCopies(ComPtr<ID3D11DeviceContext> &context,
+                         const ModelSnapshot &snapshot, UINT numCopies,
+                         UINT startInstance) {
+    const UINT instances =
+        snapshot.instancedConsts.useInstancing ? UINT(m_instanceCount) : 1;
+    context->VSSetConstantBuffers(2, 1, m_instancedConstsGPU.GetAddressOf());
+    for (const auto &mesh : m_meshes) {
+        context->VSSetConstantBuffers(0, 1,
+                                      mesh->vertexConstBuffer.GetAddressOf());
+        context->IASetVertexBuffers(0, 1, mesh->vertexBuffer.GetAddressOf(),
+                                    &mesh->strides, &mesh->offsets);
+        context->IASetIndexBuffer(mesh->indexBuffer.Get(),
+                                  DXGI_FORMAT_R32_UINT, 0);
+        context->DrawIndexedInstanced(mesh->indexCount, instances * numCopies,
+                                      0, 0, startInstance);
+    }
+}
+
+void Model::RenderMesh(ComPtr<ID3D11DeviceContext> &context, const Mesh &mesh,
+                       const std::vector<IndexRange> *drawRanges,
+                       bool useInstancing, UINT startInstance,
+                       bool bindMaps) {
+    context->VSSetConstantBuffers(0, 1, mesh.vertexConstBuffer.GetAddressOf());
+    context->PSSetConstantBuffers(0, 1, mesh.pixelConstBuffer.GetAddressOf());
+
+    context->VSSetShaderResources(0, 1, mesh.heightSRV.GetAddressOf());
+
+    // ü    ؽ  (t0 ͽ)
+    if (bindMaps) {
+        ID3D11ShaderResourceView *resViews[] = {
+            mesh.albedoSRV.Get(), mesh.normalSRV.Get(), mesh.aoSRV.Get(),
+            mesh.metallicRoughnessSRV.Get(), mesh.emissiveSRV.Get()};
+        context->PSSetShaderResources(0, UINT(std::size(resViews)),
+                                      resViews);
+    }
+
+    context->IASetVertexBuffers(0, 1, mesh.vertexBuffer.GetAddressOf(),
+                                &mesh.strides, &mesh.offsets);
+    context->IASetIndexBuffer(mesh.indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+    // startInstance only offsets the data in slot 1, SV_InstanceID still
+    // starts at 0.
+    if (drawRanges) {
+        for (const auto &range : *drawRanges)
+            context->DrawIndexedInstanced(range.indexCount, 1,
+                                          range.startIndex, 0, startInstance);
+    } else if (!useInstancing)
+        context->DrawIndexedInstanced(mesh.indexCount, 1, 0, 0,
+                                      startInstance);
+    else
+        context->DrawIndexedInstanced(mesh.indexCount, m_instanceCount, 0, 0,
+                                      startInstance);
+}
+
 void Model::RenderScreen(ComPtr<ID3D11DeviceContext>& context) {
     ID3D11Buffer *nullBuffer = NULL;
     UINT stride = 0;
@@ -215,6 +541,38 @@ void Model::RenderNormals(ComPtr<ID3D11DeviceContext> &context) {
     }
 }
 
+void Model::CullClusters(const ClusterCuller::View &view,
+                         const Matrix &worldRow, const Matrix &worldITRow,
+                         ClusterCullingStats &stats, bool useConeCulling) {
+    // Instances are offset in the vertex shader, so their clusters can't be
+    // culled with the model's world matrix.
+    if (!m_useClusterCulling ||
+        m_instancedConstsCPU.useInstancing) {
+        ResetClusterCulling();
+        return;
+    }
+
+    std::mutex statsMutex;
+    JobSystem::ParallelFor(
+        uint32_t(m_meshes.size()), 4, [&](uint32_t begin, uint32_t end) {
+            ClusterCullingStats localStats;
+            for (uint32_t i = begin; i < end; i++) {
+                auto &mesh = m_meshes[i];
+                ClusterCuller::Cull(view, worldRow, worldITRow,
+                                    mesh->meshlets, mesh->drawRanges,
+                                    localStats, useConeCulling);
+                mesh->useDrawRanges = true;
+            }
+            std::lock_guard<std::mutex> lock(statsMutex);
+            stats.Add(localStats);
+        });
+}
+
+void Model::ResetClusterCulling() {
+    for (auto &mesh : m_meshes)
+        mesh->useDrawRanges = false;
+}
+
 void Model::UpdateWorldRow(const Matrix &worldRow) {
     this->m_worldRow = worldRow;
     this->m_worldITRow = worldRow;
@@ -1,13 +1,17 @@
 #pragma once
 
+#include <array>
 #include <directxtk/SimpleMath.h>
+#include <memory>
 #include <string>
 #include <vector>
 
 #include "ConstantBuffers.h"
 #include "D3D11Utils.h"
+#include "FramePipeline.h"
 #include "Mesh.h"
 #include "MeshData.h"
+#include "Meshlet.h"
 #include "ModelLoader.h"
 
 // ref
@@ -15,6 +19,49 @@
 
 namespace jRenderer {
 
+class HotReload;
+
+// The maps of a Mesh
+enum MeshTextureSlot : uint32_t {
+    MESH_ALBEDO_TEXTURE,
+    MESH_EMISSIVE_TEXTURE,
+    MESH_NORMAL_TEXTURE,
+    MESH_HEIGHT_TEXTURE,
+    MESH_AO_TEXTURE,
+    MESH_METALLIC_ROUGHNESS_TEXTURE,
+    NUM_MESH_TEXTURES
+};
+
+// Where a map of a mesh is read from. The metallic-roughness map combines
+// two files unless they are the same.
+struct MeshTextureSource {
+    std::string filename;
+    std::string roughnessFilename; // MESH_METALLIC_ROUGHNESS_TEXTURE only
+    bool isSRGB = false;
+
+    bool IsEmpty() const {
+        return filename.empty() && roughnessFilename.empty();
+    }
+    bool operator==(const MeshTextureSource &other) const {
+        return filename == other.filename &&
+               roughnessFilename == other.roughnessFilename &&
+               isSRGB == other.isSRGB;
+    }
+};
+
+using MeshTextureSources = std::array<MeshTextureSource, NUM_MESH_TEXTURES>;
+
+// The meshes of Model::Build(), their maps read but not uploaded yet
+struct ModelBuild {
+    std::vector<shared_ptr<Mesh>> meshes;
+    std::vector<MeshTextureSources> sources;
+    std::vector<std::array<TextureImage, NUM_MESH_TEXTURES>> images;
+    std::vector<Vector3> occluderPositions;
+    std::vector<uint32_t> occluderIndices;
+    Vector3 boundingBoxMin = Vector3(0.0f);
+    Vector3 boundingBoxMax = Vector3(0.0f);
+};
+
 class Model {
   public:
     Model() {}
@@ -31,21 +78,71 @@ class Model {
                     ComPtr<ID3D11DeviceContext> &context,
                     const std::vector<MeshData> &meshes, int instanceFlag = 0);
 
+    // The meshes of Initialize() in two steps, so a reload can run the
+    // first on another thread. Build() makes the buffers with the device
+    // only and reads the maps, Apply() uploads the maps on the context's
+    // thread and replaces the meshes.
+    ModelBuild Build(ComPtr<ID3D11Device> &device,
+                     const std::vector<MeshData> &meshes) const;
+    void Apply(ComPtr<ID3D11Device> &device,
+               ComPtr<ID3D11DeviceContext> &context, ModelBuild &build);
+
+    // Registers the file of the model and each of its maps. A changed map
+    // is read again on its own, the file rebuilds all the meshes.
+    static void AddReloads(const shared_ptr<Model> &model,
+                           HotReload &hotReload,
+                           ComPtr<ID3D11Device> &device,
+                           ComPtr<ID3D11DeviceContext> &context);
+
     void UpdateConstantBuffers(ComPtr<ID3D11Device> &device,
                                ComPtr<ID3D11DeviceContext> &context);
 
     void Render(ComPtr<ID3D11DeviceContext> &context);
 
+    // Frame snapshot path: Capture() on the update side, the others on the
+    // render side. They don't read the model's per frame state.
+    void Capture(ModelSnapshot &snapshot);
+    void UpdateConstantBuffers(ComPtr<ID3D11Device> &device,
+                               ComPtr<ID3D11DeviceContext> &context,
+                               const ModelSnapshot &snapshot);
+    // useDrawRanges = false draws the whole meshes, e.g. for shadow maps
+    // where the camera's cluster culling doesn't apply.
+    void Render(ComPtr<ID3D11DeviceContext> &context,
+                const ModelSnapshot &snapshot, bool useDrawRanges = true);
+    // One mesh with its draw ranges, for passes that sort the meshes.
+    // The per-instance vertex data in slot 1 starts at startInstance, and
+    // bindMaps = false leaves t0 to t4 to the material table.
+    void RenderMesh(ComPtr<ID3D11DeviceContext> &context,
+                    const ModelSnapshot &snapshot, size_t meshIndex,
+                    UINT startInstance = 0, bool bindMaps = true);
+    // Indices drawn by RenderMesh(), see ModelSnapshot::drawCost
+    uint64_t GetDrawCost(const ModelSnapshot &snapshot,
+                         size_t meshIndex) const;
+    // Depth only, every instance numCopies times. The per-instance vertex
+    // data in slot 1 starts at startInstance, see ShadowFaceInstance.
+    void RenderCopies(ComPtr<ID3D11DeviceContext> &context,
+                      const ModelSnapshot &snapshot, UINT numCopies,
+                      UINT startInstance);
+
     void RenderScreen(ComPtr<ID3D11DeviceContext> &context);
 
     void RenderNormals(ComPtr<ID3D11DeviceContext> &context);
 
     void UpdateWorldRow(const Matrix &worldRow);        
 
+    // Per-meshlet culling, Render() then only draws the visible ranges.
+    // The rows are the object's in the SceneStore.
+    void CullClusters(const ClusterCuller::View &view, const Matrix &worldRow,
+                      const Matrix &worldITRow, ClusterCullingStats &stats,
+                      bool useConeCulling = true);
+    void ResetClusterCulling();
+
     static vector<MeshData> ReadFromFile(std::string basePath, std::string filename,
                                   bool revertNormals = false);
 
   public:
+    // Of models outside the SceneStore, e.g. the skybox. The store has the
+    // transforms and flags of the scene objects.
     Matrix m_worldRow = Matrix();   // Model(Object) To World
     Matrix m_worldITRow = Matrix(); // InverseTranspose
 
@@ -54,14 +151,36 @@ class Model {
     MaterialConstants m_materialConstsCPU;
 
     bool m_drawNormals = false;
-    bool m_isVisible = true;
-    bool m_castShadow = true;
+    bool m_useClusterCulling = true;
+
+    // Model space bounds of all meshes
+    Vector3 m_boundingBoxMin = Vector3(0.0f);
+    Vector3 m_boundingBoxMax = Vector3(0.0f);
+
+    // CPU copy of all meshes for the occlusion rasterizer
+    std::vector<Vector3> m_occluderPositions;
+    std::vector<uint32_t> m_occluderIndices;
 
     int m_instanceCount = MAX_INSTANCE;
 
     std::vector<shared_ptr<Mesh>> m_meshes;
+    std::vector<MeshTextureSources> m_textureSources; // per mesh
+
+    // Of Initialize(basePath, filename), empty for generated meshes
+    std::string m_basePath;
+    std::string m_filename;
 
   private:
+    static void AddTextureReloads(const shared_ptr<Model> &model,
+                                  HotReload &hotReload,
+                                  ComPtr<ID3D11Device> &device,
+                                  ComPtr<ID3D11DeviceContext> &context);
+
+    void RenderMesh(ComPtr<ID3D11DeviceContext> &context, const Mesh &mesh,
+                    const std::vector<IndexRange> *drawRanges,
+                    bool useInstancing, UINT startInstance = 0,
+                    bool bindMaps = true);
+
     ComPtr<ID3D11Buffer> m_meshConstsGPU;
     ComPtr<ID3D11Buffer> m_instancedConstsGPU;
     ComPtr<ID3D11Buffer> m_materialConstsGPU;
@@ -2,8 +2,12 @@
 
 #include <DirectXMesh.h>
 #include <filesystem>
+#include <sstream>
 #include <vector>
 
+#include "JobSystem.h"
+#include "MemoryArena.h"
+
 namespace jRenderer {
 
 using namespace std;
@@ -17,8 +21,13 @@ void UpdateNormals(vector<MeshData> &meshes) {
     // https://github.com/microsoft/DirectXMesh/wiki/ComputeNormals
 
     for (auto &m : meshes) {
-        vector<Vector3> normalsTemp(m.vertices.size(), Vector3(0.0f));
-        vector<float> weightsTemp(m.vertices.size(), 0.0f);
+        ScratchScope scratch;
+        Vector3 *normalsTemp =
+            scratch.AllocateArray<Vector3>(m.vertices.size(), "Normals");
+        float *weightsTemp =
+            scratch.AllocateArray<float>(m.vertices.size(), "Normals");
+        std::fill_n(normalsTemp, m.vertices.size(), Vector3(0.0f));
+        std::fill_n(weightsTemp, m.vertices.size(), 0.0f);
 
         for (int i = 0; i < m.indices.size(); i += 3) {
             int idx0 = m.indices[i];
@@ -80,6 +89,24 @@ void ModelLoader::Load(std::string basePath, std::string filename,
     } else {
         Matrix tr; // Initial transformation
         ProcessNode(pScene->mRootNode, pScene, tr);
+
+        // The node walk only collects meshes, they are converted in parallel.
+        const size_t base = meshes.size();
+        meshes.resize(base + m_pendingMeshes.size());
+        JobSystem::ParallelFor(
+            uint32_t(m_pendingMeshes.size()), 1,
+            [&](uint32_t begin, uint32_t end) {
+                for (uint32_t i = begin; i < end; i++) {
+                    const auto &pending = m_pendingMeshes[i];
+                    auto &newMesh = meshes[base + i];
+                    newMesh = ProcessMesh(pending.mesh, pScene);
+                    for (auto &v : newMesh.vertices) {
+                        v.position =
+                            Vector3::Transform(v.position, pending.transform);
+                    }
+                }
+            });
+        m_pendingMeshes.clear();
     }
     cout << pScene->mRootNode->mNumChildren << endl;
     // UpdateNormals(this->meshes); // Vertex Normal   ()
@@ -94,30 +121,40 @@ void ModelLoader::UpdateTangents() {
 
     using namespace DirectX;
 
-    for (auto &m : this->meshes) {
-
-        vector<XMFLOAT3> positions(m.vertices.size());
-        vector<XMFLOAT3> normals(m.vertices.size());
-        vector<XMFLOAT2> texcoords(m.vertices.size());
-        vector<XMFLOAT3> tangents(m.vertices.size());
-        vector<XMFLOAT3> bitangents(m.vertices.size());
-
-        for (size_t i = 0; i < m.vertices.size(); i++) {
-            auto &v = m.vertices[i];
-            positions[i] = v.position;
-            normals[i] = v.normalModel;
-            texcoords[i] = v.texcoord;
-        }
-
-        ComputeTangentFrame(m.indices.data(), m.indices.size() / 3,
-                            positions.data(), normals.data(), texcoords.data(),
-                            m.vertices.size(), tangents.data(),
-                            bitangents.data());
-
-        for (size_t i = 0; i < m.vertices.size(); i++) {
-            m.vertices[i].tangentModel = tangents[i];
-        }
-    }
+    JobSystem::ParallelFor(
+        uint32_t(this->meshes.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t k = begin; k < end; k++) {
+                auto &m = this->meshes[k];
+
+                // From the scratch arena of the job thread, reused by the
+                // next mesh. The bitangents aren't kept, so not computed.
+                ScratchScope scratch;
+                const size_t count = m.vertices.size();
+                auto *positions =
+                    scratch.AllocateArray<XMFLOAT3>(count, "Tangents");
+                auto *normals =
+                    scratch.AllocateArray<XMFLOAT3>(count, "Tangents");
+                auto *texcoords =
+                    scratch.AllocateArray<XMFLOAT2>(count, "Tangents");
+                auto *tangents =
+                    scratch.AllocateArray<XMFLOAT3>(count, "Tangents");
+
+                for (size_t i = 0; i < m.vertices.size(); i++) {
+                    auto &v = m.vertices[i];
+                    positions[i] = v.position;
+                    normals[i] = v.normalModel;
+                    texcoords[i] = v.texcoord;
+                }
+
+                ComputeTangentFrame(m.indices.data(), m.indices.size() / 3,
+                                    positions, normals, texcoords, count,
+                                    tangents, nullptr);
+
+                for (size_t i = 0; i < m.vertices.size(); i++) {
+                    m.vertices[i].tangentModel = tangents[i];
+                }
+            }
+        });
 }
 
 void ModelLoader::ProcessNode(aiNode *node, const aiScene *scene, Matrix tr) {
@@ -136,13 +173,7 @@ void ModelLoader::ProcessNode(aiNode *node, const aiScene *scene, Matrix tr) {
     for (UINT i = 0; i < node->mNumMeshes; i++) {
 
         aiMesh *mesh = scene->mMeshes[node->mMeshes[i]];
-        auto newMesh = this->ProcessMesh(mesh, scene);
-
-        for (auto &v : newMesh.vertices) {
-            v.position = DirectX::SimpleMath::Vector3::Transform(v.position, m);
-        }
-
-        meshes.push_back(newMesh);
+        m_pendingMeshes.push_back({mesh, m});
     }
 
     for (UINT i = 0; i < node->mNumChildren; i++) {
@@ -244,11 +275,13 @@ MeshData ModelLoader::ProcessMesh(aiMesh *mesh, const aiScene *scene) {
                 ReadFilename(material, aiTextureType_LIGHTMAP);
         }
 
-        // 
-         for (size_t i = 0; i < 22; i++) {
-            cout << i << " " << ReadFilename(material, aiTextureType(i))
-                 << endl;
+        //  (޽ ķ óǹǷ   )
+        std::ostringstream log;
+        for (size_t i = 0; i < 22; i++) {
+            log << i << " " << ReadFilename(material, aiTextureType(i))
+                << "\n";
         }
+        cout << log.str() << flush;
     }
 
     return newMesh;
@@ -32,6 +32,14 @@ class ModelLoader {
     std::vector<MeshData> meshes;
     bool m_isGLTF = false; // gltf or fbx
     bool m_revertNormals = false;
+
+  private:
+    // Collected by ProcessNode(), converted in parallel by Load()
+    struct PendingMesh {
+        aiMesh *mesh;
+        DirectX::SimpleMath::Matrix transform;
+    };
+    std::vector<PendingMesh> m_pendingMeshes;
 };
 
 } // namespace jRenederer
\ No newline at end of file
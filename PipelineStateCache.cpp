@@ -0,0 +1,259 @@
+#include "PipelineStateCache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#include "Hash.h"
+
+namespace jRenderer {
+
+namespace {
+
+static_assert(sizeof(D3D11_RASTERIZER_DESC) == 10 * 4,
+              "D3D11_RASTERIZER_DESC is packed as is");
+static_assert(sizeof(D3D11_SAMPLER_DESC) == 13 * 4,
+              "D3D11_SAMPLER_DESC is packed as is");
+
+uint32_t ToWord(float value) {
+    uint32_t word;
+    memcpy(&word, &value, sizeof(word));
+    return word;
+}
+
+template <typename Key, typename Desc> Key PackAsIs(const Desc &desc) {
+    Key key;
+    memcpy(key.data(), &desc, sizeof(desc));
+    return key;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+} // namespace
+
+GraphicsPSODesc::GraphicsPSODesc()
+    : rasterizer(CD3D11_RASTERIZER_DESC(D3D11_DEFAULT)),
+      blend(CD3D11_BLEND_DESC(D3D11_DEFAULT)),
+      depthStencil(CD3D11_DEPTH_STENCIL_DESC(D3D11_DEFAULT)) {}
+
+GraphicsPSODesc::GraphicsPSODesc(const GraphicsPSO &pso) : GraphicsPSODesc() {
+    vertexShader = pso.m_vertexShader.Get();
+    pixelShader = pso.m_pixelShader.Get();
+    hullShader = pso.m_hullShader.Get();
+    domainShader = pso.m_domainShader.Get();
+    geometryShader = pso.m_geometryShader.Get();
+    inputLayout = pso.m_inputLayout.Get();
+    if (pso.m_rasterizerState)
+        pso.m_rasterizerState->GetDesc(&rasterizer);
+    if (pso.m_blendState)
+        pso.m_blendState->GetDesc(&blend);
+    if (pso.m_depthStencilState)
+        pso.m_depthStencilState->GetDesc(&depthStencil);
+    memcpy(blendFactor, pso.m_blendFactor, sizeof(blendFactor));
+    stencilRef = pso.m_stencilRef;
+    primitiveTopology = pso.m_primitiveTopology;
+}
+
+template <typename Key>
+size_t PipelineStateCache::KeyHash::operator()(const Key &key) const {
+    SignatureHash hash;
+    hash.Add(key.data(), sizeof(key));
+    return size_t(hash.Get());
+}
+
+void PipelineStateCache::Initialize(ComPtr<ID3D11Device> &device) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_device = device;
+}
+
+void PipelineStateCache::Shutdown() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_pipelineStates.clear();
+    m_rasterizerStates.clear();
+    m_blendStates.clear();
+    m_depthStencilStates.clear();
+    m_samplerStates.clear();
+    m_device.Reset();
+}
+
+template <typename Key, typename Value, typename Create>
+const Value &PipelineStateCache::Find(Table<Key, Value> &table,
+                                      const Key &key, Create &&create) {
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        const auto found = table.find(key);
+        if (found != table.end()) {
+            m_hits.fetch_add(1, std::memory_order_relaxed);
+            return found->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    // Another thread may have created it in between
+    const auto found = table.find(key);
+    if (found != table.end()) {
+        m_hits.fetch_add(1, std::memory_order_relaxed);
+        return found->second;
+    }
+    const auto start = std::chrono::steady_clock::now();
+    Value value = create();
+    const double ms = MillisecondsSince(start);
+    m_stats.misses++;
+    m_stats.createMs += ms;
+    if (!m_isLoading) {
+        m_stats.stalls++;
+        m_stats.stallMs += ms;
+        m_stats.maxStallMs = std::max(m_stats.maxStallMs, ms);
+    }
+    // Nodes don't move, the reference stays valid until it is erased.
+    return table.emplace(key, std::move(value)).first->second;
+}
+
+ID3D11RasterizerState *
+PipelineStateCache::GetRasterizerState(const D3D11_RASTERIZER_DESC &desc) {
+    const auto key = PackAsIs<RasterizerKey>(desc);
+    const auto &state = Find(m_rasterizerStates, key, [&] {
+        ComPtr<ID3D11RasterizerState> created;
+        ThrowIfFailed(m_device->CreateRasterizerState(
+            &desc, created.GetAddressOf()));
+        return created;
+    });
+    return state.Get();
+}
+
+ID3D11BlendState *
+PipelineStateCache::GetBlendState(const D3D11_BLEND_DESC &desc) {
+    BlendKey key;
+    uint32_t *word = key.data();
+    *word++ = uint32_t(desc.AlphaToCoverageEnable);
+    *word++ = uint32_t(desc.IndependentBlendEnable);
+    for (const auto &target : desc.RenderTarget) {
+        *word++ = uint32_t(target.BlendEnable);
+        *word++ = uint32_t(target.SrcBlend);
+        *word++ = uint32_t(target.DestBlend);
+        *word++ = uint32_t(target.BlendOp);
+        *word++ = uint32_t(target.SrcBlendAlpha);
+        *word++ = uint32_t(target.DestBlendAlpha);
+        *word++ = uint32_t(target.BlendOpAlpha);
+        *word++ = uint32_t(target.RenderTargetWriteMask);
+    }
+    const auto &state = Find(m_blendStates, key, [&] {
+        ComPtr<ID3D11BlendState> created;
+        ThrowIfFailed(
+            m_device->CreateBlendState(&desc, created.GetAddressOf()));
+        return created;
+    });
+    return state.Get();
+}
+
+ID3D11DepthStencilState *PipelineStateCache::GetDepthStencilState(
+    const D3D11_DEPTH_STENCIL_DESC &desc) {
+    DepthStencilKey key;
+    uint32_t *word = key.data();
+    *word++ = uint32_t(desc.DepthEnable);
+    *word++ = uint32_t(desc.DepthWriteMask);
+    *word++ = uint32_t(desc.DepthFunc);
+    *word++ = uint32_t(desc.StencilEnable);
+    *word++ = uint32_t(desc.StencilReadMask);
+    *word++ = uint32_t(desc.StencilWriteMask);
+    for (const auto *face : {&desc.FrontFace, &desc.BackFace}) {
+        *word++ = uint32_t(face->StencilFailOp);
+        *word++ = uint32_t(face->StencilDepthFailOp);
+        *word++ = uint32_t(face->StencilPassOp);
+        *word++ = uint32_t(face->StencilFunc);
+    }
+    const auto &state = Find(m_depthStencilStates, key, [&] {
+        ComPtr<ID3D11DepthStencilState> created;
+        ThrowIfFailed(m_device->CreateDepthStencilState(
+            &desc, created.GetAddressOf()));
+        return created;
+    });
+    return state.Get();
+}
+
+ID3D11SamplerState *
+PipelineStateCache::GetSamplerState(const D3D11_SAMPLER_DESC &desc) {
+    const auto key = PackAsIs<SamplerKey>(desc);
+    const auto &state = Find(m_samplerStates, key, [&] {
+        ComPtr<ID3D11SamplerState> created;
+        ThrowIfFailed(m_device->CreateSamplerState(
+            &desc, created.GetAddressOf()));
+        return created;
+    });
+    return state.Get();
+}
+
+const GraphicsPSO &
+PipelineStateCache::GetPipelineState(const GraphicsPSODesc &desc) {
+    // The states are unique per description, so their pointers stand in
+    // for the descriptions in the key.
+    ID3D11RasterizerState *rasterizerState =
+        GetRasterizerState(desc.rasterizer);
+    ID3D11BlendState *blendState = GetBlendState(desc.blend);
+    ID3D11DepthStencilState *depthStencilState =
+        GetDepthStencilState(desc.depthStencil);
+
+    const PipelineKey key = {
+        uint64_t(uintptr_t(desc.vertexShader)),
+        uint64_t(uintptr_t(desc.pixelShader)),
+        uint64_t(uintptr_t(desc.hullShader)),
+        uint64_t(uintptr_t(desc.domainShader)),
+        uint64_t(uintptr_t(desc.geometryShader)),
+        uint64_t(uintptr_t(desc.inputLayout)),
+        uint64_t(uintptr_t(rasterizerState)),
+        uint64_t(uintptr_t(blendState)),
+        uint64_t(uintptr_t(depthStencilState)),
+        ToWord(desc.blendFactor[0]),
+        ToWord(desc.blendFactor[1]),
+        ToWord(desc.blendFactor[2]),
+        ToWord(desc.blendFactor[3]),
+        desc.stencilRef,
+        uint64_t(desc.primitiveTopology)};
+    // The pipeline state holds references to the shaders, so their
+    // addresses can't be reused by other shaders while it is cached.
+    return Find(m_pipelineStates, key, [&] {
+        GraphicsPSO pso;
+        pso.m_vertexShader = desc.vertexShader;
+        pso.m_pixelShader = desc.pixelShader;
+        pso.m_hullShader = desc.hullShader;
+        pso.m_domainShader = desc.domainShader;
+        pso.m_geometryShader = desc.geometryShader;
+        pso.m_inputLayout = desc.inputLayout;
+        pso.m_rasterizerState = rasterizerState;
+        pso.m_blendState = blendState;
+        pso.m_depthStencilState = depthStencilState;
+        pso.SetBlendFactor(desc.blendFactor);
+        pso.m_stencilRef = desc.stencilRef;
+        pso.m_primitiveTopology = desc.primitiveTopology;
+        return pso;
+    });
+}
+
+void PipelineStateCache::ClearPipelineStates() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_pipelineStates.clear();
+}
+
+PipelineStateCacheStats PipelineStateCache::GetStats() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    PipelineStateCacheStats stats = m_stats;
+    stats.rasterizerStates = uint32_t(m_rasterizerStates.size());
+    stats.blendStates = uint32_t(m_blendStates.size());
+    stats.depthStencilStates = uint32_t(m_depthStencilStates.size());
+    stats.samplerStates = uint32_t(m_samplerStates.size());
+    stats.pipelineStates = uint32_t(m_pipelineStates.size());
+    stats.hits = m_hits.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void PipelineStateCache::ResetStats() {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    m_stats = PipelineStateCacheStats();
+    m_hits = 0;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+
+#include "GraphicsPSO.h"
+
+namespace jRenderer {
+
+// Everything a GraphicsPSO is made of, with the fixed function states as
+// descriptions. Starts as the D3D11 defaults, which is what a null state
+// means when it is set.
+struct GraphicsPSODesc {
+    GraphicsPSODesc();
+    // The descriptions of the states of pso, e.g. to change one of them
+    explicit GraphicsPSODesc(const GraphicsPSO &pso);
+
+    ID3D11VertexShader *vertexShader = nullptr;
+    ID3D11PixelShader *pixelShader = nullptr;
+    ID3D11HullShader *hullShader = nullptr;
+    ID3D11DomainShader *domainShader = nullptr;
+    ID3D11GeometryShader *geometryShader = nullptr;
+    ID3D11InputLayout *inputLayout = nullptr;
+
+    D3D11_RASTERIZER_DESC rasterizer;
+    D3D11_BLEND_DESC blend;
+    D3D11_DEPTH_STENCIL_DESC depthStencil;
+
+    float blendFactor[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+    UINT stencilRef = 0;
+    D3D11_PRIMITIVE_TOPOLOGY primitiveTopology =
+        D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+};
+
+struct PipelineStateCacheStats {
+    uint32_t rasterizerStates = 0;
+    uint32_t blendStates = 0;
+    uint32_t depthStencilStates = 0;
+    uint32_t samplerStates = 0;
+    uint32_t pipelineStates = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    double createMs = 0.0; // of all the misses
+    // Misses after loading, states created while frames were running
+    uint32_t stalls = 0;
+    double stallMs = 0.0;
+    double maxStallMs = 0.0;
+};
+
+// Creates every state once per description. The key is the description
+// itself, packed without padding and hashed, so two passes asking for the
+// same state share one object. A hit is a lookup under a shared lock and
+// allocates nothing, only a miss creates the state and takes the lock
+// exclusively. Any thread.
+// States live as long as the cache, pipeline states until
+// ClearPipelineStates(), since they hold on to their shaders.
+class PipelineStateCache {
+  public:
+    void Initialize(ComPtr<ID3D11Device> &device);
+    // Releases everything, the device too
+    void Shutdown();
+
+    ID3D11RasterizerState *GetRasterizerState(
+        const D3D11_RASTERIZER_DESC &desc);
+    ID3D11BlendState *GetBlendState(const D3D11_BLEND_DESC &desc);
+    ID3D11DepthStencilState *GetDepthStencilState(
+        const D3D11_DEPTH_STENCIL_DESC &desc);
+    ID3D11SamplerState *GetSamplerState(const D3D11_SAMPLER_DESC &desc);
+    const GraphicsPSO &GetPipelineState(const GraphicsPSODesc &desc);
+
+    // E.g. when the shaders were created again. Not while another thread
+    // still uses a pipeline state it got.
+    void ClearPipelineStates();
+
+    // Misses are counted as stalls once loading is over
+    void SetLoading(bool isLoading) { m_isLoading = isLoading; }
+
+    PipelineStateCacheStats GetStats() const;
+    void ResetStats();
+
+  private:
+    // Descriptions as 32 bit words, without the padding of the structs
+    using RasterizerKey =
+        std::array<uint32_t, sizeof(D3D11_RASTERIZER_DESC) / 4>;
+    using BlendKey = std::array<uint32_t, 2 + 8 * 8>;
+    using DepthStencilKey = std::array<uint32_t, 6 + 2 * 4>;
+    using SamplerKey = std::array<uint32_t, sizeof(D3D11_SAMPLER_DESC) / 4>;
+    // Shaders, input layout and states as pointers, then the rest
+    using PipelineKey = std::array<uint64_t, 9 + 4 + 2>;
+
+    struct KeyHash {
+        template <typename Key> size_t operator()(const Key &key) const;
+    };
+    template <typename Key, typename Value>
+    using Table = std::unordered_map<Key, Value, KeyHash>;
+
+    template <typename Key, typename Value, typename Create>
+    const Value &Find(Table<Key, Value> &table, const Key &key,
+                      Create &&create);
+
+    ComPtr<ID3D11Device> m_device;
+    std::atomic<bool> m_isLoading = true;
+    std::atomic<uint64_t> m_hits = 0;
+
+    mutable std::shared_mutex m_mutex; // everything below
+    Table<RasterizerKey, ComPtr<ID3D11RasterizerState>> m_rasterizerStates;
+    Table<BlendKey, ComPtr<ID3D11BlendState>> m_blendStates;
+    Table<DepthStencilKey, ComPtr<ID3D11DepthStencilState>>
+        m_depthStencilStates;
+    Table<SamplerKey, ComPtr<ID3D11SamplerState>> m_samplerStates;
+    Table<PipelineKey, GraphicsPSO> m_pipelineStates;
+    PipelineStateCacheStats m_stats; // all but the sizes and hits
+};
+
+} // namespace jRenderer
@@ -0,0 +1,95 @@
+#include "RenderTargetPool.h"
+
+namespace jRenderer {
+
+uint32_t RenderTargetPool::Request(UINT width, UINT height, DXGI_FORMAT format,
+                                   UINT bindFlags, uint32_t firstPass,
+                                   uint32_t lastPass, UINT sampleCount) {
+    return m_allocator.Request(
+        MakeDesc(width, height, format, bindFlags, sampleCount), firstPass,
+        lastPass);
+}
+
+void RenderTargetPool::Allocate(ComPtr<ID3D11Device> &device) {
+    m_allocator.Allocate();
+
+    vector<PooledTarget> oldTargets;
+    oldTargets.swap(m_targets);
+    m_targets.resize(m_allocator.GetNumTextures());
+    for (uint32_t t = 0; t < m_allocator.GetNumTextures(); t++) {
+        auto &target = m_targets[t];
+        target.desc = m_allocator.GetTextureDesc(t);
+        for (auto &oldTarget : oldTargets) {
+            if (oldTarget.texture && oldTarget.desc.SameKey(target.desc)) {
+                target = std::move(oldTarget);
+                break;
+            }
+        }
+        if (target.texture)
+            continue;
+
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = target.desc.width;
+        desc.Height = target.desc.height;
+        desc.MipLevels = desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT(target.desc.format);
+        desc.SampleDesc.Count = target.desc.sampleCount;
+        desc.SampleDesc.Quality = 0;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = target.desc.bindFlags;
+        ThrowIfFailed(device->CreateTexture2D(&desc, NULL,
+                                              target.texture.GetAddressOf()));
+        if (desc.BindFlags & D3D11_BIND_RENDER_TARGET) {
+            ThrowIfFailed(device->CreateRenderTargetView(
+                target.texture.Get(), NULL, target.rtv.GetAddressOf()));
+        }
+        if (desc.BindFlags & D3D11_BIND_SHADER_RESOURCE) {
+            ThrowIfFailed(device->CreateShaderResourceView(
+                target.texture.Get(), NULL, target.srv.GetAddressOf()));
+        }
+        if (desc.BindFlags & D3D11_BIND_UNORDERED_ACCESS) {
+            ThrowIfFailed(device->CreateUnorderedAccessView(
+                target.texture.Get(), NULL, target.uav.GetAddressOf()));
+        }
+    }
+}
+
+TransientTextureDesc RenderTargetPool::MakeDesc(UINT width, UINT height,
+                                               DXGI_FORMAT format,
+                                               UINT bindFlags,
+                                               UINT sampleCount) {
+    TransientTextureDesc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.format = uint32_t(format);
+    desc.bindFlags = bindFlags;
+    desc.sampleCount = sampleCount;
+    desc.bytesPerPixel = GetBytesPerPixel(format);
+    return desc;
+}
+
+uint32_t RenderTargetPool::GetBytesPerPixel(DXGI_FORMAT format) {
+    switch (format) {
+    case DXGI_FORMAT_R32G32B32A32_FLOAT:
+        return 16;
+    case DXGI_FORMAT_R16G16B16A16_FLOAT:
+    case DXGI_FORMAT_R32G32_FLOAT:
+        return 8;
+    case DXGI_FORMAT_R8G8B8A8_UNORM:
+    case DXGI_FORMAT_R10G10B10A2_UNORM:
+    case DXGI_FORMAT_R11G11B10_FLOAT:
+    case DXGI_FORMAT_R16G16_FLOAT:
+    case DXGI_FORMAT_R16G16_UNORM:
+    case DXGI_FORMAT_R32_FLOAT:
+        return 4;
+    case DXGI_FORMAT_R16_FLOAT:
+    case DXGI_FORMAT_R8G8_UNORM:
+        return 2;
+    case DXGI_FORMAT_R8_UNORM:
+        return 1;
+    default:
+        return 0; // not counted in the stats
+    }
+}
+
+} // namespace jRenderer
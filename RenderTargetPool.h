@@ -0,0 +1,48 @@
+#pragma once
+
+#include "D3D11Utils.h"
+#include "TransientAllocator.h"
+
+namespace jRenderer {
+
+// A pooled texture with the views its bind flags allow
+struct PooledTarget {
+    TransientTextureDesc desc;
+    ComPtr<ID3D11Texture2D> texture;
+    ComPtr<ID3D11RenderTargetView> rtv;
+    ComPtr<ID3D11ShaderResourceView> srv;
+    ComPtr<ID3D11UnorderedAccessView> uav;
+};
+
+// Intermediate render targets of a frame. Targets are requested with the
+// passes they live in, then Allocate() lets targets whose passes don't
+// overlap share a texture. Textures with an unchanged key are kept from
+// the last Allocate(), so only what changed is created again.
+class RenderTargetPool {
+  public:
+    // Returns the handle for Get(), valid after Allocate()
+    uint32_t Request(UINT width, UINT height, DXGI_FORMAT format,
+                     UINT bindFlags, uint32_t firstPass, uint32_t lastPass,
+                     UINT sampleCount = 1);
+
+    void Allocate(ComPtr<ID3D11Device> &device);
+
+    // Forgets the requests, the textures are reused by the next Allocate()
+    void Reset() { m_allocator.Clear(); }
+
+    const PooledTarget &Get(uint32_t handle) const {
+        return m_targets[m_allocator.GetTexture(handle)];
+    }
+    const TransientStats &GetStats() const { return m_allocator.GetStats(); }
+
+    static TransientTextureDesc MakeDesc(UINT width, UINT height,
+                                         DXGI_FORMAT format, UINT bindFlags,
+                                         UINT sampleCount = 1);
+    static uint32_t GetBytesPerPixel(DXGI_FORMAT format);
+
+  private:
+    TransientAllocator m_allocator;
+    vector<PooledTarget> m_targets; // per allocator texture
+};
+
+} // namespace jRenderer
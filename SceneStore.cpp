@@ -0,0 +1,262 @@
+#include "SceneStore.h"
+
+#include <chrono>
+#include <cmath>
+#include <random>
+
+namespace jRenderer {
+
+namespace {
+
+Matrix GetWorldITRow(const Matrix &worldRow) {
+    Matrix worldITRow = worldRow;
+    worldITRow.Translation(Vector3(0.0f));
+    return worldITRow.Invert().Transpose();
+}
+
+// The world AABB of a model space box, from its center and extents
+// instead of its 8 corners.
+void TransformBounds(const Matrix &worldRow, const Vector3 &boxMin,
+                     const Vector3 &boxMax, Vector3 &worldMin,
+                     Vector3 &worldMax) {
+    const Vector3 center = (boxMin + boxMax) * 0.5f;
+    const Vector3 extents = (boxMax - boxMin) * 0.5f;
+    const Vector3 worldCenter = Vector3::Transform(center, worldRow);
+    const Matrix &m = worldRow;
+    const Vector3 worldExtents(std::fabs(m._11) * extents.x +
+                                   std::fabs(m._21) * extents.y +
+                                   std::fabs(m._31) * extents.z,
+                               std::fabs(m._12) * extents.x +
+                                   std::fabs(m._22) * extents.y +
+                                   std::fabs(m._32) * extents.z,
+                               std::fabs(m._13) * extents.x +
+                                   std::fabs(m._23) * extents.y +
+                                   std::fabs(m._33) * extents.z);
+    worldMin = worldCenter - worldExtents;
+    worldMax = worldCenter + worldExtents;
+}
+
+bool Overlaps(const Vector3 &minA, const Vector3 &maxA, const Vector3 &minB,
+              const Vector3 &maxB) {
+    return minA.x <= maxB.x && maxA.x >= minB.x && minA.y <= maxB.y &&
+           maxA.y >= minB.y && minA.z <= maxB.z && maxA.z >= minB.z;
+}
+
+// What the loops read of a Model, between the constants and meshes it
+// also has
+struct PointerObject {
+    Matrix worldRow;
+    uint8_t meshConsts[256];
+    Matrix worldITRow;
+    uint8_t materialConsts[256];
+    Vector3 boxMin;
+    Vector3 boxMax;
+    Vector3 worldBoxMin;
+    Vector3 worldBoxMax;
+    bool isVisible = true;
+    std::vector<uint8_t> meshes;
+};
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+} // namespace
+
+SceneHandle SceneStore::Add(const std::shared_ptr<Model> &model,
+                            const Matrix &worldRow, const Vector3 &boxMin,
+                            const Vector3 &boxMax, uint8_t flags) {
+    SceneHandle handle;
+    if (!m_freeSlots.empty()) {
+        handle.slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+    } else {
+        handle.slot = uint32_t(m_generations.size());
+        m_generations.push_back(0);
+        m_indices.push_back(0);
+    }
+    handle.generation = m_generations[handle.slot];
+    m_indices[handle.slot] = GetSize();
+
+    m_slots.push_back(handle.slot);
+    m_models.push_back(model);
+    m_worldRows.push_back(worldRow);
+    m_worldITRows.push_back(GetWorldITRow(worldRow));
+    m_localBoxMins.push_back(boxMin);
+    m_localBoxMaxs.push_back(boxMax);
+    m_worldBoxMins.emplace_back();
+    m_worldBoxMaxs.emplace_back();
+    TransformBounds(worldRow, boxMin, boxMax, m_worldBoxMins.back(),
+                    m_worldBoxMaxs.back());
+    m_flags.push_back(uint8_t(flags & ~SCENE_MOVED));
+    return handle;
+}
+
+void SceneStore::Remove(SceneHandle handle) {
+    if (!IsValid(handle))
+        return;
+    const uint32_t index = GetIndex(handle);
+    const uint32_t last = GetSize() - 1;
+    if (index != last) {
+        m_slots[index] = m_slots[last];
+        m_models[index] = std::move(m_models[last]);
+        m_worldRows[index] = m_worldRows[last];
+        m_worldITRows[index] = m_worldITRows[last];
+        m_localBoxMins[index] = m_localBoxMins[last];
+        m_localBoxMaxs[index] = m_localBoxMaxs[last];
+        m_worldBoxMins[index] = m_worldBoxMins[last];
+        m_worldBoxMaxs[index] = m_worldBoxMaxs[last];
+        m_flags[index] = m_flags[last];
+        m_indices[m_slots[index]] = index;
+    }
+    m_slots.pop_back();
+    m_models.pop_back();
+    m_worldRows.pop_back();
+    m_worldITRows.pop_back();
+    m_localBoxMins.pop_back();
+    m_localBoxMaxs.pop_back();
+    m_worldBoxMins.pop_back();
+    m_worldBoxMaxs.pop_back();
+    m_flags.pop_back();
+
+    m_generations[handle.slot]++;
+    m_freeSlots.push_back(handle.slot);
+}
+
+void SceneStore::Clear() {
+    m_slots.clear();
+    m_models.clear();
+    m_worldRows.clear();
+    m_worldITRows.clear();
+    m_localBoxMins.clear();
+    m_localBoxMaxs.clear();
+    m_worldBoxMins.clear();
+    m_worldBoxMaxs.clear();
+    m_flags.clear();
+    // Handles given out so far stay invalid
+    m_freeSlots.clear();
+    for (uint32_t slot = 0; slot < uint32_t(m_generations.size()); slot++) {
+        m_generations[slot]++;
+        m_freeSlots.push_back(slot);
+    }
+}
+
+void SceneStore::SetWorldRow(SceneHandle handle, const Matrix &worldRow) {
+    const uint32_t index = GetIndex(handle);
+    m_worldRows[index] = worldRow;
+    m_flags[index] |= SCENE_MOVED;
+}
+
+void SceneStore::SetFlags(SceneHandle handle, uint8_t flags, bool isSet) {
+    uint8_t &objectFlags = m_flags[GetIndex(handle)];
+    objectFlags = uint8_t(isSet ? objectFlags | flags : objectFlags & ~flags);
+}
+
+void SceneStore::SetLocalBounds(uint32_t index, const Vector3 &boxMin,
+                                const Vector3 &boxMax) {
+    m_localBoxMins[index] = boxMin;
+    m_localBoxMaxs[index] = boxMax;
+    m_flags[index] |= SCENE_MOVED;
+}
+
+void SceneStore::UpdateTransforms() {
+    for (uint32_t i = 0; i < GetSize(); i++) {
+        if (!(m_flags[i] & SCENE_MOVED))
+            continue;
+        m_worldITRows[i] = GetWorldITRow(m_worldRows[i]);
+        TransformBounds(m_worldRows[i], m_localBoxMins[i], m_localBoxMaxs[i],
+                        m_worldBoxMins[i], m_worldBoxMaxs[i]);
+        m_flags[i] &= ~SCENE_MOVED;
+    }
+}
+
+SceneBenchmark SceneStore::Benchmark(uint32_t numObjects, int iterations) {
+    using Clock = std::chrono::steady_clock;
+    SceneBenchmark result;
+    result.objects = numObjects;
+    iterations = iterations > 0 ? iterations : 1;
+
+    // The same objects both ways, a unit box spread over 200^3
+    std::mt19937 gen(0);
+    std::uniform_real_distribution<float> position(-100.0f, 100.0f);
+    std::uniform_int_distribution<size_t> meshBytes(64, 1024);
+    std::vector<Vector3> positions(numObjects);
+    for (auto &p : positions)
+        p = Vector3(position(gen), position(gen), position(gen));
+    const Vector3 boxMin(-0.5f), boxMax(0.5f);
+    // What the iteration counts, a part of the scene like a frustum would
+    const Vector3 queryMin(-50.0f), queryMax(50.0f);
+
+    SceneStore store;
+    std::vector<SceneHandle> handles(numObjects);
+    std::vector<std::shared_ptr<PointerObject>> objects(numObjects);
+    for (uint32_t i = 0; i < numObjects; i++) {
+        const Matrix worldRow = Matrix::CreateTranslation(positions[i]);
+        handles[i] = store.Add(nullptr, worldRow, boxMin, boxMax);
+
+        // Allocated one after the other with their meshes, like the models
+        auto object = std::make_shared<PointerObject>();
+        object->worldRow = worldRow;
+        object->boxMin = boxMin;
+        object->boxMax = boxMax;
+        object->meshes.resize(meshBytes(gen));
+        objects[i] = std::move(object);
+    }
+
+    auto start = Clock::now();
+    for (int r = 0; r < iterations; r++) {
+        const Vector3 offset(float(r & 1));
+        for (uint32_t i = 0; i < numObjects; i++) {
+            store.SetWorldRow(handles[i],
+                              Matrix::CreateTranslation(positions[i] + offset));
+        }
+        store.UpdateTransforms();
+    }
+    result.updateMs = MillisecondsSince(start) / iterations;
+
+    // The box moves, so the passes can't be folded into one.
+    uint32_t visible = 0;
+    start = Clock::now();
+    for (int r = 0; r < iterations; r++) {
+        const Vector3 offset(float(r & 1));
+        for (uint32_t i = 0; i < store.GetSize(); i++) {
+            visible += (store.m_flags[i] & SCENE_VISIBLE) &&
+                       Overlaps(store.m_worldBoxMins[i],
+                                store.m_worldBoxMaxs[i], queryMin + offset,
+                                queryMax + offset);
+        }
+    }
+    result.iterateMs = MillisecondsSince(start) / iterations;
+    result.visible = visible / uint32_t(iterations);
+
+    start = Clock::now();
+    for (int r = 0; r < iterations; r++) {
+        const Vector3 offset(float(r & 1));
+        for (uint32_t i = 0; i < numObjects; i++) {
+            auto &object = *objects[i];
+            object.worldRow = Matrix::CreateTranslation(positions[i] + offset);
+            object.worldITRow = GetWorldITRow(object.worldRow);
+            TransformBounds(object.worldRow, object.boxMin, object.boxMax,
+                            object.worldBoxMin, object.worldBoxMax);
+        }
+    }
+    result.pointerUpdateMs = MillisecondsSince(start) / iterations;
+
+    visible = 0;
+    start = Clock::now();
+    for (int r = 0; r < iterations; r++) {
+        const Vector3 offset(float(r & 1));
+        for (const auto &object : objects) {
+            visible += object->isVisible &&
+                       Overlaps(object->worldBoxMin, object->worldBoxMax,
+                                queryMin + offset, queryMax + offset);
+        }
+    }
+    result.pointerIterateMs = MillisecondsSince(start) / iterations;
+    result.pointerVisible = visible / uint32_t(iterations);
+    return result;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <memory>
+#include <vector>
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+
+class Model;
+
+enum SceneFlag : uint8_t {
+    SCENE_VISIBLE = 1 << 0,
+    SCENE_CAST_SHADOW = 1 << 1,
+    SCENE_OCCLUDER = 1 << 2, // rasterized by software occlusion culling
+    SCENE_OCCLUDED = 1 << 3, // updated by software occlusion culling
+    SCENE_MOVED = 1 << 4,    // until UpdateTransforms()
+};
+
+// An object of a SceneStore. The slot is reused after Remove(), the
+// generation tells the old object from the new one.
+struct SceneHandle {
+    uint32_t slot = UINT32_MAX;
+    uint32_t generation = 0;
+};
+
+struct SceneBenchmark {
+    uint32_t objects = 0;
+    uint32_t visible = 0;          // found by the iteration
+    uint32_t pointerVisible = 0;   // the same objects
+    double updateMs = 0.0;         // new world rows, then their bounds
+    double iterateMs = 0.0;        // flags and bounds against a box
+    double pointerUpdateMs = 0.0;  // the same, one shared_ptr per object
+    double pointerIterateMs = 0.0;
+};
+
+// The scene objects as one array per field, so the per frame loops over
+// all of them (culling, constants) read contiguous memory instead of a
+// heap object each. An object's index changes when another is removed,
+// keep a handle to find it again. The Model has the meshes and the GPU
+// resources, the store the per object state. Materials are per mesh
+// (Mesh::material), one object draws several of them, so there is no
+// material index per object here.
+class SceneStore {
+  public:
+    SceneHandle Add(const std::shared_ptr<Model> &model,
+                    const Matrix &worldRow, const Vector3 &boxMin,
+                    const Vector3 &boxMax,
+                    uint8_t flags = SCENE_VISIBLE | SCENE_CAST_SHADOW);
+    // The last object takes the index of the removed one.
+    void Remove(SceneHandle handle);
+    void Clear();
+
+    bool IsValid(SceneHandle handle) const {
+        return handle.slot < m_generations.size() &&
+               m_generations[handle.slot] == handle.generation;
+    }
+    uint32_t GetIndex(SceneHandle handle) const {
+        return m_indices[handle.slot];
+    }
+    uint32_t GetSize() const { return uint32_t(m_flags.size()); }
+
+    void SetWorldRow(SceneHandle handle, const Matrix &worldRow);
+    const Matrix &GetWorldRow(SceneHandle handle) const {
+        return m_worldRows[GetIndex(handle)];
+    }
+    void SetFlags(SceneHandle handle, uint8_t flags, bool isSet);
+    // Model space, e.g. after a hot reload changed the meshes
+    void SetLocalBounds(uint32_t index, const Vector3 &boxMin,
+                        const Vector3 &boxMax);
+
+    // World IT rows and world bounds of the objects moved since the last
+    // call, in one pass over the flags.
+    void UpdateTransforms();
+
+    // Adds numObjects objects without models and times the loops above
+    // against the same data behind a shared_ptr per object.
+    static SceneBenchmark Benchmark(uint32_t numObjects, int iterations);
+
+  public:
+    // Per object, by index. Changed through the functions above, except
+    // for SCENE_OCCLUDED.
+    std::vector<std::shared_ptr<Model>> m_models;
+    std::vector<Matrix> m_worldRows;
+    std::vector<Matrix> m_worldITRows; // InverseTranspose
+    std::vector<Vector3> m_localBoxMins;
+    std::vector<Vector3> m_localBoxMaxs;
+    std::vector<Vector3> m_worldBoxMins;
+    std::vector<Vector3> m_worldBoxMaxs;
+    std::vector<uint8_t> m_flags;
+
+  private:
+    std::vector<uint32_t> m_slots;       // per object
+    std::vector<uint32_t> m_indices;     // per slot
+    std::vector<uint32_t> m_generations; // per slot
+    std::vector<uint32_t> m_freeSlots;
+};
+
+} // namespace jRenderer
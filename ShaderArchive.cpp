@@ -0,0 +1,250 @@
+#include "ShaderArchive.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Hash.h"
+
+namespace jRenderer {
+
+namespace {
+
+constexpr uint32_t ARCHIVE_MAGIC = 0x4b415053; // "SPAK"
+constexpr uint32_t ARCHIVE_VERSION = 1;
+constexpr uint32_t BLOB_ALIGNMENT = 16;
+
+uint64_t HashName(const std::string &name) {
+    SignatureHash hash;
+    hash.Add(name.data(), name.size());
+    return hash.Get();
+}
+
+uint32_t AlignUp(uint32_t offset) {
+    return (offset + BLOB_ALIGNMENT - 1) & ~(BLOB_ALIGNMENT - 1);
+}
+
+} // namespace
+
+void ShaderArchiveWriter::Add(const std::string &name, uint64_t sourceHash,
+                              const std::vector<uint8_t> &bytecode) {
+    for (auto &shader : m_shaders) {
+        if (shader.name == name) {
+            shader.sourceHash = sourceHash;
+            shader.bytecode = bytecode;
+            return;
+        }
+    }
+    m_shaders.push_back({name, sourceHash, bytecode});
+}
+
+bool ShaderArchiveWriter::Write(const std::string &filename) const {
+    std::vector<ShaderArchiveEntry> entries(m_shaders.size());
+    uint32_t offset = uint32_t(sizeof(ShaderArchiveHeader) +
+                               sizeof(ShaderArchiveEntry) * entries.size());
+    for (size_t i = 0; i < m_shaders.size(); i++) {
+        entries[i].nameHash = HashName(m_shaders[i].name);
+        entries[i].sourceHash = m_shaders[i].sourceHash;
+        entries[i].nameOffset = offset;
+        entries[i].nameSize = uint32_t(m_shaders[i].name.size());
+        offset += entries[i].nameSize;
+    }
+    for (size_t i = 0; i < m_shaders.size(); i++) {
+        offset = AlignUp(offset);
+        entries[i].blobOffset = offset;
+        entries[i].blobSize = uint32_t(m_shaders[i].bytecode.size());
+        offset += entries[i].blobSize;
+    }
+
+    std::vector<uint8_t> file(offset, 0);
+    const ShaderArchiveHeader header = {ARCHIVE_MAGIC, ARCHIVE_VERSION,
+                                        uint32_t(entries.size()), offset};
+    memcpy(file.data(), &header, sizeof(header));
+    for (size_t i = 0; i < m_shaders.size(); i++) {
+        memcpy(file.data() + entries[i].nameOffset,
+               m_shaders[i].name.data(), entries[i].nameSize);
+        if (entries[i].blobSize) {
+            memcpy(file.data() + entries[i].blobOffset,
+                   m_shaders[i].bytecode.data(), entries[i].blobSize);
+        }
+    }
+    // The table last, sorting doesn't move the names and blobs.
+    std::sort(entries.begin(), entries.end(),
+              [](const ShaderArchiveEntry &a, const ShaderArchiveEntry &b) {
+                  return a.nameHash < b.nameHash;
+              });
+    if (!entries.empty()) {
+        memcpy(file.data() + sizeof(header), entries.data(),
+               sizeof(ShaderArchiveEntry) * entries.size());
+    }
+
+    std::ofstream stream(filename, std::ios::binary);
+    stream.write(reinterpret_cast<const char *>(file.data()),
+                 std::streamsize(file.size()));
+    return bool(stream);
+}
+
+bool ShaderArchive::Open(const std::string &filename) {
+    Close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ,
+                              FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    HANDLE mapping = NULL;
+    if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (!mapping) {
+        CloseHandle(file);
+        return false;
+    }
+    m_data = static_cast<const uint8_t *>(
+        MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+    m_file = file;
+    m_mapping = mapping;
+    m_size = size_t(size.QuadPart);
+#else
+    const int file = open(filename.c_str(), O_RDONLY);
+    if (file < 0)
+        return false;
+    struct stat info;
+    void *data = MAP_FAILED;
+    if (fstat(file, &info) == 0 && info.st_size > 0)
+        data = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_PRIVATE,
+                    file, 0);
+    close(file);
+    if (data != MAP_FAILED) {
+        m_data = static_cast<const uint8_t *>(data);
+        m_size = size_t(info.st_size);
+    }
+#endif
+    if (!m_data) {
+        Close();
+        return false;
+    }
+
+    // Everything the table points at has to be inside the file.
+    const auto *header =
+        reinterpret_cast<const ShaderArchiveHeader *>(m_data);
+    bool isValid = m_size >= sizeof(ShaderArchiveHeader) &&
+                   header->magic == ARCHIVE_MAGIC &&
+                   header->version == ARCHIVE_VERSION &&
+                   header->fileSize == m_size &&
+                   header->count <= (m_size - sizeof(ShaderArchiveHeader)) /
+                                        sizeof(ShaderArchiveEntry);
+    const auto *entries = reinterpret_cast<const ShaderArchiveEntry *>(
+        m_data + sizeof(ShaderArchiveHeader));
+    for (uint32_t i = 0; isValid && i < header->count; i++) {
+        isValid = uint64_t(entries[i].nameOffset) + entries[i].nameSize <=
+                      m_size &&
+                  uint64_t(entries[i].blobOffset) + entries[i].blobSize <=
+                      m_size;
+    }
+    if (!isValid) {
+        Close();
+        return false;
+    }
+    m_header = header;
+    m_entries = entries;
+    return true;
+}
+
+void ShaderArchive::Close() {
+#ifdef _WIN32
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+#else
+    if (m_data)
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_file = nullptr;
+    m_mapping = nullptr;
+}
+
+const ShaderArchiveEntry *ShaderArchive::Find(const std::string &name) const {
+    if (!m_header)
+        return nullptr;
+    const uint64_t hash = HashName(name);
+    const auto *end = m_entries + m_header->count;
+    auto *entry = std::lower_bound(
+        m_entries, end, hash, [](const ShaderArchiveEntry &e, uint64_t h) {
+            return e.nameHash < h;
+        });
+    // Names with the same hash are next to each other.
+    for (; entry != end && entry->nameHash == hash; entry++) {
+        if (entry->nameSize == name.size() &&
+            !memcmp(m_data + entry->nameOffset, name.data(), name.size()))
+            return entry;
+    }
+    return nullptr;
+}
+
+std::string ShaderArchive::GetName(const ShaderKey &key) {
+    char flags[16];
+    snprintf(flags, sizeof(flags), "%x", key.flags);
+    std::string name =
+        key.filename + "|" + key.entryPoint + "|" + key.profile + "|" + flags;
+    for (const auto &define : key.defines)
+        name += "|" + define.first + "=" + define.second;
+    return name;
+}
+
+ShaderArchiveBenchmark
+ShaderArchive::Benchmark(const std::string &filename,
+                         const std::vector<std::string> &names,
+                         int iterations) {
+    using Clock = std::chrono::steady_clock;
+    ShaderArchiveBenchmark result;
+    ShaderArchive archive;
+    iterations = iterations > 0 ? iterations : 1;
+
+    auto start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        archive.Open(filename);
+        archive.Close();
+    }
+    result.openUs =
+        std::chrono::duration<double, std::micro>(Clock::now() - start)
+            .count() /
+        iterations;
+
+    if (!archive.Open(filename) || names.empty())
+        return result;
+    result.shaders = archive.GetNumShaders();
+    uint32_t found = 0;
+    start = Clock::now();
+    for (int i = 0; i < iterations; i++) {
+        for (const auto &name : names)
+            found += archive.Find(name) != nullptr;
+    }
+    result.lookupNs =
+        std::chrono::duration<double, std::nano>(Clock::now() - start)
+            .count() /
+        (double(iterations) * double(names.size()));
+    result.found = found / uint32_t(iterations);
+    return result;
+}
+
+} // namespace jRenderer
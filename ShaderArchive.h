@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "ShaderCache.h"
+
+namespace jRenderer {
+
+// Layout of a shader archive file:
+//   ShaderArchiveHeader
+//   ShaderArchiveEntry[count], sorted by nameHash
+//   names, then the blobs, each 16 byte aligned
+struct ShaderArchiveHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t count;
+    uint32_t fileSize;
+};
+
+struct ShaderArchiveEntry {
+    uint64_t nameHash;
+    uint64_t sourceHash; // ShaderCache::ComputeHash() when it was built
+    uint32_t nameOffset; // from the start of the file
+    uint32_t nameSize;
+    uint32_t blobOffset;
+    uint32_t blobSize;
+};
+
+// Collects the compiled shaders and writes them as one archive
+class ShaderArchiveWriter {
+  public:
+    void Add(const std::string &name, uint64_t sourceHash,
+             const std::vector<uint8_t> &bytecode);
+    bool Write(const std::string &filename) const;
+
+    uint32_t GetNumShaders() const { return uint32_t(m_shaders.size()); }
+
+  private:
+    struct Shader {
+        std::string name;
+        uint64_t sourceHash;
+        std::vector<uint8_t> bytecode;
+    };
+    std::vector<Shader> m_shaders;
+};
+
+struct ShaderArchiveBenchmark {
+    uint32_t shaders = 0;
+    uint32_t found = 0;    // of the names, in the archive
+    double openUs = 0.0;   // Open() and Close()
+    double lookupNs = 0.0; // Find() of a name in the archive
+};
+
+// A memory mapped archive. The blobs are used in place, the file is only
+// read by the pages the device touches.
+class ShaderArchive {
+  public:
+    ShaderArchive() = default;
+    ~ShaderArchive() { Close(); }
+    ShaderArchive(const ShaderArchive &) = delete;
+    ShaderArchive &operator=(const ShaderArchive &) = delete;
+
+    // False when the file is missing or isn't a valid archive
+    bool Open(const std::string &filename);
+    void Close();
+    bool IsOpen() const { return m_data != nullptr; }
+
+    // Null when the archive doesn't have the shader
+    const ShaderArchiveEntry *Find(const std::string &name) const;
+    const uint8_t *GetBlob(const ShaderArchiveEntry &entry) const {
+        return m_data + entry.blobOffset;
+    }
+    uint32_t GetNumShaders() const { return m_header ? m_header->count : 0; }
+
+    // The name a shader is stored under, the key without the sources
+    static std::string GetName(const ShaderKey &key);
+
+    // Opens the archive the given times, then looks up every name
+    static ShaderArchiveBenchmark
+    Benchmark(const std::string &filename,
+              const std::vector<std::string> &names, int iterations);
+
+  private:
+    const uint8_t *m_data = nullptr;
+    size_t m_size = 0;
+    const ShaderArchiveHeader *m_header = nullptr;
+    const ShaderArchiveEntry *m_entries = nullptr;
+    void *m_file = nullptr;    // HANDLE on Windows
+    void *m_mapping = nullptr; // HANDLE on Windows
+};
+
+} // namespace jRenderer
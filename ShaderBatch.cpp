@@ -0,0 +1,111 @@
+#include "ShaderBatch.h"
+
+#include <chrono>
+#include <thread>
+
+#include "JobSystem.h"
+#include "ShaderArchive.h"
+
+namespace jRenderer {
+
+namespace {
+
+// Stands in for the D3D compiler, only the time it takes is real
+class SleepingCompiler : public ShaderCompiler {
+  public:
+    explicit SleepingCompiler(uint32_t compileMs) : m_compileMs(compileMs) {}
+
+    bool Compile(const ShaderKey &key, std::vector<uint8_t> &bytecode,
+                 std::string &) override {
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_compileMs));
+        bytecode.assign(key.filename.begin(), key.filename.end());
+        return true;
+    }
+
+  private:
+    uint32_t m_compileMs;
+};
+
+} // namespace
+
+void ShaderBatch::Add(const ShaderKey &key) {
+    const std::string name = ShaderArchive::GetName(key);
+    if (m_indices.count(name))
+        return;
+    m_indices[name] = uint32_t(m_shaders.size());
+    Shader shader;
+    shader.key = key;
+    m_shaders.push_back(std::move(shader));
+}
+
+bool ShaderBatch::Compile(ShaderCache &cache) {
+    const auto start = std::chrono::steady_clock::now();
+    // One shader per job, the workers steal whatever is left so a long
+    // compile doesn't hold up a batch of short ones.
+    JobSystem::ParallelFor(
+        uint32_t(m_shaders.size()), 1, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t i = begin; i < end; i++) {
+                auto &shader = m_shaders[i];
+                shader.compiled =
+                    cache.GetBytecode(shader.key, shader.bytecode,
+                                      &shader.errors);
+            }
+        });
+    m_wallMs = std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+
+    m_errors.clear();
+    for (const auto &shader : m_shaders) {
+        if (!shader.compiled) {
+            m_errors += shader.key.filename + " " + shader.key.entryPoint +
+                        ":\n" + shader.errors + "\n";
+        }
+    }
+    return m_errors.empty();
+}
+
+const ShaderBytecode *ShaderBatch::Find(const ShaderKey &key) const {
+    const auto it = m_indices.find(ShaderArchive::GetName(key));
+    if (it == m_indices.end() || !m_shaders[it->second].compiled)
+        return nullptr;
+    return &m_shaders[it->second].bytecode;
+}
+
+void ShaderBatch::Clear() {
+    m_shaders.clear();
+    m_indices.clear();
+    m_errors.clear();
+    m_wallMs = 0.0;
+}
+
+std::vector<ShaderBatchBenchmark> ShaderBatch::Benchmark(uint32_t numShaders,
+                                                         uint32_t compileMs) {
+    const int maxWorkers = JobSystem::GetWorkerCount();
+    SleepingCompiler compiler(compileMs);
+    std::vector<ShaderBatchBenchmark> results;
+    for (int workers = 0; workers <= maxWorkers; workers++) {
+        JobSystem::Initialize(workers);
+        ShaderCache cache(&compiler, "");
+        ShaderBatch batch;
+        ShaderKey key;
+        key.entryPoint = "main";
+        key.profile = "ps_5_0";
+        for (uint32_t i = 0; i < numShaders; i++) {
+            key.filename = "Shader" + std::to_string(i);
+            batch.Add(key);
+        }
+        batch.Compile(cache);
+
+        ShaderBatchBenchmark result;
+        result.threads = uint32_t(workers + 1);
+        result.wallMs = batch.GetWallMs();
+        result.speedup = results.empty() ? 1.0
+                                         : results[0].wallMs / result.wallMs;
+        results.push_back(result);
+    }
+    JobSystem::Initialize(maxWorkers);
+    return results;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ShaderCache.h"
+
+namespace jRenderer {
+
+struct ShaderBatchBenchmark {
+    uint32_t threads = 0;
+    double wallMs = 0.0;
+    double speedup = 0.0; // over one thread
+};
+
+// Shaders gathered up front and compiled together on the job system. The
+// bytecode stays with the batch, the D3D objects are created from it
+// afterwards on the device thread.
+class ShaderBatch {
+  public:
+    // The same shader twice is compiled once
+    void Add(const ShaderKey &key);
+    // cache.GetBytecode() of every shader, one job each. False when any
+    // failed, see GetErrors().
+    bool Compile(ShaderCache &cache);
+
+    // Null when the batch doesn't have it or it didn't compile
+    const ShaderBytecode *Find(const ShaderKey &key) const;
+    uint32_t GetNumShaders() const { return uint32_t(m_shaders.size()); }
+    const std::string &GetErrors() const { return m_errors; }
+    double GetWallMs() const { return m_wallMs; }
+    void Clear();
+
+    // numShaders misses of a compiler that sleeps compileMs, without a disk
+    // cache, with 0 to all of the job system workers. The job system is
+    // left with all of them again.
+    static std::vector<ShaderBatchBenchmark> Benchmark(uint32_t numShaders,
+                                                       uint32_t compileMs);
+
+  private:
+    struct Shader {
+        ShaderKey key;
+        ShaderBytecode bytecode;
+        bool compiled = false;
+        std::string errors;
+    };
+    std::vector<Shader> m_shaders;
+    std::unordered_map<std::string, uint32_t> m_indices; // archive names
+    std::string m_errors;
+    double m_wallMs = 0.0;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,254 @@
+#include "ShaderCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "Hash.h"
+#include "ShaderArchive.h"
+
+namespace jRenderer {
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Ahead of the bytecode in every blob file
+struct BlobHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t hash;
+    uint64_t compileMicros; // reported as saved when the blob is loaded
+    uint64_t size;
+};
+
+constexpr uint32_t BLOB_MAGIC = 0x43484a53; // "SJHC"
+constexpr uint32_t BLOB_VERSION = 1;
+
+bool ReadFile(const std::string &filename, std::string &contents) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file)
+        return false;
+    std::ostringstream stream;
+    stream << file.rdbuf();
+    contents = stream.str();
+    return true;
+}
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(
+               std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+void CollectIncludes(const std::string &filename,
+                     std::vector<std::string> &files) {
+    for (const auto &file : files) {
+        if (file == filename)
+            return;
+    }
+    files.push_back(filename);
+
+    std::ifstream source(filename);
+    std::string line;
+    while (std::getline(source, line)) {
+        // #include "name", the <name> form isn't used by the shaders
+        const size_t hash = line.find_first_not_of(" \t");
+        if (hash == std::string::npos || line.compare(hash, 8, "#include"))
+            continue;
+        const size_t begin = line.find('"', hash + 8);
+        const size_t end = begin == std::string::npos
+                               ? std::string::npos
+                               : line.find('"', begin + 1);
+        if (end == std::string::npos)
+            continue;
+        const fs::path include =
+            fs::path(filename).parent_path() /
+            line.substr(begin + 1, end - begin - 1);
+        CollectIncludes(include.lexically_normal().generic_string(), files);
+    }
+}
+
+} // namespace
+
+ShaderCache::ShaderCache(ShaderCompiler *compiler,
+                         const std::string &directory)
+    : m_compiler(compiler), m_directory(directory) {}
+
+std::vector<std::string>
+ShaderCache::FindIncludes(const std::string &filename) {
+    std::vector<std::string> files;
+    CollectIncludes(fs::path(filename).lexically_normal().generic_string(),
+                    files);
+    return files;
+}
+
+uint64_t ShaderCache::ComputeHash(const ShaderKey &key) const {
+    SignatureHash hash;
+    // The names too, so moving an include invalidates
+    for (const auto &filename : FindIncludes(key.filename)) {
+        std::string contents;
+        const bool exists = ReadFile(filename, contents);
+        hash.Add(filename.data(), filename.size() + 1);
+        hash.Add(exists);
+        hash.Add(contents.data(), contents.size());
+    }
+    hash.Add(key.entryPoint.data(), key.entryPoint.size() + 1);
+    hash.Add(key.profile.data(), key.profile.size() + 1);
+    hash.Add(key.flags);
+    for (const auto &define : key.defines) {
+        hash.Add(define.first.data(), define.first.size() + 1);
+        hash.Add(define.second.data(), define.second.size() + 1);
+    }
+    hash.Add(BLOB_VERSION);
+    return hash.Get();
+}
+
+std::string ShaderCache::GetBlobPath(const ShaderKey &key,
+                                     uint64_t hash) const {
+    // The file name is only for reading the directory, the hash is the key.
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+    const std::string name = fs::path(key.filename).stem().string() + "_" +
+                             key.entryPoint + "_" + key.profile + "_" + hex +
+                             ".cso";
+    return (fs::path(m_directory) / name).string();
+}
+
+bool ShaderCache::ReadBlob(const std::string &path, uint64_t hash,
+                           std::vector<uint8_t> &bytecode,
+                           double &compileMs) const {
+    std::ifstream file(path, std::ios::binary);
+    BlobHeader header = {};
+    if (!file.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        return false;
+    // A write that didn't finish or a hash collision
+    if (header.magic != BLOB_MAGIC || header.version != BLOB_VERSION ||
+        header.hash != hash || header.size == 0)
+        return false;
+    bytecode.resize(size_t(header.size));
+    if (!file.read(reinterpret_cast<char *>(bytecode.data()),
+                   std::streamsize(header.size)))
+        return false;
+    compileMs = double(header.compileMicros) * 1e-3;
+    return true;
+}
+
+void ShaderCache::WriteBlob(const std::string &path, uint64_t hash,
+                            const std::vector<uint8_t> &bytecode,
+                            double compileMs) const {
+    std::error_code error;
+    fs::create_directories(m_directory, error);
+
+    // Renamed into place, so a reader never sees half a blob
+    const std::string tempPath = path + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::binary);
+        if (!file)
+            return;
+        const BlobHeader header = {BLOB_MAGIC, BLOB_VERSION, hash,
+                                   uint64_t(compileMs * 1e3),
+                                   uint64_t(bytecode.size())};
+        file.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        file.write(reinterpret_cast<const char *>(bytecode.data()),
+                   std::streamsize(bytecode.size()));
+        if (!file)
+            return;
+    }
+    fs::rename(tempPath, path, error);
+    if (error)
+        fs::remove(tempPath, error);
+}
+
+bool ShaderCache::GetBytecode(const ShaderKey &key, ShaderBytecode &bytecode,
+                              std::string *errors) {
+    // Timed without the lock, added to m_stats at the end
+    ShaderCacheStats stats;
+    auto start = std::chrono::steady_clock::now();
+    const ShaderArchiveEntry *entry =
+        m_archive ? m_archive->Find(ShaderArchive::GetName(key)) : nullptr;
+    uint64_t hash = 0;
+    if (entry && m_verifyArchive) {
+        hash = ComputeHash(key);
+        stats.hashMs += MillisecondsSince(start);
+        if (entry->sourceHash != hash)
+            entry = nullptr;
+    }
+    if (entry) {
+        bytecode.storage.clear();
+        bytecode.data = m_archive->GetBlob(*entry);
+        bytecode.size = entry->blobSize;
+        stats.archiveHits++;
+        stats.loadMs += MillisecondsSince(start);
+        AddStats(stats);
+        return true;
+    }
+
+    const bool useDisk = !m_directory.empty();
+    std::string path;
+    if (useDisk) {
+        start = std::chrono::steady_clock::now();
+        if (!hash)
+            hash = ComputeHash(key);
+        path = GetBlobPath(key, hash);
+        stats.hashMs += MillisecondsSince(start);
+    }
+
+    auto &storage = bytecode.storage;
+    bytecode.data = nullptr;
+    bytecode.size = 0;
+    start = std::chrono::steady_clock::now();
+    double compileMs = 0.0;
+    if (useDisk && ReadBlob(path, hash, storage, compileMs)) {
+        const double loadMs = MillisecondsSince(start);
+        stats.hits++;
+        stats.loadMs += loadMs;
+        stats.savedMs += compileMs - loadMs;
+        AddStats(stats);
+        bytecode.data = storage.data();
+        bytecode.size = storage.size();
+        return true;
+    }
+
+    stats.misses++;
+    storage.clear();
+    std::string compileErrors;
+    bool compiled = false;
+    if (m_compiler) {
+        start = std::chrono::steady_clock::now();
+        compiled = m_compiler->Compile(key, storage, compileErrors);
+        compileMs = MillisecondsSince(start);
+        stats.compileMs += compileMs;
+    } else {
+        compileErrors = "No shader compiler for " + key.filename;
+    }
+    AddStats(stats);
+    if (errors)
+        *errors = compileErrors;
+    if (!compiled) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_lastErrors = compileErrors;
+        return false;
+    }
+
+    if (useDisk)
+        WriteBlob(path, hash, storage, compileMs);
+    bytecode.data = storage.data();
+    bytecode.size = storage.size();
+    return true;
+}
+
+void ShaderCache::AddStats(const ShaderCacheStats &stats) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.archiveHits += stats.archiveHits;
+    m_stats.hits += stats.hits;
+    m_stats.misses += stats.misses;
+    m_stats.hashMs += stats.hashMs;
+    m_stats.loadMs += stats.loadMs;
+    m_stats.compileMs += stats.compileMs;
+    m_stats.savedMs += stats.savedMs;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace jRenderer {
+
+class ShaderArchive;
+
+// A shader as compiled: the file, its entry point and profile, the compile
+// flags and the macros.
+struct ShaderKey {
+    std::string filename;
+    std::string entryPoint;
+    std::string profile;
+    uint32_t flags = 0;
+    std::vector<std::pair<std::string, std::string>> defines;
+};
+
+// HLSL to bytecode. D3DShaderCompiler in the app, a stub in tests.
+class ShaderCompiler {
+  public:
+    virtual ~ShaderCompiler() = default;
+    // Returns false with the compiler output in errors
+    virtual bool Compile(const ShaderKey &key, std::vector<uint8_t> &bytecode,
+                         std::string &errors) = 0;
+};
+
+// Points into the archive, or at storage when it was loaded or compiled
+struct ShaderBytecode {
+    const uint8_t *data = nullptr;
+    size_t size = 0;
+    std::vector<uint8_t> storage;
+};
+
+struct ShaderCacheStats {
+    uint32_t archiveHits = 0; // used in place, nothing hashed or read
+    uint32_t hits = 0;
+    uint32_t misses = 0;
+    // Summed over the threads, more than the wall time of a ShaderBatch
+    double hashMs = 0.0;    // reading the sources and includes
+    double loadMs = 0.0;    // reading the blobs of the hits
+    double compileMs = 0.0; // compiling the misses
+    double savedMs = 0.0;   // what the hits took to compile, minus loadMs
+
+    float GetHitRate() const {
+        const uint32_t total = archiveHits + hits + misses;
+        return total ? float(archiveHits + hits) / float(total) : 0.0f;
+    }
+};
+
+// Compiled bytecode on disk. A blob is keyed by a hash of the source, every
+// file it includes, the entry point, profile, flags and defines, so any
+// edit to them makes a new key and a stale blob is never loaded.
+// A ShaderArchive built offline is looked up before all of that.
+// GetBytecode() may run on several threads, the setters and ResetStats()
+// only between those calls. An empty directory keeps nothing on disk.
+class ShaderCache {
+  public:
+    explicit ShaderCache(ShaderCompiler *compiler = nullptr,
+                         const std::string &directory = "ShaderCache");
+
+    void SetCompiler(ShaderCompiler *compiler) { m_compiler = compiler; }
+    void SetDirectory(const std::string &directory) {
+        m_directory = directory;
+    }
+    // With verify, archived shaders whose sources changed since the archive
+    // was built are compiled again. That costs the hashing of the sources.
+    void SetArchive(const ShaderArchive *archive, bool verify) {
+        m_archive = archive;
+        m_verifyArchive = verify;
+    }
+
+    // Finds the shader in the archive, loads the blob, or compiles and
+    // stores it. Returns false when the compiler fails, with its output in
+    // errors and GetLastErrors().
+    bool GetBytecode(const ShaderKey &key, ShaderBytecode &bytecode,
+                     std::string *errors = nullptr);
+
+    uint64_t ComputeHash(const ShaderKey &key) const;
+    std::string GetBlobPath(const ShaderKey &key, uint64_t hash) const;
+
+    // The file and the files it includes, transitively, in include order.
+    // Quoted includes resolve next to the including file, like
+    // D3D_COMPILE_STANDARD_FILE_INCLUDE.
+    static std::vector<std::string> FindIncludes(const std::string &filename);
+
+    ShaderCacheStats GetStats() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_stats;
+    }
+    void ResetStats() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats = ShaderCacheStats();
+    }
+    std::string GetLastErrors() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_lastErrors;
+    }
+
+  private:
+    void AddStats(const ShaderCacheStats &stats);
+    bool ReadBlob(const std::string &path, uint64_t hash,
+                  std::vector<uint8_t> &bytecode, double &compileMs) const;
+    void WriteBlob(const std::string &path, uint64_t hash,
+                   const std::vector<uint8_t> &bytecode,
+                   double compileMs) const;
+
+    ShaderCompiler *m_compiler;
+    std::string m_directory;
+    const ShaderArchive *m_archive = nullptr;
+    bool m_verifyArchive = false;
+    mutable std::mutex m_mutex; // m_stats and m_lastErrors
+    ShaderCacheStats m_stats;
+    std::string m_lastErrors;
+};
+
+} // namespace jRenderer
@@ -1,4 +1,5 @@
 #include "Common.hlsli"
+#include "MaterialFeatures.hlsli"
 
 Texture2D albedoTex : register(t0);
 Texture2D normalTex : register(t1);
@@ -35,13 +36,13 @@ float3 GetNormal(PixelShaderInput input)
 {
     float3 normalWorld = normalize(input.normalWorld);
     
-    if (useNormalMap) // NormalWorld ü
+    if (HAS_NORMAL_MAP) // NormalWorld ü
     {
         float3 normal = normalTex.SampleLevel(linearWrapSampler, input.texcoord, lodBias).rgb; //  [0, 1]
         normal = 2.0 * normal - 1.0; //   [-1.0, 1.0]
            
         // OpenGL  ָ 쿡 y  ݴϴ.
-        normal.y = invertNormalMapY ? -normal.y : normal.y;
+        normal.y = INVERT_NORMAL_MAP_Y ? -normal.y : normal.y;
         
         float3 N = normalWorld;
         float3 T = normalize(input.tangentWorld - dot(input.tangentWorld, N) * N);
@@ -141,7 +142,7 @@ PixelShaderOutput main(PixelShaderInput input)
     float3 directLighting = float3(0, 0, 0);
     float3 pixelToEye = normalize(eyeWorld - input.posWorld);
     
-    float3 albedoColor = useAlbedoMap ? albedoTex.SampleLevel(linearWrapSampler, input.texcoord, lodBias).rgb : albedoFactor;
+    float3 albedoColor = HAS_ALBEDO_MAP ? albedoTex.SampleLevel(linearWrapSampler, input.texcoord, lodBias).rgb : albedoFactor;
     
     [unroll]
     for (int i = 0; i < MAX_LIGHTS; i++)
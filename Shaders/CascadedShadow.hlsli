@@ -0,0 +1,50 @@
+#ifndef __CASCADED_SHADOW_HLSLI__
+#define __CASCADED_SHADOW_HLSLI__
+
+#include "Common.hlsli"
+
+// One slice per cascade, see CascadedShadowMap
+Texture2DArray<float> shadowCascadeMap : register(t22);
+
+// It should be same as "ConstantBuffers.h"
+cbuffer ShadowCascadeConstants : register(b5)
+{
+    matrix viewToShadow[NUM_CASCADES]; // camera view -> shadow uv, depth
+    float4 splitFar; // camera view depth where each cascade ends
+    float cascadeTexelSize;
+    float cascadeDepthBias;
+    int cascadeLightIndex; // -1: no cascades
+    float cascadeDummy;
+};
+
+// 1: lit, 0: in shadow
+float CascadedShadowFactor(float3 viewPos)
+{
+    if (cascadeLightIndex < 0 || viewPos.z > splitFar[NUM_CASCADES - 1])
+        return 1.0f;
+
+    uint cascade = 0;
+    [unroll]
+    for (uint c = 0; c < NUM_CASCADES - 1; ++c)
+        cascade += viewPos.z > splitFar[c] ? 1 : 0;
+
+    float4 shadowPos = mul(float4(viewPos, 1.0f), viewToShadow[cascade]);
+    float depth = shadowPos.z - cascadeDepthBias;
+
+    // 3x3 PCF
+    float factor = 0.0f;
+    [unroll]
+    for (int y = -1; y <= 1; ++y)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; ++x)
+        {
+            float2 uv = shadowPos.xy + float2(x, y) * cascadeTexelSize;
+            factor += shadowCascadeMap.SampleCmpLevelZero(
+                shadowCompareSampler, float3(uv, cascade), depth);
+        }
+    }
+    return factor / 9.0f;
+}
+
+#endif // __CASCADED_SHADOW_HLSLI__
@@ -0,0 +1,71 @@
+#ifndef __CLUSTERED_LIGHTING_HLSLI__
+#define __CLUSTERED_LIGHTING_HLSLI__
+
+#include "Common.hlsli"
+
+// It should be same as "ConstantBuffers.h"
+// View space light, built and binned on the CPU (LightClusterGrid)
+struct ClusterLight
+{
+    float3 position;
+    float range;
+    float3 direction;
+    float spotPower;
+    float3 radiance;
+    uint type;
+    float fallOffStart;
+    float fallOffEnd;
+    int shadowIndex; // faces in the shadow atlas, -1: no shadow
+    float dummy;
+};
+
+StructuredBuffer<ClusterLight> clusterLights : register(t19);
+StructuredBuffer<uint2> clusterRanges : register(t20); // offset, count
+StructuredBuffer<uint> clusterLightIndices : register(t21);
+
+cbuffer ClusterConstants : register(b4)
+{
+    uint clusterDimX;
+    uint clusterDimY;
+    uint clusterDimZ;
+    uint numClusterLights;
+    float sliceScale;
+    float sliceBias;
+    float2 clusterDummy;
+};
+
+// Same indexing as LightClusterGrid: x + dimX * (y + dimY * z)
+uint GetClusterIndex(float2 texcoord, float viewZ)
+{
+    uint x = min(uint(texcoord.x * clusterDimX), clusterDimX - 1);
+    uint y = min(uint(texcoord.y * clusterDimY), clusterDimY - 1);
+    uint z = uint(clamp(log(viewZ) * sliceScale + sliceBias, 0.0f,
+                        float(clusterDimZ - 1)));
+    return x + clusterDimX * (y + clusterDimY * z);
+}
+
+Light ToLight(ClusterLight clusterLight)
+{
+    Light light = (Light) 0;
+    light.radiance = clusterLight.radiance;
+    light.lightColor = float3(1.0f, 1.0f, 1.0f); // already in radiance
+    light.fallOffStart = clusterLight.fallOffStart;
+    light.fallOffEnd = clusterLight.fallOffEnd;
+    light.direction = clusterLight.direction;
+    light.position = clusterLight.position;
+    light.spotPower = clusterLight.spotPower;
+    light.type = clusterLight.type;
+    return light;
+}
+
+// Fades the light to 0 at its range, so the binning by range is exact.
+// ref: Real Shading in Unreal Engine 4 (Karis, 2013)
+float RangeWindow(ClusterLight light, float3 positionVS)
+{
+    float ratio = length(light.position - positionVS) / light.range;
+    float ratio4 = ratio * ratio * ratio * ratio;
+    float window = saturate(1.0f - ratio4);
+    return window * window;
+}
+
+#endif // __CLUSTERED_LIGHTING_HLSLI__
@@ -10,6 +10,8 @@
 
 #define MAX_INSTANCE 2
 #define MAX_SAMPLES 64
+#define NUM_CASCADES 4
+#define MAX_SHADOW_FACES (MAX_LIGHTS * 6)
 
 // ÷  ̴  
 SamplerState linearWrapSampler : register(s0);
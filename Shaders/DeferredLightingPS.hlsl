@@ -1,5 +1,9 @@
 #include "Common.hlsli"
 #include "LightUtils.hlsli"
+#include "ClusteredLighting.hlsli"
+#include "CascadedShadow.hlsli"
+#include "ShadowAtlas.hlsli"
+#include "GBufferPacking.hlsli"
 
 Texture2D albedoTex : register(t0);
 Texture2D normalTex : register(t1);
@@ -7,10 +11,10 @@ Texture2D aoTex : register(t2);
 Texture2D metallicTex : register(t3);
 Texture2D eTex : register(t4);
 
-Texture2D DiffuseRoughnessTex : register(t5);
-Texture2D NormalMetallicTex : register(t6);
-Texture2D EmissiveTex : register(t7);
+Texture2D AlbedoAOTex : register(t5);
+Texture2D NormalMaterialTex : register(t6);
 Texture2D<float> DepthTex : register(t8);
+Texture2D ssaoTex : register(t9);
 
 cbuffer MaterialConstants : register(b0)
 {
@@ -35,40 +39,62 @@ struct VSToPS
     float2 texcoord : TEXCOORD0;
 };
 
+// Ambient and all the lights in one pass, added to the emission that
+// GBufferPS.hlsl wrote into the lighting target.
 float4 main(VSToPS input) : SV_Target
 {
     // Unpack GBuffer
-    float depth = DepthTex.Sample(linearWrapSampler, input.texcoord);
+    int2 pixel = int2(input.pos.xy);
+    float depth = DepthTex.Load(int3(pixel, 0));
     float3 viewPos = GetViewSpacePosition(input.texcoord, depth);
     float3 viewDir = normalize(0.0f.xxx - viewPos);
     
-    float4 normalMetallic = NormalMetallicTex.Sample(linearWrapSampler, input.texcoord);
-    float3 viewNormal = normalMetallic.rgb * 2.0f - 1.0f;
-    float metallic = normalMetallic.a;
+    GBufferData gBuffer = LoadGBuffer(AlbedoAOTex, NormalMaterialTex, pixel);
+    float3 viewNormal = gBuffer.normal;
+    float3 albedo = gBuffer.albedo;
+    float metallic = gBuffer.metallic;
+    float roughness = gBuffer.roughness;
     
-    float4 diffuseRoughness = DiffuseRoughnessTex.Sample(linearWrapSampler, input.texcoord);
-    float roughness = diffuseRoughness.a;
+    float ao = gBuffer.ao;
+    if (SSAO)
+        ao *= ssaoTex.Load(int3(pixel, 0)).r;
     
-    float4 emission = EmissiveTex.Sample(linearWrapSampler, input.texcoord);
+    float3 ambient = albedo;
+    if (IBL && depth < 1.0f)
+        ambient = DoAmbientIBL(viewPos, viewNormal, albedo, metallic, roughness);
+    float3 Lo = ambient * ao;
     
-    float3 Lo = float3(0.0f, 0.0f, 0.0f); 
+    // Only the lights whose range touches this pixel's cluster
+    uint2 range = clusterRanges[GetClusterIndex(input.texcoord, viewPos.z)];
     
-    [unroll]
-    for (int i = 0; i < MAX_LIGHTS; ++i)
+    for (uint i = 0; i < range.y; ++i)
     {
-        if (lights[i].type & LIGHT_POINT)
+        ClusterLight clusterLight = clusterLights[clusterLightIndices[range.x + i]];
+        Light light = ToLight(clusterLight);
+        
+        if (light.type & LIGHT_POINT)
         {
-            Lo += DoPointLightPBR(lights[i], viewPos, viewNormal, viewDir, diffuseRoughness.rgb, metallic, roughness);
+            float3 toPixelWorld = mul(float4(viewPos - clusterLight.position, 0.0f), invView).xyz;
+            Lo += DoPointLightPBR(light, viewPos, viewNormal, viewDir, albedo, metallic, roughness)
+                * RangeWindow(clusterLight, viewPos)
+                * AtlasShadowFactor(clusterLight.shadowIndex, true, viewPos, toPixelWorld);
         }
-        if (lights[i].type & LIGHT_DIRECTIONAL)
+        if (light.type & LIGHT_DIRECTIONAL)
         {
-            Lo += DoDirectinoalLightPBR(lights[i], viewPos, viewNormal, viewDir, diffuseRoughness.rgb, metallic, roughness);
+            // Only the cascaded light keeps LIGHT_SHADOW here, the others
+            // may have an atlas tile.
+            float shadowFactor = (light.type & LIGHT_SHADOW)
+                ? CascadedShadowFactor(viewPos)
+                : AtlasShadowFactor(clusterLight.shadowIndex, false, viewPos, float3(0.0f, 0.0f, 0.0f));
+            Lo += DoDirectinoalLightPBR(light, viewPos, viewNormal, viewDir, albedo, metallic, roughness)
+                * shadowFactor;
         }
-        if (lights[i].type & LIGHT_SPOT)
+        if (light.type & LIGHT_SPOT)
         {
-            Lo += DoSpotLightPBR(lights[i], viewPos, viewNormal, viewDir, diffuseRoughness.rgb, metallic, roughness);
+            Lo += DoSpotLightPBR(light, viewPos, viewNormal, viewDir, albedo, metallic, roughness)
+                * RangeWindow(clusterLight, viewPos)
+                * AtlasShadowFactor(clusterLight.shadowIndex, false, viewPos, float3(0.0f, 0.0f, 0.0f));
         }
-      
     }
     return float4(Lo, 1.0f);
 }
\ No newline at end of file
@@ -1,4 +1,7 @@
 #include "Common.hlsli"
+#include "GBufferPacking.hlsli"
+#include "MaterialFeatures.hlsli"
+#include "MaterialTable.hlsli"
 
 Texture2D AlbedoTex : register(t0);
 Texture2D NormalTex : register(t1);
@@ -29,26 +32,51 @@ struct VSToPS
     float2 texcoord : TEXCOORD0;
     float3 normalWorld : NORMAL0;
     float3 tangentWorld : TANGENT0;
+#ifdef MATERIAL_TABLE
+    nointerpolation uint material : MATERIAL;
+#endif
 };
 
+// The maps of the draw, bound at t0 to t4 or in the material table
+#ifdef MATERIAL_TABLE
+#define MATERIAL_MAP(slot) materials[input.material].maps[slot]
+#else
+#define MATERIAL_MAP(slot) MATERIAL_BOUND_MAP
+#endif
+
+float4 SampleMap(Texture2D tex, uint map, float2 texcoord, float2 dx, float2 dy)
+{
+    if (map == MATERIAL_BOUND_MAP)
+        return tex.Sample(linearWrapSampler, texcoord);
+    return SampleMaterialArray(map, texcoord, dx, dy);
+}
+
+float4 SampleMapLevel(Texture2D tex, uint map, float2 texcoord, float lod)
+{
+    if (map == MATERIAL_BOUND_MAP)
+        return tex.SampleLevel(linearWrapSampler, texcoord, lod);
+    return SampleMaterialArrayLevel(map, texcoord, lod);
+}
+
 struct PSOutput
 {
-    float4 DiffuseRoughness : SV_Target0;
-    float4 NormalMetallic   : SV_Target1;
-    float4 Emissive         : SV_Target2;
+    float4 AlbedoAO       : SV_Target0;
+    float4 NormalMaterial : SV_Target1;
+    // The lighting target, DeferredLightingPS.hlsl adds the rest on top.
+    float4 Emission       : SV_Target2;
 };
 
 float3 GetNormal(VSToPS input)
 {
     float3 normalWorld = normalize(input.normalWorld);
     
-    if (useNormalMap) // NormalWorld ü
+    if (HAS_NORMAL_MAP) // NormalWorld ü
     {
-        float3 normal = NormalTex.SampleLevel(linearWrapSampler, input.texcoord, lodBias).rgb; //  [0, 1]
+        float3 normal = SampleMapLevel(NormalTex, MATERIAL_MAP(1), input.texcoord, lodBias).rgb; //  [0, 1]
         normal = 2.0 * normal - 1.0; //   [-1.0, 1.0]
            
         // OpenGL  ָ 쿡 y  ݴϴ.
-        normal.y = invertNormalMapY ? -normal.y : normal.y;
+        normal.y = INVERT_NORMAL_MAP_Y ? -normal.y : normal.y;
         
         float3 N = normalWorld;
         float3 T = normalize(input.tangentWorld - dot(input.tangentWorld, N) * N);
@@ -61,29 +89,32 @@ float3 GetNormal(VSToPS input)
     return normalWorld;
 }
 
-PSOutput PackGBuffer(float3 baseColor, float3 viewSpaceNormal, float4 emissive, float roughness, float metallic)
-{
-    PSOutput output = (PSOutput) 0;
-    output.NormalMetallic = float4(0.5f * viewSpaceNormal + 0.5f, metallic);
-    output.DiffuseRoughness = float4(baseColor, roughness);
-    output.Emissive = float4(emissive.xyz, emissive.w);
-    
-    return output;
-}
-
 PSOutput main(VSToPS input)
 {
-    float4 albeoColor = useAlbedoMap ? AlbedoTex.Sample(linearWrapSampler, input.texcoord) : float4(albedoFactor, 1.0);
+    // For the arrays, taken before any branch
+    float2 dx = ddx(input.texcoord);
+    float2 dy = ddy(input.texcoord);
+
+    float4 albeoColor = HAS_ALBEDO_MAP ? SampleMap(AlbedoTex, MATERIAL_MAP(0), input.texcoord, dx, dy) : float4(albedoFactor, 1.0);
      
     float3 normalWorld = GetNormal(input);
     float3 viewSpaceNormal = normalize(mul(normalWorld, (float3x3) view));
     
-    float ao = useAOMap ? AOTex.Sample(linearWrapSampler, input.texcoord).r : 1.0f;
-    float metallic = useMetallicMap ? MetallicRoughnessTex.Sample(linearWrapSampler, input.texcoord).b : metallicFactor;
-    float roughness = useRoughnessMap ? MetallicRoughnessTex.Sample(linearWrapSampler, input.texcoord).g : roughnessFactor;
-    float3 aoRoughnessMetallic = float3(ao, roughness, metallic);
+    float ao = HAS_AO_MAP ? SampleMap(AOTex, MATERIAL_MAP(2), input.texcoord, dx, dy).r : 1.0f;
+    float metallic = HAS_METALLIC_MAP ? SampleMap(MetallicRoughnessTex, MATERIAL_MAP(3), input.texcoord, dx, dy).b : metallicFactor;
+    float roughness = HAS_ROUGHNESS_MAP ? SampleMap(MetallicRoughnessTex, MATERIAL_MAP(3), input.texcoord, dx, dy).g : roughnessFactor;
+    
+    float3 emissiveColor = HAS_EMISSIVE_MAP ? SampleMap(EmissiveTex, MATERIAL_MAP(4), input.texcoord, dx, dy).rgb : emissionFactor;
     
-    float3 emissiveColor = useEmissiveMap ? EmissiveTex.Sample(linearWrapSampler, input.texcoord).rgb : emissionFactor;
+    GBufferData data;
+    data.albedo = albeoColor.xyz;
+    data.ao = ao;
+    data.normal = viewSpaceNormal;
+    data.roughness = roughness;
+    data.metallic = metallic;
     
-    return PackGBuffer(albeoColor.xyz, viewSpaceNormal, float4(emissiveColor, aoRoughnessMetallic.r), aoRoughnessMetallic.g, aoRoughnessMetallic.b);
+    PSOutput output;
+    PackGBuffer(data, output.AlbedoAO, output.NormalMaterial);
+    output.Emission = float4(emissiveColor, 0.0f);
+    return output;
 }
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef __GBUFFER_PACKING_HLSLI__
+#define __GBUFFER_PACKING_HLSLI__
+
+// It should be same as "GBufferPacking.h"
+// SV_Target0 R8G8B8A8_UNORM    : albedo, material AO
+// SV_Target1 R10G10B10A2_UNORM : octahedral normal, roughness, metallic
+// Emissive goes to the lighting target, see GBufferPS.hlsl.
+
+struct GBufferData
+{
+    float3 albedo;
+    float ao;
+    float3 normal; // view space
+    float roughness;
+    float metallic; // 2 bits
+};
+
+// ref: A Survey of Efficient Representations for Independent Unit Vectors
+//      (Cigolle et al., 2014)
+float2 OctWrap(float2 v)
+{
+    return (1.0f - abs(v.yx)) * (v.xy >= 0.0f ? 1.0f : -1.0f);
+}
+
+// Unit vector -> [0, 1]^2
+float2 EncodeOctahedral(float3 n)
+{
+    n /= abs(n.x) + abs(n.y) + abs(n.z);
+    n.xy = n.z >= 0.0f ? n.xy : OctWrap(n.xy);
+    return n.xy * 0.5f + 0.5f;
+}
+
+float3 DecodeOctahedral(float2 f)
+{
+    f = f * 2.0f - 1.0f;
+    float3 n = float3(f.x, f.y, 1.0f - abs(f.x) - abs(f.y));
+    float t = saturate(-n.z);
+    n.xy += n.xy >= 0.0f ? -t : t;
+    return normalize(n);
+}
+
+void PackGBuffer(GBufferData data, out float4 albedoAO,
+                 out float4 normalMaterial)
+{
+    albedoAO = float4(data.albedo, data.ao);
+    normalMaterial = float4(EncodeOctahedral(data.normal), data.roughness,
+                            data.metallic);
+}
+
+// Load, not Sample: filtering the octahedral normal across texels is wrong.
+GBufferData LoadGBuffer(Texture2D albedoAOTex, Texture2D normalMaterialTex,
+                        int2 pixel)
+{
+    float4 albedoAO = albedoAOTex.Load(int3(pixel, 0));
+    float4 normalMaterial = normalMaterialTex.Load(int3(pixel, 0));
+
+    GBufferData data;
+    data.albedo = albedoAO.rgb;
+    data.ao = albedoAO.a;
+    data.normal = DecodeOctahedral(normalMaterial.xy);
+    data.roughness = normalMaterial.z;
+    data.metallic = normalMaterial.w;
+    return data;
+}
+
+#endif // __GBUFFER_PACKING_HLSLI__
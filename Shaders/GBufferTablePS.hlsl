@@ -0,0 +1,3 @@
+// GBufferPS.hlsl reading the maps through the material table
+#define MATERIAL_TABLE
+#include "GBufferPS.hlsl"
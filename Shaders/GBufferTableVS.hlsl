@@ -0,0 +1,3 @@
+// GBufferVS.hlsl with the material index per instance, see MaterialTable.h
+#define MATERIAL_TABLE
+#include "GBufferVS.hlsl"
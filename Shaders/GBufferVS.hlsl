@@ -21,9 +21,16 @@ struct VSToPS
     float2 texcoord : TEXCOORD0;
     float3 normalWorld : NORMAL0;
     float3 tangentWorld : TANGENT0;
+#ifdef MATERIAL_TABLE
+    nointerpolation uint material : MATERIAL;
+#endif
 };
 
-VSToPS main(VertexShaderInput input)
+VSToPS main(VertexShaderInput input
+#ifdef MATERIAL_TABLE
+            , uint material : MATERIAL // per instance, vertex buffer slot 1
+#endif
+            )
 {
     VSToPS output;
 
@@ -42,6 +49,9 @@ VSToPS main(VertexShaderInput input)
     
     output.tangentWorld = mul(float4(input.tangentModel, 0.0), world);
     output.tangentWorld = normalize(output.tangentWorld);
+#ifdef MATERIAL_TABLE
+    output.material = material;
+#endif
 
     return output;
 }
\ No newline at end of file
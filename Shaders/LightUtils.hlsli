@@ -219,4 +219,37 @@ float3 DoSpotLightPBR(Light light, float3 positionVS, float3 normalVS, float3 V,
     return Lo;
 }
 
+uint QuerySpecularTextureLevels()
+{
+    uint width, height, levels;
+    specularIBLTex.GetDimensions(0, width, height, levels);
+    return levels;
+}
+
+float3 DoAmbientIBL(float3 positionVS, float3 normalVS, float3 albedo, float metallic, float roughness)
+{
+    float3 worldNormal = normalize(mul(normalVS, (float3x3) invView));
+    float3 worldPos = mul(float4(positionVS, 1.0f), invView).xyz;
+    float3 V = normalize(eyeWorld - worldPos);
+    
+    float cosLo = max(0.0f, dot(worldNormal, V));
+    float3 irradiance = irradianceIBLTex.Sample(aniWrapSampler, worldNormal).rgb;
+    
+    float3 F0 = float3(0.04f, 0.04f, 0.04f);
+    F0 = lerp(F0, albedo, metallic);
+    float3 F = FreselSchlickRoughness(cosLo, F0, roughness);
+    float3 kd = 1.0f - F;
+    kd *= 1.0f - metallic;
+    
+    float3 diffuseIBL = kd * albedo * irradiance;
+    uint specularTextureLevels = QuerySpecularTextureLevels();
+    float3 Lr = reflect(-V, worldNormal);
+    
+    const float MAX_RELECTION_LOD = min(4.0, specularTextureLevels);
+    float3 specularIrradiance = specularIBLTex.SampleLevel(aniWrapSampler, Lr, roughness * MAX_RELECTION_LOD).rgb;
+    float2 specularBRDF = brdfTex.Sample(linearClampSampler, float2(cosLo, roughness)).rg;
+    float3 specularIBL = (F0 * specularBRDF.x + specularBRDF.y) * specularIrradiance;
+    return (diffuseIBL + specularIBL) * strengthIBL;
+}
+
 #endif // __LIGHT_UTILS__
\ No newline at end of file
@@ -0,0 +1,28 @@
+#ifndef __MATERIAL_FEATURES_HLSLI__
+#define __MATERIAL_FEATURES_HLSLI__
+
+// It should be same as "MaterialPermutations.h"
+// MATERIAL_PERMUTATION is the feature mask of a permutation, so the flags
+// are literals and the branches and samples of unused maps compile away.
+// Without it they are the ints of MaterialConstants, read per pixel.
+// Include it before the MaterialConstants cbuffer.
+
+#ifdef MATERIAL_PERMUTATION
+#define HAS_ALBEDO_MAP      ((MATERIAL_PERMUTATION & 1) != 0)
+#define HAS_NORMAL_MAP      ((MATERIAL_PERMUTATION & 2) != 0)
+#define HAS_AO_MAP          ((MATERIAL_PERMUTATION & 4) != 0)
+#define HAS_METALLIC_MAP    ((MATERIAL_PERMUTATION & 8) != 0)
+#define HAS_ROUGHNESS_MAP   ((MATERIAL_PERMUTATION & 16) != 0)
+#define HAS_EMISSIVE_MAP    ((MATERIAL_PERMUTATION & 32) != 0)
+#define INVERT_NORMAL_MAP_Y ((MATERIAL_PERMUTATION & 64) != 0)
+#else
+#define HAS_ALBEDO_MAP      useAlbedoMap
+#define HAS_NORMAL_MAP      useNormalMap
+#define HAS_AO_MAP          useAOMap
+#define HAS_METALLIC_MAP    useMetallicMap
+#define HAS_ROUGHNESS_MAP   useRoughnessMap
+#define HAS_EMISSIVE_MAP    useEmissiveMap
+#define INVERT_NORMAL_MAP_Y invertNormalMapY
+#endif
+
+#endif // __MATERIAL_FEATURES_HLSLI__
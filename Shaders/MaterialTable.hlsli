@@ -0,0 +1,49 @@
+#ifndef __MATERIAL_TABLE_HLSLI__
+#define __MATERIAL_TABLE_HLSLI__
+
+// It should be same as "MaterialTable.h"
+// A draw of the G-buffer pass reads its maps through the index of its
+// material, from the Texture2DArrays instead of t0 to t4.
+
+#define MAX_MATERIAL_ARRAYS 8
+#define MATERIAL_NO_MAP 0xffffffff
+#define MATERIAL_BOUND_MAP 0xfffffffe // bound at t0 to t4 for the draw
+
+struct MaterialData
+{
+    uint maps[5]; // albedo, normal, ao, metallicRoughness, emissive
+    uint3 padding;
+};
+
+StructuredBuffer<MaterialData> materials : register(t26);
+Texture2DArray materialArrays[MAX_MATERIAL_ARRAYS] : register(t27);
+
+// Shader model 5.0 only indexes texture arrays with literals, so every
+// array is a branch. The index is the same for the whole draw.
+float4 SampleMaterialArray(uint map, float2 texcoord, float2 dx, float2 dy)
+{
+    float3 uvw = float3(texcoord, map & 0xffff);
+    float4 color = 0.0;
+    [unroll]
+    for (uint i = 0; i < MAX_MATERIAL_ARRAYS; i++)
+    {
+        if (i == (map >> 16))
+            color = materialArrays[i].SampleGrad(linearWrapSampler, uvw, dx, dy);
+    }
+    return color;
+}
+
+float4 SampleMaterialArrayLevel(uint map, float2 texcoord, float lod)
+{
+    float3 uvw = float3(texcoord, map & 0xffff);
+    float4 color = 0.0;
+    [unroll]
+    for (uint i = 0; i < MAX_MATERIAL_ARRAYS; i++)
+    {
+        if (i == (map >> 16))
+            color = materialArrays[i].SampleLevel(linearWrapSampler, uvw, lod);
+    }
+    return color;
+}
+
+#endif // __MATERIAL_TABLE_HLSLI__
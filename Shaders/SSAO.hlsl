@@ -1,4 +1,6 @@
 #include "Common.hlsli"
+#include "SSAOCommon.hlsli"
+#include "GBufferPacking.hlsli"
 
 struct VSToPS
 {
@@ -24,64 +26,92 @@ VSToPS VSmain(VertexShaderInput input)
     return output;
 }
 
-Texture2D DiffuseTex : register(t5);
 Texture2D NormalTex : register(t6);
-Texture2D EmissiveTex : register(t7);
 Texture2D<float> DepthTex : register(t8);
 Texture2D NoiseTex : register(t9);
 
+// AO history and view depth of the last frame, AO resolution
+Texture2D<float> PrevAOTex : register(t24);
+Texture2D<float> PrevAODepthTex : register(t25);
+
 cbuffer kernelSamples : register(b2)
 {
-    float3 samples[MAX_SAMPLES];
+    float4 samples[MAX_SAMPLES];
+};
+
+struct SsaoOutput
+{
+    float ao : SV_Target0;
+    float viewZ : SV_Target1; // for the upsample and the next frame
 };
 
-float4 PSmain(VSToPS input) : SV_Target0 
+// Same as SsaoReference::ComputeOcclusion()
+float ComputeOcclusion(float3 position, float3 normal, int2 aoPixel)
+{
+    float3 randomVector = normalize(NoiseTex.Load(int3(aoPixel % 4, 0)).xyz);
+
+    float3 tangent = normalize(randomVector - normal * dot(randomVector, normal));
+    float3 bitangent = cross(normal, tangent);
+    float3x3 TBN = float3x3(tangent, bitangent, normal);
+
+    float occlusion = 0.0f;
+
+    [loop]
+    for (uint idx = 0; idx < sampleCount; ++idx)
+    {
+        float3 _sample = mul(samples[idx * sampleStride + sampleOffset].xyz, TBN);
+        _sample = position + (_sample * aoRadius);
+
+        float4 offset = mul(float4(_sample, 1.0f), proj);
+        offset.xy /= offset.w;
+        float2 uv = float2(offset.x, -offset.y) * 0.5f + 0.5f;
+        if (any(uv < 0.0f) || any(uv >= 1.0f))
+            continue; // off screen, not occluded
+
+        int2 pixel = int2(uv * float2(screenSize));
+        float sampleDepth = GetViewDepth(pixel, DepthTex.Load(int3(pixel, 0)));
+        float occluded = step(sampleDepth, _sample.z + aoBias);
+        float intensity = smoothstep(0.0f, 1.0f, aoRadius / abs(position.z - sampleDepth));
+
+        occlusion += occluded * intensity;
+    }
+
+    return pow(abs(1.0f - occlusion / float(sampleCount)), aoPower);
+}
+
+SsaoOutput PSmain(VSToPS input)
 {
-    float depth = DepthTex.Sample(linearBorderSampler, input.texcoord);
+    int2 aoPixel = int2(input.pos.xy);
+    int2 pixel = min(GetAOScreenPixel(aoPixel), int2(screenSize) - 1);
+    float depth = DepthTex.Load(int3(pixel, 0));
+    float2 texcoord = (float2(pixel) + 0.5f) / float2(screenSize);
+    float3 position = GetViewSpacePosition(texcoord, depth);
+
+    SsaoOutput output;
+    output.ao = 1.0f;
+    output.viewZ = position.z;
+
     if(depth < 1.0f) //   1.0 ̻ , skybox̹Ƿ ssao 귮 ȭ  Ѵ.
     {
-        float3 position = GetViewSpacePosition(input.texcoord, depth);
-        float3 normal = NormalTex.Sample(linearBorderSampler, input.texcoord).rgb;
-        normal = normalize(normal * 2.0f - 1.0f);
-        
-        const float2 noiseScale = float2(1280.0f / 4.0f, 720.0f / 4.0f);
-        float3 randomVector = normalize(NoiseTex.Sample(pointWrapSampler, input.texcoord * noiseScale).xyz * 2.0f - 1.0f);
-        
-        float3 tangent = normalize(randomVector - normal * dot(randomVector, normal));
-        float3 bitangent = normalize(cross(normal, tangent));
-        float3x3 TBN = float3x3(tangent, bitangent, normal);
-        
-        int kernelSize = MAX_SAMPLES;
-        const float radius = 0.1f;
-        const float bias = 0.0005f;
-        float occlusion = 0.0f;
-        
-        [unroll(kernelSize)]
-        for (int idx = 0; idx < kernelSize; ++idx)
+        float3 normal = DecodeOctahedral(NormalTex.Load(int3(pixel, 0)).xy);
+        output.ao = ComputeOcclusion(position, normal, aoPixel);
+
+        // Where this point was in the last frame. w of the perspective
+        // projection is the view depth.
+        float4 prevClip = mul(float4(position, 1.0f), viewToPrevClip);
+        float2 prevUV = float2(prevClip.x, -prevClip.y) / prevClip.w * 0.5f + 0.5f;
+        if (historyValid && prevClip.w > 0.0f && all(prevUV >= 0.0f) &&
+            all(prevUV < 1.0f))
         {
-            float3 _sample = mul(samples[idx].xyz, TBN);
-            _sample = position + (_sample * radius);
-            
-            float4 offset = float4(_sample, 1.0f);
-            offset = mul(offset, proj);
-            offset.xyz /= offset.w;
-            offset.y *= -1.0f;
-            offset.xy = offset.xy * 0.5f + 0.5f;
-            //offset.y = (1.0f - offset.y); 
-            
-            float sampleDepth = DepthTex.Sample(linearBorderSampler, offset.xy);
-            sampleDepth = GetViewSpacePosition(offset.xy, sampleDepth).z;
-            //float occluded = (_sample.z + bias <= sampleDepth ? 0.0f : 1.0f);
-            float occluded = step(sampleDepth, _sample.z + bias);
-            float intensity = smoothstep(0.0f, 1.0f, radius / abs(position.z - sampleDepth));
-            
-            occlusion += occluded * intensity;
-        }
+            int2 prevPixel = int2(prevUV * float2(aoSize));
+            float history = PrevAOTex.Load(int3(prevPixel, 0));
+            float prevZ = PrevAODepthTex.Load(int3(prevPixel, 0));
 
-        occlusion = 1.0f - (occlusion / (float) kernelSize);
-        occlusion = saturate(pow(abs(occlusion), 2.0f) * 500.0f);
-        
-        return float4(occlusion, occlusion, occlusion, 1.0f);
+            // Disoccluded pixels start over with this frame only
+            float alpha = lerp(1.0f, temporalAlpha, DepthWeight(prevClip.w, prevZ));
+            output.ao = lerp(history, output.ao, alpha);
+        }
     }
-    return float4(0.0f, 0.0f, 0.0f, 0.0f);
-} 
\ No newline at end of file
+
+    return output;
+}
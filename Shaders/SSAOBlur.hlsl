@@ -47,5 +47,6 @@ float4 PSmain(VSToPS input) : SV_Target0
         }
     }
 
-    return float4(result / (4.0f * 4.0f), result / (4.0f * 4.0f), result / (4.0f * 4.0f), 1.0f);
+    result /= 8.0f * 8.0f; // 8x8 taps
+    return float4(result, result, result, 1.0f);
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef __SSAO_BLUR_CS_HLSLI__
+#define __SSAO_BLUR_CS_HLSLI__
+
+#include "SSAOCommon.hlsli"
+
+// One pass of the separable bilateral blur, BLUR_DIRECTION is int2(1, 0)
+// or int2(0, 1). A group blurs SSAO_BLUR_TILE pixels of a row or a column.
+// The tile and its apron are loaded into groupshared memory once, so a
+// pixel loads 2 texels instead of 2 * (2 * SSAO_BLUR_RADIUS + 1).
+// Same as SsaoReference::Blur()
+
+Texture2D<float> AOTex : register(t0);
+Texture2D<float> DepthTex : register(t1); // G-buffer depth
+RWTexture2D<unorm float> OutputTex : register(u0);
+
+#define BLUR_SHARED_SIZE (SSAO_BLUR_TILE + 2 * SSAO_BLUR_RADIUS)
+
+groupshared float sharedAO[BLUR_SHARED_SIZE];
+groupshared float sharedZ[BLUR_SHARED_SIZE];
+
+// Gaussian, sigma = SSAO_BLUR_RADIUS / 2
+static const float blurWeights[SSAO_BLUR_RADIUS + 1] =
+{
+    1.0f, 0.8824969f, 0.6065307f, 0.3246525f, 0.1353353f
+};
+
+void BlurPass(uint2 groupId, uint groupIndex)
+{
+    const int2 dir = BLUR_DIRECTION;
+    const int2 tileStart = int2(groupId) * (dir * (SSAO_BLUR_TILE - 1) + 1);
+    const int2 maxPixel = int2(screenSize) - 1;
+
+    for (uint i = groupIndex; i < BLUR_SHARED_SIZE; i += SSAO_BLUR_TILE)
+    {
+        int2 p = tileStart + (int(i) - SSAO_BLUR_RADIUS) * dir;
+        p = clamp(p, int2(0, 0), maxPixel);
+        sharedAO[i] = AOTex.Load(int3(p, 0));
+        sharedZ[i] = GetViewDepth(p, DepthTex.Load(int3(p, 0)));
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    int2 pixel = tileStart + int(groupIndex) * dir;
+    if (any(pixel > maxPixel))
+        return;
+
+    uint center = groupIndex + SSAO_BLUR_RADIUS;
+    float viewZ = sharedZ[center];
+    float sum = 0.0f;
+    float weightSum = 0.0f;
+
+    [unroll]
+    for (int k = -SSAO_BLUR_RADIUS; k <= SSAO_BLUR_RADIUS; k++)
+    {
+        float weight = blurWeights[abs(k)] * DepthWeight(viewZ, sharedZ[center + k]);
+        sum += sharedAO[center + k] * weight;
+        weightSum += weight;
+    }
+
+    OutputTex[pixel] = sum / weightSum;
+}
+
+#endif // __SSAO_BLUR_CS_HLSLI__
@@ -0,0 +1,8 @@
+#define BLUR_DIRECTION int2(1, 0)
+#include "SSAOBlurCS.hlsli"
+
+[numthreads(SSAO_BLUR_TILE, 1, 1)]
+void main(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    BlurPass(groupId.xy, groupIndex);
+}
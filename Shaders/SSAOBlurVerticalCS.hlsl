@@ -0,0 +1,8 @@
+#define BLUR_DIRECTION int2(0, 1)
+#include "SSAOBlurCS.hlsli"
+
+[numthreads(1, SSAO_BLUR_TILE, 1)]
+void main(uint3 groupId : SV_GroupID, uint groupIndex : SV_GroupIndex)
+{
+    BlurPass(groupId.xy, groupIndex);
+}
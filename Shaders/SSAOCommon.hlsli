@@ -0,0 +1,48 @@
+#ifndef __SSAO_COMMON_HLSLI__
+#define __SSAO_COMMON_HLSLI__
+
+#include "Common.hlsli"
+
+// It should be same as "ConstantBuffers.h"
+#define SSAO_BLUR_RADIUS 4
+#define SSAO_BLUR_TILE 128
+
+cbuffer SsaoConstants : register(b3)
+{
+    matrix viewToPrevClip; // camera view -> clip space of the last frame
+    uint2 aoSize;
+    uint2 screenSize;
+    uint aoScale; // screen / AO resolution
+    uint sampleCount;
+    uint sampleStride;
+    uint sampleOffset;
+    float aoRadius;
+    float aoBias;
+    float aoPower;
+    float temporalAlpha; // weight of the new frame
+    float depthSigma; // relative view depth, history and upsample
+    uint historyValid;
+    float2 ssaoDummy;
+};
+
+// AO texel i is computed for the screen pixel i * aoScale + aoScale / 2,
+// the upsample and the CPU reference (SsaoReference) use the same pixel.
+int2 GetAOScreenPixel(int2 aoPixel)
+{
+    return aoPixel * int(aoScale) + int(aoScale / 2);
+}
+
+float GetViewDepth(int2 pixel, float depth)
+{
+    float2 texcoord = (float2(pixel) + 0.5f) / float2(screenSize);
+    return GetViewSpacePosition(texcoord, depth).z;
+}
+
+// 1 for the same depth, falls off with the relative difference
+float DepthWeight(float viewZ, float otherZ)
+{
+    float diff = abs(viewZ - otherZ) / (viewZ * depthSigma);
+    return exp(-diff * diff);
+}
+
+#endif // __SSAO_COMMON_HLSLI__
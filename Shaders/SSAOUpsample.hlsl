@@ -0,0 +1,77 @@
+#include "Common.hlsli"
+#include "SSAOCommon.hlsli"
+
+struct VSToPS
+{
+    float4 pos : SV_Position;
+    float2 texcoord : TEXCOORD0;
+};
+
+cbuffer MeshConstants : register(b0)
+{
+    matrix world;
+    matrix worldIT;
+    int useHeightMap;
+    float heightScale;
+    float2 dummy;
+};
+
+VSToPS VSmain(VertexShaderInput input)
+{
+    VSToPS output;
+    output.pos = float4(input.posModel, 1.0);
+    output.pos = mul(output.pos, world);
+    output.texcoord = input.texcoord;
+    return output;
+}
+
+Texture2D<float> DepthTex : register(t8);
+
+// Output of SSAO.hlsl, AO resolution
+Texture2D<float> AOTex : register(t24);
+Texture2D<float> AODepthTex : register(t25);
+
+// Bilinear weights of the 4 nearest AO texels times their depth similarity,
+// so the AO doesn't bleed over depth edges.
+// ref: Joint Bilateral Upsampling (Kopf et al., SIGGRAPH 2007)
+// Same as SsaoReference::Upsample()
+float4 PSmain(VSToPS input) : SV_Target0
+{
+    int2 pixel = int2(input.pos.xy);
+    float viewZ = GetViewDepth(pixel, DepthTex.Load(int3(pixel, 0)));
+
+    // Texel i is at the screen pixel i * aoScale + aoScale / 2
+    float2 t = (float2(pixel) - float(aoScale / 2)) / float(aoScale);
+    int2 base = int2(floor(t));
+    float2 f = t - float2(base);
+
+    float sum = 0.0f;
+    float weightSum = 0.0f;
+    float nearestAO = 1.0f;
+    float nearestDiff = 1e30f;
+
+    [unroll]
+    for (int k = 0; k < 4; k++)
+    {
+        int2 offset = int2(k & 1, k >> 1);
+        int2 texel = clamp(base + offset, int2(0, 0), int2(aoSize) - 1);
+        float2 bilinear = lerp(1.0f - f, f, float2(offset));
+
+        float ao = AOTex.Load(int3(texel, 0));
+        float z = AODepthTex.Load(int3(texel, 0));
+        float weight = bilinear.x * bilinear.y * DepthWeight(viewZ, z);
+        sum += ao * weight;
+        weightSum += weight;
+
+        float diff = abs(z - viewZ);
+        if (diff < nearestDiff)
+        {
+            nearestDiff = diff;
+            nearestAO = ao;
+        }
+    }
+
+    // None of the texels is on this surface, take the closest depth
+    float ao = weightSum > 1e-4f ? sum / weightSum : nearestAO;
+    return float4(ao, ao, ao, 1.0f);
+}
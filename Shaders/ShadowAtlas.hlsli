@@ -0,0 +1,71 @@
+#ifndef __SHADOW_ATLAS_HLSLI__
+#define __SHADOW_ATLAS_HLSLI__
+
+#include "Common.hlsli"
+
+// Spot, point and non-cascaded directional light shadows in one texture,
+// see ShadowAtlas
+Texture2D<float> shadowAtlas : register(t23);
+
+// It should be same as "ConstantBuffers.h"
+// Face f of light i is at i * 6 + f, spot and directional lights only use
+// face 0.
+cbuffer ShadowAtlasConstants : register(b6)
+{
+    matrix viewToFace[MAX_SHADOW_FACES]; // camera view -> atlas uv, depth
+    float4 faceRects[MAX_SHADOW_FACES]; // uv min xy, max zw
+    float atlasTexelSize;
+    float atlasDepthBias;
+    float2 atlasDummy;
+};
+
+// Same order as the faces in Engine::UpdateShadowMatrices
+// +x, -x, +y, -y, +z, -z
+uint GetCubeFace(float3 dir)
+{
+    float3 a = abs(dir);
+    if (a.x >= a.y && a.x >= a.z)
+        return dir.x > 0.0f ? 0 : 1;
+    if (a.y >= a.z)
+        return dir.y > 0.0f ? 2 : 3;
+    return dir.z > 0.0f ? 4 : 5;
+}
+
+// 1: lit, 0: in shadow
+// toPixelWorld picks the cube face of a point light.
+float AtlasShadowFactor(int shadowIndex, bool isPoint, float3 viewPos,
+                        float3 toPixelWorld)
+{
+    if (shadowIndex < 0)
+        return 1.0f;
+
+    uint face = shadowIndex * 6 + (isPoint ? GetCubeFace(toPixelWorld) : 0);
+    float4 rect = faceRects[face];
+    float4 shadowPos = mul(float4(viewPos, 1.0f), viewToFace[face]);
+    if (shadowPos.w <= 0.0f)
+        return 1.0f; // behind a spot light
+    shadowPos.xyz /= shadowPos.w;
+
+    // Outside of the spot light frustum
+    if (any(shadowPos.xy < rect.xy) || any(shadowPos.xy > rect.zw))
+        return 1.0f;
+    float depth = shadowPos.z - atlasDepthBias;
+
+    // 3x3 PCF, clamped so that it never reads the neighbouring tiles
+    float factor = 0.0f;
+    [unroll]
+    for (int y = -1; y <= 1; ++y)
+    {
+        [unroll]
+        for (int x = -1; x <= 1; ++x)
+        {
+            float2 uv = clamp(shadowPos.xy + float2(x, y) * atlasTexelSize,
+                              rect.xy, rect.zw);
+            factor += shadowAtlas.SampleCmpLevelZero(shadowCompareSampler,
+                                                     uv, depth);
+        }
+    }
+    return factor / 9.0f;
+}
+
+#endif // __SHADOW_ATLAS_HLSLI__
@@ -11,6 +11,7 @@ cbuffer MeshConstants : register(b0)
 cbuffer ShadowLightTransform : register(b2)
 {
     matrix shadowViewProj[6];
+    uint faceMask; // faces to draw, the others keep their depth
 }
 
 struct VSToGS
@@ -24,7 +25,7 @@ struct GSToPS
     float4 posProj : SV_POSITION;
     float3 fragPos : POSITION0;
     float2 texcoord : TEXCOORD0;
-    uint layer : SV_RenderTargetArrayIndex;
+    uint viewport : SV_ViewportArrayIndex; // face tile in the atlas
 };
 
 [maxvertexcount(18)]
@@ -35,8 +36,11 @@ void main(
 {
     for (int face = 0; face < 6; ++face)
     {
+        if (!(faceMask & (1u << face)))
+            continue;
+
         GSToPS output;
-        output.layer = face;
+        output.viewport = face;
         for (int i = 0; i < 3; i++)
         {
             output.fragPos = input[i].posWorld;
@@ -0,0 +1,52 @@
+#include "Common.hlsli"
+
+cbuffer MeshConstants : register(b0)
+{
+    matrix world;
+    matrix worldIT;
+    int useHeightMap;
+    float heightScale;
+    float2 dummy;
+};
+
+cbuffer InstancedConsts : register(b2)
+{
+    float3 instanceMat[MAX_INSTANCE];
+    int useInstancing;
+}
+
+// Same as ShadowCubeMapGS.hlsl, faceMask is not used here.
+cbuffer ShadowLightTransform : register(b3)
+{
+    matrix shadowViewProj[6];
+    uint faceMask;
+}
+
+struct ShadowFaceVertexInput
+{
+    float3 posModel : POSITION;
+    // Per instance, see ShadowFaceInstance in ConstantBuffers.h
+    uint face : FACE;
+    uint modelInstance : FACE1;
+};
+
+struct VSToPS
+{
+    float4 posProj : SV_POSITION;
+    uint viewport : SV_ViewportArrayIndex; // face tile in the atlas
+};
+
+// One instance per cube face the object touches, so the faces are selected
+// here instead of amplified in a geometry shader. Needs
+// VPAndRTArrayIndexFromAnyShaderFeedingRasterizer.
+VSToPS main(ShadowFaceVertexInput input)
+{
+    if (useInstancing)
+        input.posModel += instanceMat[input.modelInstance];
+    float4 posWorld = mul(float4(input.posModel, 1.0f), world);
+
+    VSToPS output;
+    output.posProj = mul(posWorld, shadowViewProj[input.face]);
+    output.viewport = input.face;
+    return output;
+}
@@ -5,7 +5,7 @@ struct GSToPS
     float4 posProj : SV_POSITION;
     float3 fragPos : POSITION0;
     float2 texcoord : TEXCOORD0;
-    uint layer : SV_RenderTargetArrayIndex;
+    uint viewport : SV_ViewportArrayIndex; // face tile in the atlas
 };
 
 float4 main(GSToPS input) : SV_TARGET
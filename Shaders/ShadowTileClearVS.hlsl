@@ -0,0 +1,7 @@
+// Full screen triangle on the far plane. With the viewport on one tile and
+// the depth test set to always, it clears only that tile of the atlas.
+float4 main(uint vertexID : SV_VertexID) : SV_POSITION
+{
+    float2 uv = float2((vertexID << 1) & 2, vertexID & 2);
+    return float4(uv * float2(2.0f, -2.0f) + float2(-1.0f, 1.0f), 1.0f, 1.0f);
+}
@@ -0,0 +1,340 @@
+#include "ShadowAtlas.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace jRenderer {
+
+void ShadowAtlasAllocator::Initialize(uint32_t atlasSize,
+                                      uint32_t minTileSize) {
+    m_atlasSize = atlasSize;
+    m_minTileSize = std::min(minTileSize, atlasSize);
+
+    int numLevels = 1;
+    while ((m_atlasSize >> (numLevels - 1)) > m_minTileSize)
+        numLevels++;
+    m_levels.resize(numLevels);
+    m_freeCounts.resize(numLevels);
+    Clear();
+}
+
+void ShadowAtlasAllocator::Clear() {
+    for (size_t level = 0; level < m_levels.size(); level++) {
+        const uint32_t dim = GetDim(int(level));
+        m_levels[level].assign(dim * dim, NODE_NONE);
+        m_freeCounts[level] = 0;
+    }
+    m_levels[0][0] = NODE_FREE;
+    m_freeCounts[0] = 1;
+}
+
+int ShadowAtlasAllocator::GetLevel(uint32_t size) const {
+    int level = int(m_levels.size()) - 1;
+    while (level > 0 && (m_atlasSize >> level) < size)
+        level--;
+    return level;
+}
+
+int ShadowAtlasAllocator::AllocateNode(int level) {
+    auto &nodes = m_levels[level];
+    if (m_freeCounts[level] > 0) {
+        for (size_t i = 0; i < nodes.size(); i++) {
+            if (nodes[i] == NODE_FREE) {
+                nodes[i] = NODE_USED;
+                m_freeCounts[level]--;
+                return int(i);
+            }
+        }
+    }
+    if (level == 0)
+        return -1;
+
+    // Split the smallest free node above
+    const int parent = AllocateNode(level - 1);
+    if (parent < 0)
+        return -1;
+    m_levels[level - 1][parent] = NODE_SPLIT;
+
+    const uint32_t parentDim = GetDim(level - 1);
+    const uint32_t dim = GetDim(level);
+    const uint32_t x = (parent % parentDim) * 2;
+    const uint32_t y = (parent / parentDim) * 2;
+    nodes[y * dim + x] = NODE_USED;
+    nodes[y * dim + x + 1] = NODE_FREE;
+    nodes[(y + 1) * dim + x] = NODE_FREE;
+    nodes[(y + 1) * dim + x + 1] = NODE_FREE;
+    m_freeCounts[level] += 3;
+    return int(y * dim + x);
+}
+
+bool ShadowAtlasAllocator::Allocate(uint32_t size, ShadowTile &tile) {
+    const int level = GetLevel(size);
+    const int node = AllocateNode(level);
+    if (node < 0)
+        return false;
+
+    const uint32_t dim = GetDim(level);
+    const uint32_t nodeSize = m_atlasSize >> level;
+    tile.x = uint16_t((node % dim) * nodeSize);
+    tile.y = uint16_t((node / dim) * nodeSize);
+    tile.size = uint16_t(nodeSize);
+    return true;
+}
+
+void ShadowAtlasAllocator::Free(const ShadowTile &tile) {
+    int level = GetLevel(tile.size);
+    uint32_t x = tile.x / tile.size;
+    uint32_t y = tile.y / tile.size;
+    m_levels[level][y * GetDim(level) + x] = NODE_FREE;
+    m_freeCounts[level]++;
+
+    // Merge four free siblings into their parent
+    while (level > 0) {
+        const uint32_t dim = GetDim(level);
+        const uint32_t x0 = x & ~1u;
+        const uint32_t y0 = y & ~1u;
+        auto &nodes = m_levels[level];
+        uint8_t *siblings[4] = {
+            &nodes[y0 * dim + x0], &nodes[y0 * dim + x0 + 1],
+            &nodes[(y0 + 1) * dim + x0], &nodes[(y0 + 1) * dim + x0 + 1]};
+        for (const auto *sibling : siblings) {
+            if (*sibling != NODE_FREE)
+                return;
+        }
+        for (auto *sibling : siblings)
+            *sibling = NODE_NONE;
+        m_freeCounts[level] -= 4;
+
+        level--;
+        x = x0 / 2;
+        y = y0 / 2;
+        m_levels[level][y * GetDim(level) + x] = NODE_FREE;
+        m_freeCounts[level]++;
+    }
+}
+
+uint32_t ShadowAtlasAllocator::GetLargestFree() const {
+    for (size_t level = 0; level < m_freeCounts.size(); level++) {
+        if (m_freeCounts[level] > 0)
+            return m_atlasSize >> level;
+    }
+    return 0;
+}
+
+uint64_t ShadowAtlasAllocator::GetFreeTexels() const {
+    uint64_t texels = 0;
+    for (size_t level = 0; level < m_freeCounts.size(); level++) {
+        const uint64_t size = m_atlasSize >> level;
+        texels += m_freeCounts[level] * size * size;
+    }
+    return texels;
+}
+
+float ShadowAtlasAllocator::GetFragmentation() const {
+    const uint64_t freeTexels = GetFreeTexels();
+    if (freeTexels == 0)
+        return 0.0f;
+    const uint64_t largest = GetLargestFree();
+    return 1.0f - float(largest * largest) / float(freeTexels);
+}
+
+void ShadowAtlas::Initialize(uint32_t atlasSize, uint32_t minTileSize) {
+    m_allocator.Initialize(atlasSize, minTileSize);
+    m_entries.clear();
+    m_stats.Reset();
+}
+
+ShadowAtlas::Entry *ShadowAtlas::FindEntry(uint32_t key) {
+    for (auto &entry : m_entries) {
+        if (entry.key == key)
+            return &entry;
+    }
+    return nullptr;
+}
+
+ShadowTile ShadowAtlas::GetTile(uint32_t key) const {
+    for (const auto &entry : m_entries) {
+        if (entry.key == key)
+            return entry.tile;
+    }
+    return ShadowTile();
+}
+
+void ShadowAtlas::Update(const std::vector<ShadowAtlasRequest> &requests) {
+    m_stats.Reset();
+    m_stats.requests = uint32_t(requests.size());
+
+    for (auto &entry : m_entries)
+        entry.isUsed = false;
+
+    // Tiles that keep their size stay where they are.
+    m_pending.clear();
+    for (const auto &request : requests) {
+        Entry *entry = FindEntry(request.key);
+        if (!entry) {
+            m_entries.push_back(Entry());
+            entry = &m_entries.back();
+            entry->key = request.key;
+        }
+        entry->isUsed = true;
+        if (!entry->tile.IsValid() || entry->tile.size != request.size)
+            m_pending.push_back(&request);
+    }
+
+    // Make room: keys that are gone and tiles that shrink
+    for (auto &entry : m_entries) {
+        if (entry.isUsed || !entry.tile.IsValid())
+            continue;
+        m_allocator.Free(entry.tile);
+        entry.tile = ShadowTile();
+    }
+    m_entries.erase(std::remove_if(m_entries.begin(), m_entries.end(),
+                                   [](const Entry &e) { return !e.isUsed; }),
+                    m_entries.end());
+    for (const auto *request : m_pending) {
+        Entry *entry = FindEntry(request->key);
+        if (entry->tile.IsValid() && request->size < entry->tile.size) {
+            m_allocator.Free(entry->tile);
+            entry->tile = ShadowTile();
+        }
+    }
+
+    // Larger tiles first packs better when the priorities are the same.
+    std::sort(m_pending.begin(), m_pending.end(),
+              [](const ShadowAtlasRequest *a, const ShadowAtlasRequest *b) {
+                  if (a->priority != b->priority)
+                      return a->priority > b->priority;
+                  if (a->size != b->size)
+                      return a->size > b->size;
+                  return a->key < b->key;
+              });
+
+    const uint32_t minSize = m_allocator.GetMinTileSize();
+    for (const auto *request : m_pending) {
+        Entry *entry = FindEntry(request->key);
+        ShadowTile tile;
+
+        if (entry->tile.IsValid()) {
+            // Growing: keep the old tile unless the bigger one fits.
+            if (m_allocator.Allocate(request->size, tile)) {
+                m_allocator.Free(entry->tile);
+                entry->tile = tile;
+                m_stats.moved++;
+            } else
+                m_stats.downsized++;
+            continue;
+        }
+
+        uint32_t size = std::max(request->size, minSize);
+        while (!m_allocator.Allocate(size, tile) && size > minSize)
+            size /= 2;
+        if (tile.IsValid()) {
+            entry->tile = tile;
+            m_stats.moved++;
+            if (size < request->size)
+                m_stats.downsized++;
+        } else
+            m_stats.failed++;
+    }
+
+    const float atlasTexels = float(m_allocator.GetAtlasSize()) *
+                              float(m_allocator.GetAtlasSize());
+    for (const auto &entry : m_entries)
+        m_stats.usedTexels += uint64_t(entry.tile.size) * entry.tile.size;
+    m_stats.occupancy = float(m_stats.usedTexels) / atlasTexels;
+    m_stats.fragmentation = m_allocator.GetFragmentation();
+}
+
+bool ShadowAtlas::Validate() const {
+    const uint32_t atlasSize = m_allocator.GetAtlasSize();
+    for (size_t i = 0; i < m_entries.size(); i++) {
+        const ShadowTile &a = m_entries[i].tile;
+        if (!a.IsValid())
+            continue;
+        if (a.x + a.size > atlasSize || a.y + a.size > atlasSize)
+            return false;
+        for (size_t j = i + 1; j < m_entries.size(); j++) {
+            const ShadowTile &b = m_entries[j].tile;
+            if (!b.IsValid())
+                continue;
+            if (a.x < b.x + b.size && b.x < a.x + a.size &&
+                a.y < b.y + b.size && b.y < a.y + a.size)
+                return false;
+        }
+    }
+    return true;
+}
+
+uint32_t ShadowAtlas::SelectSize(float texels, uint32_t current,
+                                 uint32_t minSize, uint32_t maxSize,
+                                 float margin) {
+    if (current && texels < 2.0f * float(current) * margin &&
+        texels >= float(current) / margin)
+        return std::clamp(current, minSize, maxSize);
+
+    uint32_t size = minSize;
+    while (size * 2 <= maxSize && float(size * 2) <= texels)
+        size *= 2;
+    return size;
+}
+
+bool ShadowAtlas::RunStressTest(uint32_t atlasSize, uint32_t minTileSize,
+                                int numKeys, int numFrames, uint32_t seed,
+                                ShadowAtlasStats &average) {
+    // Numerical Recipes LCG, the same sequence on every platform
+    uint32_t state = seed;
+    auto random = [&]() {
+        state = state * 1664525u + 1013904223u;
+        return float(state >> 8) / float(1u << 24);
+    };
+
+    ShadowAtlas atlas;
+    atlas.Initialize(atlasSize, minTileSize);
+    std::vector<float> texels(numKeys);
+    std::vector<uint8_t> isActive(numKeys);
+    for (int k = 0; k < numKeys; k++) {
+        texels[k] = float(minTileSize) +
+                    random() * float(atlasSize / 2 - minTileSize);
+        isActive[k] = random() < 0.5f;
+    }
+
+    average.Reset();
+    bool isValid = true;
+    std::vector<ShadowAtlasRequest> requests;
+    for (int frame = 0; frame < numFrames; frame++) {
+        requests.clear();
+        for (int k = 0; k < numKeys; k++) {
+            // Lights come and go, their screen coverage drifts.
+            if (random() < 0.02f)
+                isActive[k] = !isActive[k];
+            texels[k] *= std::pow(1.1f, 2.0f * random() - 1.0f);
+            texels[k] = std::clamp(texels[k], float(minTileSize),
+                                   float(atlasSize / 2));
+            if (!isActive[k])
+                continue;
+
+            ShadowAtlasRequest request;
+            request.key = uint32_t(k);
+            request.size =
+                SelectSize(texels[k], atlas.GetTile(request.key).size,
+                           minTileSize, atlasSize / 2);
+            request.priority = texels[k];
+            requests.push_back(request);
+        }
+        atlas.Update(requests);
+        isValid = isValid && atlas.Validate();
+
+        // Counts are summed over the frames, ratios averaged.
+        const auto &stats = atlas.m_stats;
+        average.requests += stats.requests;
+        average.downsized += stats.downsized;
+        average.failed += stats.failed;
+        average.moved += stats.moved;
+        average.usedTexels += stats.usedTexels;
+        average.occupancy += stats.occupancy / float(numFrames);
+        average.fragmentation += stats.fragmentation / float(numFrames);
+    }
+    return isValid;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// ref
+// Buddy allocation: https://en.wikipedia.org/wiki/Buddy_memory_allocation
+
+namespace jRenderer {
+
+// Square power of two region of the atlas, in texels.
+struct ShadowTile {
+    uint16_t x = 0;
+    uint16_t y = 0;
+    uint16_t size = 0; // 0: no tile
+
+    bool IsValid() const { return size > 0; }
+    bool operator==(const ShadowTile &o) const {
+        return x == o.x && y == o.y && size == o.size;
+    }
+};
+
+struct ShadowAtlasStats {
+    uint32_t requests = 0;
+    uint32_t downsized = 0; // got a smaller tile than requested
+    uint32_t failed = 0;    // got no tile at all
+    uint32_t moved = 0;     // new or moved tiles, their content is lost
+    uint64_t usedTexels = 0;
+    float occupancy = 0.0f;     // used / atlas
+    float fragmentation = 0.0f; // 1 - largest free block / free texels
+
+    void Reset() { *this = ShadowAtlasStats(); }
+};
+
+// Quadtree (buddy) allocator over a square power of two atlas. Every node is
+// free, used, split in four children, or not there because its parent is
+// free or used. Allocation takes the smallest free node that fits, and
+// freeing merges four free siblings back into their parent.
+class ShadowAtlasAllocator {
+  public:
+    void Initialize(uint32_t atlasSize, uint32_t minTileSize);
+    void Clear();
+
+    // size is rounded up to a power of two >= minTileSize.
+    bool Allocate(uint32_t size, ShadowTile &tile);
+    void Free(const ShadowTile &tile);
+
+    uint32_t GetAtlasSize() const { return m_atlasSize; }
+    uint32_t GetMinTileSize() const { return m_minTileSize; }
+    uint32_t GetLargestFree() const;
+    uint64_t GetFreeTexels() const;
+    float GetFragmentation() const;
+
+  private:
+    enum NodeState : uint8_t {
+        NODE_NONE = 0,
+        NODE_FREE,
+        NODE_USED,
+        NODE_SPLIT
+    };
+
+    int GetLevel(uint32_t size) const;
+    int AllocateNode(int level);
+    uint32_t GetDim(int level) const { return 1u << level; }
+
+    uint32_t m_atlasSize = 0;
+    uint32_t m_minTileSize = 0;
+    std::vector<std::vector<uint8_t>> m_levels; // level 0: the whole atlas
+    std::vector<uint32_t> m_freeCounts;         // free nodes per level
+};
+
+struct ShadowAtlasRequest {
+    uint32_t key = 0;      // stable over frames, e.g. light * 6 + face
+    uint32_t size = 0;     // wanted tile size
+    float priority = 0.0f; // higher is allocated first
+};
+
+// Keeps the tiles of the last frame and only touches what changed, so the
+// shadow cache can keep the content of the tiles that stay in place.
+class ShadowAtlas {
+  public:
+    void Initialize(uint32_t atlasSize, uint32_t minTileSize);
+
+    // Frees the keys that are gone, keeps the tiles that still have the
+    // wanted size, and allocates the rest by priority. A tile that can't
+    // grow keeps its old size, and a new one is halved until it fits.
+    void Update(const std::vector<ShadowAtlasRequest> &requests);
+
+    // Returns an invalid tile for unknown keys.
+    ShadowTile GetTile(uint32_t key) const;
+
+    // All tiles inside the atlas and disjoint.
+    bool Validate() const;
+
+    // Power of two for a wanted resolution. The current size only changes
+    // when the wanted one leaves [current / margin, 2 * current * margin),
+    // so a light near a boundary doesn't flip its tile every frame.
+    static uint32_t SelectSize(float texels, uint32_t current,
+                               uint32_t minSize, uint32_t maxSize,
+                               float margin = 1.25f);
+
+    // Random lights that come, go and change size over many frames.
+    // Returns false if the tiles ever overlapped.
+    static bool RunStressTest(uint32_t atlasSize, uint32_t minTileSize,
+                              int numKeys, int numFrames, uint32_t seed,
+                              ShadowAtlasStats &average);
+
+    const ShadowAtlasAllocator &GetAllocator() const { return m_allocator; }
+
+    ShadowAtlasStats m_stats;
+
+  private:
+    struct Entry {
+        uint32_t key = 0;
+        ShadowTile tile;
+        bool isUsed = false; // requested this frame
+    };
+
+    Entry *FindEntry(uint32_t key);
+
+    ShadowAtlasAllocator m_allocator;
+    std::vector<Entry> m_entries;
+    std::vector<const ShadowAtlasRequest *> m_pending;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,24 @@
+#include "ShadowCache.h"
+
+#include <algorithm>
+
+namespace jRenderer {
+
+void ShadowCache::Resize(int numFaces) {
+    m_signatures.resize(numFaces, 0);
+    m_isValid.resize(numFaces, 0);
+}
+
+void ShadowCache::Invalidate() {
+    std::fill(m_isValid.begin(), m_isValid.end(), uint8_t(0));
+}
+
+bool ShadowCache::Update(int face, uint64_t signature) {
+    if (m_isValid[face] && m_signatures[face] == signature)
+        return false;
+    m_signatures[face] = signature;
+    m_isValid[face] = 1;
+    return true;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace jRenderer {
+
+struct ShadowCacheStats {
+    uint32_t lights = 0;        // lights with a shadow map
+    uint32_t skippedLights = 0; // none of their faces was rendered
+    uint32_t faces = 0;         // shadow map faces, cube faces and cascades
+    uint32_t skippedFaces = 0;  // unchanged since they were last rendered
+    uint32_t casters = 0;       // caster x face pairs inside the volume
+    uint32_t culledCasters = 0; // caster x face pairs outside of it
+    uint32_t cubeCasters = 0;   // casters of point lights, any face
+    uint32_t cubeFaces = 0;     // their faces, instances of the VS path
+
+    void Reset() { *this = ShadowCacheStats(); }
+};
+
+// Remembers the signature each shadow map face was last rendered with, the
+// light's view projection and the casters inside it. A face whose signature
+// didn't change still holds the right depth and can be skipped.
+class ShadowCache {
+  public:
+    void Resize(int numFaces);
+
+    // Every face is rendered again, e.g. after the maps were recreated.
+    void Invalidate();
+
+    // Returns true when the face has to be rendered, and remembers the
+    // signature as rendered.
+    bool Update(int face, uint64_t signature);
+
+  private:
+    std::vector<uint64_t> m_signatures;
+    std::vector<uint8_t> m_isValid;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,196 @@
+#include "SoftwareOcclusion.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "CpuFeatures.h"
+
+namespace jRenderer {
+
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+
+float ElapsedMs(std::chrono::high_resolution_clock::time_point start) {
+    return std::chrono::duration<float, std::milli>(
+               std::chrono::high_resolution_clock::now() - start)
+        .count();
+}
+
+} // namespace
+
+void RasterizeRowScalar(float *row, int minX, int maxX, const float *a,
+                        const float *edgeRow, float dzdx, float zRow) {
+    for (int px = minX; px <= maxX; px++) {
+        const float fx = float(px) + 0.5f;
+        if (a[0] * fx + edgeRow[0] < 0.0f || a[1] * fx + edgeRow[1] < 0.0f ||
+            a[2] * fx + edgeRow[2] < 0.0f)
+            continue;
+        row[px] = std::min(row[px], dzdx * fx + zRow);
+    }
+}
+
+SoftwareOcclusion::SoftwareOcclusion() : m_useAvx2(HasAvx2()) {}
+
+void SoftwareOcclusion::SetUseAvx2(bool useAvx2) {
+    m_useAvx2 = useAvx2 && HasAvx2();
+}
+
+void SoftwareOcclusion::Resize(int width, int height) {
+    m_width = std::max(1, width);
+    m_height = std::max(1, height);
+    m_stride = (m_width + 7) & ~7;
+    m_depth.assign(size_t(m_stride) * m_height, 1.0f);
+    m_hiZ.Clear();
+}
+
+void SoftwareOcclusion::BeginFrame(const Matrix &viewProjRow) {
+    if (m_depth.empty())
+        Resize(256, 144);
+
+    m_viewProjRow = viewProjRow;
+    std::fill(m_depth.begin(), m_depth.end(), 1.0f);
+    m_hiZ.Clear();
+    m_stats.Reset();
+}
+
+void SoftwareOcclusion::RasterizeOccluder(const std::vector<Vector3> &positions,
+                                          const std::vector<uint32_t> &indices,
+                                          const Matrix &worldRow) {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    const Matrix worldViewProj = worldRow * m_viewProjRow;
+
+    // Vertices are shared by several triangles, so transform them once.
+    m_clipVertices.resize(positions.size() * 4);
+    for (size_t i = 0; i < positions.size(); i++) {
+        const Vector4 clip =
+            Vector4::Transform(Vector4(positions[i], 1.0f), worldViewProj);
+        float *out = &m_clipVertices[i * 4];
+        out[0] = clip.x;
+        out[1] = clip.y;
+        out[2] = clip.z;
+        out[3] = clip.w;
+    }
+
+    for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+        RasterizeTriangle(&m_clipVertices[indices[i] * 4],
+                          &m_clipVertices[indices[i + 1] * 4],
+                          &m_clipVertices[indices[i + 2] * 4]);
+    }
+
+    m_stats.occluders++;
+    m_stats.occluderTriangles += uint32_t(indices.size() / 3);
+    m_stats.rasterizeMs += ElapsedMs(start);
+}
+
+void SoftwareOcclusion::RasterizeTriangle(const float *v0, const float *v1,
+                                          const float *v2) {
+    // Triangles crossing the near plane are skipped instead of clipped.
+    // Dropping occluder area only makes the result more conservative.
+    const float nearW = 1e-4f;
+    if (v0[3] <= nearW || v1[3] <= nearW || v2[3] <= nearW)
+        return;
+
+    // Trivial reject when all vertices are outside the same clip plane
+    if ((v0[0] > v0[3] && v1[0] > v1[3] && v2[0] > v2[3]) ||
+        (v0[0] < -v0[3] && v1[0] < -v1[3] && v2[0] < -v2[3]) ||
+        (v0[1] > v0[3] && v1[1] > v1[3] && v2[1] > v2[3]) ||
+        (v0[1] < -v0[3] && v1[1] < -v1[3] && v2[1] < -v2[3]) ||
+        (v0[2] > v0[3] && v1[2] > v1[3] && v2[2] > v2[3]))
+        return;
+
+    // NDC -> screen (top-left origin)
+    float x[3], y[3], z[3];
+    const float *v[3] = {v0, v1, v2};
+    for (int i = 0; i < 3; i++) {
+        const float invW = 1.0f / v[i][3];
+        x[i] = (v[i][0] * invW * 0.5f + 0.5f) * m_width;
+        y[i] = (-v[i][1] * invW * 0.5f + 0.5f) * m_height;
+        z[i] = std::max(v[i][2] * invW, 0.0f);
+    }
+
+    float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if (std::abs(area) < 1e-8f)
+        return;
+
+    // Occluders are rasterized double sided, flip to a single winding.
+    if (area < 0.0f) {
+        std::swap(x[1], x[2]);
+        std::swap(y[1], y[2]);
+        std::swap(z[1], z[2]);
+        area = -area;
+    }
+
+    const int minX = std::max(0, int(std::floor(std::min({x[0], x[1], x[2]}))));
+    const int maxX =
+        std::min(m_width - 1, int(std::ceil(std::max({x[0], x[1], x[2]}))));
+    const int minY = std::max(0, int(std::floor(std::min({y[0], y[1], y[2]}))));
+    const int maxY =
+        std::min(m_height - 1, int(std::ceil(std::max({y[0], y[1], y[2]}))));
+    if (minX > maxX || minY > maxY)
+        return;
+
+    // Edge functions E(px, py) = a * px + b * py + c, positive inside.
+    // Pixel centers are sampled like the GPU does. Shrinking the edges to
+    // full coverage would open holes along the shared edges of a mesh.
+    float a[3], b[3], c[3];
+    for (int i = 0; i < 3; i++) {
+        const int j = (i + 1) % 3;
+        a[i] = y[i] - y[j];
+        b[i] = x[j] - x[i];
+        c[i] = x[i] * y[j] - x[j] * y[i];
+    }
+
+    // z/w is linear in screen space: z = z0 + dzdx * (px - x0) + ...
+    const float invArea = 1.0f / area;
+    const float dzdx =
+        ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) *
+        invArea;
+    const float dzdy =
+        ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) *
+        invArea;
+    // Farthest depth inside the pixel, again to stay conservative
+    const float zc = z[0] - dzdx * x[0] - dzdy * y[0] +
+                     0.5f * (std::abs(dzdx) + std::abs(dzdy));
+
+    m_stats.trianglesRasterized++;
+
+    for (int py = minY; py <= maxY; py++) {
+        const float fy = float(py) + 0.5f;
+        float *row = &m_depth[size_t(py) * m_stride];
+        const float edgeRow[3] = {b[0] * fy + c[0], b[1] * fy + c[1],
+                                  b[2] * fy + c[2]};
+        const float zRow = dzdy * fy + zc;
+
+        if (m_useAvx2)
+            RasterizeRowAvx2(row, minX, maxX, a, edgeRow, dzdx, zRow);
+        else
+            RasterizeRowScalar(row, minX, maxX, a, edgeRow, dzdx, zRow);
+    }
+}
+
+void SoftwareOcclusion::EndFrame() {
+    const auto start = std::chrono::high_resolution_clock::now();
+
+    if (m_stride == m_width) {
+        m_hiZ.Build(m_depth.data(), m_width, m_height);
+    } else {
+        std::vector<float> packed(size_t(m_width) * m_height);
+        for (int y = 0; y < m_height; y++) {
+            std::copy_n(GetDepth(y), m_width, &packed[size_t(y) * m_width]);
+        }
+        m_hiZ.Build(packed.data(), m_width, m_height);
+    }
+
+    m_stats.rasterizeMs += ElapsedMs(start);
+}
+
+bool SoftwareOcclusion::IsVisible(const Vector3 &boxMin,
+                                  const Vector3 &boxMax) const {
+    return !m_hiZ.IsBoxOccluded(boxMin, boxMax, m_viewProjRow);
+}
+
+} // namespace jRenderer
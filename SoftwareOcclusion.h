@@ -0,0 +1,92 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <vector>
+
+#include "Culling.h"
+
+// ref
+// Masked Software Occlusion Culling (Hasselgren et al., Intel)
+// https://github.com/GameTechDev/MaskedOcclusionCulling
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+
+struct OcclusionCullingStats {
+    uint32_t occluders = 0;
+    uint32_t occluderTriangles = 0;
+    uint32_t trianglesRasterized = 0;
+    uint32_t objectsTested = 0;
+    uint32_t objectsCulled = 0;
+    float rasterizeMs = 0.0f;
+    float testMs = 0.0f;
+
+    void Reset() { *this = OcclusionCullingStats(); }
+};
+
+// Depth test and write of one triangle row in [minX, maxX]. A pixel center
+// fx is inside when a[i] * fx + edgeRow[i] >= 0 for all three edges, its
+// depth is dzdx * fx + zRow. Both write the same depths, the AVX2 one is in
+// SoftwareOcclusionAvx2.cpp, the only file built for AVX2.
+void RasterizeRowScalar(float *row, int minX, int maxX, const float *a,
+                        const float *edgeRow, float dzdx, float zRow);
+void RasterizeRowAvx2(float *row, int minX, int maxX, const float *a,
+                      const float *edgeRow, float dzdx, float zRow);
+
+// Rasterizes occluder triangles into a small 32-bit float depth buffer on
+// the CPU (AVX2 when the CPU has it) and tests AABBs against its depth
+// pyramid.
+// Depth is D3D style: 0 is near, 1 is far, cleared to 1.
+class SoftwareOcclusion {
+  public:
+    SoftwareOcclusion();
+
+    void Resize(int width, int height);
+
+    // Off falls back to the scalar rows, on is ignored without AVX2.
+    void SetUseAvx2(bool useAvx2);
+    bool IsUsingAvx2() const { return m_useAvx2; }
+
+    // Clears the depth buffer and sets the camera for this frame.
+    void BeginFrame(const Matrix &viewProjRow);
+
+    // positions/indices are in model space.
+    void RasterizeOccluder(const std::vector<Vector3> &positions,
+                           const std::vector<uint32_t> &indices,
+                           const Matrix &worldRow);
+
+    // Builds the depth pyramid that the tests read from.
+    void EndFrame();
+
+    // World space AABB. Returns false if it is hidden behind occluders.
+    // Read only, so it can be called from several threads. The caller
+    // fills in the objects tested/culled stats.
+    bool IsVisible(const Vector3 &boxMin, const Vector3 &boxMax) const;
+
+    int GetWidth() const { return m_width; }
+    int GetHeight() const { return m_height; }
+    const float *GetDepth(int y) const {
+        return &m_depth[size_t(y) * m_stride];
+    }
+    const HiZBuffer &GetHiZ() const { return m_hiZ; }
+
+    OcclusionCullingStats m_stats;
+
+  private:
+    void RasterizeTriangle(const float *v0, const float *v1, const float *v2);
+
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0; // width padded to a multiple of 8 floats
+    bool m_useAvx2 = false;
+
+    Matrix m_viewProjRow;
+    std::vector<float> m_depth;
+    std::vector<float> m_clipVertices; // x, y, z, w per vertex (scratch)
+    HiZBuffer m_hiZ;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,61 @@
+#include "SoftwareOcclusion.h"
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace jRenderer {
+
+// Built with /arch:AVX2 (-mavx2), so nothing else may live in this file:
+// the compiler is free to use AVX2 in any function here.
+void RasterizeRowAvx2(float *row, int minX, int maxX, const float *a,
+                      const float *edgeRow, float dzdx, float zRow) {
+#if defined(_M_X64) || defined(__x86_64__)
+    const __m256 a0 = _mm256_set1_ps(a[0]);
+    const __m256 a1 = _mm256_set1_ps(a[1]);
+    const __m256 a2 = _mm256_set1_ps(a[2]);
+    const __m256 e0Row = _mm256_set1_ps(edgeRow[0]);
+    const __m256 e1Row = _mm256_set1_ps(edgeRow[1]);
+    const __m256 e2Row = _mm256_set1_ps(edgeRow[2]);
+    const __m256 dz = _mm256_set1_ps(dzdx);
+    const __m256 z = _mm256_set1_ps(zRow);
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 lane =
+        _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+    const __m256i laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i spanMin = _mm256_set1_epi32(minX - 1);
+    const __m256i spanMax = _mm256_set1_epi32(maxX + 1);
+
+    // Rows are padded to 8 floats, the lanes past maxX are masked out.
+    for (int px = minX & ~7; px <= maxX; px += 8) {
+        const __m256 fx = _mm256_add_ps(_mm256_set1_ps(float(px)), lane);
+        const __m256 e0 = _mm256_add_ps(_mm256_mul_ps(a0, fx), e0Row);
+        const __m256 e1 = _mm256_add_ps(_mm256_mul_ps(a1, fx), e1Row);
+        const __m256 e2 = _mm256_add_ps(_mm256_mul_ps(a2, fx), e2Row);
+
+        __m256 inside = _mm256_and_ps(
+            _mm256_and_ps(_mm256_cmp_ps(e0, zero, _CMP_GE_OQ),
+                          _mm256_cmp_ps(e1, zero, _CMP_GE_OQ)),
+            _mm256_cmp_ps(e2, zero, _CMP_GE_OQ));
+
+        // Keep the lanes within [minX, maxX]
+        const __m256i xs = _mm256_add_epi32(_mm256_set1_epi32(px), laneIndex);
+        const __m256i inSpan =
+            _mm256_and_si256(_mm256_cmpgt_epi32(xs, spanMin),
+                             _mm256_cmpgt_epi32(spanMax, xs));
+        inside = _mm256_and_ps(inside, _mm256_castsi256_ps(inSpan));
+
+        if (_mm256_movemask_ps(inside) == 0)
+            continue;
+
+        const __m256 depth = _mm256_add_ps(_mm256_mul_ps(dz, fx), z);
+        const __m256 old = _mm256_loadu_ps(row + px);
+        const __m256 closer = _mm256_min_ps(old, depth);
+        _mm256_storeu_ps(row + px, _mm256_blendv_ps(old, closer, inside));
+    }
+#else
+    RasterizeRowScalar(row, minX, maxX, a, edgeRow, dzdx, zRow);
+#endif
+}
+
+} // namespace jRenderer
@@ -0,0 +1,359 @@
+#include "SsaoReference.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+#include "JobSystem.h"
+
+namespace jRenderer {
+
+namespace {
+
+float Saturate(float x) { return std::min(std::max(x, 0.0f), 1.0f); }
+
+float SmoothStep01(float x) {
+    const float t = Saturate(x);
+    return t * t * (3.0f - 2.0f * t);
+}
+
+// Same as DepthWeight() in SSAOCommon.hlsli
+float DepthWeight(float viewZ, float otherZ, float depthSigma) {
+    const float diff = std::abs(viewZ - otherZ) / (viewZ * depthSigma);
+    return std::exp(-diff * diff);
+}
+
+} // namespace
+
+SsaoReference::SsaoReference(const GBufferCapture &capture,
+                             const Vector4 *kernel, const Vector3 *noise)
+    : m_capture(capture), m_kernel(kernel), m_noise(noise) {
+    m_invProj = capture.projRow.Invert();
+
+    m_viewDepth.resize(size_t(capture.width) * capture.height);
+    JobSystem::ParallelFor(
+        capture.height, 16, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = begin; y < end; y++) {
+                for (uint32_t x = 0; x < capture.width; x++) {
+                    m_viewDepth[y * capture.width + x] =
+                        GetViewPosition(x, y).z;
+                }
+            }
+        });
+}
+
+// GetViewSpacePosition() in Common.hlsli at the pixel center
+Vector3 SsaoReference::GetViewPosition(int x, int y) const {
+    const float u = (float(x) + 0.5f) / float(m_capture.width);
+    const float v = (float(y) + 0.5f) / float(m_capture.height);
+    const float depth = m_capture.depth[y * m_capture.width + x];
+    const Vector4 p = Vector4::Transform(
+        Vector4(u * 2.0f - 1.0f, 1.0f - v * 2.0f, depth, 1.0f), m_invProj);
+    return Vector3(p.x, p.y, p.z) / p.w;
+}
+
+float SsaoReference::GetViewDepth(int x, int y) const {
+    return m_viewDepth[y * m_capture.width + x];
+}
+
+void SsaoReference::SetSizes(SsaoConstants &consts) const {
+    consts.screenWidth = m_capture.width;
+    consts.screenHeight = m_capture.height;
+    consts.aoWidth = (m_capture.width + consts.scale - 1) / consts.scale;
+    consts.aoHeight = (m_capture.height + consts.scale - 1) / consts.scale;
+}
+
+float SsaoReference::ComputeOcclusion(const SsaoConstants &consts,
+                                      const Vector3 &position,
+                                      const Vector3 &normal, int aoX,
+                                      int aoY) const {
+    Vector3 randomVector = m_noise[(aoY % 4) * 4 + aoX % 4];
+    randomVector.Normalize();
+
+    Vector3 tangent = randomVector - normal * randomVector.Dot(normal);
+    tangent.Normalize();
+    const Vector3 bitangent = normal.Cross(tangent);
+
+    const int width = int(m_capture.width);
+    const int height = int(m_capture.height);
+    float occlusion = 0.0f;
+    for (uint32_t i = 0; i < consts.sampleCount; i++) {
+        const Vector4 &k =
+            m_kernel[i * consts.sampleStride + consts.sampleOffset];
+        const Vector3 sample =
+            position +
+            (tangent * k.x + bitangent * k.y + normal * k.z) * consts.radius;
+
+        const Vector4 offset =
+            Vector4::Transform(Vector4(sample, 1.0f), m_capture.projRow);
+        const float u = offset.x / offset.w * 0.5f + 0.5f;
+        const float v = -offset.y / offset.w * 0.5f + 0.5f;
+        if (u < 0.0f || v < 0.0f || u >= 1.0f || v >= 1.0f)
+            continue; // off screen, not occluded
+
+        const int x = std::min(int(u * float(width)), width - 1);
+        const int y = std::min(int(v * float(height)), height - 1);
+        const float sampleDepth = GetViewDepth(x, y);
+        const float occluded =
+            sample.z + consts.bias >= sampleDepth ? 1.0f : 0.0f;
+        const float intensity = SmoothStep01(
+            consts.radius / std::abs(position.z - sampleDepth));
+
+        occlusion += occluded * intensity;
+    }
+
+    return std::pow(std::abs(1.0f - occlusion / float(consts.sampleCount)),
+                    consts.power);
+}
+
+void SsaoReference::ComputeAO(const SsaoConstants &consts,
+                              std::vector<float> &ao,
+                              std::vector<float> &aoDepth) const {
+    const size_t count = size_t(consts.aoWidth) * consts.aoHeight;
+    if (!consts.historyValid) {
+        ao.assign(count, 1.0f);
+        aoDepth.assign(count, 0.0f);
+    }
+
+    const int scale = int(consts.scale);
+    const int maxX = int(m_capture.width) - 1;
+    const int maxY = int(m_capture.height) - 1;
+    JobSystem::ParallelFor(
+        consts.aoHeight, 4, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t aoY = begin; aoY < end; aoY++) {
+                for (uint32_t aoX = 0; aoX < consts.aoWidth; aoX++) {
+                    const int x = std::min(int(aoX) * scale + scale / 2, maxX);
+                    const int y = std::min(int(aoY) * scale + scale / 2, maxY);
+                    const size_t i = aoY * consts.aoWidth + aoX;
+                    const size_t p = y * m_capture.width + x;
+
+                    const float history = ao[i];
+                    const float prevZ = aoDepth[i];
+                    aoDepth[i] = GetViewDepth(x, y);
+                    ao[i] = 1.0f;
+                    if (m_capture.depth[p] >= 1.0f)
+                        continue; // sky
+
+                    ao[i] = ComputeOcclusion(consts, GetViewPosition(x, y),
+                                             m_capture.normal[p], aoX, aoY);
+                    if (consts.historyValid) {
+                        const float alpha =
+                            1.0f + (consts.temporalAlpha - 1.0f) *
+                                       DepthWeight(aoDepth[i], prevZ,
+                                                   consts.depthSigma);
+                        ao[i] = history + (ao[i] - history) * alpha;
+                    }
+                }
+            }
+        });
+}
+
+void SsaoReference::Upsample(const SsaoConstants &consts,
+                             const std::vector<float> &ao,
+                             const std::vector<float> &aoDepth,
+                             std::vector<float> &result) const {
+    result.resize(size_t(m_capture.width) * m_capture.height);
+
+    const float scale = float(consts.scale);
+    const float halfScale = float(consts.scale / 2);
+    const int maxX = int(consts.aoWidth) - 1;
+    const int maxY = int(consts.aoHeight) - 1;
+    JobSystem::ParallelFor(
+        m_capture.height, 16, [&](uint32_t begin, uint32_t end) {
+            for (uint32_t y = begin; y < end; y++) {
+                for (uint32_t x = 0; x < m_capture.width; x++) {
+                    const float viewZ = GetViewDepth(x, y);
+                    const float tx = (float(x) - halfScale) / scale;
+                    const float ty = (float(y) - halfScale) / scale;
+                    const int baseX = int(std::floor(tx));
+                    const int baseY = int(std::floor(ty));
+                    const float fx = tx - float(baseX);
+                    const float fy = ty - float(baseY);
+
+                    float sum = 0.0f;
+                    float weightSum = 0.0f;
+                    float nearestAO = 1.0f;
+                    float nearestDiff = 1e30f;
+                    for (int k = 0; k < 4; k++) {
+                        const int ox = k & 1;
+                        const int oy = k >> 1;
+                        const int texelX = std::clamp(baseX + ox, 0, maxX);
+                        const int texelY = std::clamp(baseY + oy, 0, maxY);
+                        const float bilinear = (ox ? fx : 1.0f - fx) *
+                                               (oy ? fy : 1.0f - fy);
+
+                        const size_t i = texelY * consts.aoWidth + texelX;
+                        const float weight =
+                            bilinear *
+                            DepthWeight(viewZ, aoDepth[i], consts.depthSigma);
+                        sum += ao[i] * weight;
+                        weightSum += weight;
+
+                        const float diff = std::abs(aoDepth[i] - viewZ);
+                        if (diff < nearestDiff) {
+                            nearestDiff = diff;
+                            nearestAO = ao[i];
+                        }
+                    }
+
+                    result[y * m_capture.width + x] =
+                        weightSum > 1e-4f ? sum / weightSum : nearestAO;
+                }
+            }
+        });
+}
+
+void SsaoReference::BlurPass(const SsaoConstants &consts,
+                             const std::vector<float> &ao,
+                             std::vector<float> &result, int dirX, int dirY,
+                             bool roundTo8Bits) const {
+    // Gaussian, sigma = SSAO_BLUR_RADIUS / 2, same as SSAOBlurCS.hlsli
+    static const float weights[SSAO_BLUR_RADIUS + 1] = {
+        1.0f, 0.8824969f, 0.6065307f, 0.3246525f, 0.1353353f};
+
+    const int width = int(m_capture.width);
+    const int height = int(m_capture.height);
+    result.resize(ao.size());
+    JobSystem::ParallelFor(height, 16, [&](uint32_t begin, uint32_t end) {
+        for (int y = int(begin); y < int(end); y++) {
+            for (int x = 0; x < width; x++) {
+                const float viewZ = GetViewDepth(x, y);
+                float sum = 0.0f;
+                float weightSum = 0.0f;
+                for (int k = -SSAO_BLUR_RADIUS; k <= SSAO_BLUR_RADIUS; k++) {
+                    const int sx = std::clamp(x + k * dirX, 0, width - 1);
+                    const int sy = std::clamp(y + k * dirY, 0, height - 1);
+                    const float weight =
+                        weights[std::abs(k)] *
+                        DepthWeight(viewZ, GetViewDepth(sx, sy),
+                                    consts.depthSigma);
+                    sum += ao[sy * width + sx] * weight;
+                    weightSum += weight;
+                }
+
+                float value = sum / weightSum;
+                if (roundTo8Bits)
+                    value = std::round(Saturate(value) * 255.0f) / 255.0f;
+                result[y * width + x] = value;
+            }
+        }
+    });
+}
+
+void SsaoReference::Blur(const SsaoConstants &consts,
+                         const std::vector<float> &ao,
+                         std::vector<float> &result) const {
+    std::vector<float> horizontal;
+    BlurPass(consts, ao, horizontal, 1, 0, true);
+    BlurPass(consts, horizontal, result, 0, 1, false);
+}
+
+void SsaoReference::Run(const SsaoConstants &consts, std::vector<float> &ao,
+                        std::vector<float> &aoDepth,
+                        std::vector<float> &result) const {
+    ComputeAO(consts, ao, aoDepth);
+    if (consts.scale > 1)
+        Upsample(consts, ao, aoDepth, result);
+    else
+        result = ao;
+}
+
+uint64_t SsaoReference::GetLoads(const SsaoConstants &consts) const {
+    // depth, normal, noise and the samples, the history on top
+    const uint64_t perTexel =
+        3 + consts.sampleCount + (consts.temporalAlpha < 1.0f ? 2 : 0);
+    uint64_t loads = uint64_t(consts.aoWidth) * consts.aoHeight * perTexel;
+    if (consts.scale > 1) // depth and 4 AO texels with their depth
+        loads += uint64_t(m_capture.width) * m_capture.height * 9;
+    return loads;
+}
+
+SsaoEvaluation SsaoReference::Evaluate(const SsaoConstants &consts,
+                                       uint32_t frames) const {
+    using Clock = std::chrono::high_resolution_clock;
+    auto elapsedMs = [](Clock::time_point start) {
+        return std::chrono::duration<float, std::milli>(Clock::now() - start)
+            .count();
+    };
+
+    SsaoEvaluation eval;
+    frames = std::max(frames, 1u);
+
+    std::vector<float> ao;
+    std::vector<float> aoDepth;
+    std::vector<float> reference;
+    SsaoConstants refConsts = consts;
+    refConsts.scale = 1;
+    refConsts.sampleCount = MAX_SAMPLES;
+    refConsts.sampleStride = 1;
+    refConsts.sampleOffset = 0;
+    refConsts.temporalAlpha = 1.0f;
+    refConsts.historyValid = 0;
+    SetSizes(refConsts);
+    auto start = Clock::now();
+    Run(refConsts, ao, aoDepth, reference);
+    eval.referenceMs = elapsedMs(start);
+    eval.referenceLoads = GetLoads(refConsts);
+
+    SsaoConstants testConsts = consts;
+    testConsts.sampleStride = MAX_SAMPLES / testConsts.sampleCount;
+    SetSizes(testConsts);
+    eval.scale = testConsts.scale;
+    eval.sampleCount = testConsts.sampleCount;
+    eval.frames = frames;
+    eval.testLoads = GetLoads(testConsts);
+
+    auto measure = [&](const std::vector<float> &result, float &meanError) {
+        double sum = 0.0;
+        double sumSq = 0.0;
+        uint64_t count = 0;
+        eval.maxError = 0.0f;
+        for (size_t i = 0; i < reference.size(); i++) {
+            if (m_capture.depth[i] >= 1.0f)
+                continue;
+            const float error = std::abs(result[i] - reference[i]);
+            sum += error;
+            sumSq += double(error) * error;
+            eval.maxError = std::max(eval.maxError, error);
+            count++;
+        }
+        meanError = count ? float(sum / count) : 0.0f;
+        const double mse = count ? sumSq / count : 0.0;
+        eval.psnr = mse > 0.0 ? float(10.0 * std::log10(1.0 / mse)) : 99.0f;
+    };
+
+    std::vector<float> result;
+    float testMs = 0.0f;
+    for (uint32_t f = 0; f < frames; f++) {
+        testConsts.sampleOffset = f % testConsts.sampleStride;
+        testConsts.historyValid = f > 0 && testConsts.temporalAlpha < 1.0f;
+        start = Clock::now();
+        Run(testConsts, ao, aoDepth, result);
+        testMs += elapsedMs(start);
+        if (f == 0)
+            measure(result, eval.firstFrameMeanError);
+    }
+    measure(result, eval.meanError);
+    eval.testMs = testMs / float(frames);
+
+    const size_t numPixels = size_t(m_capture.width) * m_capture.height;
+    if (m_capture.ao.size() == numPixels &&
+        m_capture.blurredAO.size() == numPixels) {
+        start = Clock::now();
+        Blur(consts, m_capture.ao, result);
+        eval.blurMs = elapsedMs(start);
+
+        double sum = 0.0;
+        eval.blurMaxError = 0.0f;
+        for (size_t i = 0; i < numPixels; i++) {
+            const float error = std::abs(result[i] - m_capture.blurredAO[i]);
+            sum += error;
+            eval.blurMaxError = std::max(eval.blurMaxError, error);
+        }
+        eval.blurMeanError = float(sum / numPixels);
+    }
+
+    return eval;
+}
+
+} // namespace jRenderer
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cstdint>
+#include <directxtk/SimpleMath.h>
+#include <vector>
+
+#include "ConstantBuffers.h"
+
+namespace jRenderer {
+
+using DirectX::SimpleMath::Matrix;
+using DirectX::SimpleMath::Vector3;
+using DirectX::SimpleMath::Vector4;
+
+// Depth and normals read back from the G-buffer
+struct GBufferCapture {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> depth;    // NDC depth, 1: sky
+    std::vector<Vector3> normal; // view space
+    Matrix projRow;
+
+    // GPU AO of the same frame before and after the blur, [0, 1].
+    // Empty when SSAO was off.
+    std::vector<float> ao;
+    std::vector<float> blurredAO;
+
+    bool IsValid() const { return width > 0 && height > 0; }
+};
+
+// Compares one SSAO mode with full resolution and all kernel samples.
+// Sky pixels are not counted.
+struct SsaoEvaluation {
+    uint32_t scale = 1;
+    uint32_t sampleCount = MAX_SAMPLES;
+    uint32_t frames = 0; // temporal frames accumulated, static camera
+
+    float firstFrameMeanError = 0.0f; // no history yet
+    float meanError = 0.0f;           // after the last frame
+    float maxError = 0.0f;
+    float psnr = 0.0f; // dB
+
+    // CPU time of one frame, AO and upsample
+    float referenceMs = 0.0f;
+    float testMs = 0.0f;
+
+    // Texture loads of one frame at most, what the GPU cost scales with
+    uint64_t referenceLoads = 0;
+    uint64_t testLoads = 0;
+
+    // Blur() over the captured GPU AO vs the GPU blur, -1: not captured
+    float blurMeanError = -1.0f;
+    float blurMaxError = -1.0f;
+    float blurMs = 0.0f;
+};
+
+// CPU version of SSAO.hlsl, SSAOUpsample.hlsl and SSAOBlurCS.hlsli, one
+// float per pixel. Slow, only for checking the quality of the cheaper
+// modes. The blur after the upsample is left out of Evaluate() on both
+// sides and checked against the GPU on its own.
+class SsaoReference {
+  public:
+    SsaoReference(const GBufferCapture &capture, const Vector4 *kernel,
+                  const Vector3 *noise);
+
+    // AO at 1/consts.scale of the capture, with the history when
+    // consts.historyValid. The camera doesn't move, so the history is read
+    // at the same texel.
+    void ComputeAO(const SsaoConstants &consts, std::vector<float> &ao,
+                   std::vector<float> &aoDepth) const;
+
+    void Upsample(const SsaoConstants &consts, const std::vector<float> &ao,
+                  const std::vector<float> &aoDepth,
+                  std::vector<float> &result) const;
+
+    // Separable bilateral blur, horizontal then vertical. The result of the
+    // first pass is rounded to 8 bits like the R8_UNORM target in between.
+    void Blur(const SsaoConstants &consts, const std::vector<float> &ao,
+              std::vector<float> &result) const;
+
+    // Runs consts for 'frames' frames, rotating the samples like
+    // Engine::UpdateSsaoConstants().
+    SsaoEvaluation Evaluate(const SsaoConstants &consts,
+                            uint32_t frames) const;
+
+    uint64_t GetLoads(const SsaoConstants &consts) const;
+
+    // Fills in the AO and screen size of consts for the capture
+    void SetSizes(SsaoConstants &consts) const;
+
+  private:
+    float GetViewDepth(int x, int y) const;
+    Vector3 GetViewPosition(int x, int y) const;
+    float ComputeOcclusion(const SsaoConstants &consts,
+                           const Vector3 &position, const Vector3 &normal,
+                           int aoX, int aoY) const;
+    void BlurPass(const SsaoConstants &consts, const std::vector<float> &ao,
+                  std::vector<float> &result, int dirX, int dirY,
+                  bool roundTo8Bits) const;
+    void Run(const SsaoConstants &consts, std::vector<float> &ao,
+             std::vector<float> &aoDepth, std::vector<float> &result) const;
+
+    const GBufferCapture &m_capture;
+    const Vector4 *m_kernel;
+    const Vector3 *m_noise; // 4x4
+    Matrix m_invProj;
+    std::vector<float> m_viewDepth;
+};
+
+} // namespace jRenderer
@@ -0,0 +1,106 @@
+#include <algorithm>
+#include <random>
+
+#include "ClusteredLighting.h"
+#include "JobSystem.h"
+#include "Test.h"
+
+using namespace jRenderer;
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+
+// View space lights in and around the frustum, a few directional and off
+std::vector<ClusterLight> MakeLights(int count, uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> xy(-40.0f, 40.0f);
+    std::uniform_real_distribution<float> z(-10.0f, 110.0f);
+    std::uniform_real_distribution<float> range(0.2f, 15.0f);
+    std::uniform_int_distribution<int> type(0, 19);
+    std::vector<ClusterLight> lights(count);
+    for (auto &light : lights) {
+        light.position = Vector3(xy(random), xy(random), z(random));
+        light.range = range(random);
+        const int t = type(random);
+        light.type = t == 0   ? LIGHT_DIRECTIONAL
+                     : t == 1 ? LIGHT_OFF
+                     : t < 10 ? LIGHT_SPOT | LIGHT_SHADOW
+                              : LIGHT_POINT;
+    }
+    return lights;
+}
+
+std::vector<uint32_t> GetList(const LightClusterGrid &grid,
+                              uint32_t cluster) {
+    const ClusterRange &range = grid.GetRanges()[cluster];
+    const auto begin = grid.GetLightIndices().begin() + range.offset;
+    return std::vector<uint32_t>(begin, begin + range.count);
+}
+
+bool Overlaps(const ClusterLight &light, const Vector3 &boxMin,
+              const Vector3 &boxMax) {
+    const Vector3 closest = Vector3::Max(boxMin,
+                                         Vector3::Min(light.position, boxMax));
+    return Vector3::DistanceSquared(closest, light.position) <=
+           light.range * light.range;
+}
+
+void CheckBinMatchesReference(uint32_t dimX, uint32_t dimY, uint32_t dimZ,
+                              int numLights, uint32_t seed) {
+    const Matrix proj = XMMatrixPerspectiveFovLH(
+        XMConvertToRadians(70.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+    const auto lights = MakeLights(numLights, seed);
+
+    LightClusterGrid fast, reference;
+    for (LightClusterGrid *grid : {&fast, &reference}) {
+        grid->SetDimensions(dimX, dimY, dimZ);
+        grid->Build(proj);
+    }
+    fast.Bin(lights);
+    reference.BinReference(lights);
+
+    CHECK_EQ(fast.m_stats.lightIndices, reference.m_stats.lightIndices);
+    CHECK_EQ(fast.m_stats.maxPerCluster, reference.m_stats.maxPerCluster);
+    if (numLights > 0)
+        CHECK_LT(0u, reference.m_stats.lightIndices);
+
+    int different = 0, wrong = 0;
+    for (uint32_t c = 0; c < reference.GetClusterCount(); c++) {
+        const auto list = GetList(reference, c);
+        different += GetList(fast, c) != list;
+
+        // Against a plain sphere vs box test of every light
+        Vector3 boxMin, boxMax;
+        reference.GetClusterBounds(c, boxMin, boxMax);
+        for (uint32_t i = 0; i < uint32_t(lights.size()); i++) {
+            const uint32_t type = lights[i].type;
+            const bool expected =
+                (type & LIGHT_DIRECTIONAL) ||
+                ((type & (LIGHT_POINT | LIGHT_SPOT)) &&
+                 Overlaps(lights[i], boxMin, boxMax));
+            const bool binned =
+                std::find(list.begin(), list.end(), i) != list.end();
+            wrong += expected != binned;
+        }
+    }
+    CHECK_EQ(different, 0);
+    CHECK_EQ(wrong, 0);
+}
+
+} // namespace
+
+TEST(ClusteredLighting, BinMatchesReference) {
+    JobSystem::Initialize(3);
+    CheckBinMatchesReference(16, 9, 24, 1000, 1);
+    // Odd sizes and fewer lights than a SIMD batch in most slices
+    CheckBinMatchesReference(7, 5, 11, 13, 2);
+    CheckBinMatchesReference(16, 9, 24, 0, 3);
+    JobSystem::Shutdown();
+}
+
+TEST(ClusteredLighting, BinMatchesReferenceWithoutWorkers) {
+    JobSystem::Initialize(0);
+    CheckBinMatchesReference(16, 9, 24, 300, 4);
+    JobSystem::Shutdown();
+}
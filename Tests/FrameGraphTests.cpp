@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <string>
+
+#include "FrameGraph.h"
+#include "Test.h"
+
+using namespace jRenderer;
+
+namespace {
+
+TransientTextureDesc MakeDesc() {
+    TransientTextureDesc desc;
+    desc.width = 1280;
+    desc.height = 720;
+    desc.format = 10;
+    desc.bindFlags = 0x28;
+    desc.bytesPerPixel = 8;
+    return desc;
+}
+
+bool Contains(const std::string &text, const std::string &part) {
+    return text.find(part) != std::string::npos;
+}
+
+int CountClears(const FrameGraph &graph, uint32_t resource) {
+    const auto &commands = graph.GetCommands();
+    return int(std::count_if(commands.begin(), commands.end(),
+                             [&](const FrameGraphCommand &command) {
+                                 return command.type ==
+                                            FrameGraphCommand::Clear &&
+                                        command.index == resource;
+                             }));
+}
+
+} // namespace
+
+TEST(FrameGraph, CullsPassesNothingReads) {
+    FrameGraph graph;
+    const uint32_t backBuffer = graph.ImportResource("BackBuffer");
+    const uint32_t lit = graph.CreateResource("Lit", MakeDesc());
+    const uint32_t unused = graph.CreateResource("Unused", MakeDesc());
+    const uint32_t unusedBlur = graph.CreateResource("Blur", MakeDesc());
+    const uint32_t overwritten = graph.CreateResource("Color", MakeDesc());
+    const uint32_t readback = graph.CreateResource("Readback", MakeDesc());
+
+    const uint32_t light = graph.AddPass("Light");
+    graph.Write(light, lit);
+    const uint32_t orphan = graph.AddPass("Orphan");
+    graph.Write(orphan, unused);
+    // Reads the output of Orphan, but nothing reads its own output
+    const uint32_t orphanBlur = graph.AddPass("OrphanBlur");
+    graph.Read(orphanBlur, unused, ShaderStage::Compute, 0);
+    graph.Write(orphanBlur, unusedBlur);
+    // Discarded by Fog before anyone reads it
+    const uint32_t dead = graph.AddPass("Dead");
+    graph.Write(dead, overwritten);
+    const uint32_t fog = graph.AddPass("Fog");
+    graph.Read(fog, lit, ShaderStage::Pixel, 0);
+    graph.Write(fog, overwritten, WriteMode::Discard);
+    // Blends on top of Fog, so Fog stays
+    const uint32_t post = graph.AddPass("Post");
+    graph.Write(post, overwritten, WriteMode::Load);
+    const uint32_t present = graph.AddPass("Present");
+    graph.Read(present, overwritten, ShaderStage::Pixel, 0);
+    graph.Write(present, backBuffer);
+    const uint32_t capture = graph.AddPass("Capture");
+    graph.Write(capture, readback);
+    graph.SetSideEffect(capture);
+    graph.Compile();
+
+    CHECK(!graph.IsCulled(light));
+    CHECK(graph.IsCulled(orphan));
+    CHECK(graph.IsCulled(orphanBlur));
+    CHECK(graph.IsCulled(dead));
+    CHECK(!graph.IsCulled(fog));
+    CHECK(!graph.IsCulled(post));
+    CHECK(!graph.IsCulled(present));
+    CHECK(!graph.IsCulled(capture));
+    const std::vector<uint32_t> schedule = {light, fog, post, present,
+                                            capture};
+    CHECK(graph.GetSchedule() == schedule);
+
+    // Culled passes don't run.
+    std::vector<uint32_t> ran;
+    FrameGraph counted;
+    const uint32_t target = counted.ImportResource("BackBuffer");
+    const uint32_t kept = counted.AddPass("Kept", [&] { ran.push_back(0); });
+    counted.Write(kept, target);
+    counted.AddPass("Culled", [&] { ran.push_back(1); });
+    counted.Compile();
+    counted.Execute([](uint32_t) {}, [](ShaderStage, uint32_t) {});
+    CHECK(ran == std::vector<uint32_t>{0});
+}
+
+TEST(FrameGraph, LifetimesInScheduleOrder) {
+    FrameGraph graph;
+    const uint32_t backBuffer = graph.ImportResource("BackBuffer");
+    const uint32_t a = graph.CreateResource("A", MakeDesc());
+    const uint32_t b = graph.CreateResource("B", MakeDesc());
+    const uint32_t unused = graph.CreateResource("Unused", MakeDesc());
+
+    const uint32_t p0 = graph.AddPass("P0");
+    graph.Write(p0, a);
+    const uint32_t culled = graph.AddPass("Culled");
+    graph.Write(culled, unused);
+    const uint32_t p1 = graph.AddPass("P1");
+    graph.Read(p1, a, ShaderStage::Compute, 0);
+    graph.Write(p1, b);
+    const uint32_t p2 = graph.AddPass("P2");
+    graph.Read(p2, a, ShaderStage::Pixel, 0);
+    graph.Read(p2, b, ShaderStage::Pixel, 1);
+    graph.Write(p2, backBuffer);
+    graph.Compile();
+
+    // Positions in GetSchedule(), the culled pass isn't counted.
+    CHECK(graph.IsCulled(culled));
+    CHECK_EQ(graph.GetLifetime(a).firstPass, 0u);
+    CHECK_EQ(graph.GetLifetime(a).lastPass, 2u);
+    CHECK_EQ(graph.GetLifetime(b).firstPass, 1u);
+    CHECK_EQ(graph.GetLifetime(b).lastPass, 2u);
+    CHECK_EQ(graph.GetLifetime(backBuffer).firstPass, 2u);
+    CHECK(!graph.GetLifetime(unused).IsUsed());
+    CHECK_EQ(graph.GetSchedule()[graph.GetLifetime(b).firstPass], p1);
+}
+
+TEST(FrameGraph, ClearsOnlyUndefinedLoads) {
+    FrameGraph graph;
+    const uint32_t backBuffer = graph.ImportResource("BackBuffer");
+    const uint32_t history = graph.ImportResource("History");
+    const uint32_t fresh = graph.CreateResource("Fresh", MakeDesc());
+    const uint32_t written = graph.CreateResource("Written", MakeDesc());
+    const uint32_t cleared = graph.CreateResource("Cleared", MakeDesc());
+    const uint32_t discarded = graph.CreateResource("Discarded", MakeDesc());
+
+    const uint32_t first = graph.AddPass("First");
+    graph.Write(first, written, WriteMode::Discard);
+    graph.Write(first, discarded, WriteMode::Discard);
+    graph.Write(first, cleared, WriteMode::Clear);
+    const uint32_t blend = graph.AddPass("Blend");
+    graph.Write(blend, fresh, WriteMode::Load);   // nothing wrote it yet
+    graph.Write(blend, written, WriteMode::Load); // First wrote it
+    graph.Write(blend, history, WriteMode::Load); // last frame wrote it
+    const uint32_t combine = graph.AddPass("Combine");
+    graph.Read(combine, fresh, ShaderStage::Pixel, 0);
+    graph.Read(combine, written, ShaderStage::Pixel, 1);
+    graph.Read(combine, cleared, ShaderStage::Pixel, 2);
+    graph.Read(combine, discarded, ShaderStage::Pixel, 3);
+    graph.Write(combine, backBuffer, WriteMode::Load);
+    graph.Compile();
+
+    CHECK_EQ(CountClears(graph, fresh), 1);
+    CHECK_EQ(CountClears(graph, written), 0);
+    CHECK_EQ(CountClears(graph, history), 0);
+    CHECK_EQ(CountClears(graph, cleared), 1);
+    CHECK_EQ(CountClears(graph, discarded), 0);
+    CHECK_EQ(CountClears(graph, backBuffer), 0);
+
+    // The clear comes right before the pass that loads.
+    const auto &commands = graph.GetCommands();
+    for (size_t i = 0; i + 1 < commands.size(); i++) {
+        if (commands[i].type == FrameGraphCommand::Clear &&
+            commands[i].index == fresh) {
+            CHECK_EQ(int(commands[i + 1].type),
+                     int(FrameGraphCommand::Execute));
+            CHECK_EQ(commands[i + 1].index, blend);
+        }
+    }
+
+    std::vector<uint32_t> clearedResources;
+    graph.Execute([&](uint32_t r) { clearedResources.push_back(r); },
+                  [](ShaderStage, uint32_t) {});
+    std::sort(clearedResources.begin(), clearedResources.end());
+    CHECK(clearedResources == (std::vector<uint32_t>{fresh, cleared}));
+}
+
+TEST(FrameGraph, UnbindsSrvsBeforeTheResourceIsWritten) {
+    FrameGraph graph;
+    const uint32_t backBuffer = graph.ImportResource("BackBuffer");
+    const uint32_t depth = graph.ImportResource("Depth");
+    const uint32_t ao = graph.CreateResource("AO", MakeDesc());
+    const uint32_t blurred = graph.CreateResource("Blurred", MakeDesc());
+    const uint32_t bloom = graph.CreateResource("Bloom", MakeDesc());
+
+    const uint32_t ssao = graph.AddPass("SSAO");
+    graph.Read(ssao, depth, ShaderStage::Pixel, 0);
+    graph.Write(ssao, ao);
+    const uint32_t blurX = graph.AddPass("BlurX");
+    graph.Read(blurX, ao, ShaderStage::Compute, 0);
+    graph.Write(blurX, blurred);
+    const uint32_t blurY = graph.AddPass("BlurY");
+    graph.Read(blurY, blurred, ShaderStage::Compute, 0);
+    graph.Write(blurY, ao);
+    const uint32_t bloomPass = graph.AddPass("Bloom");
+    graph.Read(bloomPass, blurred, ShaderStage::Pixel, 1);
+    graph.Read(bloomPass, ao, ShaderStage::Pixel, 2);
+    graph.Write(bloomPass, bloom);
+    const uint32_t present = graph.AddPass("Present");
+    graph.Read(present, bloom, ShaderStage::Pixel, 1);
+    graph.Read(present, ao, ShaderStage::Pixel, 2);
+    graph.Write(present, backBuffer);
+    graph.Compile();
+
+    // The unbinds that follow each pass
+    auto getUnbinds = [&](uint32_t pass) {
+        std::vector<std::pair<ShaderStage, uint32_t>> unbinds;
+        const auto &commands = graph.GetCommands();
+        for (size_t i = 0; i < commands.size(); i++) {
+            if (commands[i].type != FrameGraphCommand::Execute ||
+                commands[i].index != pass)
+                continue;
+            for (size_t j = i + 1; j < commands.size() &&
+                                   commands[j].type ==
+                                       FrameGraphCommand::Unbind;
+                 j++)
+                unbinds.push_back({commands[j].stage, commands[j].index});
+        }
+        return unbinds;
+    };
+    using Unbinds = std::vector<std::pair<ShaderStage, uint32_t>>;
+    // BlurY writes AO while BlurX left it at CS t0.
+    CHECK(getUnbinds(blurX) == (Unbinds{{ShaderStage::Compute, 0}}));
+    // BlurX writes Blurred next frame, nothing rebinds CS t0 before.
+    CHECK(getUnbinds(blurY) == (Unbinds{{ShaderStage::Compute, 0}}));
+    // Present binds PS t1 and t2 again before they are written.
+    CHECK(getUnbinds(bloomPass).empty());
+    // Next frame SSAO writes AO (PS t2) and Bloom writes Bloom (PS t1).
+    // The depth at PS t0 of SSAO is imported and never written.
+    CHECK(getUnbinds(present) ==
+          (Unbinds{{ShaderStage::Pixel, 1}, {ShaderStage::Pixel, 2}}));
+    CHECK(getUnbinds(ssao).empty());
+}
+
+TEST(FrameGraph, ExportsGraphviz) {
+    FrameGraph graph;
+    const uint32_t backBuffer = graph.ImportResource("BackBuffer");
+    const uint32_t lit = graph.CreateResource("Lit", MakeDesc());
+    const uint32_t unused = graph.CreateResource("Unused", MakeDesc());
+    const uint32_t light = graph.AddPass("Light");
+    graph.Write(light, lit, WriteMode::Clear);
+    const uint32_t tonemap = graph.AddPass("Tonemap");
+    graph.Read(tonemap, lit, ShaderStage::Compute, 3);
+    graph.Write(tonemap, backBuffer, WriteMode::Load);
+    graph.Write(graph.AddPass("Orphan"), unused);
+    graph.Compile();
+
+    const std::string dot = graph.ExportGraphviz();
+    CHECK(dot.rfind("digraph FrameGraph {\n", 0) == 0);
+    CHECK(dot.size() >= 2 && dot.compare(dot.size() - 2, 2, "}\n") == 0);
+    CHECK(Contains(dot, "p0 [shape=box, label=\"Light\", style=filled"));
+    CHECK(Contains(dot, "p2 [shape=box, label=\"Orphan\", style=dashed"));
+    CHECK(Contains(dot, "r0 [shape=ellipse, label=\"BackBuffer\\npasses "
+                        "1-1\", style=filled, fillcolor=lightgray];"));
+    CHECK(Contains(dot, "r1 [shape=ellipse, label=\"Lit\\n1280x720, "
+                        "format 10\\npasses 0-1\"];"));
+    CHECK(Contains(dot, "r1 -> p1 [label=\"CS t3\"];"));
+    CHECK(Contains(dot, "p0 -> r1 [label=\"clear\", color=red];"));
+    CHECK(Contains(dot, "p1 -> r0 [label=\"load\", color=red];"));
+    CHECK(Contains(dot, "p2 -> r2 [label=\"discard\", color=red];"));
+    // Culled, so no lifetime
+    CHECK(Contains(dot, "label=\"Unused\\n1280x720, format 10\"];"));
+}
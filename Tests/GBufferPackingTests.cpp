@@ -0,0 +1,120 @@
+#include <algorithm>
+#include <random>
+
+#include "GBufferPacking.h"
+#include "Test.h"
+
+using namespace jRenderer;
+using namespace DirectX::SimpleMath;
+
+namespace {
+
+struct ErrorBound {
+    NormalEncoding encoding;
+    float meanDegrees;
+    float maxDegrees;
+};
+
+// About 20% over the measured error, MeasureError() with 200k normals
+const ErrorBound ERROR_BOUNDS[] = {
+    {NormalEncoding::Unorm8Xyz, 0.2f, 0.45f},         // 0.17, 0.38
+    {NormalEncoding::Octahedral8, 0.4f, 1.1f},        // 0.34, 0.95
+    {NormalEncoding::Octahedral10, 0.1f, 0.28f},      // 0.084, 0.23
+    {NormalEncoding::Octahedral16, 0.0016f, 0.0045f}, // 0.0013, 0.0037
+};
+
+float AngleDegrees(const Vector3 &a, const Vector3 &b) {
+    return std::atan2(a.Cross(b).Length(), a.Dot(b)) * 180.0f /
+           DirectX::XM_PI;
+}
+
+// Uniform on the sphere, from the raw sequence so it is the same everywhere
+Vector3 RandomNormal(std::mt19937 &random) {
+    auto uniform = [&]() { return float(random()) / 4294967296.0f; };
+    const float z = uniform() * 2.0f - 1.0f;
+    const float phi = uniform() * DirectX::XM_2PI;
+    const float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+    return Vector3(r * std::cos(phi), r * std::sin(phi), z);
+}
+
+} // namespace
+
+TEST(GBufferPacking, NormalErrorPerEncoding) {
+    for (const auto &bound : ERROR_BOUNDS) {
+        const NormalEncodingError error =
+            GBufferPacking::MeasureError(bound.encoding, 200000);
+        CHECK_LE(error.meanDegrees, bound.meanDegrees);
+        CHECK_LE(error.maxDegrees, bound.maxDegrees);
+
+        // Random normals, not only the Fibonacci sphere of MeasureError()
+        std::mt19937 random(3);
+        float maxDegrees = 0.0f;
+        for (int i = 0; i < 100000; i++) {
+            const Vector3 normal = RandomNormal(random);
+            maxDegrees = std::max(
+                maxDegrees,
+                AngleDegrees(normal,
+                             GBufferPacking::RoundTrip(bound.encoding,
+                                                       normal)));
+        }
+        CHECK_LE(maxDegrees, bound.maxDegrees);
+    }
+}
+
+TEST(GBufferPacking, OctahedralStaysInUnitSquare) {
+    std::mt19937 random(4);
+    int outside = 0;
+    for (int i = 0; i < 10000; i++) {
+        const Vector2 f =
+            GBufferPacking::EncodeOctahedral(RandomNormal(random));
+        outside += f.x < 0.0f || f.x > 1.0f || f.y < 0.0f || f.y > 1.0f;
+    }
+    CHECK_EQ(outside, 0);
+}
+
+TEST(GBufferPacking, NormalMaterialRoundTrip) {
+    std::mt19937 random(5);
+    auto uniform = [&]() { return float(random()) / 4294967296.0f; };
+    float maxNormalDegrees = 0.0f, maxRoughnessError = 0.0f;
+    int wrongMetallic = 0;
+    for (int i = 0; i < 100000; i++) {
+        const Vector3 normal = RandomNormal(random);
+        const float roughness = uniform();
+        const float metallic = uniform();
+        const uint32_t texel =
+            GBufferPacking::PackNormalMaterial(normal, roughness, metallic);
+
+        Vector3 unpackedNormal;
+        float unpackedRoughness, unpackedMetallic;
+        GBufferPacking::UnpackNormalMaterial(
+            texel, unpackedNormal, unpackedRoughness, unpackedMetallic);
+        maxNormalDegrees = std::max(maxNormalDegrees,
+                                    AngleDegrees(normal, unpackedNormal));
+        maxRoughnessError = std::max(
+            maxRoughnessError, std::abs(unpackedRoughness - roughness));
+
+        // 2 bits: the nearest of 0, 1/3, 2/3 and 1
+        const float level = std::round(metallic * 3.0f) / 3.0f;
+        wrongMetallic += std::abs(unpackedMetallic - level) > 1e-6f;
+    }
+    CHECK_LE(maxNormalDegrees, 0.28f); // same as Octahedral10
+    CHECK_LE(maxRoughnessError, 0.5f / 1023.0f + 1e-6f);
+    CHECK_EQ(wrongMetallic, 0);
+
+    // The fields don't bleed into each other at their limits
+    Vector3 normal;
+    float roughness, metallic;
+    GBufferPacking::UnpackNormalMaterial(
+        GBufferPacking::PackNormalMaterial(Vector3(0.0f, 0.0f, -1.0f), 1.0f,
+                                           1.0f),
+        normal, roughness, metallic);
+    CHECK_LE(AngleDegrees(normal, Vector3(0.0f, 0.0f, -1.0f)), 0.28f);
+    CHECK_EQ(roughness, 1.0f);
+    CHECK_EQ(metallic, 1.0f);
+    GBufferPacking::UnpackNormalMaterial(
+        GBufferPacking::PackNormalMaterial(Vector3(1.0f, 0.0f, 0.0f), 0.0f,
+                                           0.0f),
+        normal, roughness, metallic);
+    CHECK_EQ(roughness, 0.0f);
+    CHECK_EQ(metallic, 0.0f);
+}
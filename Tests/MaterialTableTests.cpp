@@ -0,0 +1,207 @@
+#include <set>
+
+#include "MaterialTable.h"
+#include "Test.h"
+
+using namespace jRenderer;
+
+namespace {
+
+// DXGI_FORMAT
+constexpr uint32_t BC1_UNORM = 71;
+constexpr uint32_t BC5_UNORM = 83;
+
+MaterialTextureDesc MakeDesc(uint32_t size, uint32_t format) {
+    MaterialTextureDesc desc;
+    desc.width = size;
+    desc.height = size;
+    desc.mipLevels = 1;
+    while (size >>= 1)
+        desc.mipLevels++;
+    desc.format = format;
+    return desc;
+}
+
+bool operator==(const MaterialTextureDesc &a, const MaterialTextureDesc &b) {
+    return !(a < b) && !(b < a);
+}
+
+// Every texture in exactly one array or bound, and the maps of the
+// materials pointing at the layer of their texture
+void CheckLayout(const MaterialTable &table,
+                 const std::vector<MaterialTextureDesc> &textures,
+                 const std::vector<std::array<uint32_t, 5>> &materials) {
+    std::vector<uint32_t> locations(textures.size(), MATERIAL_BOUND_MAP);
+    const auto &arrays = table.GetArrays();
+    for (uint32_t a = 0; a < uint32_t(arrays.size()); a++) {
+        const auto &array = arrays[a];
+        CHECK_LE(array.textures.size(), size_t(MAX_MATERIAL_ARRAY_LAYERS));
+        if (a > 0)
+            CHECK_LE(array.textures.size(), arrays[a - 1].textures.size());
+        for (uint32_t layer = 0; layer < uint32_t(array.textures.size());
+             layer++) {
+            const uint32_t texture = array.textures[layer];
+            CHECK(textures[texture] == array.desc);
+            CHECK_EQ(locations[texture], MATERIAL_BOUND_MAP);
+            locations[texture] = MaterialTable::Pack(a, layer);
+        }
+    }
+
+    const auto &data = table.GetMaterials();
+    CHECK_EQ(data.size(), materials.size());
+    for (uint32_t m = 0; m < uint32_t(data.size()); m++) {
+        bool isPacked = true;
+        for (uint32_t s = 0; s < NUM_MATERIAL_SLOTS; s++) {
+            const uint32_t texture = materials[m][s];
+            const uint32_t expected =
+                texture == MATERIAL_NO_MAP ? MATERIAL_NO_MAP
+                                           : locations[texture];
+            CHECK_EQ(data[m].maps[s], expected);
+            isPacked = isPacked && expected != MATERIAL_BOUND_MAP;
+        }
+        CHECK_EQ(table.IsPacked(m), isPacked);
+    }
+}
+
+} // namespace
+
+TEST(MaterialTable, GroupsByDesc) {
+    // Sponza-like: albedo and normal maps per material, some of them
+    // smaller, one emissive map and one texture read by two materials
+    MaterialTable table;
+    std::vector<MaterialTextureDesc> textures;
+    std::vector<std::array<uint32_t, 5>> materials;
+    auto addTexture = [&](const std::string &key, MaterialTextureDesc desc) {
+        const uint32_t id = table.AddTexture(key, desc);
+        if (id == textures.size())
+            textures.push_back(desc);
+        return id;
+    };
+    for (uint32_t i = 0; i < 12; i++) {
+        const uint32_t size = i % 4 == 3 ? 512 : 1024;
+        std::array<uint32_t, 5> maps;
+        maps.fill(MATERIAL_NO_MAP);
+        maps[MATERIAL_SLOT_ALBEDO] = addTexture(
+            "albedo" + std::to_string(i), MakeDesc(size, BC1_UNORM));
+        maps[MATERIAL_SLOT_NORMAL] = addTexture(
+            "normal" + std::to_string(i), MakeDesc(size, BC5_UNORM));
+        if (i == 5) {
+            maps[MATERIAL_SLOT_EMISSIVE] =
+                addTexture("albedo0", MakeDesc(1024, BC1_UNORM));
+        }
+        CHECK_EQ(table.AddMaterial(maps), uint32_t(materials.size()));
+        materials.push_back(maps);
+    }
+    // The same file and the same maps again are shared.
+    CHECK_EQ(table.AddTexture("normal3", MakeDesc(512, BC5_UNORM)), 7u);
+    CHECK_EQ(table.AddMaterial(materials[4]), 4u);
+
+    table.Build();
+    CheckLayout(table, textures, materials);
+    const auto &arrays = table.GetArrays();
+    CHECK_EQ(arrays.size(), size_t(4));
+    if (arrays.size() == 4) {
+        // 9 of each format at 1024, 3 at 512, largest first
+        CHECK(arrays[0].desc == MakeDesc(1024, BC1_UNORM));
+        CHECK(arrays[1].desc == MakeDesc(1024, BC5_UNORM));
+        CHECK(arrays[2].desc == MakeDesc(512, BC1_UNORM));
+        CHECK(arrays[3].desc == MakeDesc(512, BC5_UNORM));
+        CHECK_EQ(arrays[0].textures.size(), size_t(9));
+        CHECK_EQ(arrays[2].textures.size(), size_t(3));
+        // Layers in the order the textures were added
+        CHECK_EQ(arrays[0].textures[0], 0u);
+        CHECK_EQ(arrays[0].textures[1], 2u);
+        CHECK_EQ(arrays[2].textures[0], 6u);
+        CHECK_EQ(arrays[3].textures[0], 7u);
+    }
+    // Albedo 0 is at the same layer for both materials.
+    CHECK_EQ(table.GetMaterials()[5].maps[MATERIAL_SLOT_EMISSIVE],
+             MaterialTable::Pack(0, 0));
+    CHECK_EQ(table.GetMaterials()[3].maps[MATERIAL_SLOT_NORMAL],
+             MaterialTable::Pack(3, 0));
+    CHECK_EQ(table.GetMaterials()[0].maps[MATERIAL_SLOT_AO],
+             MATERIAL_NO_MAP);
+
+    const auto stats = table.GetStats();
+    CHECK_EQ(stats.textures, 24u);
+    CHECK_EQ(stats.materials, 12u);
+    CHECK_EQ(stats.arrays, 4u);
+    CHECK_EQ(stats.unpackedTextures, 0u);
+    CHECK_EQ(stats.boundMaterials, 0u);
+
+    table.Clear();
+    table.Build();
+    CHECK_EQ(table.GetStats().textures, 0u);
+    CHECK(table.GetArrays().empty());
+    CHECK(table.GetMaterials().empty());
+}
+
+TEST(MaterialTable, Overflow) {
+    MaterialTable table;
+    std::vector<MaterialTextureDesc> textures;
+    std::vector<std::array<uint32_t, 5>> materials;
+    auto addMaterial = [&](uint32_t size, uint32_t format) {
+        const MaterialTextureDesc desc = MakeDesc(size, format);
+        std::array<uint32_t, 5> maps;
+        maps.fill(MATERIAL_NO_MAP);
+        maps[MATERIAL_SLOT_ALBEDO] = table.AddTexture(
+            "texture" + std::to_string(textures.size()), desc);
+        textures.push_back(desc);
+        table.AddMaterial(maps);
+        materials.push_back(maps);
+    };
+
+    // A full array and 5 more of the same desc
+    const uint32_t numFull = MAX_MATERIAL_ARRAY_LAYERS + 5;
+    for (uint32_t i = 0; i < numFull; i++)
+        addMaterial(256, BC1_UNORM);
+    // And 3 other descs with 4, 3 and 2 textures
+    for (uint32_t i = 0; i < 4; i++)
+        addMaterial(2048, BC1_UNORM);
+    for (uint32_t i = 0; i < 3; i++)
+        addMaterial(1024, BC1_UNORM);
+    for (uint32_t i = 0; i < 2; i++)
+        addMaterial(1024, BC5_UNORM);
+
+    // The full desc is split into a second array.
+    table.Build();
+    CheckLayout(table, textures, materials);
+    const auto &arrays = table.GetArrays();
+    CHECK_EQ(arrays.size(), size_t(5));
+    if (arrays.size() == 5) {
+        CHECK_EQ(arrays[0].textures.size(),
+                 size_t(MAX_MATERIAL_ARRAY_LAYERS));
+        CHECK_EQ(arrays[1].textures.size(), size_t(5));
+        CHECK(arrays[1].desc == arrays[0].desc);
+        CHECK_EQ(arrays[1].textures[0], MAX_MATERIAL_ARRAY_LAYERS);
+        CHECK_EQ(arrays[2].textures.size(), size_t(4));
+        CHECK_EQ(arrays[4].textures.size(), size_t(2));
+    }
+    CHECK_EQ(table.GetMaterials()[MAX_MATERIAL_ARRAY_LAYERS].maps[0],
+             MaterialTable::Pack(1, 0));
+    CHECK_EQ(table.GetStats().unpackedTextures, 0u);
+
+    // Past maxArrays the smallest groups are bound per draw.
+    table.Build(3);
+    CheckLayout(table, textures, materials);
+    CHECK_EQ(table.GetArrays().size(), size_t(3));
+    auto stats = table.GetStats();
+    CHECK_EQ(stats.arrays, 3u);
+    CHECK_EQ(stats.unpackedTextures, 5u);
+    CHECK_EQ(stats.boundMaterials, 5u);
+    CHECK(table.IsPacked(numFull + 3));
+    CHECK(!table.IsPacked(numFull + 4));
+    CHECK_EQ(table.GetMaterials()[numFull + 4].maps[0], MATERIAL_BOUND_MAP);
+
+    // Only the first 2048 of the full desc when there is one array
+    table.Build(1);
+    CheckLayout(table, textures, materials);
+    stats = table.GetStats();
+    CHECK_EQ(stats.unpackedTextures, 14u);
+    CHECK_EQ(stats.boundMaterials, 14u);
+    CHECK(table.IsPacked(MAX_MATERIAL_ARRAY_LAYERS - 1));
+    CHECK(!table.IsPacked(MAX_MATERIAL_ARRAY_LAYERS));
+
+    table.Build(0);
+    CHECK_EQ(table.GetStats().unpackedTextures, uint32_t(textures.size()));
+}
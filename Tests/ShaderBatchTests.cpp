@@ -0,0 +1,132 @@
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "JobSystem.h"
+#include "ShaderBatch.h"
+#include "Test.h"
+
+using namespace jRenderer;
+
+namespace {
+
+// Sleeps like a real compile and counts the compiles that have finished.
+// Files named "Broken" fail.
+class SleepingCompiler : public ShaderCompiler {
+  public:
+    explicit SleepingCompiler(uint32_t compileMs) : m_compileMs(compileMs) {}
+
+    bool Compile(const ShaderKey &key, std::vector<uint8_t> &bytecode,
+                 std::string &errors) override {
+        started++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_compileMs));
+        const std::string text = key.filename + "|" + key.profile;
+        bytecode.assign(text.begin(), text.end());
+        finished++;
+        if (key.filename.find("Broken") != std::string::npos) {
+            errors = "error X3000";
+            return false;
+        }
+        return true;
+    }
+
+    std::atomic<int> started = 0;
+    std::atomic<int> finished = 0;
+
+  private:
+    uint32_t m_compileMs;
+};
+
+ShaderKey MakeKey(const std::string &filename, const char *profile) {
+    ShaderKey key;
+    key.filename = filename;
+    key.entryPoint = "main";
+    key.profile = profile;
+    return key;
+}
+
+std::string ToString(const ShaderBytecode &bytecode) {
+    return std::string(reinterpret_cast<const char *>(bytecode.data),
+                       bytecode.size);
+}
+
+} // namespace
+
+// Graphics::InitShaders() compiles the batch on the job system and then
+// creates every vertex shader and its input layout from the batch.
+TEST(ShaderBatch, VertexShadersBeforeInputLayouts) {
+    JobSystem::Initialize(3);
+    const char *names[] = {"BasicVS", "SkyboxVS", "DepthOnlyVS",
+                           "GBufferVS", "ShadowCubeMapVS", "BasicPS",
+                           "SkyboxPS", "GBufferPS"};
+    ShaderBatch batch;
+    std::vector<ShaderKey> vertexShaders;
+    for (const char *name : names) {
+        const bool isVertex =
+            std::string(name).find("VS") != std::string::npos;
+        const ShaderKey key = MakeKey(name, isVertex ? "vs_5_0" : "ps_5_0");
+        batch.Add(key);
+        batch.Add(key);
+        if (isVertex)
+            vertexShaders.push_back(key);
+    }
+    CHECK_EQ(batch.GetNumShaders(), 8u);
+
+    SleepingCompiler compiler(5);
+    ShaderCache cache(&compiler, "");
+    CHECK(batch.Compile(cache));
+    CHECK(batch.GetErrors().empty());
+
+    // Every compile has returned when Compile() does, none of them still
+    // running on a worker when the layouts are made.
+    CHECK_EQ(compiler.started.load(), 8);
+    CHECK_EQ(compiler.finished.load(), 8);
+    for (const auto &key : vertexShaders) {
+        const ShaderBytecode *bytecode = batch.Find(key);
+        CHECK(bytecode != nullptr);
+        if (bytecode)
+            CHECK_EQ(ToString(*bytecode), key.filename + "|vs_5_0");
+    }
+    // Found in the batch, not compiled again on the device thread
+    CHECK_EQ(compiler.started.load(), 8);
+    CHECK(batch.Find(MakeKey("BasicVS", "ps_5_0")) == nullptr);
+
+    // A shader that doesn't compile fails the batch, the rest are kept.
+    batch.Add(MakeKey("BrokenPS", "ps_5_0"));
+    CHECK(!batch.Compile(cache));
+    CHECK(batch.GetErrors().find("BrokenPS main:\nerror X3000") !=
+          std::string::npos);
+    CHECK(batch.Find(MakeKey("BrokenPS", "ps_5_0")) == nullptr);
+    CHECK(batch.Find(vertexShaders[0]) != nullptr);
+
+    batch.Clear();
+    CHECK_EQ(batch.GetNumShaders(), 0u);
+    CHECK(batch.Find(vertexShaders[0]) == nullptr);
+    JobSystem::Shutdown();
+}
+
+TEST(ShaderBatch, WallTimeScalesWithWorkers) {
+    // Sleeps scale with the workers whatever the number of cores.
+    const uint32_t numShaders = 24;
+    const uint32_t compileMs = 10;
+    JobSystem::Initialize(3);
+    const auto results = ShaderBatch::Benchmark(numShaders, compileMs);
+    CHECK_EQ(JobSystem::GetWorkerCount(), 3);
+    JobSystem::Shutdown();
+
+    CHECK_EQ(results.size(), size_t(4));
+    if (results.size() != 4)
+        return;
+    CHECK_LE(double(numShaders * compileMs), results[0].wallMs + 1.0);
+    for (const auto &result : results) {
+        // ceil(24 / threads) compiles in a row on the slowest thread,
+        // measured within 2% of it
+        const uint32_t rounds =
+            (numShaders + result.threads - 1) / result.threads;
+        CHECK_LE(double(rounds * compileMs), result.wallMs + 1.0);
+        CHECK_LT(result.wallMs, 1.5 * rounds * compileMs + 10.0);
+    }
+    CHECK_LT(1.0, results[1].speedup);
+    CHECK_LT(results[1].speedup, results[3].speedup);
+    CHECK_LT(2.5, results[3].speedup);
+}
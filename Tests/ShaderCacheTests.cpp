@@ -0,0 +1,307 @@
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+#include "ShaderArchive.h"
+#include "ShaderCache.h"
+#include "Test.h"
+
+using namespace jRenderer;
+namespace fs = std::filesystem;
+
+namespace {
+
+// "Compiles" to the text of the file and its includes, so a blob shows
+// which sources it was built from. Fails on sources containing "error".
+class StubCompiler : public ShaderCompiler {
+  public:
+    bool Compile(const ShaderKey &key, std::vector<uint8_t> &bytecode,
+                 std::string &errors) override {
+        compiles++;
+        std::string text = key.entryPoint + ":";
+        for (const auto &filename : ShaderCache::FindIncludes(key.filename)) {
+            std::ifstream file(filename);
+            std::ostringstream contents;
+            contents << file.rdbuf();
+            text += contents.str();
+        }
+        if (text.find("error") != std::string::npos) {
+            errors = key.filename + "(1,1): error X3000: syntax error";
+            return false;
+        }
+        bytecode.assign(text.begin(), text.end());
+        return true;
+    }
+
+    int compiles = 0;
+};
+
+// A fresh directory per test under the working directory of the test
+class TestDirectory {
+  public:
+    explicit TestDirectory(const std::string &name) : m_path(name) {
+        fs::remove_all(m_path);
+        fs::create_directories(m_path / "Shaders" / "Common");
+    }
+    ~TestDirectory() { fs::remove_all(m_path); }
+
+    std::string Write(const std::string &name, const std::string &text) {
+        const fs::path path = m_path / "Shaders" / name;
+        std::ofstream(path, std::ios::binary) << text;
+        return path.lexically_normal().generic_string();
+    }
+    std::string GetCache() const { return (m_path / "Cache").string(); }
+
+  private:
+    fs::path m_path;
+};
+
+std::string ToString(const ShaderBytecode &bytecode) {
+    return std::string(reinterpret_cast<const char *>(bytecode.data),
+                       bytecode.size);
+}
+
+ShaderKey MakeKey(const std::string &filename) {
+    ShaderKey key;
+    key.filename = filename;
+    key.entryPoint = "main";
+    key.profile = "ps_5_0";
+    return key;
+}
+
+// Overwrites 4 bytes of the blob file
+void PatchBlob(const std::string &path, size_t offset, uint32_t value) {
+    std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+    file.seekp(std::streamoff(offset));
+    file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+} // namespace
+
+TEST(ShaderCache, HitAndMiss) {
+    TestDirectory directory("ShaderCacheHitAndMiss");
+    const std::string filename =
+        directory.Write("Basic.hlsl", "float4 main() : SV_Target;");
+    const ShaderKey key = MakeKey(filename);
+
+    StubCompiler compiler;
+    ShaderBytecode bytecode;
+    {
+        ShaderCache cache(&compiler, directory.GetCache());
+        CHECK(cache.GetBytecode(key, bytecode));
+        CHECK_EQ(compiler.compiles, 1);
+        CHECK_EQ(cache.GetStats().misses, 1u);
+        CHECK(fs::exists(cache.GetBlobPath(key, cache.ComputeHash(key))));
+    }
+    const std::string compiled = ToString(bytecode);
+    CHECK_EQ(compiled, std::string("main:float4 main() : SV_Target;"));
+
+    // A new cache, like the next start of the app
+    ShaderCache cache(&compiler, directory.GetCache());
+    CHECK(cache.GetBytecode(key, bytecode));
+    CHECK_EQ(compiler.compiles, 1);
+    CHECK_EQ(cache.GetStats().hits, 1u);
+    CHECK_EQ(cache.GetStats().misses, 0u);
+    CHECK_EQ(ToString(bytecode), compiled);
+
+    // Every part of the key is part of the hash.
+    ShaderKey other = key;
+    other.defines.push_back({"SKINNED", "1"});
+    CHECK(cache.ComputeHash(other) != cache.ComputeHash(key));
+    other = key;
+    other.entryPoint = "mainAlpha";
+    CHECK(cache.ComputeHash(other) != cache.ComputeHash(key));
+    other = key;
+    other.profile = "ps_5_1";
+    CHECK(cache.ComputeHash(other) != cache.ComputeHash(key));
+    other = key;
+    other.flags = 1;
+    CHECK(cache.ComputeHash(other) != cache.ComputeHash(key));
+    CHECK(cache.GetBytecode(other, bytecode));
+    CHECK_EQ(compiler.compiles, 2);
+
+    // No directory, nothing on disk
+    ShaderCache memoryOnly(&compiler, "");
+    CHECK(memoryOnly.GetBytecode(key, bytecode));
+    CHECK(memoryOnly.GetBytecode(key, bytecode));
+    CHECK_EQ(compiler.compiles, 4);
+}
+
+TEST(ShaderCache, IncludeEditInvalidates) {
+    TestDirectory directory("ShaderCacheIncludes");
+    directory.Write("Lighting.hlsli", "float3 Light();");
+    directory.Write("Common/Common.hlsli",
+                    "  #include \"../Lighting.hlsli\"\nfloat Pi();");
+    const std::string filename = directory.Write(
+        "Deferred.hlsl", "#include \"Common/Common.hlsli\"\nfloat4 main();");
+    const ShaderKey key = MakeKey(filename);
+
+    const auto includes = ShaderCache::FindIncludes(filename);
+    CHECK_EQ(includes.size(), size_t(3));
+    if (includes.size() == 3) {
+        CHECK_EQ(includes[0], filename);
+        CHECK(includes[1].find("Shaders/Common/Common.hlsli") !=
+              std::string::npos);
+        CHECK(includes[2].find("Shaders/Lighting.hlsli") !=
+              std::string::npos);
+    }
+
+    StubCompiler compiler;
+    ShaderCache cache(&compiler, directory.GetCache());
+    ShaderBytecode bytecode;
+    CHECK(cache.GetBytecode(key, bytecode));
+    const uint64_t hash = cache.ComputeHash(key);
+
+    // An edit two includes deep makes a new key.
+    directory.Write("Lighting.hlsli", "float3 Light(float3 n);");
+    CHECK(cache.ComputeHash(key) != hash);
+    CHECK(cache.GetBytecode(key, bytecode));
+    CHECK_EQ(compiler.compiles, 2);
+    CHECK(ToString(bytecode).find("Light(float3 n)") != std::string::npos);
+
+    // Undoing the edit finds the first blob again.
+    directory.Write("Lighting.hlsli", "float3 Light();");
+    CHECK_EQ(cache.ComputeHash(key), hash);
+    CHECK(cache.GetBytecode(key, bytecode));
+    CHECK_EQ(compiler.compiles, 2);
+    CHECK_EQ(cache.GetStats().hits, 1u);
+}
+
+TEST(ShaderCache, RejectsBadBlobs) {
+    TestDirectory directory("ShaderCacheBadBlobs");
+    const ShaderKey key =
+        MakeKey(directory.Write("Basic.hlsl", "float4 main();"));
+    StubCompiler compiler;
+    ShaderCache cache(&compiler, directory.GetCache());
+    ShaderBytecode bytecode;
+    CHECK(cache.GetBytecode(key, bytecode));
+    const std::string expected = ToString(bytecode);
+    const std::string path = cache.GetBlobPath(key, cache.ComputeHash(key));
+    const auto blobSize = fs::file_size(path);
+
+    // Header: magic, version, hash (8 bytes), compile time (8), size (8)
+    struct Damage {
+        const char *name;
+        uintmax_t size; // cut to size, or
+        size_t offset;  // patched with value
+        uint32_t value;
+    };
+    const uintmax_t PATCH = ~uintmax_t(0);
+    const Damage damages[] = {
+        {"empty", 0, 0, 0},
+        {"truncated header", 20, 0, 0},
+        {"truncated bytecode", blobSize - 1, 0, 0},
+        {"magic", PATCH, 0, 0x12345678},
+        {"version", PATCH, 4, 99},
+        {"hash", PATCH, 8, 0xdeadbeef},
+        {"zero size", PATCH, 24, 0},
+    };
+    int compiles = compiler.compiles;
+    for (const auto &damage : damages) {
+        if (damage.size != PATCH)
+            fs::resize_file(path, damage.size);
+        else
+            PatchBlob(path, damage.offset, damage.value);
+
+        // Compiled again and the blob rewritten
+        CHECK(cache.GetBytecode(key, bytecode));
+        compiles++;
+        if (compiler.compiles != compiles)
+            std::cerr << "Loaded a blob with a bad " << damage.name << "\n";
+        CHECK_EQ(compiler.compiles, compiles);
+        CHECK_EQ(ToString(bytecode), expected);
+        CHECK_EQ(fs::file_size(path), blobSize);
+    }
+    CHECK(cache.GetBytecode(key, bytecode));
+    CHECK_EQ(compiler.compiles, compiles);
+    CHECK_EQ(cache.GetStats().hits, 1u);
+}
+
+TEST(ShaderCache, CompileErrors) {
+    TestDirectory directory("ShaderCacheErrors");
+    const ShaderKey key =
+        MakeKey(directory.Write("Broken.hlsl", "float4 main() { error }"));
+    StubCompiler compiler;
+    ShaderCache cache(&compiler, directory.GetCache());
+    ShaderBytecode bytecode;
+    std::string errors;
+    CHECK(!cache.GetBytecode(key, bytecode, &errors));
+    CHECK(errors.find("X3000") != std::string::npos);
+    CHECK_EQ(cache.GetLastErrors(), errors);
+    CHECK(!fs::exists(cache.GetBlobPath(key, cache.ComputeHash(key))));
+
+    ShaderCache noCompiler(nullptr, directory.GetCache());
+    CHECK(!noCompiler.GetBytecode(key, bytecode, &errors));
+    CHECK(errors.find("No shader compiler") != std::string::npos);
+}
+
+TEST(ShaderCache, ArchiveLookup) {
+    TestDirectory directory("ShaderCacheArchive");
+    std::vector<ShaderKey> keys;
+    for (const char *name : {"Sky.hlsl", "Tonemap.hlsl", "Ssao.hlsl"}) {
+        keys.push_back(
+            MakeKey(directory.Write(name, std::string("// ") + name)));
+    }
+    keys.push_back(keys[0]);
+    keys.back().defines.push_back({"HDR", "1"});
+
+    // Built like --build-shaders does
+    StubCompiler compiler;
+    ShaderCache builder(&compiler, "");
+    ShaderArchiveWriter writer;
+    std::vector<std::string> blobs;
+    for (const auto &key : keys) {
+        ShaderBytecode bytecode;
+        CHECK(builder.GetBytecode(key, bytecode));
+        blobs.push_back(ToString(bytecode));
+        writer.Add(ShaderArchive::GetName(key), builder.ComputeHash(key),
+                   bytecode.storage);
+    }
+    const std::string archivePath = directory.GetCache() + ".pak";
+    CHECK(writer.Write(archivePath));
+
+    ShaderArchive archive;
+    CHECK(archive.Open(archivePath));
+    CHECK_EQ(archive.GetNumShaders(), uint32_t(keys.size()));
+    for (size_t i = 0; i < keys.size(); i++) {
+        const ShaderArchiveEntry *entry =
+            archive.Find(ShaderArchive::GetName(keys[i]));
+        CHECK(entry != nullptr);
+        if (!entry)
+            continue;
+        CHECK_EQ(entry->blobOffset % 16, 0u);
+        CHECK_EQ(std::string(reinterpret_cast<const char *>(
+                                 archive.GetBlob(*entry)),
+                             entry->blobSize),
+                 blobs[i]);
+    }
+    CHECK(archive.Find("Missing.hlsl|main|ps_5_0|0") == nullptr);
+
+    // Used in place without a compiler or hashing the sources
+    ShaderCache cache(nullptr, directory.GetCache());
+    cache.SetArchive(&archive, false);
+    ShaderBytecode bytecode;
+    CHECK(cache.GetBytecode(keys[1], bytecode));
+    CHECK(bytecode.storage.empty());
+    CHECK_EQ(ToString(bytecode), blobs[1]);
+    CHECK_EQ(cache.GetStats().archiveHits, 1u);
+
+    // With verify, an edited source is compiled again.
+    directory.Write("Tonemap.hlsl", "// Tonemap.hlsl, edited");
+    cache.SetCompiler(&compiler);
+    cache.SetArchive(&archive, true);
+    CHECK(cache.GetBytecode(keys[1], bytecode));
+    CHECK_EQ(ToString(bytecode), "main:// Tonemap.hlsl, edited");
+    CHECK(cache.GetBytecode(keys[2], bytecode));
+    CHECK_EQ(cache.GetStats().archiveHits, 2u);
+    CHECK_EQ(cache.GetStats().misses, 1u);
+    archive.Close();
+
+    // Files that aren't whole archives don't open.
+    const auto size = fs::file_size(archivePath);
+    fs::resize_file(archivePath, size - 1);
+    CHECK(!archive.Open(archivePath));
+    fs::resize_file(archivePath, 8);
+    CHECK(!archive.Open(archivePath));
+    CHECK(!archive.Open(directory.GetCache() + ".missing"));
+}
@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <random>
+
+#include "ShadowAtlas.h"
+#include "Test.h"
+
+using namespace jRenderer;
+
+namespace {
+
+constexpr uint32_t ATLAS_SIZE = 4096;
+constexpr uint32_t MIN_TILE = 64;
+
+// Texels covered per min tile cell, to find overlaps without Validate()
+class Coverage {
+  public:
+    explicit Coverage(uint32_t atlasSize, uint32_t cellSize)
+        : m_dim(atlasSize / cellSize), m_cellSize(cellSize),
+          m_cells(size_t(m_dim) * m_dim) {}
+
+    // False if the tile leaves the atlas or covers a covered cell.
+    bool Add(const ShadowTile &tile) {
+        if (tile.x % tile.size || tile.y % tile.size ||
+            tile.x + tile.size > m_dim * m_cellSize ||
+            tile.y + tile.size > m_dim * m_cellSize)
+            return false;
+        bool isDisjoint = true;
+        for (uint32_t y = 0; y < tile.size / m_cellSize; y++) {
+            for (uint32_t x = 0; x < tile.size / m_cellSize; x++) {
+                uint8_t &cell = m_cells[(tile.y / m_cellSize + y) * m_dim +
+                                        tile.x / m_cellSize + x];
+                isDisjoint = isDisjoint && !cell;
+                cell = 1;
+            }
+        }
+        return isDisjoint;
+    }
+
+  private:
+    uint32_t m_dim;
+    uint32_t m_cellSize;
+    std::vector<uint8_t> m_cells;
+};
+
+uint32_t RoundUp(uint32_t size) {
+    uint32_t rounded = MIN_TILE;
+    while (rounded < size)
+        rounded *= 2;
+    return rounded;
+}
+
+} // namespace
+
+// The tests only use the raw std::mt19937 sequence, the distributions
+// differ between standard libraries.
+
+TEST(ShadowAtlas, AllocatorChurn) {
+    ShadowAtlasAllocator allocator;
+    allocator.Initialize(ATLAS_SIZE, MIN_TILE);
+    std::mt19937 random(5);
+    std::vector<ShadowTile> tiles;
+
+    int overlaps = 0, wrongFailures = 0, wrongTexels = 0;
+    for (int step = 0; step < 20000; step++) {
+        if (!tiles.empty() && random() % 2) {
+            const size_t i = random() % tiles.size();
+            allocator.Free(tiles[i]);
+            tiles[i] = tiles.back();
+            tiles.pop_back();
+        } else {
+            // Fails only when no free block is big enough.
+            const uint32_t wanted = 1 + random() % (ATLAS_SIZE / 4);
+            const uint32_t largest = allocator.GetLargestFree();
+            ShadowTile tile;
+            const bool allocated = allocator.Allocate(wanted, tile);
+            wrongFailures += allocated != (largest >= RoundUp(wanted));
+            if (allocated) {
+                wrongFailures += tile.size != RoundUp(wanted);
+                tiles.push_back(tile);
+            }
+        }
+
+        Coverage coverage(ATLAS_SIZE, MIN_TILE);
+        uint64_t usedTexels = 0;
+        for (const auto &tile : tiles) {
+            overlaps += !coverage.Add(tile);
+            usedTexels += uint64_t(tile.size) * tile.size;
+        }
+        wrongTexels += usedTexels + allocator.GetFreeTexels() !=
+                       uint64_t(ATLAS_SIZE) * ATLAS_SIZE;
+    }
+    CHECK_EQ(overlaps, 0);
+    CHECK_EQ(wrongFailures, 0);
+    CHECK_EQ(wrongTexels, 0);
+
+    // Freeing everything merges back into one block.
+    for (const auto &tile : tiles)
+        allocator.Free(tile);
+    CHECK_EQ(allocator.GetLargestFree(), ATLAS_SIZE);
+    CHECK_EQ(allocator.GetFragmentation(), 0.0f);
+}
+
+TEST(ShadowAtlas, UpdateChurn) {
+    ShadowAtlas atlas;
+    atlas.Initialize(ATLAS_SIZE, MIN_TILE);
+    std::mt19937 random(9);
+    std::vector<ShadowAtlasRequest> requests;
+
+    int invalidFrames = 0, overlaps = 0, oversized = 0;
+    float fragmentation = 0.0f;
+    const int numFrames = 2000;
+    for (int frame = 0; frame < numFrames; frame++) {
+        // Drop some lights, add some, resize some
+        for (size_t i = 0; i < requests.size();) {
+            if (random() % 10 == 0) {
+                requests[i] = requests.back();
+                requests.pop_back();
+                continue;
+            }
+            if (random() % 10 == 0)
+                requests[i].size = MIN_TILE << random() % 6;
+            i++;
+        }
+        while (requests.size() < 40 && random() % 4) {
+            ShadowAtlasRequest request;
+            request.key = random() % 1000;
+            request.size = MIN_TILE << random() % 6;
+            request.priority = float(random() % 100);
+            const bool isNew = std::none_of(
+                requests.begin(), requests.end(),
+                [&](const auto &r) { return r.key == request.key; });
+            if (isNew)
+                requests.push_back(request);
+        }
+
+        atlas.Update(requests);
+        invalidFrames += !atlas.Validate();
+        Coverage coverage(ATLAS_SIZE, MIN_TILE);
+        for (const auto &request : requests) {
+            const ShadowTile tile = atlas.GetTile(request.key);
+            if (!tile.IsValid())
+                continue;
+            overlaps += !coverage.Add(tile);
+            // A tile that couldn't grow keeps its old, smaller size.
+            oversized += tile.size > request.size &&
+                         atlas.m_stats.downsized == 0;
+        }
+        fragmentation += atlas.m_stats.fragmentation / numFrames;
+    }
+    CHECK_EQ(invalidFrames, 0);
+    CHECK_EQ(overlaps, 0);
+    CHECK_EQ(oversized, 0);
+    // With sizes from 64 to 2048 this averages 0.66, most of the free
+    // texels are in small blocks. Catches a merge that stops working.
+    CHECK_LE(fragmentation, 0.75f);
+}
+
+TEST(ShadowAtlas, StressTest) {
+    ShadowAtlasStats average;
+    CHECK(ShadowAtlas::RunStressTest(ATLAS_SIZE, MIN_TILE, 64, 1000, 3,
+                                     average));
+    // 0.73 at 80% occupancy
+    CHECK_LE(average.fragmentation, 0.8f);
+    CHECK_LE(0.5f, average.occupancy);
+}
@@ -0,0 +1,118 @@
+#include <random>
+
+#include "CpuFeatures.h"
+#include "SoftwareOcclusion.h"
+#include "Test.h"
+
+using namespace jRenderer;
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+
+Matrix GetViewProj() {
+    const Matrix view =
+        XMMatrixLookAtLH(Vector3(0.0f, 0.0f, -5.0f), Vector3(0.0f),
+                         Vector3(0.0f, 1.0f, 0.0f));
+    const Matrix proj =
+        XMMatrixPerspectiveFovLH(XMConvertToRadians(70.0f), 16.0f / 9.0f,
+                                 0.1f, 100.0f);
+    return view * proj;
+}
+
+// Triangles all over the screen, some crossing the near plane and the sides
+void AddRandomTriangles(std::vector<Vector3> &positions,
+                        std::vector<uint32_t> &indices, int count,
+                        uint32_t seed) {
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> xy(-8.0f, 8.0f);
+    std::uniform_real_distribution<float> z(-5.5f, 20.0f);
+    for (int i = 0; i < count * 3; i++) {
+        indices.push_back(uint32_t(positions.size()));
+        positions.push_back(Vector3(xy(random), xy(random), z(random)));
+    }
+}
+
+void AddQuad(std::vector<Vector3> &positions, std::vector<uint32_t> &indices,
+             float halfSize, float z) {
+    const uint32_t base = uint32_t(positions.size());
+    positions.push_back(Vector3(-halfSize, -halfSize, z));
+    positions.push_back(Vector3(halfSize, -halfSize, z));
+    positions.push_back(Vector3(halfSize, halfSize, z));
+    positions.push_back(Vector3(-halfSize, halfSize, z));
+    for (uint32_t i : {0u, 1u, 2u, 0u, 2u, 3u})
+        indices.push_back(base + i);
+}
+
+} // namespace
+
+TEST(SoftwareOcclusion, QuadHidesBoxesBehindIt) {
+    std::vector<Vector3> positions;
+    std::vector<uint32_t> indices;
+    AddQuad(positions, indices, 2.0f, 0.0f);
+
+    SoftwareOcclusion occlusion;
+    occlusion.Resize(250, 141);
+    occlusion.BeginFrame(GetViewProj());
+    occlusion.RasterizeOccluder(positions, indices, Matrix());
+    occlusion.EndFrame();
+
+    CHECK(!occlusion.IsVisible(Vector3(-0.5f, -0.5f, 2.0f),
+                               Vector3(0.5f, 0.5f, 3.0f)));
+    // In front of the quad, beside it, and straddling its depth
+    CHECK(occlusion.IsVisible(Vector3(-0.5f, -0.5f, -2.0f),
+                              Vector3(0.5f, 0.5f, -1.0f)));
+    CHECK(occlusion.IsVisible(Vector3(3.0f, -0.5f, 2.0f),
+                              Vector3(4.0f, 0.5f, 3.0f)));
+    CHECK(occlusion.IsVisible(Vector3(-0.5f, -0.5f, -0.5f),
+                              Vector3(0.5f, 0.5f, 0.5f)));
+    CHECK_EQ(occlusion.m_stats.trianglesRasterized, 2u);
+}
+
+TEST(SoftwareOcclusion, Avx2MatchesScalar) {
+    if (!HasAvx2()) {
+        std::cout << "No AVX2 on this CPU, only the scalar rows ran\n";
+        return;
+    }
+    std::vector<Vector3> positions;
+    std::vector<uint32_t> indices;
+    AddRandomTriangles(positions, indices, 500, 7);
+
+    // Not a multiple of 8 wide, so the last lanes of a row are masked.
+    SoftwareOcclusion avx2, scalar;
+    scalar.SetUseAvx2(false);
+    CHECK(avx2.IsUsingAvx2());
+    CHECK(!scalar.IsUsingAvx2());
+    for (SoftwareOcclusion *occlusion : {&avx2, &scalar}) {
+        occlusion->Resize(250, 141);
+        occlusion->BeginFrame(GetViewProj());
+        occlusion->RasterizeOccluder(positions, indices, Matrix());
+        occlusion->EndFrame();
+    }
+
+    CHECK_EQ(avx2.m_stats.trianglesRasterized,
+             scalar.m_stats.trianglesRasterized);
+    int written = 0, different = 0;
+    for (int y = 0; y < avx2.GetHeight(); y++) {
+        for (int x = 0; x < avx2.GetWidth(); x++) {
+            written += avx2.GetDepth(y)[x] < 1.0f;
+            different += avx2.GetDepth(y)[x] != scalar.GetDepth(y)[x];
+        }
+    }
+    CHECK_LT(0, written);
+    CHECK_EQ(different, 0);
+
+    std::mt19937 random(11);
+    std::uniform_real_distribution<float> position(-6.0f, 6.0f);
+    std::uniform_real_distribution<float> size(0.05f, 2.0f);
+    int mismatches = 0;
+    for (int i = 0; i < 1000; i++) {
+        const Vector3 boxMin(position(random), position(random),
+                             position(random) + 8.0f);
+        const Vector3 boxMax =
+            boxMin + Vector3(size(random), size(random), size(random));
+        mismatches += avx2.IsVisible(boxMin, boxMax) !=
+                      scalar.IsVisible(boxMin, boxMax);
+    }
+    CHECK_EQ(mismatches, 0);
+}
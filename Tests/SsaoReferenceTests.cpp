@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <random>
+
+#include "JobSystem.h"
+#include "SsaoReference.h"
+#include "Test.h"
+
+using namespace jRenderer;
+using namespace DirectX;
+using namespace DirectX::SimpleMath;
+
+namespace {
+
+constexpr uint32_t WIDTH = 160;
+constexpr uint32_t HEIGHT = 90;
+
+// A floor, a wall and a box on the floor, seen from the origin looking
+// down +z, so view space is world space. Distances along a ray are its z.
+// Sky above the wall.
+struct SyntheticScene {
+    GBufferCapture capture;
+    std::vector<float> viewZ;
+    Vector4 kernel[MAX_SAMPLES];
+    Vector3 noise[16];
+
+    SyntheticScene() {
+        capture.width = WIDTH;
+        capture.height = HEIGHT;
+        capture.projRow = XMMatrixPerspectiveFovLH(
+            XMConvertToRadians(70.0f), float(WIDTH) / HEIGHT, 0.1f, 100.0f);
+        const Matrix invProj = capture.projRow.Invert();
+        const Matrix &p = capture.projRow;
+
+        capture.depth.assign(WIDTH * HEIGHT, 1.0f);
+        capture.normal.assign(WIDTH * HEIGHT, Vector3(0.0f, 0.0f, -1.0f));
+        viewZ.assign(WIDTH * HEIGHT, 100.0f);
+        for (uint32_t y = 0; y < HEIGHT; y++) {
+            for (uint32_t x = 0; x < WIDTH; x++) {
+                const float u = (float(x) + 0.5f) / WIDTH;
+                const float v = (float(y) + 0.5f) / HEIGHT;
+                Vector3 ray = Vector3::Transform(
+                    Vector3(u * 2.0f - 1.0f, 1.0f - v * 2.0f, 1.0f),
+                    invProj);
+                ray /= ray.z; // at z = 1
+
+                float t = 1e30f;
+                Vector3 normal;
+                auto hit = [&](float distance, const Vector3 &n,
+                               bool isInside) {
+                    if (distance > 0.0f && distance < t && isInside) {
+                        t = distance;
+                        normal = n;
+                    }
+                };
+                // Floor y = -1, wall z = 6 up to y = 2
+                if (ray.y < 0.0f)
+                    hit(-1.0f / ray.y, Vector3(0.0f, 1.0f, 0.0f), true);
+                hit(6.0f, Vector3(0.0f, 0.0f, -1.0f), ray.y * 6.0f < 2.0f);
+                // Box [0.5, 2] x [-1, -0.3] x [4, 5.5], its top and front
+                if (ray.y < 0.0f) {
+                    const Vector3 top = ray * (-0.3f / ray.y);
+                    hit(top.z, Vector3(0.0f, 1.0f, 0.0f),
+                        top.x >= 0.5f && top.x <= 2.0f && top.z >= 4.0f &&
+                            top.z <= 5.5f);
+                }
+                const Vector3 front = ray * 4.0f;
+                hit(4.0f, Vector3(0.0f, 0.0f, -1.0f),
+                    front.x >= 0.5f && front.x <= 2.0f && front.y >= -1.0f &&
+                        front.y <= -0.3f);
+                if (t > 1e29f)
+                    continue; // sky
+
+                const size_t i = y * WIDTH + x;
+                capture.depth[i] = (t * p._33 + p._43) / (t * p._34 + p._44);
+                capture.normal[i] = normal;
+                viewZ[i] = t;
+            }
+        }
+
+        // Like AppBase, from the raw sequence so it is the same everywhere
+        std::mt19937 random(1);
+        auto uniform = [&]() { return float(random()) / 4294967296.0f; };
+        for (auto &n : noise)
+            n = Vector3(uniform() * 2.0f - 1.0f, uniform() * 2.0f - 1.0f,
+                        0.0f);
+        for (int i = 0; i < MAX_SAMPLES; i++) {
+            Vector3 sample(uniform() * 2.0f - 1.0f, uniform() * 2.0f - 1.0f,
+                           uniform());
+            sample.Normalize();
+            const float scale = float(i) / MAX_SAMPLES;
+            sample *= 0.1f + 0.9f * scale * scale;
+            kernel[i] = Vector4(sample, 0.0f);
+        }
+    }
+};
+
+// The 9x9 bilateral blur that Blur() splits into two passes
+std::vector<float> Blur2D(const SyntheticScene &scene,
+                          const SsaoConstants &consts,
+                          const std::vector<float> &ao) {
+    const float weights[SSAO_BLUR_RADIUS + 1] = {
+        1.0f, 0.8824969f, 0.6065307f, 0.3246525f, 0.1353353f};
+    std::vector<float> result(ao.size());
+    for (int y = 0; y < int(HEIGHT); y++) {
+        for (int x = 0; x < int(WIDTH); x++) {
+            const float z = scene.viewZ[y * WIDTH + x];
+            float sum = 0.0f, weightSum = 0.0f;
+            for (int j = -SSAO_BLUR_RADIUS; j <= SSAO_BLUR_RADIUS; j++) {
+                for (int i = -SSAO_BLUR_RADIUS; i <= SSAO_BLUR_RADIUS; i++) {
+                    const int sx = std::clamp(x + i, 0, int(WIDTH) - 1);
+                    const int sy = std::clamp(y + j, 0, int(HEIGHT) - 1);
+                    const float diff =
+                        std::abs(z - scene.viewZ[sy * WIDTH + sx]) /
+                        (z * consts.depthSigma);
+                    const float weight = weights[std::abs(i)] *
+                                         weights[std::abs(j)] *
+                                         std::exp(-diff * diff);
+                    sum += ao[sy * WIDTH + sx] * weight;
+                    weightSum += weight;
+                }
+            }
+            result[y * WIDTH + x] = sum / weightSum;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(SsaoReference, SeparableBlurMatches2D) {
+    JobSystem::Initialize(2);
+    const SyntheticScene scene;
+    const SsaoReference reference(scene.capture, scene.kernel, scene.noise);
+    SsaoConstants consts;
+    consts.scale = 1;
+    reference.SetSizes(consts);
+    std::vector<float> ao, aoDepth, blurred;
+    reference.ComputeAO(consts, ao, aoDepth);
+    reference.Blur(consts, ao, blurred);
+    const auto expected = Blur2D(scene, consts, ao);
+
+    double sum = 0.0;
+    float maxError = 0.0f;
+    for (size_t i = 0; i < ao.size(); i++) {
+        const float error = std::abs(blurred[i] - expected[i]);
+        sum += error;
+        maxError = std::max(maxError, error);
+    }
+    // 0.0004 and 0.15, the passes only differ where the depth weights of
+    // the two directions disagree, at the edges of the box.
+    CHECK_LE(float(sum / ao.size()), 0.001f);
+    CHECK_LE(maxError, 0.2f);
+    JobSystem::Shutdown();
+}
+
+TEST(SsaoReference, FullResolutionMatchesReference) {
+    JobSystem::Initialize(2);
+    const SyntheticScene scene;
+    const SsaoReference reference(scene.capture, scene.kernel, scene.noise);
+    SsaoConstants consts;
+    consts.scale = 1;
+    consts.sampleCount = MAX_SAMPLES;
+    const SsaoEvaluation eval = reference.Evaluate(consts, 4);
+    CHECK_EQ(eval.meanError, 0.0f);
+    CHECK_EQ(eval.maxError, 0.0f);
+    JobSystem::Shutdown();
+}
+
+TEST(SsaoReference, Upsample) {
+    JobSystem::Initialize(2);
+    const SyntheticScene scene;
+    const SsaoReference reference(scene.capture, scene.kernel, scene.noise);
+    SsaoConstants consts;
+    consts.sampleCount = MAX_SAMPLES;
+    consts.temporalAlpha = 1.0f;
+
+    // All samples, so only the upsample is off. Large errors stay at the
+    // silhouette of the box.
+    consts.scale = 2;
+    SsaoEvaluation eval = reference.Evaluate(consts, 1);
+    CHECK_LE(eval.meanError, 0.03f); // 0.023
+    CHECK_LE(24.0f, eval.psnr);      // 24.3 dB
+    consts.scale = 4;
+    eval = reference.Evaluate(consts, 1);
+    CHECK_LE(eval.meanError, 0.04f); // 0.031
+    CHECK_LE(20.0f, eval.psnr);      // 20.8 dB
+    JobSystem::Shutdown();
+}
+
+TEST(SsaoReference, TemporalAccumulation) {
+    JobSystem::Initialize(2);
+    const SyntheticScene scene;
+    const SsaoReference reference(scene.capture, scene.kernel, scene.noise);
+    SsaoConstants consts;
+    consts.sampleCount = 16;
+
+    // 16 samples rotated over 4 frames converge to the 64 sample AO.
+    consts.scale = 1;
+    consts.temporalAlpha = 1.0f;
+    const SsaoEvaluation noHistory = reference.Evaluate(consts, 8);
+    consts.temporalAlpha = 0.25f;
+    SsaoEvaluation eval = reference.Evaluate(consts, 8);
+    CHECK_LE(eval.firstFrameMeanError, 0.12f); // 0.089
+    CHECK_LE(eval.meanError, 0.015f);          // 0.010
+    CHECK_LE(eval.meanError, noHistory.meanError * 0.25f);
+    CHECK_LE(eval.maxError, 0.08f); // 0.055
+
+    consts.scale = 2;
+    eval = reference.Evaluate(consts, 8);
+    CHECK_LE(eval.meanError, 0.04f); // 0.029
+    CHECK_LE(eval.meanError, eval.firstFrameMeanError * 0.6f);
+    JobSystem::Shutdown();
+}
@@ -0,0 +1,316 @@
+#pragma once
+
+// The subset of DirectXTK SimpleMath the headless tests build against where
+// DirectXTK isn't available. Same row-vector conventions (v * M) and the
+// same left-handed D3D projections as DirectXMath.
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// MSVC only, the tests don't need the constant buffer alignment.
+#ifndef _MSC_VER
+#define __declspec(x)
+#endif
+
+namespace DirectX {
+
+constexpr float XM_PI = 3.141592654f;
+constexpr float XM_2PI = 6.283185307f;
+constexpr float XM_PIDIV2 = 1.570796327f;
+constexpr float XM_PIDIV4 = 0.785398163f;
+
+inline float XMConvertToRadians(float degrees) {
+    return degrees * (XM_PI / 180.0f);
+}
+
+struct XMFLOAT2 {
+    float x = 0.0f, y = 0.0f;
+};
+
+struct XMFLOAT3 {
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+};
+
+struct XMFLOAT4 {
+    float x = 0.0f, y = 0.0f, z = 0.0f, w = 0.0f;
+};
+
+namespace SimpleMath {
+
+struct Matrix;
+
+struct Vector2 : XMFLOAT2 {
+    Vector2() = default;
+    explicit Vector2(float s) : XMFLOAT2{s, s} {}
+    Vector2(float x, float y) : XMFLOAT2{x, y} {}
+
+    Vector2 operator+(const Vector2 &v) const { return {x + v.x, y + v.y}; }
+    Vector2 operator-(const Vector2 &v) const { return {x - v.x, y - v.y}; }
+    Vector2 operator*(float s) const { return {x * s, y * s}; }
+    bool operator==(const Vector2 &v) const { return x == v.x && y == v.y; }
+
+    float Dot(const Vector2 &v) const { return x * v.x + y * v.y; }
+    float Length() const { return std::sqrt(Dot(*this)); }
+};
+
+struct Vector3 : XMFLOAT3 {
+    Vector3() = default;
+    explicit Vector3(float s) : XMFLOAT3{s, s, s} {}
+    Vector3(float x, float y, float z) : XMFLOAT3{x, y, z} {}
+    Vector3(const XMFLOAT3 &v) : XMFLOAT3(v) {}
+
+    Vector3 operator+(const Vector3 &v) const {
+        return {x + v.x, y + v.y, z + v.z};
+    }
+    Vector3 operator-(const Vector3 &v) const {
+        return {x - v.x, y - v.y, z - v.z};
+    }
+    Vector3 operator*(const Vector3 &v) const {
+        return {x * v.x, y * v.y, z * v.z};
+    }
+    Vector3 operator*(float s) const { return {x * s, y * s, z * s}; }
+    Vector3 operator/(float s) const { return {x / s, y / s, z / s}; }
+    Vector3 operator-() const { return {-x, -y, -z}; }
+    Vector3 &operator+=(const Vector3 &v) { return *this = *this + v; }
+    Vector3 &operator-=(const Vector3 &v) { return *this = *this - v; }
+    Vector3 &operator*=(float s) { return *this = *this * s; }
+    Vector3 &operator/=(float s) { return *this = *this / s; }
+    bool operator==(const Vector3 &v) const {
+        return x == v.x && y == v.y && z == v.z;
+    }
+    bool operator!=(const Vector3 &v) const { return !(*this == v); }
+
+    float Dot(const Vector3 &v) const { return x * v.x + y * v.y + z * v.z; }
+    Vector3 Cross(const Vector3 &v) const {
+        return {y * v.z - z * v.y, z * v.x - x * v.z, x * v.y - y * v.x};
+    }
+    float Length() const { return std::sqrt(Dot(*this)); }
+    float LengthSquared() const { return Dot(*this); }
+    void Normalize() {
+        const float length = Length();
+        if (length > 0.0f)
+            *this /= length;
+    }
+    void Normalize(Vector3 &result) const {
+        result = *this;
+        result.Normalize();
+    }
+
+    static float Distance(const Vector3 &a, const Vector3 &b) {
+        return (a - b).Length();
+    }
+    static float DistanceSquared(const Vector3 &a, const Vector3 &b) {
+        return (a - b).LengthSquared();
+    }
+    static Vector3 Min(const Vector3 &a, const Vector3 &b) {
+        return {std::min(a.x, b.x), std::min(a.y, b.y), std::min(a.z, b.z)};
+    }
+    static Vector3 Max(const Vector3 &a, const Vector3 &b) {
+        return {std::max(a.x, b.x), std::max(a.y, b.y), std::max(a.z, b.z)};
+    }
+    static Vector3 Lerp(const Vector3 &a, const Vector3 &b, float t) {
+        return a + (b - a) * t;
+    }
+    static Vector3 Transform(const Vector3 &v, const Matrix &m);
+    static Vector3 TransformNormal(const Vector3 &v, const Matrix &m);
+};
+
+inline Vector3 operator*(float s, const Vector3 &v) { return v * s; }
+
+struct Vector4 : XMFLOAT4 {
+    Vector4() = default;
+    explicit Vector4(float s) : XMFLOAT4{s, s, s, s} {}
+    Vector4(float x, float y, float z, float w) : XMFLOAT4{x, y, z, w} {}
+    Vector4(const Vector3 &v, float w) : XMFLOAT4{v.x, v.y, v.z, w} {}
+
+    Vector4 operator+(const Vector4 &v) const {
+        return {x + v.x, y + v.y, z + v.z, w + v.w};
+    }
+    Vector4 operator-(const Vector4 &v) const {
+        return {x - v.x, y - v.y, z - v.z, w - v.w};
+    }
+    Vector4 operator*(float s) const { return {x * s, y * s, z * s, w * s}; }
+    Vector4 operator/(float s) const { return {x / s, y / s, z / s, w / s}; }
+
+    float Dot(const Vector4 &v) const {
+        return x * v.x + y * v.y + z * v.z + w * v.w;
+    }
+    float Length() const { return std::sqrt(Dot(*this)); }
+
+    static Vector4 Transform(const Vector4 &v, const Matrix &m);
+};
+
+struct Matrix {
+    union {
+        float m[4][4];
+        struct {
+            float _11, _12, _13, _14;
+            float _21, _22, _23, _24;
+            float _31, _32, _33, _34;
+            float _41, _42, _43, _44;
+        };
+    };
+
+    Matrix() : m{{1, 0, 0, 0}, {0, 1, 0, 0}, {0, 0, 1, 0}, {0, 0, 0, 1}} {}
+
+    Matrix operator*(const Matrix &other) const {
+        Matrix r;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                r.m[i][j] = 0.0f;
+                for (int k = 0; k < 4; k++)
+                    r.m[i][j] += m[i][k] * other.m[k][j];
+            }
+        }
+        return r;
+    }
+    bool operator==(const Matrix &other) const {
+        return !std::memcmp(m, other.m, sizeof(m));
+    }
+    bool operator!=(const Matrix &other) const { return !(*this == other); }
+
+    Vector3 Translation() const { return {_41, _42, _43}; }
+    void Translation(const Vector3 &v) {
+        _41 = v.x;
+        _42 = v.y;
+        _43 = v.z;
+    }
+
+    Matrix Transpose() const {
+        Matrix r;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++)
+                r.m[i][j] = m[j][i];
+        }
+        return r;
+    }
+
+    // Gauss-Jordan with partial pivoting
+    Matrix Invert() const {
+        double a[4][8];
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                a[i][j] = m[i][j];
+                a[i][j + 4] = i == j ? 1.0 : 0.0;
+            }
+        }
+        for (int c = 0; c < 4; c++) {
+            int pivot = c;
+            for (int r = c + 1; r < 4; r++) {
+                if (std::fabs(a[r][c]) > std::fabs(a[pivot][c]))
+                    pivot = r;
+            }
+            for (int j = 0; j < 8; j++)
+                std::swap(a[c][j], a[pivot][j]);
+            const double d = a[c][c];
+            for (int j = 0; j < 8; j++)
+                a[c][j] /= d;
+            for (int r = 0; r < 4; r++) {
+                if (r == c)
+                    continue;
+                const double f = a[r][c];
+                for (int j = 0; j < 8; j++)
+                    a[r][j] -= f * a[c][j];
+            }
+        }
+        Matrix r;
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++)
+                r.m[i][j] = float(a[i][j + 4]);
+        }
+        return r;
+    }
+
+    static Matrix CreateTranslation(const Vector3 &v) {
+        Matrix r;
+        r.Translation(v);
+        return r;
+    }
+    static Matrix CreateTranslation(float x, float y, float z) {
+        return CreateTranslation(Vector3(x, y, z));
+    }
+    static Matrix CreateScale(float s) {
+        Matrix r;
+        r._11 = r._22 = r._33 = s;
+        return r;
+    }
+    static Matrix CreateScale(const Vector3 &s) {
+        Matrix r;
+        r._11 = s.x;
+        r._22 = s.y;
+        r._33 = s.z;
+        return r;
+    }
+    static Matrix CreateRotationY(float radians) {
+        Matrix r;
+        r._11 = r._33 = std::cos(radians);
+        r._31 = std::sin(radians);
+        r._13 = -r._31;
+        return r;
+    }
+};
+
+inline Vector4 Vector4::Transform(const Vector4 &v, const Matrix &m) {
+    const float in[4] = {v.x, v.y, v.z, v.w};
+    float out[4] = {};
+    for (int j = 0; j < 4; j++) {
+        for (int k = 0; k < 4; k++)
+            out[j] += in[k] * m.m[k][j];
+    }
+    return {out[0], out[1], out[2], out[3]};
+}
+
+inline Vector3 Vector3::Transform(const Vector3 &v, const Matrix &m) {
+    const Vector4 r = Vector4::Transform(Vector4(v, 1.0f), m);
+    return Vector3(r.x, r.y, r.z) / r.w;
+}
+
+inline Vector3 Vector3::TransformNormal(const Vector3 &v, const Matrix &m) {
+    const Vector4 r = Vector4::Transform(Vector4(v, 0.0f), m);
+    return {r.x, r.y, r.z};
+}
+
+struct Plane : XMFLOAT4 {
+    Plane() = default;
+    Plane(const Vector3 &normal, float d)
+        : XMFLOAT4{normal.x, normal.y, normal.z, d} {}
+    Vector3 Normal() const { return {x, y, z}; }
+    float D() const { return w; }
+};
+
+} // namespace SimpleMath
+
+// DirectXMath returns an XMMATRIX, the callers convert it to a Matrix.
+inline SimpleMath::Matrix XMMatrixPerspectiveFovLH(float fovY, float aspect,
+                                                   float nearZ, float farZ) {
+    SimpleMath::Matrix p;
+    const float yScale = 1.0f / std::tan(fovY * 0.5f);
+    p._11 = yScale / aspect;
+    p._22 = yScale;
+    p._33 = farZ / (farZ - nearZ);
+    p._34 = 1.0f;
+    p._43 = -nearZ * farZ / (farZ - nearZ);
+    p._44 = 0.0f;
+    return p;
+}
+
+inline SimpleMath::Matrix XMMatrixLookAtLH(const SimpleMath::Vector3 &eye,
+                                           const SimpleMath::Vector3 &at,
+                                           const SimpleMath::Vector3 &up) {
+    SimpleMath::Vector3 z = at - eye;
+    z.Normalize();
+    SimpleMath::Vector3 x = up.Cross(z);
+    x.Normalize();
+    const SimpleMath::Vector3 y = z.Cross(x);
+    SimpleMath::Matrix v;
+    v._11 = x.x, v._21 = x.y, v._31 = x.z;
+    v._12 = y.x, v._22 = y.y, v._32 = y.z;
+    v._13 = z.x, v._23 = z.y, v._33 = z.z;
+    v._41 = -x.Dot(eye);
+    v._42 = -y.Dot(eye);
+    v._43 = -z.Dot(eye);
+    return v;
+}
+
+} // namespace DirectX
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// A small test harness for the parts of the renderer that don't need D3D.
+// TEST(Suite, Name) registers a test, the CHECKs record a failure and keep
+// going. "jRendererTests Suite" runs the tests of one suite, CTest runs one
+// suite per test.
+
+namespace jRenderer::test {
+
+struct TestCase {
+    std::string suite;
+    std::string name;
+    std::function<void()> run;
+};
+
+inline std::vector<TestCase> &GetTests() {
+    static std::vector<TestCase> tests;
+    return tests;
+}
+
+inline int &GetFailures() {
+    static int failures = 0;
+    return failures;
+}
+
+struct Registrar {
+    Registrar(const char *suite, const char *name, void (*run)()) {
+        GetTests().push_back({suite, name, run});
+    }
+};
+
+template <typename A, typename B>
+void Fail(const char *file, int line, const char *expression, const A &a,
+          const B &b) {
+    std::cerr << file << ":" << line << ": CHECK(" << expression
+              << ") failed, " << a << " vs " << b << "\n";
+    GetFailures()++;
+}
+
+} // namespace jRenderer::test
+
+#define TEST(suite, name)                                                      \
+    static void suite##_##name();                                              \
+    static const jRenderer::test::Registrar suite##_##name##_registrar(        \
+        #suite, #name, suite##_##name);                                        \
+    static void suite##_##name()
+
+#define CHECK(condition)                                                       \
+    do {                                                                       \
+        if (!(condition)) {                                                    \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK("             \
+                      << #condition << ") failed\n";                           \
+            jRenderer::test::GetFailures()++;                                  \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_OP(a, op, b)                                                     \
+    do {                                                                       \
+        const auto checkA = (a);                                               \
+        const auto checkB = (b);                                               \
+        if (!(checkA op checkB))                                               \
+            jRenderer::test::Fail(__FILE__, __LINE__, #a " " #op " " #b,       \
+                                  checkA, checkB);                             \
+    } while (0)
+
+#define CHECK_EQ(a, b) CHECK_OP(a, ==, b)
+#define CHECK_LE(a, b) CHECK_OP(a, <=, b)
+#define CHECK_LT(a, b) CHECK_OP(a, <, b)
+#define CHECK_NEAR(a, b, tolerance) CHECK_LE(std::abs((a) - (b)), tolerance)
@@ -0,0 +1,24 @@
+#include <cstring>
+
+#include "Test.h"
+
+int main(int argc, char *argv[]) {
+    using namespace jRenderer::test;
+    const char *suite = argc > 1 ? argv[1] : nullptr;
+    int ran = 0;
+    for (const auto &test : GetTests()) {
+        if (suite && test.suite != suite)
+            continue;
+        const int failures = GetFailures();
+        test.run();
+        std::cout << (GetFailures() == failures ? "[ OK ] " : "[FAIL] ")
+                  << test.suite << "." << test.name << "\n";
+        ran++;
+    }
+    if (!ran) {
+        std::cerr << "No tests in " << (suite ? suite : "any suite") << "\n";
+        return 1;
+    }
+    std::cout << ran << " tests, " << GetFailures() << " failed checks\n";
+    return GetFailures() ? 1 : 0;
+}
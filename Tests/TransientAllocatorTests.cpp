@@ -0,0 +1,133 @@
+#include <algorithm>
+#include <random>
+
+#include "Test.h"
+#include "TransientAllocator.h"
+
+using namespace jRenderer;
+
+namespace {
+
+TransientTextureDesc MakeDesc(uint32_t width, uint32_t height,
+                              uint32_t format = 10, uint32_t bindFlags = 0x28,
+                              uint32_t sampleCount = 1) {
+    TransientTextureDesc desc;
+    desc.width = width;
+    desc.height = height;
+    desc.format = format;
+    desc.bindFlags = bindFlags;
+    desc.sampleCount = sampleCount;
+    desc.bytesPerPixel = 8;
+    return desc;
+}
+
+} // namespace
+
+TEST(TransientAllocator, AliasesDisjointLifetimes) {
+    const auto desc = MakeDesc(1920, 1080);
+    TransientAllocator allocator;
+    const uint32_t a = allocator.Request(desc, 0, 2);
+    const uint32_t b = allocator.Request(desc, 3, 5);
+    const uint32_t c = allocator.Request(desc, 1, 4);
+    const uint32_t d = allocator.Request(desc, 5, 6); // starts as b ends
+    allocator.Allocate();
+
+    CHECK_EQ(allocator.GetTexture(a), allocator.GetTexture(b));
+    CHECK(allocator.GetTexture(c) != allocator.GetTexture(a));
+    CHECK(allocator.GetTexture(d) != allocator.GetTexture(b));
+    CHECK_EQ(allocator.GetTexture(d), allocator.GetTexture(c));
+    CHECK_EQ(allocator.GetNumTextures(), 2u);
+
+    const auto &stats = allocator.GetStats();
+    CHECK_EQ(stats.requests, 4u);
+    CHECK_EQ(stats.naiveBytes, 4 * desc.GetBytes());
+    CHECK_EQ(stats.pooledBytes, 2 * desc.GetBytes());
+    CHECK_EQ(stats.livePeakBytes, 2 * desc.GetBytes());
+}
+
+TEST(TransientAllocator, KeysOnSizeFormatBindFlagsAndSamples) {
+    const TransientTextureDesc descs[] = {
+        MakeDesc(1920, 1080),           MakeDesc(960, 1080),
+        MakeDesc(1920, 540),            MakeDesc(1920, 1080, 24),
+        MakeDesc(1920, 1080, 10, 0x08), MakeDesc(1920, 1080, 10, 0x28, 4),
+    };
+    // One after the other, so only the keys keep them apart.
+    TransientAllocator allocator;
+    uint32_t pass = 0;
+    for (const auto &desc : descs) {
+        allocator.Request(desc, pass, pass);
+        pass++;
+    }
+    allocator.Allocate();
+    CHECK_EQ(allocator.GetNumTextures(), uint32_t(std::size(descs)));
+
+    // bytesPerPixel is only for the stats.
+    TransientTextureDesc other = descs[0];
+    other.bytesPerPixel = 4;
+    const uint32_t request = allocator.Request(other, pass, pass);
+    allocator.Allocate();
+    CHECK_EQ(allocator.GetTexture(request), allocator.GetTexture(0));
+    CHECK_EQ(allocator.GetNumTextures(), uint32_t(std::size(descs)));
+}
+
+TEST(TransientAllocator, RandomFrames) {
+    const TransientTextureDesc keys[] = {
+        MakeDesc(1920, 1080), MakeDesc(960, 540), MakeDesc(1920, 1080, 24),
+        MakeDesc(1920, 1080, 10, 0x28, 4)};
+    const uint32_t numKeys = uint32_t(std::size(keys));
+    struct Request {
+        uint32_t key, first, last;
+    };
+    std::mt19937 random(2);
+    TransientAllocator allocator;
+
+    int overlaps = 0, wrongKeys = 0, notOptimal = 0, tooManyBytes = 0;
+    for (int frame = 0; frame < 500; frame++) {
+        allocator.Clear();
+        std::vector<Request> requests(random() % 40);
+        const uint32_t numPasses = 2 + random() % 30;
+        for (auto &request : requests) {
+            request.key = random() % numKeys;
+            request.first = random() % numPasses;
+            request.last =
+                request.first + random() % (numPasses - request.first);
+            allocator.Request(keys[request.key], request.first, request.last);
+        }
+        allocator.Allocate();
+
+        for (size_t i = 0; i < requests.size(); i++) {
+            const uint32_t texture = allocator.GetTexture(uint32_t(i));
+            wrongKeys += !allocator.GetTextureDesc(texture).SameKey(
+                keys[requests[i].key]);
+            for (size_t j = i + 1; j < requests.size(); j++) {
+                overlaps += texture == allocator.GetTexture(uint32_t(j)) &&
+                            requests[i].first <= requests[j].last &&
+                            requests[j].first <= requests[i].last;
+            }
+        }
+
+        // As many textures of a key as its requests live in one pass
+        uint32_t minTextures = 0;
+        for (uint32_t key = 0; key < numKeys; key++) {
+            uint32_t maxLive = 0;
+            for (uint32_t pass = 0; pass < numPasses; pass++) {
+                uint32_t live = 0;
+                for (const auto &request : requests) {
+                    live += request.key == key && request.first <= pass &&
+                            pass <= request.last;
+                }
+                maxLive = std::max(maxLive, live);
+            }
+            minTextures += maxLive;
+        }
+        notOptimal += allocator.GetNumTextures() != minTextures;
+
+        const auto &stats = allocator.GetStats();
+        tooManyBytes += stats.livePeakBytes > stats.pooledBytes ||
+                        stats.pooledBytes > stats.naiveBytes;
+    }
+    CHECK_EQ(overlaps, 0);
+    CHECK_EQ(wrongKeys, 0);
+    CHECK_EQ(notOptimal, 0);
+    CHECK_EQ(tooManyBytes, 0);
+}
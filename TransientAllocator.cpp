@@ -0,0 +1,75 @@
+#include "TransientAllocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <numeric>
+
+namespace jRenderer {
+
+uint32_t TransientAllocator::Request(const TransientTextureDesc &desc,
+                                     uint32_t firstPass, uint32_t lastPass) {
+    assert(firstPass <= lastPass);
+    m_requests.push_back({desc, firstPass, lastPass, UINT32_MAX});
+    return uint32_t(m_requests.size() - 1);
+}
+
+void TransientAllocator::Allocate() {
+    m_textures.clear();
+    m_textureLastPass.clear();
+
+    std::vector<uint32_t> order(m_requests.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+        return m_requests[a].firstPass < m_requests[b].firstPass;
+    });
+
+    for (uint32_t i : order) {
+        auto &request = m_requests[i];
+
+        // The free texture released last, the others stay free for longer
+        uint32_t best = UINT32_MAX;
+        for (uint32_t t = 0; t < uint32_t(m_textures.size()); t++) {
+            if (!m_textures[t].SameKey(request.desc) ||
+                m_textureLastPass[t] >= request.firstPass)
+                continue;
+            if (best == UINT32_MAX ||
+                m_textureLastPass[t] > m_textureLastPass[best])
+                best = t;
+        }
+        if (best == UINT32_MAX) {
+            best = uint32_t(m_textures.size());
+            m_textures.push_back(request.desc);
+            m_textureLastPass.push_back(0);
+        }
+        request.texture = best;
+        m_textureLastPass[best] = request.lastPass;
+    }
+
+    m_stats = TransientStats();
+    m_stats.requests = uint32_t(m_requests.size());
+    m_stats.textures = uint32_t(m_textures.size());
+    uint32_t lastPass = 0;
+    for (const auto &request : m_requests) {
+        m_stats.naiveBytes += request.desc.GetBytes();
+        lastPass = std::max(lastPass, request.lastPass);
+    }
+    for (const auto &texture : m_textures)
+        m_stats.pooledBytes += texture.GetBytes();
+    for (uint32_t pass = 0; pass <= lastPass && !m_requests.empty(); pass++) {
+        uint64_t liveBytes = 0;
+        for (const auto &request : m_requests) {
+            if (request.firstPass <= pass && pass <= request.lastPass)
+                liveBytes += request.desc.GetBytes();
+        }
+        m_stats.livePeakBytes = std::max(m_stats.livePeakBytes, liveBytes);
+    }
+}
+
+void TransientAllocator::Clear() {
+    m_requests.clear();
+    m_textures.clear();
+    m_textureLastPass.clear();
+    m_stats = TransientStats();
+}
+
+} // namespace jRenderer
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace jRenderer {
+
+// Textures with the same key can stand in for each other.
+struct TransientTextureDesc {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t format = 0;    // DXGI_FORMAT
+    uint32_t bindFlags = 0; // D3D11_BIND_FLAG
+    uint32_t sampleCount = 1;
+    uint32_t bytesPerPixel = 0; // only for the stats, not part of the key
+
+    bool SameKey(const TransientTextureDesc &other) const {
+        return width == other.width && height == other.height &&
+               format == other.format && bindFlags == other.bindFlags &&
+               sampleCount == other.sampleCount;
+    }
+    uint64_t GetBytes() const {
+        return uint64_t(width) * height * sampleCount * bytesPerPixel;
+    }
+};
+
+struct TransientStats {
+    uint32_t requests = 0;
+    uint32_t textures = 0;
+    uint64_t naiveBytes = 0;  // a texture per request
+    uint64_t pooledBytes = 0; // the textures after Allocate()
+    // Most bytes live in one pass. What heap aliasing across formats
+    // could get down to, D3D11 can only share whole textures.
+    uint64_t livePeakBytes = 0;
+};
+
+// Assigns the transient textures of a frame to as few textures as
+// possible. Requests with the same key whose pass ranges don't overlap
+// get the same texture. CPU only, RenderTargetPool creates the textures.
+class TransientAllocator {
+  public:
+    // A texture written first in firstPass and read last in lastPass,
+    // passes in frame order. Returns the request index.
+    uint32_t Request(const TransientTextureDesc &desc, uint32_t firstPass,
+                     uint32_t lastPass);
+
+    // Interval coloring per key, in the order of the first pass. Optimal
+    // for the number of textures of each key.
+    void Allocate();
+
+    void Clear();
+
+    uint32_t GetTexture(uint32_t request) const {
+        return m_requests[request].texture;
+    }
+    const TransientTextureDesc &GetTextureDesc(uint32_t texture) const {
+        return m_textures[texture];
+    }
+    uint32_t GetNumRequests() const { return uint32_t(m_requests.size()); }
+    uint32_t GetNumTextures() const { return uint32_t(m_textures.size()); }
+    const TransientStats &GetStats() const { return m_stats; }
+
+  private:
+    struct Interval {
+        TransientTextureDesc desc;
+        uint32_t firstPass;
+        uint32_t lastPass;
+        uint32_t texture;
+    };
+
+    std::vector<Interval> m_requests;
+    std::vector<TransientTextureDesc> m_textures;
+    std::vector<uint32_t> m_textureLastPass; // while allocating
+    TransientStats m_stats;
+};
+
+} // namespace jRenderer
@@ -1,16 +1,33 @@
 #include <Windows.h>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <memory>
 
 #include "Engine.h"
+#include "GraphicsCommon.h"
+#include "JobSystem.h"
+
+int main(int argc, char *argv[]) {
+    // Post build step: compile the shaders into one archive and quit
+    if (argc == 3 && !strcmp(argv[1], "--build-shaders")) {
+        jRenderer::JobSystem::Initialize();
+        const bool built = jRenderer::Graphics::BuildShaderArchive(argv[2]);
+        jRenderer::JobSystem::Shutdown();
+        return built ? 0 : -1;
+    }
 
-int main() {
     jRenderer::Engine app;
 
+    // Renders the given number of frames, fails if any of them allocated
+    if (argc == 3 && !strcmp(argv[1], "--check-allocations"))
+        app.m_allocationCheckFrames = std::max(atoi(argv[2]), 1);
+
     if (!app.Initialize()) {
         std::cout << "Init failed" << std::endl;
         return -1;
     }
 
     return app.Run();
-}
\ No newline at end of file
+}